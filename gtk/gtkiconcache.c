@@ -424,26 +424,15 @@ pixbuf_destroy_cb (guchar   *pixels,
   _gtk_icon_cache_unref (cache);
 }
 
-GdkPixbuf *
-_gtk_icon_cache_get_icon (GtkIconCache *cache,
-			  const gchar  *icon_name,
-			  gint          directory_index)
+static GdkPixbuf *
+pixbuf_from_pixel_data (GtkIconCache *cache,
+			guint32       pixel_data_offset)
 {
-  guint32 offset, image_data_offset, pixel_data_offset;
   guint32 length, type;
   GdkPixbuf *pixbuf;
   GdkPixdata pixdata;
   GError *error = NULL;
 
-  offset = find_image_offset (cache, icon_name, directory_index);
-  
-  image_data_offset = GET_UINT32 (cache->buffer, offset + 4);
-  
-  if (!image_data_offset)
-    return NULL;
-
-  pixel_data_offset = GET_UINT32 (cache->buffer, image_data_offset);
-
   type = GET_UINT32 (cache->buffer, pixel_data_offset);
 
   if (type != 0)
@@ -474,8 +463,7 @@ _gtk_icon_cache_get_icon (GtkIconCache *cache,
   if (!pixbuf)
     {
       GTK_NOTE (ICONTHEME,
-		g_print ("could not convert pixdata to pixbuf: %s\n", error->message));
-      g_error_free (error);
+		g_print ("could not convert pixdata to pixbuf\n"));
 
       return NULL;
     }
@@ -485,6 +473,66 @@ _gtk_icon_cache_get_icon (GtkIconCache *cache,
   return pixbuf;
 }
 
+GdkPixbuf *
+_gtk_icon_cache_get_icon (GtkIconCache *cache,
+			  const gchar  *icon_name,
+			  gint          directory_index)
+{
+  guint32 offset, image_data_offset, pixel_data_offset;
+
+  offset = find_image_offset (cache, icon_name, directory_index);
+  
+  image_data_offset = GET_UINT32 (cache->buffer, offset + 4);
+  
+  if (!image_data_offset)
+    return NULL;
+
+  pixel_data_offset = GET_UINT32 (cache->buffer, image_data_offset);
+
+  return pixbuf_from_pixel_data (cache, pixel_data_offset);
+}
+
+/* Returns the image as pre-rendered at exactly @size pixels by
+ * gtk-update-icon-cache --prescale, or %NULL if the cache
+ * doesn't have it at that size.
+ */
+GdkPixbuf *
+_gtk_icon_cache_get_scaled_icon (GtkIconCache *cache,
+				 const gchar  *icon_name,
+				 gint          directory_index,
+				 gint          size)
+{
+  guint32 offset, image_data_offset, scaled_data_offset;
+  guint32 n_scaled;
+  gint i;
+
+  /* Only minor version 1 caches have the scaled data field */
+  if (GET_UINT16 (cache->buffer, 2) < 1)
+    return NULL;
+
+  offset = find_image_offset (cache, icon_name, directory_index);
+  if (!offset)
+    return NULL;
+
+  image_data_offset = GET_UINT32 (cache->buffer, offset + 4);
+  if (!image_data_offset)
+    return NULL;
+
+  scaled_data_offset = GET_UINT32 (cache->buffer, image_data_offset + 8);
+  if (!scaled_data_offset)
+    return NULL;
+
+  n_scaled = GET_UINT32 (cache->buffer, scaled_data_offset);
+  for (i = 0; i < n_scaled; i++)
+    {
+      if (GET_UINT32 (cache->buffer, scaled_data_offset + 4 + 8 * i) == size)
+	return pixbuf_from_pixel_data (cache,
+				       GET_UINT32 (cache->buffer, scaled_data_offset + 8 + 8 * i));
+    }
+
+  return NULL;
+}
+
 GtkIconData  *
 _gtk_icon_cache_get_icon_data  (GtkIconCache *cache,
 				const gchar  *icon_name,
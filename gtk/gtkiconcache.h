@@ -55,6 +55,10 @@ gint          _gtk_icon_cache_get_icon_flags (GtkIconCache *cache,
 GdkPixbuf    *_gtk_icon_cache_get_icon       (GtkIconCache *cache,
 					      const gchar  *icon_name,
 					      gint          directory_index);
+GdkPixbuf    *_gtk_icon_cache_get_scaled_icon (GtkIconCache *cache,
+						const gchar  *icon_name,
+						gint          directory_index,
+						gint          size);
 GtkIconData  *_gtk_icon_cache_get_icon_data  (GtkIconCache *cache,
  					      const gchar  *icon_name,
  					      gint          directory_index);
@@ -72,7 +72,9 @@ check_version (CacheInfo *info)
   guint16 major, minor;
 
   check ("major version", get_uint16 (info, 0, &major) && major == 1);
-  check ("minor version", get_uint16 (info, 2, &minor) && minor == 0);
+  check ("minor version", get_uint16 (info, 2, &minor) && minor <= 1);
+
+  info->minor_version = minor;
 
   return TRUE;
 }
@@ -252,15 +254,43 @@ check_meta_data (CacheInfo *info,
   return TRUE;
 }
 
+static gboolean 
+check_scaled_data (CacheInfo *info, 
+                   guint32    offset)
+{
+  guint32 n_scaled;
+  guint32 size, pixel_data_offset;
+  gint i;
+
+  check ("offset, scaled data", get_uint32 (info, offset, &n_scaled));
+
+  for (i = 0; i < n_scaled; i++)
+    {
+      check ("offset, scaled size", 
+             get_uint32 (info, offset + 4 + 8 * i, &size));
+      check ("offset, scaled pixel data", 
+             get_uint32 (info, offset + 8 + 8 * i, &pixel_data_offset));
+      check ("scaled size", size > 0);
+
+      if (!check_pixel_data (info, pixel_data_offset))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
 static gboolean 
 check_image_data (CacheInfo *info, 
                   guint32    offset)
 {
   guint32 pixel_data_offset;
   guint32 meta_data_offset;
+  guint32 scaled_data_offset = 0;
 
   check ("offset, pixel data", get_uint32 (info, offset, &pixel_data_offset));
   check ("offset, meta data", get_uint32 (info, offset + 4, &meta_data_offset));
+  if (info->minor_version >= 1)
+    check ("offset, scaled data", get_uint32 (info, offset + 8, &scaled_data_offset));
 
   if (pixel_data_offset != 0) 
     {
@@ -272,6 +302,11 @@ check_image_data (CacheInfo *info,
       if (!check_meta_data (info, meta_data_offset))
         return FALSE;
     }
+  if (scaled_data_offset != 0) 
+    {
+      if (!check_scaled_data (info, scaled_data_offset))
+        return FALSE;
+    }
 	
   return TRUE;
 }
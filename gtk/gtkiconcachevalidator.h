@@ -35,6 +35,7 @@ typedef struct {
   gsize cache_size;
   guint32 n_directories;
   gint flags;
+  guint16 minor_version;
 } CacheInfo;
 
 gboolean _gtk_icon_cache_validate (CacheInfo *info);
@@ -30,6 +30,7 @@
 #include <string.h>
 #include "gtkiconfactory.h"
 #include "gtkiconcache.h"
+#include "gtkpixbufcache.h"
 #include "gtkdebug.h"
 #include "gtkicontheme.h"
 #include "gtksettings.h"
@@ -1129,19 +1130,8 @@ static void       add_to_cache      (GtkIconSet       *icon_set,
                                      GtkStateType      state,
                                      GtkIconSize       size,
                                      GdkPixbuf        *pixbuf);
-/* Clear icon set contents, drop references to all contained
- * GdkPixbuf objects and forget all GtkIconSources. Used to
- * recycle an icon set.
- */
-static void       clear_cache       (GtkIconSet       *icon_set,
-                                     gboolean          style_detach);
-static GSList*    copy_cache        (GtkIconSet       *icon_set,
-                                     GtkIconSet       *copy_recipient);
-static void       attach_to_style   (GtkIconSet       *icon_set,
-                                     GtkStyle         *style);
-static void       detach_from_style (GtkIconSet       *icon_set,
-                                     GtkStyle         *style);
-static void       style_dnotify     (gpointer          data);
+/* Drop the rendered versions of @icon_set from the render cache */
+static void       clear_cache       (GtkIconSet       *icon_set);
 
 struct _GtkIconSet
 {
@@ -1149,12 +1139,8 @@ struct _GtkIconSet
 
   GSList *sources;
 
-  /* Cache of the last few rendered versions of the icon. */
-  GSList *cache;
-
-  guint cache_size;
-
-  guint cache_serial;
+  /* Number of rendered versions of the icon in the render cache */
+  guint n_cached;
 };
 
 static guint cache_serial = 0;
@@ -1183,9 +1169,7 @@ gtk_icon_set_new (void)
 
   icon_set->ref_count = 1;
   icon_set->sources = NULL;
-  icon_set->cache = NULL;
-  icon_set->cache_size = 0;
-  icon_set->cache_serial = cache_serial;
+  icon_set->n_cached = 0;
 
   return icon_set;
 }
@@ -1266,7 +1250,7 @@ gtk_icon_set_unref (GtkIconSet *icon_set)
         }
       g_slist_free (icon_set->sources);
 
-      clear_cache (icon_set, TRUE);
+      clear_cache (icon_set);
 
       g_free (icon_set);
     }
@@ -1312,10 +1296,6 @@ gtk_icon_set_copy (GtkIconSet *icon_set)
 
   copy->sources = g_slist_reverse (copy->sources);
 
-  copy->cache = copy_cache (icon_set, copy);
-  copy->cache_size = icon_set->cache_size;
-  copy->cache_serial = icon_set->cache_serial;
-
   return copy;
 }
 
@@ -2406,7 +2386,11 @@ gtk_icon_source_get_size (const GtkIconSource *source)
   return source->size;
 }
 
-#define NUM_CACHED_ICONS 8
+/* Rendered icons are kept in one cache shared by all icon sets, so
+ * that widgets with different but equivalent styles share them. The
+ * cache is bounded by the memory used by the pixbufs.
+ */
+#define ICON_CACHE_MAX_BYTES (1024 * 1024)
 
 typedef struct _CachedIcon CachedIcon;
 
@@ -2415,33 +2399,94 @@ struct _CachedIcon
   /* These must all match to use the cached pixbuf.
    * If any don't match, we must re-render the pixbuf.
    */
-  GtkStyle *style;
+  GtkIconSet *icon_set;
+  gpointer style_key;
   GtkTextDirection direction;
   GtkStateType state;
   GtkIconSize size;
 
-  GdkPixbuf *pixbuf;
+  /* Only set (and referenced) when style_key is the style */
+  GtkStyle *style;
 };
 
-static void
-ensure_cache_up_to_date (GtkIconSet *icon_set)
+static GtkPixbufCache *icon_cache = NULL;
+static guint icon_cache_serial = 0;
+
+/* Styles that render icons the default way only differ in the
+ * screen they are for, so all such styles on a screen are
+ * equivalent. Styles from engines with their own render_icon
+ * are only equivalent to themselves.
+ */
+static gpointer
+get_style_key (GtkStyle *style)
 {
-  if (icon_set->cache_serial != cache_serial)
-    {
-      clear_cache (icon_set, TRUE);
-      icon_set->cache_serial = cache_serial;
-    }
+  static GtkStyleClass *default_class = NULL;
+
+  if (style == NULL)
+    return NULL;
+
+  if (default_class == NULL)
+    default_class = g_type_class_ref (GTK_TYPE_STYLE);
+
+  if (GTK_STYLE_GET_CLASS (style)->render_icon != default_class->render_icon)
+    return style;
+
+  if (style->colormap)
+    return gdk_colormap_get_screen (style->colormap);
+
+  return NULL;
+}
+
+static guint
+cached_icon_hash (gconstpointer v)
+{
+  const CachedIcon *icon = v;
+
+  return GPOINTER_TO_UINT (icon->icon_set) ^
+         GPOINTER_TO_UINT (icon->style_key) ^
+         (icon->size << 8) ^ (icon->state << 4) ^ icon->direction;
+}
+
+static gboolean
+cached_icon_equal (gconstpointer a,
+                   gconstpointer b)
+{
+  const CachedIcon *icon_a = a;
+  const CachedIcon *icon_b = b;
+
+  return icon_a->icon_set == icon_b->icon_set &&
+         icon_a->style_key == icon_b->style_key &&
+         icon_a->direction == icon_b->direction &&
+         icon_a->state == icon_b->state &&
+         icon_a->size == icon_b->size;
 }
 
 static void
 cached_icon_free (CachedIcon *icon)
 {
-  g_object_unref (icon->pixbuf);
+  icon->icon_set->n_cached--;
 
   if (icon->style)
     g_object_unref (icon->style);
 
-  g_free (icon);
+  g_slice_free (CachedIcon, icon);
+}
+
+static void
+ensure_cache_up_to_date (void)
+{
+  if (icon_cache == NULL)
+    icon_cache = _gtk_pixbuf_cache_new ("icon set render cache",
+                                        ICON_CACHE_MAX_BYTES,
+                                        cached_icon_hash,
+                                        cached_icon_equal,
+                                        (GDestroyNotify) cached_icon_free);
+
+  if (icon_cache_serial != cache_serial)
+    {
+      _gtk_pixbuf_cache_remove_all (icon_cache);
+      icon_cache_serial = cache_serial;
+    }
 }
 
 static GdkPixbuf *
@@ -2451,38 +2496,17 @@ find_in_cache (GtkIconSet      *icon_set,
                GtkStateType     state,
                GtkIconSize      size)
 {
-  GSList *tmp_list;
-  GSList *prev;
-
-  ensure_cache_up_to_date (icon_set);
-
-  prev = NULL;
-  tmp_list = icon_set->cache;
-  while (tmp_list != NULL)
-    {
-      CachedIcon *icon = tmp_list->data;
-
-      if (icon->style == style &&
-          icon->direction == direction &&
-          icon->state == state &&
-          (size == (GtkIconSize)-1 || icon->size == size))
-        {
-          if (prev)
-            {
-              /* Move this icon to the front of the list. */
-              prev->next = tmp_list->next;
-              tmp_list->next = icon_set->cache;
-              icon_set->cache = tmp_list;
-            }
+  CachedIcon key;
 
-          return icon->pixbuf;
-        }
+  ensure_cache_up_to_date ();
 
-      prev = tmp_list;
-      tmp_list = g_slist_next (tmp_list);
-    }
+  key.icon_set = icon_set;
+  key.style_key = get_style_key (style);
+  key.direction = direction;
+  key.state = state;
+  key.size = size;
 
-  return NULL;
+  return _gtk_pixbuf_cache_lookup (icon_cache, &key);
 }
 
 static void
@@ -2495,188 +2519,44 @@ add_to_cache (GtkIconSet      *icon_set,
 {
   CachedIcon *icon;
 
-  ensure_cache_up_to_date (icon_set);
-
-  g_object_ref (pixbuf);
-
-  /* We have to ref the style, since if the style was finalized
-   * its address could be reused by another style, creating a
-   * really weird bug
-   */
-
-  if (style)
-    g_object_ref (style);
+  ensure_cache_up_to_date ();
 
-  icon = g_new (CachedIcon, 1);
-  icon_set->cache = g_slist_prepend (icon_set->cache, icon);
-  icon_set->cache_size++;
-
-  icon->style = style;
+  icon = g_slice_new (CachedIcon);
+  icon->icon_set = icon_set;
+  icon->style_key = get_style_key (style);
   icon->direction = direction;
   icon->state = state;
   icon->size = size;
-  icon->pixbuf = pixbuf;
-
-  if (icon->style)
-    attach_to_style (icon_set, icon->style);
-
-  if (icon_set->cache_size >= NUM_CACHED_ICONS)
-    {
-      /* Remove oldest item in the cache */
-      GSList *tmp_list;
-
-      tmp_list = icon_set->cache;
-
-      /* Find next-to-last link */
-      g_assert (NUM_CACHED_ICONS > 2);
-      while (tmp_list->next->next)
-        tmp_list = tmp_list->next;
 
-      g_assert (tmp_list != NULL);
-      g_assert (tmp_list->next != NULL);
-      g_assert (tmp_list->next->next == NULL);
-
-      /* Free the last icon */
-      icon = tmp_list->next->data;
-
-      g_slist_free (tmp_list->next);
-      tmp_list->next = NULL;
-
-      cached_icon_free (icon);
-    }
-}
-
-static void
-clear_cache (GtkIconSet *icon_set,
-             gboolean    style_detach)
-{
-  GSList *cache, *tmp_list;
-  GtkStyle *last_style = NULL;
-
-  cache = icon_set->cache;
-  icon_set->cache = NULL;
-  icon_set->cache_size = 0;
-  tmp_list = cache;
-  while (tmp_list != NULL)
-    {
-      CachedIcon *icon = tmp_list->data;
-
-      if (style_detach)
-        {
-          /* simple optimization for the case where the cache
-           * contains contiguous icons from the same style.
-           * it's safe to call detach_from_style more than
-           * once on the same style though.
-           */
-          if (last_style != icon->style)
-            {
-              detach_from_style (icon_set, icon->style);
-              last_style = icon->style;
-            }
-        }
-
-      cached_icon_free (icon);
-
-      tmp_list = g_slist_next (tmp_list);
-    }
-
-  g_slist_free (cache);
-}
-
-static GSList*
-copy_cache (GtkIconSet *icon_set,
-            GtkIconSet *copy_recipient)
-{
-  GSList *tmp_list;
-  GSList *copy = NULL;
-
-  ensure_cache_up_to_date (icon_set);
-
-  tmp_list = icon_set->cache;
-  while (tmp_list != NULL)
-    {
-      CachedIcon *icon = tmp_list->data;
-      CachedIcon *icon_copy = g_new (CachedIcon, 1);
-
-      *icon_copy = *icon;
-
-      if (icon_copy->style)
-	{
-	  attach_to_style (copy_recipient, icon_copy->style);
-	  g_object_ref (icon_copy->style);
-	}
-
-      g_object_ref (icon_copy->pixbuf);
-
-      icon_copy->size = icon->size;
-
-      copy = g_slist_prepend (copy, icon_copy);
-
-      tmp_list = g_slist_next (tmp_list);
-    }
-
-  return g_slist_reverse (copy);
-}
-
-static void
-attach_to_style (GtkIconSet *icon_set,
-                 GtkStyle   *style)
-{
-  GHashTable *table;
-
-  table = g_object_get_qdata (G_OBJECT (style),
-                              g_quark_try_string ("gtk-style-icon-sets"));
-
-  if (table == NULL)
-    {
-      table = g_hash_table_new (NULL, NULL);
-      g_object_set_qdata_full (G_OBJECT (style),
-                               g_quark_from_static_string ("gtk-style-icon-sets"),
-                               table,
-                               style_dnotify);
-    }
-
-  g_hash_table_insert (table, icon_set, icon_set);
-}
-
-static void
-detach_from_style (GtkIconSet *icon_set,
-                   GtkStyle   *style)
-{
-  GHashTable *table;
+  /* We have to ref the style if we key on it, since if the style
+   * was finalized its address could be reused by another style,
+   * creating a really weird bug
+   */
+  if (style != NULL && icon->style_key == (gpointer) style)
+    icon->style = g_object_ref (style);
+  else
+    icon->style = NULL;
 
-  table = g_object_get_qdata (G_OBJECT (style),
-                              g_quark_try_string ("gtk-style-icon-sets"));
+  icon_set->n_cached++;
 
-  if (table != NULL)
-    g_hash_table_remove (table, icon_set);
+  _gtk_pixbuf_cache_insert (icon_cache, icon, pixbuf);
 }
 
-static void
-iconsets_foreach (gpointer key,
-                  gpointer value,
-                  gpointer user_data)
+static gboolean
+cached_icon_has_set (gpointer key,
+                     gpointer value,
+                     gpointer user_data)
 {
-  GtkIconSet *icon_set = key;
+  CachedIcon *icon = key;
 
-  /* We only need to remove cache entries for the given style;
-   * but that complicates things because in destroy notify
-   * we don't know which style got destroyed, and 95% of the
-   * time all cache entries will have the same style,
-   * so this is faster anyway.
-   */
-
-  clear_cache (icon_set, FALSE);
+  return icon->icon_set == user_data;
 }
 
 static void
-style_dnotify (gpointer data)
+clear_cache (GtkIconSet *icon_set)
 {
-  GHashTable *table = data;
-
-  g_hash_table_foreach (table, iconsets_foreach, NULL);
-
-  g_hash_table_destroy (table);
+  if (icon_set->n_cached > 0)
+    _gtk_pixbuf_cache_foreach_remove (icon_cache, cached_icon_has_set, icon_set);
 }
 
 /* This allows the icon set to detect that its cache is out of date. */
@@ -41,6 +41,7 @@
 #include "gtkicontheme.h"
 #include "gtkiconfactory.h"
 #include "gtkiconcache.h"
+#include "gtkpixbufcache.h"
 #include "gtkbuiltincache.h"
 #include "gtkintl.h"
 #include "gtkmain.h"
@@ -90,7 +91,7 @@ struct _GtkIconThemePrivate
   GHashTable *unthemed_icons;
   
   /* Note: The keys of this hashtable are owned by the
-   * themedir and unthemed hashtables.
+   * unthemed hashtable.
    */
   GHashTable *all_icons;
 
@@ -102,7 +103,13 @@ struct _GtkIconThemePrivate
   long last_stat_time;
   GList *dir_mtimes;
 
+  /* set by the directory monitors, see rescan_themes() */
+  guint dirs_changed : 1;
+
   gulong reset_styles_idle;
+
+  /* Recently loaded icons, see gtk_icon_theme_load_icon() */
+  GtkPixbufCache *pixbuf_cache;
 };
 
 struct _GtkIconInfo
@@ -122,6 +129,11 @@ struct _GtkIconInfo
   /* Cache pixbuf (if there is any) */
   GdkPixbuf *cache_pixbuf;
 
+  /* Pixbuf pre-rendered at the desired size by
+   * gtk-update-icon-cache --prescale (if there is any)
+   */
+  GdkPixbuf *prescaled_pixbuf;
+
   GtkIconData *data;
   
   /* Information about the directory where
@@ -136,6 +148,7 @@ struct _GtkIconInfo
   gint desired_size;
   guint raw_coordinates : 1;
   guint forced_size     : 1;
+  guint prescaled_svg   : 1;
 
   /* Cached information if we go ahead and try to load
    * the icon.
@@ -174,8 +187,12 @@ typedef struct
   
   GtkIconCache *cache;
   
+  /* Without a cache, the directory is only scanned when
+   * the first lookup needs it; see theme_dir_ensure_scanned()
+   */
   GHashTable *icons;
   GHashTable *icon_data;
+  gboolean exists;
 } IconThemeDir;
 
 typedef struct
@@ -190,16 +207,35 @@ typedef struct
   GdkPixbuf *pixbuf;
 } BuiltinIcon;
 
+typedef struct
+{
+  char *icon_name;
+  gint size;
+  GtkIconLookupFlags flags;
+} CachedPixbuf;
+
+/* Budget for the pixbufs kept by gtk_icon_theme_load_icon();
+ * enough for a few hundred toolbar and menu sized icons.
+ */
+#define PIXBUF_CACHE_MAX_BYTES (1024 * 1024)
+
 typedef struct 
 {
   char *dir;
   time_t mtime; /* 0 == not existing or not a dir */
 
   GtkIconCache *cache;
+
+  /* NULL if dir did not exist when the themes were loaded */
+  GFileMonitor *monitor;
+
+  /* Whether rescan_themes() has to stat() dir to notice changes */
+  gboolean poll;
 } IconThemeDirMtime;
 
 static void  gtk_icon_theme_finalize   (GObject              *object);
 static void  theme_dir_destroy         (IconThemeDir         *dir);
+static void  theme_dir_ensure_scanned  (IconThemeDir         *dir);
 
 static void         theme_destroy     (IconTheme        *theme);
 static GtkIconInfo *theme_lookup_icon (IconTheme        *theme,
@@ -589,9 +625,87 @@ gtk_icon_theme_init (GtkIconTheme *icon_theme)
   priv->pixbuf_supports_svg = pixbuf_supports_svg ();
 }
 
+static void
+dir_mtime_changed (GFileMonitor      *monitor,
+		   GFile             *file,
+		   GFile             *other_file,
+		   GFileMonitorEvent  event,
+		   gpointer           user_data)
+{
+  GtkIconTheme *icon_theme = user_data;
+
+  if (event == G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED ||
+      event == G_FILE_MONITOR_EVENT_PRE_UNMOUNT)
+    return;
+
+  icon_theme->priv->dirs_changed = TRUE;
+}
+
+static IconThemeDirMtime *
+dir_mtime_new (GtkIconTheme *icon_theme,
+	       char         *dir)
+{
+  IconThemeDirMtime *dir_mtime;
+  struct stat stat_buf;
+  GFile *file;
+
+  dir_mtime = g_slice_new (IconThemeDirMtime);
+  dir_mtime->dir = dir;
+  dir_mtime->cache = NULL;
+
+  if (g_stat (dir, &stat_buf) == 0 && S_ISDIR (stat_buf.st_mode))
+    dir_mtime->mtime = stat_buf.st_mtime;
+  else
+    dir_mtime->mtime = 0;
+
+  /* Watching the directory replaces the periodic stat() in
+   * rescan_themes().  Directories that don't exist are not watched;
+   * most of the search path is missing on a typical system, and the
+   * monitor backends have to poll for those, so we stat() them
+   * ourselves to notice when they appear.  Monitors also miss changes
+   * made by other hosts to remote file systems, such as NFS, so those
+   * directories are stat()ed as well.
+   */
+  dir_mtime->monitor = NULL;
+  dir_mtime->poll = TRUE;
+  if (dir_mtime->mtime != 0)
+    {
+      file = g_file_new_for_path (dir);
+      dir_mtime->monitor = g_file_monitor_directory (file, G_FILE_MONITOR_NONE,
+						     NULL, NULL);
+      if (dir_mtime->monitor)
+	{
+	  GFileInfo *info;
+
+	  g_signal_connect (dir_mtime->monitor, "changed",
+			    G_CALLBACK (dir_mtime_changed), icon_theme);
+
+	  info = g_file_query_filesystem_info (file,
+					       G_FILE_ATTRIBUTE_FILESYSTEM_REMOTE,
+					       NULL, NULL);
+	  dir_mtime->poll = info == NULL ||
+	    g_file_info_get_attribute_boolean (info, G_FILE_ATTRIBUTE_FILESYSTEM_REMOTE);
+	  if (info)
+	    g_object_unref (info);
+	}
+      g_object_unref (file);
+    }
+
+  return dir_mtime;
+}
+
 static void
 free_dir_mtime (IconThemeDirMtime *dir_mtime)
 {
+  if (dir_mtime->monitor)
+    {
+      g_signal_handlers_disconnect_matched (dir_mtime->monitor,
+					    G_SIGNAL_MATCH_FUNC,
+					    0, 0, NULL,
+					    dir_mtime_changed, NULL);
+      g_file_monitor_cancel (dir_mtime->monitor);
+      g_object_unref (dir_mtime->monitor);
+    }
   if (dir_mtime->cache)
     _gtk_icon_cache_unref (dir_mtime->cache);
 
@@ -620,6 +734,80 @@ reset_styles_idle (gpointer user_data)
   return FALSE;
 }
 
+static guint
+cached_pixbuf_hash (gconstpointer v)
+{
+  const CachedPixbuf *cached = v;
+
+  return g_str_hash (cached->icon_name) ^ (cached->size << 8) ^ cached->flags;
+}
+
+static gboolean
+cached_pixbuf_equal (gconstpointer a,
+		     gconstpointer b)
+{
+  const CachedPixbuf *cached_a = a;
+  const CachedPixbuf *cached_b = b;
+
+  return cached_a->size == cached_b->size &&
+         cached_a->flags == cached_b->flags &&
+         strcmp (cached_a->icon_name, cached_b->icon_name) == 0;
+}
+
+static void
+cached_pixbuf_free (CachedPixbuf *cached)
+{
+  g_free (cached->icon_name);
+  g_slice_free (CachedPixbuf, cached);
+}
+
+static GdkPixbuf *
+pixbuf_cache_lookup (GtkIconTheme       *icon_theme,
+		     const gchar        *icon_name,
+		     gint                size,
+		     GtkIconLookupFlags  flags)
+{
+  GtkIconThemePrivate *priv = icon_theme->priv;
+  CachedPixbuf lookup;
+  GdkPixbuf *pixbuf;
+
+  if (!priv->pixbuf_cache)
+    return NULL;
+
+  lookup.icon_name = (gchar *)icon_name;
+  lookup.size = size;
+  lookup.flags = flags;
+
+  pixbuf = _gtk_pixbuf_cache_lookup (priv->pixbuf_cache, &lookup);
+
+  return pixbuf ? g_object_ref (pixbuf) : NULL;
+}
+
+static void
+pixbuf_cache_insert (GtkIconTheme       *icon_theme,
+		     const gchar        *icon_name,
+		     gint                size,
+		     GtkIconLookupFlags  flags,
+		     GdkPixbuf          *pixbuf)
+{
+  GtkIconThemePrivate *priv = icon_theme->priv;
+  CachedPixbuf *cached;
+
+  if (!priv->pixbuf_cache)
+    priv->pixbuf_cache = _gtk_pixbuf_cache_new ("icon theme pixbuf cache",
+						PIXBUF_CACHE_MAX_BYTES,
+						cached_pixbuf_hash,
+						cached_pixbuf_equal,
+						(GDestroyNotify)cached_pixbuf_free);
+
+  cached = g_slice_new (CachedPixbuf);
+  cached->icon_name = g_strdup (icon_name);
+  cached->size = size;
+  cached->flags = flags;
+
+  _gtk_pixbuf_cache_insert (priv->pixbuf_cache, cached, pixbuf);
+}
+
 static void
 do_theme_change (GtkIconTheme *icon_theme)
 {
@@ -653,6 +841,8 @@ blow_themes (GtkIconTheme *icon_theme)
       g_list_free (priv->dir_mtimes);
       g_hash_table_destroy (priv->unthemed_icons);
     }
+  if (priv->pixbuf_cache)
+    _gtk_pixbuf_cache_remove_all (priv->pixbuf_cache);
   priv->themes = NULL;
   priv->unthemed_icons = NULL;
   priv->dir_mtimes = NULL;
@@ -689,6 +879,12 @@ gtk_icon_theme_finalize (GObject *object)
 
   blow_themes (icon_theme);
 
+  if (priv->pixbuf_cache)
+    {
+      _gtk_pixbuf_cache_free (priv->pixbuf_cache);
+      priv->pixbuf_cache = NULL;
+    }
+
   G_OBJECT_CLASS (gtk_icon_theme_parent_class)->finalize (object);  
 }
 
@@ -899,7 +1095,6 @@ insert_theme (GtkIconTheme *icon_theme, const char *theme_name)
   GKeyFile *theme_file;
   GError *error = NULL;
   IconThemeDirMtime *dir_mtime;
-  struct stat stat_buf;
   
   priv = icon_theme->priv;
 
@@ -915,13 +1110,11 @@ insert_theme (GtkIconTheme *icon_theme, const char *theme_name)
       path = g_build_filename (priv->search_path[i],
 			       theme_name,
 			       NULL);
-      dir_mtime = g_slice_new (IconThemeDirMtime);
-      dir_mtime->cache = NULL;
-      dir_mtime->dir = path;
-      if (g_stat (path, &stat_buf) == 0 && S_ISDIR (stat_buf.st_mode))
-	dir_mtime->mtime = stat_buf.st_mtime;
-      else
-	dir_mtime->mtime = 0;
+      dir_mtime = dir_mtime_new (icon_theme, path);
+
+      /* Look for the cache once here, rather than once per subdir */
+      if (dir_mtime->mtime != 0)
+	dir_mtime->cache = _gtk_icon_cache_new_for_path (path);
 
       priv->dir_mtimes = g_list_prepend (priv->dir_mtimes, dir_mtime);
     }
@@ -1043,7 +1236,6 @@ load_themes (GtkIconTheme *icon_theme)
   IconSuffix old_suffix, new_suffix;
   GTimeVal tv;
   IconThemeDirMtime *dir_mtime;
-  struct stat stat_buf;
   
   priv = icon_theme->priv;
 
@@ -1066,16 +1258,11 @@ load_themes (GtkIconTheme *icon_theme)
     {
       dir = icon_theme->priv->search_path[base];
 
-      dir_mtime = g_slice_new (IconThemeDirMtime);
+      dir_mtime = dir_mtime_new (icon_theme, g_strdup (dir));
       priv->dir_mtimes = g_list_append (priv->dir_mtimes, dir_mtime);
-      
-      dir_mtime->dir = g_strdup (dir);
-      dir_mtime->mtime = 0;
-      dir_mtime->cache = NULL;
 
-      if (g_stat (dir, &stat_buf) != 0 || !S_ISDIR (stat_buf.st_mode))
+      if (dir_mtime->mtime == 0)
 	continue;
-      dir_mtime->mtime = stat_buf.st_mtime;
 
       dir_mtime->cache = _gtk_icon_cache_new_for_path (dir);
       if (dir_mtime->cache != NULL)
@@ -1147,6 +1334,7 @@ load_themes (GtkIconTheme *icon_theme)
     }
 
   priv->themes_valid = TRUE;
+  priv->dirs_changed = FALSE;
   
   g_get_current_time(&tv);
   priv->last_stat_time = tv.tv_sec;
@@ -1201,7 +1389,7 @@ ensure_valid_themes (GtkIconTheme *icon_theme)
     {
       g_get_current_time (&tv);
 
-      if (ABS (tv.tv_sec - priv->last_stat_time) > 5 &&
+      if ((priv->dirs_changed || ABS (tv.tv_sec - priv->last_stat_time) > 5) &&
 	  rescan_themes (icon_theme))
 	blow_themes (icon_theme);
     }
@@ -1534,6 +1722,13 @@ gtk_icon_theme_load_icon (GtkIconTheme         *icon_theme,
   g_return_val_if_fail ((flags & GTK_ICON_LOOKUP_NO_SVG) == 0 ||
 			(flags & GTK_ICON_LOOKUP_FORCE_SVG) == 0, NULL);
   g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  /* Make sure a theme change blows the cache before we consult it */
+  ensure_valid_themes (icon_theme);
+
+  pixbuf = pixbuf_cache_lookup (icon_theme, icon_name, size, flags);
+  if (pixbuf)
+    return pixbuf;
   
   icon_info = gtk_icon_theme_lookup_icon (icon_theme, icon_name, size,
 				          flags | GTK_ICON_LOOKUP_USE_BUILTIN);
@@ -1547,6 +1742,9 @@ gtk_icon_theme_load_icon (GtkIconTheme         *icon_theme,
   pixbuf = gtk_icon_info_load_icon (icon_info, error);
   gtk_icon_info_free (icon_info);
 
+  if (pixbuf)
+    pixbuf_cache_insert (icon_theme, icon_name, size, flags, pixbuf);
+
   return pixbuf;
 }
 
@@ -1586,6 +1784,24 @@ gtk_icon_theme_has_icon (GtkIconTheme *icon_theme,
 	return TRUE;
     }
 
+  for (l = priv->themes; l; l = l->next)
+    {
+      IconTheme *theme = l->data;
+      GList *d;
+
+      for (d = theme->dirs; d; d = d->next)
+	{
+	  IconThemeDir *dir = d->data;
+
+	  if (dir->cache)
+	    continue;
+
+	  theme_dir_ensure_scanned (dir);
+	  if (g_hash_table_lookup_extended (dir->icons, icon_name, NULL, NULL))
+	    return TRUE;
+	}
+    }
+
   if (g_hash_table_lookup_extended (priv->all_icons,
 				    icon_name, NULL, NULL))
     return TRUE;
@@ -1891,10 +2107,17 @@ rescan_themes (GtkIconTheme *icon_theme)
 
   priv = icon_theme->priv;
 
+  if (priv->dirs_changed)
+    return TRUE;
+
   for (d = priv->dir_mtimes; d != NULL; d = d->next)
     {
       dir_mtime = d->data;
 
+      /* Changes to monitored directories set dirs_changed */
+      if (!dir_mtime->poll)
+	continue;
+
       stat_res = g_stat (dir_mtime->dir, &stat_buf);
 
       /* dir mtime didn't change */
@@ -1962,7 +2185,7 @@ theme_dir_destroy (IconThemeDir *dir)
 {
   if (dir->cache)
       _gtk_icon_cache_unref (dir->cache);
-  else
+  else if (dir->icons)
     g_hash_table_destroy (dir->icons);
   
   if (dir->icon_data)
@@ -2076,7 +2299,10 @@ theme_dir_get_icon_suffix (IconThemeDir *dir,
       suffix = suffix & ~HAS_ICON_FILE;
     }
   else
-    suffix = GPOINTER_TO_UINT (g_hash_table_lookup (dir->icons, icon_name));
+    {
+      theme_dir_ensure_scanned (dir);
+      suffix = GPOINTER_TO_UINT (g_hash_table_lookup (dir->icons, icon_name));
+    }
 
   GTK_NOTE (ICONTHEME, 
 	    g_print ("get_icon_suffix%s %u\n", dir->cache ? " (cached)" : "", suffix));
@@ -2262,6 +2488,9 @@ theme_lookup_icon (IconTheme          *theme,
 	{
 	  icon_info->cache_pixbuf = _gtk_icon_cache_get_icon (min_dir->cache, icon_name,
 							      min_dir->subdir_index);
+	  icon_info->prescaled_pixbuf = _gtk_icon_cache_get_scaled_icon (min_dir->cache, icon_name,
+									 min_dir->subdir_index, size);
+	  icon_info->prescaled_svg = suffix == ICON_SUFFIX_SVG;
 	}
 
       icon_info->dir_type = min_dir->type;
@@ -2301,6 +2530,7 @@ theme_list_icons (IconTheme  *theme,
 	    }
 	  else
 	    {
+	      theme_dir_ensure_scanned (dir);
 	      g_hash_table_foreach (dir->icons,
 				    add_key_to_hash,
 				    icons);
@@ -2322,8 +2552,12 @@ theme_list_contexts (IconTheme  *theme,
     {
       dir = l->data;
 
-      context = g_quark_to_string (dir->context);
-      g_hash_table_replace (contexts, (gpointer) context, NULL);
+      theme_dir_ensure_scanned (dir);
+      if (dir->exists)
+	{
+	  context = g_quark_to_string (dir->context);
+	  g_hash_table_replace (contexts, (gpointer) context, NULL);
+	}
 
       l = l->next;
     }
@@ -2411,8 +2645,7 @@ load_icon_data (IconThemeDir *dir, const char *path, const char *name)
 }
 
 static void
-scan_directory (GtkIconThemePrivate *icon_theme,
-		IconThemeDir *dir, char *full_dir)
+scan_directory (IconThemeDir *dir, char *full_dir)
 {
   GDir *gdir;
   const char *name;
@@ -2427,6 +2660,8 @@ scan_directory (GtkIconThemePrivate *icon_theme,
   if (gdir == NULL)
     return;
 
+  dir->exists = TRUE;
+
   while ((name = g_dir_read_name (gdir)))
     {
       char *path;
@@ -2455,13 +2690,19 @@ scan_directory (GtkIconThemePrivate *icon_theme,
       base_name = strip_suffix (name);
 
       hash_suffix = GPOINTER_TO_INT (g_hash_table_lookup (dir->icons, base_name));
-      g_hash_table_replace (icon_theme->all_icons, base_name, NULL);
       g_hash_table_replace (dir->icons, base_name, GUINT_TO_POINTER (hash_suffix| suffix));
     }
   
   g_dir_close (gdir);
 }
 
+static void
+theme_dir_ensure_scanned (IconThemeDir *dir)
+{
+  if (dir->cache == NULL && dir->icons == NULL)
+    scan_directory (dir, dir->dir);
+}
+
 static void
 theme_subdir_load (GtkIconTheme *icon_theme,
 		   IconTheme    *theme,
@@ -2549,15 +2790,13 @@ theme_subdir_load (GtkIconTheme *icon_theme,
 
        full_dir = g_build_filename (dir_mtime->dir, subdir, NULL);
 
-      /* First, see if we have a cache for the directory */
-      if (dir_mtime->cache != NULL || g_file_test (full_dir, G_FILE_TEST_IS_DIR))
+      /* If there is a cache for the directory, it knows which
+       * subdirectories exist; otherwise we find out when
+       * the directory is first scanned.
+       */
+      if (dir_mtime->cache == NULL ||
+	  _gtk_icon_cache_get_directory_index (dir_mtime->cache, subdir) >= 0)
 	{
-	  if (dir_mtime->cache == NULL)
-	    {
-	      /* This will return NULL if the cache doesn't exist or is outdated */
-	      dir_mtime->cache = _gtk_icon_cache_new_for_path (dir_mtime->dir);
-	    }
-	  
 	  dir = g_new (IconThemeDir, 1);
 	  dir->type = type;
 	  dir->context = context;
@@ -2567,17 +2806,19 @@ theme_subdir_load (GtkIconTheme *icon_theme,
 	  dir->threshold = threshold;
 	  dir->dir = full_dir;
 	  dir->icon_data = NULL;
+	  dir->icons = NULL;
 	  dir->subdir = g_strdup (subdir);
 	  if (dir_mtime->cache != NULL)
             {
 	      dir->cache = _gtk_icon_cache_ref (dir_mtime->cache);
               dir->subdir_index = _gtk_icon_cache_get_directory_index (dir->cache, dir->subdir);
+	      dir->exists = TRUE;
             }
 	  else
 	    {
 	      dir->cache = NULL;
               dir->subdir_index = -1;
-	      scan_directory (icon_theme->priv, dir, full_dir);
+	      dir->exists = FALSE;
 	    }
 
 	  theme->dirs = g_list_prepend (theme->dirs, dir);
@@ -2686,6 +2927,8 @@ gtk_icon_info_free (GtkIconInfo *icon_info)
     g_object_unref (icon_info->pixbuf);
   if (icon_info->cache_pixbuf)
     g_object_unref (icon_info->cache_pixbuf);
+  if (icon_info->prescaled_pixbuf)
+    g_object_unref (icon_info->prescaled_pixbuf);
 
   g_slice_free (GtkIconInfo, icon_info);
 }
@@ -2872,6 +3115,27 @@ icon_info_ensure_scale_and_pixbuf (GtkIconInfo  *icon_info,
   if (icon_info->load_error)
     return FALSE;
 
+  /* The icon cache may already have the icon at the size we want.
+   * It was rendered the same way as below, except that forcing the
+   * size of a non-SVG icon depends on the image size.
+   */
+  if (icon_info->prescaled_pixbuf &&
+      (icon_info->prescaled_svg || !icon_info->forced_size))
+    {
+      if (icon_info->prescaled_svg)
+	icon_info->scale = icon_info->desired_size / 1000.;
+      else
+	icon_info->scale = (gdouble) icon_info->desired_size / icon_info->dir_size;
+
+      if (scale_only)
+	return TRUE;
+
+      icon_info->pixbuf = g_object_ref (icon_info->prescaled_pixbuf);
+      apply_emblems (icon_info);
+
+      return TRUE;
+    }
+
   /* SVG icons are a special case - we just immediately scale them
    * to the desired size
    */
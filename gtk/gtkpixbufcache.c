@@ -0,0 +1,253 @@
+/* GTK - The GIMP Toolkit
+ * gtkpixbufcache.c: LRU cache of pixbufs bounded by memory use
+ * Copyright (C) 1995-1997 Peter Mattis, Spencer Kimball and Josh MacDonald
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+
+#include "gtkpixbufcache.h"
+#include "gtkdebug.h"
+#include "gtkalias.h"
+
+/* With GTK_DEBUG=icontheme, the statistics of a cache are printed
+ * every STATS_INTERVAL lookups and whenever it is emptied.
+ */
+#define STATS_INTERVAL 1000
+
+typedef struct _CacheEntry CacheEntry;
+
+struct _CacheEntry
+{
+  gpointer key;
+  GdkPixbuf *pixbuf;
+  gsize n_bytes;
+};
+
+struct _GtkPixbufCache
+{
+  gchar *name;
+  gsize max_bytes;
+  GDestroyNotify key_destroy_func;
+
+  GHashTable *hash;   /* key => GList link in lru */
+  GQueue lru;         /* CacheEntry, most recently used first */
+  gsize n_bytes;
+
+  guint hits;
+  guint misses;
+  guint evictions;
+};
+
+#ifdef G_ENABLE_DEBUG
+static void
+print_stats (GtkPixbufCache *cache)
+{
+  g_print ("%s: %u hits, %u misses, %u evictions, %u pixbufs, %" G_GSIZE_FORMAT " bytes\n",
+	   cache->name, cache->hits, cache->misses, cache->evictions,
+	   g_hash_table_size (cache->hash), cache->n_bytes);
+}
+#endif
+
+/**
+ * _gtk_pixbuf_cache_new:
+ * @name: name of the cache, for debugging output
+ * @max_bytes: the memory the cached pixbufs may use
+ * @hash_func: hash function for the keys
+ * @equal_func: comparison function for the keys
+ * @key_destroy_func: function to free a key when its entry is dropped
+ *
+ * Creates a cache that keeps recently used pixbufs until their
+ * pixel data exceeds @max_bytes.  The cache is not thread-safe.
+ *
+ * Return value: a new #GtkPixbufCache
+ */
+GtkPixbufCache *
+_gtk_pixbuf_cache_new (const gchar    *name,
+		       gsize           max_bytes,
+		       GHashFunc       hash_func,
+		       GEqualFunc      equal_func,
+		       GDestroyNotify  key_destroy_func)
+{
+  GtkPixbufCache *cache;
+
+  cache = g_slice_new0 (GtkPixbufCache);
+  cache->name = g_strdup (name);
+  cache->max_bytes = max_bytes;
+  cache->key_destroy_func = key_destroy_func;
+  cache->hash = g_hash_table_new (hash_func, equal_func);
+  g_queue_init (&cache->lru);
+
+  return cache;
+}
+
+static void
+cache_remove (GtkPixbufCache *cache,
+	      GList          *link)
+{
+  CacheEntry *entry = link->data;
+
+  g_hash_table_remove (cache->hash, entry->key);
+  g_queue_delete_link (&cache->lru, link);
+  cache->n_bytes -= entry->n_bytes;
+
+  if (cache->key_destroy_func)
+    cache->key_destroy_func (entry->key);
+  g_object_unref (entry->pixbuf);
+  g_slice_free (CacheEntry, entry);
+}
+
+void
+_gtk_pixbuf_cache_free (GtkPixbufCache *cache)
+{
+  _gtk_pixbuf_cache_remove_all (cache);
+
+  g_hash_table_destroy (cache->hash);
+  g_free (cache->name);
+  g_slice_free (GtkPixbufCache, cache);
+}
+
+/**
+ * _gtk_pixbuf_cache_lookup:
+ * @cache: a #GtkPixbufCache
+ * @key: the key to look up
+ *
+ * Looks up the pixbuf stored for @key, and marks it as the most
+ * recently used one.
+ *
+ * Return value: the pixbuf, owned by the cache, or %NULL
+ */
+GdkPixbuf *
+_gtk_pixbuf_cache_lookup (GtkPixbufCache *cache,
+			  gconstpointer   key)
+{
+  GList *link;
+
+  link = g_hash_table_lookup (cache->hash, key);
+
+  if (link)
+    cache->hits++;
+  else
+    cache->misses++;
+
+  GTK_NOTE (ICONTHEME,
+	    if ((cache->hits + cache->misses) % STATS_INTERVAL == 0)
+	      print_stats (cache));
+
+  if (!link)
+    return NULL;
+
+  g_queue_unlink (&cache->lru, link);
+  g_queue_push_head_link (&cache->lru, link);
+
+  return ((CacheEntry *) link->data)->pixbuf;
+}
+
+/**
+ * _gtk_pixbuf_cache_insert:
+ * @cache: a #GtkPixbufCache
+ * @key: the key to store @pixbuf under; the cache takes ownership of it
+ * @pixbuf: the pixbuf to store
+ *
+ * Stores @pixbuf in the cache, dropping the least recently used
+ * pixbufs to stay within the memory budget.  A pixbuf using more
+ * than a quarter of the budget is not stored, so that a single
+ * huge one doesn't flush everything else.
+ */
+void
+_gtk_pixbuf_cache_insert (GtkPixbufCache *cache,
+			  gpointer        key,
+			  GdkPixbuf      *pixbuf)
+{
+  CacheEntry *entry;
+  GList *link;
+  gsize n_bytes;
+
+  n_bytes = gdk_pixbuf_get_rowstride (pixbuf) * gdk_pixbuf_get_height (pixbuf);
+
+  if (n_bytes > cache->max_bytes / 4)
+    {
+      if (cache->key_destroy_func)
+	cache->key_destroy_func (key);
+      return;
+    }
+
+  link = g_hash_table_lookup (cache->hash, key);
+  if (link)
+    cache_remove (cache, link);
+
+  while (cache->n_bytes + n_bytes > cache->max_bytes)
+    {
+      cache_remove (cache, cache->lru.tail);
+      cache->evictions++;
+    }
+
+  entry = g_slice_new (CacheEntry);
+  entry->key = key;
+  entry->pixbuf = g_object_ref (pixbuf);
+  entry->n_bytes = n_bytes;
+
+  g_queue_push_head (&cache->lru, entry);
+  g_hash_table_insert (cache->hash, key, cache->lru.head);
+  cache->n_bytes += n_bytes;
+}
+
+/**
+ * _gtk_pixbuf_cache_foreach_remove:
+ * @cache: a #GtkPixbufCache
+ * @func: function called with each key and pixbuf
+ * @user_data: data to pass to @func
+ *
+ * Drops the entries for which @func returns %TRUE.
+ *
+ * Return value: the number of entries dropped
+ */
+guint
+_gtk_pixbuf_cache_foreach_remove (GtkPixbufCache *cache,
+				  GHRFunc         func,
+				  gpointer        user_data)
+{
+  GList *link, *next;
+  guint n_removed = 0;
+
+  for (link = cache->lru.head; link; link = next)
+    {
+      CacheEntry *entry = link->data;
+
+      next = link->next;
+
+      if (func (entry->key, entry->pixbuf, user_data))
+	{
+	  cache_remove (cache, link);
+	  n_removed++;
+	}
+    }
+
+  return n_removed;
+}
+
+void
+_gtk_pixbuf_cache_remove_all (GtkPixbufCache *cache)
+{
+  if (cache->lru.head == NULL)
+    return;
+
+  GTK_NOTE (ICONTHEME, print_stats (cache));
+
+  while (cache->lru.head)
+    cache_remove (cache, cache->lru.head);
+}
@@ -0,0 +1,48 @@
+/* GTK - The GIMP Toolkit
+ * gtkpixbufcache.h: LRU cache of pixbufs bounded by memory use
+ * Copyright (C) 1995-1997 Peter Mattis, Spencer Kimball and Josh MacDonald
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GTK_PIXBUF_CACHE_H__
+#define __GTK_PIXBUF_CACHE_H__
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GtkPixbufCache GtkPixbufCache;
+
+GtkPixbufCache *_gtk_pixbuf_cache_new            (const gchar    *name,
+						  gsize           max_bytes,
+						  GHashFunc       hash_func,
+						  GEqualFunc      equal_func,
+						  GDestroyNotify  key_destroy_func);
+void            _gtk_pixbuf_cache_free           (GtkPixbufCache *cache);
+GdkPixbuf      *_gtk_pixbuf_cache_lookup         (GtkPixbufCache *cache,
+						  gconstpointer   key);
+void            _gtk_pixbuf_cache_insert         (GtkPixbufCache *cache,
+						  gpointer        key,
+						  GdkPixbuf      *pixbuf);
+guint           _gtk_pixbuf_cache_foreach_remove (GtkPixbufCache *cache,
+						  GHRFunc         func,
+						  gpointer        user_data);
+void            _gtk_pixbuf_cache_remove_all     (GtkPixbufCache *cache);
+
+G_END_DECLS
+
+#endif /* __GTK_PIXBUF_CACHE_H__ */
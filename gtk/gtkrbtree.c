@@ -37,6 +37,8 @@ static inline void _fixup_validation              (GtkRBTree  *tree,
 						   GtkRBNode  *node);
 static inline void _fixup_parity                  (GtkRBTree  *tree,
 						   GtkRBNode  *node);
+static inline void _fixup_selected                (GtkRBTree  *tree,
+						   GtkRBNode  *node);
 
 
 
@@ -51,6 +53,7 @@ _gtk_rbnode_new (GtkRBTree *tree,
   node->parent = tree->nil;
   node->flags = GTK_RBNODE_RED;
   node->parity = 1;
+  node->n_selected = 0;
   node->count = 1;
   node->children = NULL;
   node->offset = height;
@@ -126,7 +129,9 @@ _gtk_rbnode_rotate_left (GtkRBTree *tree,
   _fixup_validation (tree, node);
   _fixup_validation (tree, right);
   _fixup_parity (tree, node);
+  _fixup_selected (tree, node);
   _fixup_parity (tree, right);
+  _fixup_selected (tree, right);
 }
 
 static void
@@ -187,7 +192,9 @@ _gtk_rbnode_rotate_right (GtkRBTree *tree,
   _fixup_validation (tree, node);
   _fixup_validation (tree, left);
   _fixup_parity (tree, node);
+  _fixup_selected (tree, node);
   _fixup_parity (tree, left);
+  _fixup_selected (tree, left);
 }
 
 static void
@@ -344,6 +351,7 @@ _gtk_rbtree_new (void)
   retval->nil->count = 0;
   retval->nil->offset = 0;
   retval->nil->parity = 0;
+  retval->nil->n_selected = 0;
 
   retval->root = retval->nil;
   return retval;
@@ -404,6 +412,8 @@ _gtk_rbtree_remove (GtkRBTree *tree)
       /* If the removed tree was odd, flip all parents */
       if (tree->root->parity)
         tmp_node->parity = !tmp_node->parity;
+
+      tmp_node->n_selected -= tree->root->n_selected;
       
       tmp_node = tmp_node->parent;
       if (tmp_node == tmp_tree->nil)
@@ -720,6 +730,106 @@ _gtk_rbtree_node_mark_valid (GtkRBTree *tree,
   while (node);
 }
 
+void
+_gtk_rbtree_node_set_selected (GtkRBTree *tree,
+			       GtkRBNode *node,
+			       gboolean   selected)
+{
+  gint diff;
+
+  if (GTK_RBNODE_FLAG_SET (node, GTK_RBNODE_IS_SELECTED) == (selected != FALSE))
+    return;
+
+  if (selected)
+    {
+      GTK_RBNODE_SET_FLAG (node, GTK_RBNODE_IS_SELECTED);
+      diff = 1;
+    }
+  else
+    {
+      GTK_RBNODE_UNSET_FLAG (node, GTK_RBNODE_IS_SELECTED);
+      diff = -1;
+    }
+
+  while (tree && node && node != tree->nil)
+    {
+      node->n_selected += diff;
+      node = node->parent;
+      if (node == tree->nil)
+	{
+	  node = tree->parent_node;
+	  tree = tree->parent_tree;
+	}
+    }
+}
+
+static gint
+_gtk_rbtree_set_selected_helper (GtkRBTree *tree,
+				 GtkRBNode *node,
+				 gboolean   selected)
+{
+  gint changed = 0;
+
+  if (node == tree->nil)
+    return 0;
+
+  /* nothing to unselect beneath us */
+  if (!selected && node->n_selected == 0)
+    return 0;
+
+  changed += _gtk_rbtree_set_selected_helper (tree, node->left, selected);
+  changed += _gtk_rbtree_set_selected_helper (tree, node->right, selected);
+  if (node->children)
+    changed += _gtk_rbtree_set_selected_helper (node->children,
+						node->children->root,
+						selected);
+
+  if (GTK_RBNODE_FLAG_SET (node, GTK_RBNODE_IS_SELECTED) != selected)
+    {
+      node->flags ^= GTK_RBNODE_IS_SELECTED;
+      changed++;
+    }
+
+  _fixup_selected (tree, node);
+
+  return changed;
+}
+
+/* Sets the selection state of every node in @tree and its child trees
+ * without going node by node through the parent chain, and returns the
+ * number of nodes that changed.
+ */
+gint
+_gtk_rbtree_set_selected (GtkRBTree *tree,
+			  gboolean   selected)
+{
+  GtkRBTree *tmp_tree;
+  GtkRBNode *tmp_node;
+  gint diff;
+  gint changed;
+
+  g_return_val_if_fail (tree != NULL, 0);
+
+  diff = tree->root->n_selected;
+  changed = _gtk_rbtree_set_selected_helper (tree, tree->root, selected != FALSE);
+  diff = tree->root->n_selected - diff;
+
+  tmp_tree = tree->parent_tree;
+  tmp_node = tree->parent_node;
+  while (diff != 0 && tmp_tree && tmp_node && tmp_node != tmp_tree->nil)
+    {
+      tmp_node->n_selected += diff;
+      tmp_node = tmp_node->parent;
+      if (tmp_node == tmp_tree->nil)
+	{
+	  tmp_node = tmp_tree->parent_node;
+	  tmp_tree = tmp_tree->parent_tree;
+	}
+    }
+
+  return changed;
+}
+
 #if 0
 /* Draconian version */
 void
@@ -856,24 +966,28 @@ gtk_rbtree_reorder_fixup (GtkRBTree *tree,
     return;
 
   node->parity = 1;
+  node->n_selected = GTK_RBNODE_FLAG_SET (node, GTK_RBNODE_IS_SELECTED) ? 1 : 0;
 
   if (node->left != tree->nil)
     {
       gtk_rbtree_reorder_fixup (tree, node->left);
       node->offset += node->left->offset;
       node->parity += node->left->parity;
+      node->n_selected += node->left->n_selected;
     }
   if (node->right != tree->nil)
     {
       gtk_rbtree_reorder_fixup (tree, node->right);
       node->offset += node->right->offset;
       node->parity += node->right->parity;
+      node->n_selected += node->right->n_selected;
     }
       
   if (node->children)
     {
       node->offset += node->children->root->offset;
       node->parity += node->children->root->parity;
+      node->n_selected += node->children->root->n_selected;
     }
   
   if (GTK_RBNODE_FLAG_SET (node, GTK_RBNODE_INVALID) ||
@@ -1166,6 +1280,7 @@ _gtk_rbtree_remove_node (GtkRBTree *tree,
       tmp_node->offset -= (y_height + (y->children?y->children->root->offset:0));
       _fixup_validation (tmp_tree, tmp_node);
       _fixup_parity (tmp_tree, tmp_node);
+      _fixup_selected (tmp_tree, tmp_node);
       tmp_node = tmp_node->parent;
       if (tmp_node == tmp_tree->nil)
 	{
@@ -1206,6 +1321,7 @@ _gtk_rbtree_remove_node (GtkRBTree *tree,
 	{
 	  _fixup_validation (tmp_tree, tmp_node);
 	  _fixup_parity (tmp_tree, tmp_node);
+	  _fixup_selected (tmp_tree, tmp_node);
 	}
       tmp_node = tmp_node->parent;
       if (tmp_node == tmp_tree->nil)
@@ -1237,6 +1353,7 @@ _gtk_rbtree_remove_node (GtkRBTree *tree,
 	}
       _fixup_validation (tree, node);
       _fixup_parity (tree, node);
+      _fixup_selected (tree, node);
       /* We want to see how different our height is from the previous node.
        * To do this, we compare our current height with our supposed height.
        */
@@ -1249,6 +1366,7 @@ _gtk_rbtree_remove_node (GtkRBTree *tree,
 	  tmp_node->offset += diff;
 	  _fixup_validation (tmp_tree, tmp_node);
 	  _fixup_parity (tmp_tree, tmp_node);
+	  _fixup_selected (tmp_tree, tmp_node);
 	  tmp_node = tmp_node->parent;
 	  if (tmp_node == tmp_tree->nil)
 	    {
@@ -1495,6 +1613,16 @@ void _fixup_parity (GtkRBTree *tree,
     ((node->right != tree->nil) ? node->right->parity : 0);
 }
 
+static inline
+void _fixup_selected (GtkRBTree *tree,
+		      GtkRBNode *node)
+{
+  node->n_selected = (GTK_RBNODE_FLAG_SET (node, GTK_RBNODE_IS_SELECTED) ? 1 : 0) +
+    ((node->children != NULL && node->children->root != node->children->nil) ? node->children->root->n_selected : 0) +
+    ((node->left != tree->nil) ? node->left->n_selected : 0) +
+    ((node->right != tree->nil) ? node->right->n_selected : 0);
+}
+
 #ifdef G_ENABLE_DEBUG
 static guint
 get_parity (GtkRBNode *node)
@@ -1551,6 +1679,27 @@ count_parity (GtkRBTree *tree,
   return res;
 }
 
+static gint
+count_selected (GtkRBTree *tree,
+                GtkRBNode *node)
+{
+  gint res;
+
+  if (node == tree->nil)
+    return 0;
+
+  res =
+    count_selected (tree, node->left) +
+    count_selected (tree, node->right) +
+    (GTK_RBNODE_FLAG_SET (node, GTK_RBNODE_IS_SELECTED) ? 1 : 0) +
+    (node->children ? count_selected (node->children, node->children->root) : 0);
+
+  if (res != node->n_selected)
+    g_error ("Node has incorrect selection count %d, expected %d", node->n_selected, res);
+
+  return res;
+}
+
 static gint
 _count_nodes (GtkRBTree *tree,
               GtkRBNode *node)
@@ -1704,6 +1853,7 @@ _gtk_rbtree_test (const gchar *where,
   _gtk_rbtree_test_height (tmp_tree, tmp_tree->root);
   _gtk_rbtree_test_dirty (tmp_tree, tmp_tree->root, GTK_RBNODE_FLAG_SET (tmp_tree->root, GTK_RBNODE_DESCENDANTS_INVALID));
   g_assert (count_parity (tmp_tree, tmp_tree->root) == tmp_tree->root->parity);
+  g_assert (count_selected (tmp_tree, tmp_tree->root) == tmp_tree->root->n_selected);
 }
 
 static void
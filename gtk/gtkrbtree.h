@@ -81,6 +81,13 @@ struct _GtkRBNode
    */
 
   guint parity : 1;
+
+  /* n_selected is the number of selected rows beneath us, including
+   * ourselves and the rows in ->children.  It is aggregated the same
+   * way as the offset, so the root of the toplevel tree holds the
+   * number of selected rows in the whole view.
+   */
+  gint n_selected;
   
   GtkRBNode *left;
   GtkRBNode *right;
@@ -137,6 +144,11 @@ void       _gtk_rbtree_node_mark_invalid(GtkRBTree              *tree,
 					 GtkRBNode              *node);
 void       _gtk_rbtree_node_mark_valid  (GtkRBTree              *tree,
 					 GtkRBNode              *node);
+void       _gtk_rbtree_node_set_selected(GtkRBTree              *tree,
+					 GtkRBNode              *node,
+					 gboolean                selected);
+gint       _gtk_rbtree_set_selected     (GtkRBTree              *tree,
+					 gboolean                selected);
 void       _gtk_rbtree_column_invalid   (GtkRBTree              *tree);
 void       _gtk_rbtree_mark_invalid     (GtkRBTree              *tree);
 void       _gtk_rbtree_set_fixed_height (GtkRBTree              *tree,
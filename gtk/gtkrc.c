@@ -128,9 +128,32 @@ struct _GtkRcContext
 
   GHashTable *color_hash;
 
+  /* GtkRcMatchKey => sorted list of matching GtkRcStyles */
+  GHashTable *match_cache;
+  guint match_hits;
+  guint match_misses;
+
   guint reloading : 1;
 };
 
+/* What gtk_rc_get_style() matches the rc sets against. A path is
+ * NULL when there are no sets of its kind, type is G_TYPE_NONE when
+ * there are no class sets.
+ */
+typedef struct _GtkRcMatchKey GtkRcMatchKey;
+
+struct _GtkRcMatchKey
+{
+  gchar *widget_path;
+  gchar *class_path;
+  GType  type;
+};
+
+/* Distinct paths are usually few, but named widgets can make them
+ * unbounded; start over rather than grow without limit.
+ */
+#define GTK_RC_MATCH_CACHE_SIZE 1024
+
 #define GTK_RC_STYLE_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), GTK_TYPE_RC_STYLE, GtkRcStylePrivate))
 
 typedef struct _GtkRcStylePrivate GtkRcStylePrivate;
@@ -138,6 +161,8 @@ typedef struct _GtkRcStylePrivate GtkRcStylePrivate;
 struct _GtkRcStylePrivate
 {
   GSList *color_hashes;
+
+  guint interned : 1;
 };
 
 static GtkRcContext *gtk_rc_context_get              (GtkSettings     *settings);
@@ -223,6 +248,7 @@ static void        gtk_rc_clear_hash_node            (gpointer         key,
                                                       gpointer         data,
                                                       gpointer         user_data);
 static void        gtk_rc_clear_styles               (GtkRcContext    *context);
+static void        gtk_rc_clear_match_cache          (GtkRcContext    *context);
 static void        gtk_rc_add_initial_default_files  (void);
 
 static void        gtk_rc_style_finalize             (GObject         *object);
@@ -369,6 +395,9 @@ static const struct
 
 static GHashTable *realized_style_ht = NULL;
 
+/* Modifier styles with identical contents, see _gtk_rc_style_intern() */
+static GHashTable *interned_rc_styles = NULL;
+
 static gchar *im_module_file = NULL;
 
 static gint    max_default_files = 0;
@@ -685,6 +714,9 @@ gtk_rc_context_get (GtkSettings *settings)
       context->rc_sets_class = NULL;
       context->rc_files = NULL;
       context->default_style = NULL;
+      context->match_cache = NULL;
+      context->match_hits = 0;
+      context->match_misses = 0;
       context->reloading = FALSE;
 
       g_object_get (settings,
@@ -785,6 +817,429 @@ _gtk_rc_context_destroy (GtkSettings *settings)
   settings->rc_context = NULL;
 }
 
+/*
+ * Theme file lookups
+ *
+ * Parsing a theme probes for include files, locale variants and,
+ * above all, every image a pixmap engine theme references, in every
+ * directory of the pixmap path. The answers are kept in a per-user
+ * cache file across runs. Each answer is recorded along with the
+ * mtime of the directory holding the file, since adding or removing
+ * the file changes it; a directory is stat()ed once per run to
+ * validate all answers for it.
+ */
+
+#define RC_LOOKUP_CACHE_MAJOR_VERSION 1
+#define RC_LOOKUP_CACHE_MINOR_VERSION 0
+
+#define RC_LOOKUP_CACHE_HEADER_SIZE 12
+#define RC_LOOKUP_CACHE_DIR_SIZE    8
+#define RC_LOOKUP_CACHE_ENTRY_SIZE  12
+
+#define GET_UINT16(cache, offset) (GUINT16_FROM_BE (*(guint16 *)((cache) + (offset))))
+#define GET_UINT32(cache, offset) (GUINT32_FROM_BE (*(guint32 *)((cache) + (offset))))
+
+typedef struct _GtkRcLookupDir GtkRcLookupDir;
+typedef struct _GtkRcLookup    GtkRcLookup;
+
+struct _GtkRcLookupDir
+{
+  gchar   *path;
+  guint32  mtime;	/* 0 if the directory doesn't exist */
+  gint     index;	/* while saving */
+  guint    checked : 1;
+  guint    stale   : 1;
+  guint    recent  : 1;	/* changed too recently to trust the mtime */
+};
+
+struct _GtkRcLookup
+{
+  GtkRcLookupDir *dir;
+  guint           exists : 1;
+};
+
+static GHashTable *rc_lookups = NULL;		/* path => GtkRcLookup */
+static GHashTable *rc_lookup_dirs = NULL;	/* path => current GtkRcLookupDir */
+static GPtrArray  *rc_lookup_dir_list = NULL;	/* all GtkRcLookupDirs */
+static gboolean    rc_lookups_dirty = FALSE;
+
+static gchar *
+gtk_rc_lookup_cache_filename (void)
+{
+  return g_build_filename (g_get_user_cache_dir (), "gtk-2.0",
+			   "rc-lookups.cache", NULL);
+}
+
+static void
+gtk_rc_lookup_free (gpointer data)
+{
+  g_slice_free (GtkRcLookup, data);
+}
+
+static GtkRcLookupDir *
+gtk_rc_lookup_dir_new (const gchar *path,
+		       guint32      mtime)
+{
+  GtkRcLookupDir *dir;
+
+  dir = g_slice_new0 (GtkRcLookupDir);
+  dir->path = g_strdup (path);
+  dir->mtime = mtime;
+
+  g_hash_table_replace (rc_lookup_dirs, dir->path, dir);
+  g_ptr_array_add (rc_lookup_dir_list, dir);
+
+  return dir;
+}
+
+static gboolean
+gtk_rc_lookup_dir_is_valid (GtkRcLookupDir *dir)
+{
+  struct stat statbuf;
+
+  if (!dir->checked)
+    {
+      dir->checked = TRUE;
+
+      if (g_stat (dir->path, &statbuf) == 0)
+	dir->stale = dir->mtime != (guint32) statbuf.st_mtime;
+      else
+	dir->stale = dir->mtime != 0;
+
+      if (dir->stale)
+	{
+	  GTK_NOTE (MISC, g_print ("rc lookup cache: %s changed\n", dir->path));
+
+	  if (g_hash_table_lookup (rc_lookup_dirs, dir->path) == dir)
+	    g_hash_table_remove (rc_lookup_dirs, dir->path);
+	}
+    }
+
+  return !dir->stale;
+}
+
+/* Makes the next lookup in each directory stat() it again, so that
+ * a reparse notices files added or removed since the last one.
+ */
+static void
+gtk_rc_lookup_cache_recheck (void)
+{
+  guint i;
+
+  if (!rc_lookup_dir_list)
+    return;
+
+  for (i = 0; i < rc_lookup_dir_list->len; i++)
+    {
+      GtkRcLookupDir *dir = g_ptr_array_index (rc_lookup_dir_list, i);
+
+      if (dir->stale)
+	continue;
+
+      if (dir->recent)
+	{
+	  /* Its mtime may not show changes made since it was read */
+	  dir->stale = TRUE;
+	  if (g_hash_table_lookup (rc_lookup_dirs, dir->path) == dir)
+	    g_hash_table_remove (rc_lookup_dirs, dir->path);
+	}
+      else
+	dir->checked = FALSE;
+    }
+}
+
+/* Finds the record for a directory, making a fresh one if
+ * there is none or it is out of date.
+ */
+static GtkRcLookupDir *
+gtk_rc_lookup_dir_get (const gchar *path)
+{
+  GtkRcLookupDir *dir;
+  struct stat statbuf;
+  GTimeVal now;
+
+  dir = g_hash_table_lookup (rc_lookup_dirs, path);
+  if (dir && gtk_rc_lookup_dir_is_valid (dir))
+    return dir;
+
+  g_get_current_time (&now);
+
+  if (g_stat (path, &statbuf) == 0)
+    {
+      dir = gtk_rc_lookup_dir_new (path, statbuf.st_mtime);
+      /* Changes within the same second wouldn't show in the mtime */
+      dir->recent = statbuf.st_mtime >= now.tv_sec - 1;
+    }
+  else
+    dir = gtk_rc_lookup_dir_new (path, 0);
+
+  dir->checked = TRUE;
+
+  return dir;
+}
+
+static const gchar *
+rc_lookup_cache_get_string (const gchar *cache,
+			    gsize        size,
+			    guint32      offset)
+{
+  if (offset >= size || !memchr (cache + offset, '\0', size - offset))
+    return NULL;
+
+  return cache + offset;
+}
+
+static gboolean
+gtk_rc_lookup_cache_read (const gchar *cache,
+			  gsize        size)
+{
+  GtkRcLookupDir **dirs;
+  guint32 n_dirs, n_entries;
+  guint32 dirs_offset, entries_offset;
+  guint32 i;
+
+  if (size < RC_LOOKUP_CACHE_HEADER_SIZE ||
+      GET_UINT16 (cache, 0) != RC_LOOKUP_CACHE_MAJOR_VERSION)
+    return FALSE;
+
+  n_dirs = GET_UINT32 (cache, 4);
+  n_entries = GET_UINT32 (cache, 8);
+
+  if ((guint64) RC_LOOKUP_CACHE_HEADER_SIZE +
+      (guint64) n_dirs * RC_LOOKUP_CACHE_DIR_SIZE +
+      (guint64) n_entries * RC_LOOKUP_CACHE_ENTRY_SIZE > size)
+    return FALSE;
+
+  dirs_offset = RC_LOOKUP_CACHE_HEADER_SIZE;
+  entries_offset = dirs_offset + n_dirs * RC_LOOKUP_CACHE_DIR_SIZE;
+
+  /* Check everything before adding anything */
+  for (i = 0; i < n_dirs; i++)
+    if (!rc_lookup_cache_get_string (cache, size, GET_UINT32 (cache, dirs_offset + i * RC_LOOKUP_CACHE_DIR_SIZE)))
+      return FALSE;
+
+  for (i = 0; i < n_entries; i++)
+    {
+      guint32 offset = entries_offset + i * RC_LOOKUP_CACHE_ENTRY_SIZE;
+
+      if (GET_UINT32 (cache, offset) >= n_dirs ||
+	  !rc_lookup_cache_get_string (cache, size, GET_UINT32 (cache, offset + 4)))
+	return FALSE;
+    }
+
+  dirs = g_new (GtkRcLookupDir *, n_dirs);
+
+  for (i = 0; i < n_dirs; i++)
+    {
+      guint32 offset = dirs_offset + i * RC_LOOKUP_CACHE_DIR_SIZE;
+
+      dirs[i] = gtk_rc_lookup_dir_new (cache + GET_UINT32 (cache, offset),
+				       GET_UINT32 (cache, offset + 4));
+    }
+
+  for (i = 0; i < n_entries; i++)
+    {
+      guint32 offset = entries_offset + i * RC_LOOKUP_CACHE_ENTRY_SIZE;
+      GtkRcLookup *lookup;
+
+      lookup = g_slice_new (GtkRcLookup);
+      lookup->dir = dirs[GET_UINT32 (cache, offset)];
+      lookup->exists = GET_UINT32 (cache, offset + 8) != 0;
+
+      g_hash_table_replace (rc_lookups,
+			    g_strdup (cache + GET_UINT32 (cache, offset + 4)),
+			    lookup);
+    }
+
+  g_free (dirs);
+
+  return TRUE;
+}
+
+static void
+gtk_rc_lookup_cache_load (void)
+{
+  GMappedFile *map;
+  gchar *filename;
+
+  if (rc_lookups)
+    return;
+
+  rc_lookups = g_hash_table_new_full (g_str_hash, g_str_equal,
+				      g_free, gtk_rc_lookup_free);
+  rc_lookup_dirs = g_hash_table_new (g_str_hash, g_str_equal);
+  rc_lookup_dir_list = g_ptr_array_new ();
+
+  filename = gtk_rc_lookup_cache_filename ();
+  map = g_mapped_file_new (filename, FALSE, NULL);
+
+  if (map)
+    {
+      if (!gtk_rc_lookup_cache_read (g_mapped_file_get_contents (map),
+				     g_mapped_file_get_length (map)))
+	GTK_NOTE (MISC, g_print ("rc lookup cache: %s is invalid\n", filename));
+
+      g_mapped_file_unref (map);
+    }
+
+  g_free (filename);
+}
+
+static void
+append_uint16 (GByteArray *array,
+	       guint16     value)
+{
+  value = GUINT16_TO_BE (value);
+  g_byte_array_append (array, (guint8 *) &value, 2);
+}
+
+static void
+append_uint32 (GByteArray *array,
+	       guint32     value)
+{
+  value = GUINT32_TO_BE (value);
+  g_byte_array_append (array, (guint8 *) &value, 4);
+}
+
+static gboolean
+gtk_rc_lookup_dir_can_save (GtkRcLookupDir *dir)
+{
+  return !dir->stale && !dir->recent;
+}
+
+static void
+gtk_rc_lookup_cache_save (void)
+{
+  GByteArray *data;
+  GString *strings;
+  GHashTableIter iter;
+  gpointer key, value;
+  guint32 n_dirs, n_entries, tables_size;
+  gchar *filename, *dirname;
+  guint i;
+
+  if (!rc_lookups_dirty)
+    return;
+
+  rc_lookups_dirty = FALSE;
+
+  n_dirs = 0;
+  for (i = 0; i < rc_lookup_dir_list->len; i++)
+    {
+      GtkRcLookupDir *dir = g_ptr_array_index (rc_lookup_dir_list, i);
+
+      dir->index = gtk_rc_lookup_dir_can_save (dir) ? n_dirs++ : -1;
+    }
+
+  n_entries = 0;
+  g_hash_table_iter_init (&iter, rc_lookups);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      GtkRcLookup *lookup = value;
+
+      if (lookup->dir->index >= 0)
+	n_entries++;
+    }
+
+  tables_size = RC_LOOKUP_CACHE_HEADER_SIZE +
+                n_dirs * RC_LOOKUP_CACHE_DIR_SIZE +
+                n_entries * RC_LOOKUP_CACHE_ENTRY_SIZE;
+
+  data = g_byte_array_new ();
+  strings = g_string_new (NULL);
+
+  append_uint16 (data, RC_LOOKUP_CACHE_MAJOR_VERSION);
+  append_uint16 (data, RC_LOOKUP_CACHE_MINOR_VERSION);
+  append_uint32 (data, n_dirs);
+  append_uint32 (data, n_entries);
+
+  for (i = 0; i < rc_lookup_dir_list->len; i++)
+    {
+      GtkRcLookupDir *dir = g_ptr_array_index (rc_lookup_dir_list, i);
+
+      if (dir->index < 0)
+	continue;
+
+      append_uint32 (data, tables_size + strings->len);
+      append_uint32 (data, dir->mtime);
+      g_string_append_len (strings, dir->path, strlen (dir->path) + 1);
+    }
+
+  g_hash_table_iter_init (&iter, rc_lookups);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      GtkRcLookup *lookup = value;
+
+      if (lookup->dir->index < 0)
+	continue;
+
+      append_uint32 (data, lookup->dir->index);
+      append_uint32 (data, tables_size + strings->len);
+      append_uint32 (data, lookup->exists);
+      g_string_append_len (strings, key, strlen (key) + 1);
+    }
+
+  g_assert (data->len == tables_size);
+
+  g_byte_array_append (data, (guint8 *) strings->str, strings->len);
+
+  filename = gtk_rc_lookup_cache_filename ();
+  dirname = g_path_get_dirname (filename);
+
+  /* Failing to write the cache only costs the next run some time */
+  if (g_mkdir_with_parents (dirname, 0700) == 0)
+    g_file_set_contents (filename, (gchar *) data->data, data->len, NULL);
+
+  GTK_NOTE (MISC, g_print ("rc lookup cache: saved %u lookups in %u directories\n",
+			   n_entries, n_dirs));
+
+  g_free (dirname);
+  g_free (filename);
+  g_string_free (strings, TRUE);
+  g_byte_array_free (data, TRUE);
+}
+
+/* g_file_test (filename, G_FILE_TEST_EXISTS), answered from the
+ * lookup cache when the directory of @filename is unchanged.
+ */
+static gboolean
+gtk_rc_file_exists (const gchar *filename)
+{
+  GtkRcLookup *lookup;
+  gchar *dirname;
+
+  gtk_rc_lookup_cache_load ();
+
+  lookup = g_hash_table_lookup (rc_lookups, filename);
+  if (lookup && gtk_rc_lookup_dir_is_valid (lookup->dir))
+    return lookup->exists;
+
+  dirname = g_path_get_dirname (filename);
+
+  lookup = g_slice_new (GtkRcLookup);
+  lookup->dir = gtk_rc_lookup_dir_get (dirname);
+  lookup->exists = g_file_test (filename, G_FILE_TEST_EXISTS);
+
+  g_hash_table_replace (rc_lookups, g_strdup (filename), lookup);
+
+  if (!lookup->dir->recent)
+    rc_lookups_dirty = TRUE;
+
+  g_free (dirname);
+
+  return lookup->exists;
+}
+
+/* Saves the lookups made by a parse that wasn't part of a reparse,
+ * like gtk_rc_parse_string() or a theme engine loaded later on.
+ */
+static void
+gtk_rc_context_parse_finished (GtkRcContext *context)
+{
+  if (!context->reloading && !current_files_stack)
+    gtk_rc_lookup_cache_save ();
+}
+
 static void
 gtk_rc_parse_named (GtkRcContext *context,
 		    const gchar  *name,
@@ -807,7 +1262,7 @@ gtk_rc_parse_named (GtkRcContext *context,
   if (home_dir)
     {
       path = g_build_filename (home_dir, ".themes", name, subpath, NULL);
-      if (!g_file_test (path, G_FILE_TEST_EXISTS))
+      if (!gtk_rc_file_exists (path))
 	{
 	  g_free (path);
 	  path = NULL;
@@ -820,7 +1275,7 @@ gtk_rc_parse_named (GtkRcContext *context,
       path = g_build_filename (theme_dir, name, subpath, NULL);
       g_free (theme_dir);
       
-      if (!g_file_test (path, G_FILE_TEST_EXISTS))
+      if (!gtk_rc_file_exists (path))
 	{
 	  g_free (path);
 	  path = NULL;
@@ -906,6 +1361,7 @@ gtk_rc_context_parse_string (GtkRcContext *context,
 			     const gchar  *rc_string)
 {
   gtk_rc_parse_any (context, "-", -1, rc_string);
+  gtk_rc_context_parse_finished (context);
 }
 
 void
@@ -1024,6 +1480,8 @@ gtk_rc_context_parse_one_file (GtkRcContext *context,
 
  out:
   context->default_priority = saved_priority;
+
+  gtk_rc_context_parse_finished (context);
 }
 
 static gchar *
@@ -1087,7 +1545,7 @@ gtk_rc_context_parse_file (GtkRcContext *context,
       if (!found)
 	{
 	  gchar *name = g_strconcat (filename, ".", locale_suffixes[j], NULL);
-	  if (g_file_test (name, G_FILE_TEST_EXISTS))
+	  if (gtk_rc_file_exists (name))
 	    {
 	      gtk_rc_context_parse_one_file (context, name, priority, FALSE);
 	      found = TRUE;
@@ -1173,6 +1631,12 @@ gtk_rc_style_finalize (GObject *object)
   rc_style = GTK_RC_STYLE (object);
   rc_priv = GTK_RC_STYLE_GET_PRIVATE (rc_style);
 
+  /* Must happen while the contents are still intact, since they
+   * are the key in interned_rc_styles.
+   */
+  if (rc_priv->interned)
+    g_hash_table_remove (interned_rc_styles, rc_style);
+
   g_free (rc_style->name);
   if (rc_style->font_desc)
     pango_font_description_free (rc_style->font_desc);
@@ -1272,6 +1736,167 @@ gtk_rc_style_copy (GtkRcStyle *orig)
   return style;
 }
 
+static gboolean
+gtk_rc_style_can_intern (GtkRcStyle *rc_style)
+{
+  GtkRcStylePrivate *priv = GTK_RC_STYLE_GET_PRIVATE (rc_style);
+
+  return (G_OBJECT_TYPE (rc_style) == GTK_TYPE_RC_STYLE &&
+          !rc_style->engine_specified &&
+          (!rc_style->rc_properties || rc_style->rc_properties->len == 0) &&
+          !rc_style->icon_factories &&
+          !priv->color_hashes);
+}
+
+static guint
+gtk_rc_style_contents_hash (gconstpointer key)
+{
+  const GtkRcStyle *rc_style = key;
+  guint result = 0;
+  gint i;
+
+  for (i = 0; i < 5; i++)
+    {
+      result = (result << 5) - result + rc_style->color_flags[i];
+
+      if (rc_style->color_flags[i] & GTK_RC_FG)
+        result = (result << 5) - result + gdk_color_hash (&rc_style->fg[i]);
+      if (rc_style->color_flags[i] & GTK_RC_BG)
+        result = (result << 5) - result + gdk_color_hash (&rc_style->bg[i]);
+      if (rc_style->color_flags[i] & GTK_RC_TEXT)
+        result = (result << 5) - result + gdk_color_hash (&rc_style->text[i]);
+      if (rc_style->color_flags[i] & GTK_RC_BASE)
+        result = (result << 5) - result + gdk_color_hash (&rc_style->base[i]);
+
+      if (rc_style->bg_pixmap_name[i])
+        result = (result << 5) - result + g_str_hash (rc_style->bg_pixmap_name[i]);
+    }
+
+  result = (result << 5) - result + rc_style->xthickness;
+  result = (result << 5) - result + rc_style->ythickness;
+
+  if (rc_style->font_desc)
+    result ^= pango_font_description_hash (rc_style->font_desc);
+
+  return result;
+}
+
+static gboolean
+gtk_rc_style_contents_equal (gconstpointer a,
+                             gconstpointer b)
+{
+  const GtkRcStyle *style_a = a;
+  const GtkRcStyle *style_b = b;
+  gint i;
+
+  if (style_a->xthickness != style_b->xthickness ||
+      style_a->ythickness != style_b->ythickness)
+    return FALSE;
+
+  if (style_a->font_desc && style_b->font_desc)
+    {
+      if (!pango_font_description_equal (style_a->font_desc, style_b->font_desc))
+        return FALSE;
+    }
+  else if (style_a->font_desc || style_b->font_desc)
+    return FALSE;
+
+  for (i = 0; i < 5; i++)
+    {
+      if (style_a->color_flags[i] != style_b->color_flags[i])
+        return FALSE;
+
+      if ((style_a->color_flags[i] & GTK_RC_FG) &&
+          !gdk_color_equal (&style_a->fg[i], &style_b->fg[i]))
+        return FALSE;
+      if ((style_a->color_flags[i] & GTK_RC_BG) &&
+          !gdk_color_equal (&style_a->bg[i], &style_b->bg[i]))
+        return FALSE;
+      if ((style_a->color_flags[i] & GTK_RC_TEXT) &&
+          !gdk_color_equal (&style_a->text[i], &style_b->text[i]))
+        return FALSE;
+      if ((style_a->color_flags[i] & GTK_RC_BASE) &&
+          !gdk_color_equal (&style_a->base[i], &style_b->base[i]))
+        return FALSE;
+
+      if (g_strcmp0 (style_a->bg_pixmap_name[i], style_b->bg_pixmap_name[i]) != 0)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/**
+ * _gtk_rc_style_intern:
+ * @rc_style: a #GtkRcStyle
+ *
+ * Returns a copy of @rc_style that may be shared with other users
+ * that asked for a style with the same contents. Widgets that are
+ * modified in the same way then end up with the same rc style list,
+ * and so share one realized #GtkStyle, including its property cache.
+ *
+ * The returned style must not be modified; see _gtk_rc_style_is_shared().
+ *
+ * Return value: a new reference to the interned style
+ **/
+GtkRcStyle *
+_gtk_rc_style_intern (GtkRcStyle *rc_style)
+{
+  GtkRcStyle *interned;
+
+  g_return_val_if_fail (GTK_IS_RC_STYLE (rc_style), NULL);
+
+  if (!gtk_rc_style_can_intern (rc_style))
+    return gtk_rc_style_copy (rc_style);
+
+  if (!interned_rc_styles)
+    interned_rc_styles = g_hash_table_new (gtk_rc_style_contents_hash,
+                                           gtk_rc_style_contents_equal);
+
+  interned = g_hash_table_lookup (interned_rc_styles, rc_style);
+  if (interned)
+    return g_object_ref (interned);
+
+  interned = gtk_rc_style_copy (rc_style);
+  GTK_RC_STYLE_GET_PRIVATE (interned)->interned = TRUE;
+  g_hash_table_insert (interned_rc_styles, interned, interned);
+
+  return interned;
+}
+
+/**
+ * _gtk_rc_style_is_shared:
+ * @rc_style: a #GtkRcStyle
+ *
+ * Checks whether @rc_style was returned by _gtk_rc_style_intern()
+ * and is still in use elsewhere, in which case it must be copied
+ * before it is modified. An interned style that only has the
+ * caller's reference is taken out of the table and becomes an
+ * ordinary, modifiable style.
+ *
+ * Return value: %TRUE if @rc_style must not be modified
+ **/
+gboolean
+_gtk_rc_style_is_shared (GtkRcStyle *rc_style)
+{
+  GtkRcStylePrivate *priv;
+
+  g_return_val_if_fail (GTK_IS_RC_STYLE (rc_style), FALSE);
+
+  priv = GTK_RC_STYLE_GET_PRIVATE (rc_style);
+
+  if (!priv->interned)
+    return FALSE;
+
+  if (G_OBJECT (rc_style)->ref_count > 1)
+    return TRUE;
+
+  g_hash_table_remove (interned_rc_styles, rc_style);
+  priv->interned = FALSE;
+
+  return FALSE;
+}
+
 void
 _gtk_rc_style_set_rc_property (GtkRcStyle *rc_style,
 			       GtkRcProperty *property)
@@ -1613,6 +2238,8 @@ gtk_rc_free_rc_sets (GSList *slist)
 static void
 gtk_rc_clear_styles (GtkRcContext *context)
 {
+  gtk_rc_clear_match_cache (context);
+
   /* Clear out all old rc_styles */
 
   if (context->rc_style_ht)
@@ -1812,6 +2439,8 @@ gtk_rc_reparse_all_for_settings (GtkSettings *settings,
       
   if (force_load || mtime_modified)
     {
+      gtk_rc_lookup_cache_recheck ();
+
       _gtk_binding_reset_parsed ();
       gtk_rc_clear_styles (context);
       context->reloading = TRUE;
@@ -1849,6 +2478,8 @@ gtk_rc_reparse_all_for_settings (GtkSettings *settings,
 
       context->reloading = FALSE;
 
+      gtk_rc_lookup_cache_save ();
+
       gtk_rc_reset_widgets (context->settings);
     }
 
@@ -1952,6 +2583,157 @@ sort_and_dereference_sets (GSList *styles)
   return styles;
 }
 
+static GSList *
+gtk_rc_styles_match_path (GSList      *rc_styles,
+                          GSList      *sets,
+                          const gchar *path)
+{
+  gchar *path_reversed;
+
+  path_reversed = g_strdup (path);
+  g_strreverse (path_reversed);
+
+  rc_styles = gtk_rc_styles_match (rc_styles, sets, strlen (path),
+                                   (gchar *) path, path_reversed);
+  g_free (path_reversed);
+
+  return rc_styles;
+}
+
+static guint
+gtk_rc_match_key_hash (gconstpointer v)
+{
+  const GtkRcMatchKey *key = v;
+  guint h = key->type;
+
+  if (key->widget_path)
+    h = h * 31 + g_str_hash (key->widget_path);
+  if (key->class_path)
+    h = h * 31 + g_str_hash (key->class_path);
+
+  return h;
+}
+
+static gboolean
+gtk_rc_match_key_equal (gconstpointer a,
+                        gconstpointer b)
+{
+  const GtkRcMatchKey *key_a = a;
+  const GtkRcMatchKey *key_b = b;
+
+  return key_a->type == key_b->type &&
+         g_strcmp0 (key_a->widget_path, key_b->widget_path) == 0 &&
+         g_strcmp0 (key_a->class_path, key_b->class_path) == 0;
+}
+
+static void
+gtk_rc_match_key_free (gpointer data)
+{
+  GtkRcMatchKey *key = data;
+
+  g_free (key->widget_path);
+  g_free (key->class_path);
+  g_slice_free (GtkRcMatchKey, key);
+}
+
+/* The cached lists point to the rc styles of the current rc sets,
+ * so this must be called whenever the sets change.
+ */
+static void
+gtk_rc_clear_match_cache (GtkRcContext *context)
+{
+  if (context->match_cache)
+    {
+      GTK_NOTE (MISC,
+		g_print ("rc style matches: %u from cache, %u computed\n",
+			 context->match_hits, context->match_misses));
+
+      g_hash_table_destroy (context->match_cache);
+      context->match_cache = NULL;
+    }
+}
+
+/* Finds the rc styles matching a widget, sorted by priority. Takes
+ * ownership of @widget_path and @class_path; the returned list
+ * belongs to the caller.
+ */
+static GSList *
+gtk_rc_context_match (GtkRcContext *context,
+                      gchar        *widget_path,
+                      gchar        *class_path,
+                      GType         type)
+{
+  GtkRcMatchKey lookup;
+  GtkRcMatchKey *key;
+  GSList *rc_styles = NULL;
+  gpointer cached;
+
+  if (!context->rc_sets_widget)
+    {
+      g_free (widget_path);
+      widget_path = NULL;
+    }
+
+  if (!context->rc_sets_widget_class)
+    {
+      g_free (class_path);
+      class_path = NULL;
+    }
+
+  if (!context->rc_sets_class)
+    type = G_TYPE_NONE;
+
+  lookup.widget_path = widget_path;
+  lookup.class_path = class_path;
+  lookup.type = type;
+
+  if (context->match_cache &&
+      g_hash_table_lookup_extended (context->match_cache, &lookup, NULL, &cached))
+    {
+      context->match_hits++;
+
+      g_free (widget_path);
+      g_free (class_path);
+
+      return g_slist_copy (cached);
+    }
+
+  context->match_misses++;
+
+  if (widget_path)
+    rc_styles = gtk_rc_styles_match_path (rc_styles, context->rc_sets_widget, widget_path);
+
+  if (class_path)
+    rc_styles = gtk_rc_styles_match_path (rc_styles, context->rc_sets_widget_class, class_path);
+
+  if (type != G_TYPE_NONE)
+    {
+      GType t;
+
+      for (t = type; t; t = g_type_parent (t))
+	rc_styles = gtk_rc_styles_match_path (rc_styles, context->rc_sets_class, g_type_name (t));
+    }
+
+  rc_styles = sort_and_dereference_sets (rc_styles);
+
+  if (!context->match_cache)
+    context->match_cache = g_hash_table_new_full (gtk_rc_match_key_hash,
+                                                  gtk_rc_match_key_equal,
+                                                  gtk_rc_match_key_free,
+                                                  (GDestroyNotify) g_slist_free);
+  else if (g_hash_table_size (context->match_cache) >= GTK_RC_MATCH_CACHE_SIZE)
+    g_hash_table_remove_all (context->match_cache);
+
+  key = g_slice_new (GtkRcMatchKey);
+  key->widget_path = widget_path;
+  key->class_path = class_path;
+  key->type = type;
+
+  g_hash_table_insert (context->match_cache, key, g_slist_copy (rc_styles));
+
+  return rc_styles;
+}
+
 /**
  * gtk_rc_get_style:
  * @widget: a #GtkWidget
@@ -1971,8 +2753,10 @@ GtkStyle *
 gtk_rc_get_style (GtkWidget *widget)
 {
   GtkRcStyle *widget_rc_style;
-  GSList *rc_styles = NULL;
+  GSList *rc_styles;
   GtkRcContext *context;
+  gchar *path = NULL;
+  gchar *class_path = NULL;
 
   static guint rc_style_key_id = 0;
 
@@ -1987,52 +2771,13 @@ gtk_rc_get_style (GtkWidget *widget)
     rc_style_key_id = g_quark_from_static_string ("gtk-rc-style");
 
   if (context->rc_sets_widget)
-    {
-      gchar *path, *path_reversed;
-      guint path_length;
+    gtk_widget_path (widget, NULL, &path, NULL);
 
-      gtk_widget_path (widget, &path_length, &path, &path_reversed);
-      rc_styles = gtk_rc_styles_match (rc_styles, context->rc_sets_widget, path_length, path, path_reversed);
-      g_free (path);
-      g_free (path_reversed);
-    }
-  
   if (context->rc_sets_widget_class)
-    {
-      gchar *path, *path_reversed;
-      guint path_length;
-
-      gtk_widget_class_path (widget, &path_length, &path, &path_reversed);
-      rc_styles = gtk_rc_styles_match (rc_styles, context->rc_sets_widget_class, path_length, path, path_reversed);
-      g_free (path);
-      g_free (path_reversed);
-    }
-
-  if (context->rc_sets_class)
-    {
-      GType type;
+    gtk_widget_class_path (widget, NULL, &class_path, NULL);
 
-      type = G_TYPE_FROM_INSTANCE (widget);
-      while (type)
-	{
-	  gchar *path;
-          gchar *path_reversed;
-	  guint path_length;
-
-	  path = g_strdup (g_type_name (type));
-	  path_length = strlen (path);
-	  path_reversed = g_strdup (path);
-	  g_strreverse (path_reversed);
-	  
-	  rc_styles = gtk_rc_styles_match (rc_styles, context->rc_sets_class, path_length, path, path_reversed);
-	  g_free (path);
-	  g_free (path_reversed);
-      
-	  type = g_type_parent (type);
-	}
-    }
-  
-  rc_styles = sort_and_dereference_sets (rc_styles);
+  rc_styles = gtk_rc_context_match (context, path, class_path,
+                                    G_TYPE_FROM_INSTANCE (widget));
   
   widget_rc_style = g_object_get_qdata (G_OBJECT (widget), rc_style_key_id);
 
@@ -2090,71 +2835,17 @@ gtk_rc_get_style_by_paths (GtkSettings *settings,
 			   const char  *class_path,
 			   GType        type)
 {
-  /* We duplicate the code from above to avoid slowing down the above
-   * by generating paths when we don't need them. I don't know if
-   * this is really worth it.
-   */
-  GSList *rc_styles = NULL;
+  GSList *rc_styles;
   GtkRcContext *context;
 
   g_return_val_if_fail (GTK_IS_SETTINGS (settings), NULL);
 
   context = gtk_rc_context_get (settings);
 
-  if (widget_path && context->rc_sets_widget)
-    {
-      gchar *path;
-      gchar *path_reversed;
-      guint path_length;
-
-      path_length = strlen (widget_path);
-      path = g_strdup (widget_path);
-      path_reversed = g_strdup (widget_path);
-      g_strreverse (path_reversed);
-
-      rc_styles = gtk_rc_styles_match (rc_styles, context->rc_sets_widget, path_length, path, path_reversed);
-      g_free (path);
-      g_free (path_reversed);
-    }
-  
-  if (class_path && context->rc_sets_widget_class)
-    {
-      gchar *path;
-      gchar *path_reversed;
-      guint path_length;
-
-      path = g_strdup (class_path);
-      path_length = strlen (class_path);
-      path_reversed = g_strdup (class_path);
-      g_strreverse (path_reversed);
-
-      rc_styles = gtk_rc_styles_match (rc_styles, context->rc_sets_widget_class, path_length, path, path_reversed);
-      g_free (path);
-      g_free (path_reversed);
-    }
-
-  if (type != G_TYPE_NONE && context->rc_sets_class)
-    {
-      while (type)
-	{
-	  gchar *path;
-          gchar *path_reversed;
-	  guint path_length;
-
-	  path = g_strdup (g_type_name (type));
-	  path_length = strlen (path);
-	  path_reversed = g_strdup (path);
-	  g_strreverse (path_reversed);
-	  
-	  rc_styles = gtk_rc_styles_match (rc_styles, context->rc_sets_class, path_length, path, path_reversed);
-	  g_free (path);
-	  g_free (path_reversed);
-      
-	  type = g_type_parent (type);
-	}
-    }
- 
-  rc_styles = sort_and_dereference_sets (rc_styles);
+  rc_styles = gtk_rc_context_match (context,
+                                    g_strdup (widget_path),
+                                    g_strdup (class_path),
+                                    type);
   
   if (rc_styles)
     return gtk_rc_init_style (context, rc_styles);
@@ -2211,6 +2902,7 @@ gtk_rc_add_widget_name_style (GtkRcStyle  *rc_style,
 
   context = gtk_rc_context_get (gtk_settings_get_default ());
   
+  gtk_rc_clear_match_cache (context);
   context->rc_sets_widget = gtk_rc_add_rc_sets (context->rc_sets_widget, rc_style, pattern, GTK_PATH_WIDGET);
 }
 
@@ -2225,6 +2917,7 @@ gtk_rc_add_widget_class_style (GtkRcStyle  *rc_style,
 
   context = gtk_rc_context_get (gtk_settings_get_default ());
   
+  gtk_rc_clear_match_cache (context);
   context->rc_sets_widget_class = gtk_rc_add_rc_sets (context->rc_sets_widget_class, rc_style, pattern, GTK_PATH_WIDGET_CLASS);
 }
 
@@ -2239,6 +2932,7 @@ gtk_rc_add_class_style (GtkRcStyle  *rc_style,
 
   context = gtk_rc_context_get (gtk_settings_get_default ());
   
+  gtk_rc_clear_match_cache (context);
   context->rc_sets_class = gtk_rc_add_rc_sets (context->rc_sets_class, rc_style, pattern, GTK_PATH_CLASS);
 }
 
@@ -2883,7 +3577,7 @@ parse_include_file (GtkRcContext *context,
 	  GtkRcFile *curfile = tmp_list->data;
 	  gchar *tmpname = g_build_filename (curfile->directory, filename, NULL);
 
-	  if (g_file_test (tmpname, G_FILE_TEST_EXISTS))
+	  if (gtk_rc_file_exists (tmpname))
 	    {
 	      to_parse = tmpname;
 	      break;
@@ -3010,6 +3704,8 @@ fixup_rc_sets (GtkRcContext *context,
 	       GtkRcStyle   *orig,
 	       GtkRcStyle   *new)
 {
+  gtk_rc_clear_match_cache (context);
+
   fixup_rc_set (context->rc_sets_widget, orig, new);
   fixup_rc_set (context->rc_sets_widget_class, orig, new);
   fixup_rc_set (context->rc_sets_class, orig, new);
@@ -3480,7 +4176,7 @@ gtk_rc_check_pixmap_dir (const gchar *dir,
 
   buf = g_build_filename (dir, pixmap_file, NULL);
 
-  if (g_file_test (buf, G_FILE_TEST_EXISTS))
+  if (gtk_rc_file_exists (buf))
     return buf;
    
   g_free (buf);
@@ -4274,6 +4970,8 @@ gtk_rc_parse_path_pattern (GtkRcContext *context,
       rc_set->rc_style = rc_style;
       rc_set->priority = priority;
 
+      gtk_rc_clear_match_cache (context);
+
       if (path_type == GTK_PATH_WIDGET)
 	context->rc_sets_widget = g_slist_prepend (context->rc_sets_widget, rc_set);
       else if (path_type == GTK_PATH_WIDGET_CLASS)
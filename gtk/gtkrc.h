@@ -263,6 +263,9 @@ void	      _gtk_rc_style_unset_rc_property	      (GtkRcStyle *rc_style,
 
 GSList     * _gtk_rc_style_get_color_hashes        (GtkRcStyle *rc_style);
 
+GtkRcStyle * _gtk_rc_style_intern                  (GtkRcStyle *rc_style);
+gboolean     _gtk_rc_style_is_shared               (GtkRcStyle *rc_style);
+
 void         _gtk_rc_style_set_symbolic_color       (GtkRcStyle     *rc_style,
                                                      const gchar    *name,
                                                      const GdkColor *color);
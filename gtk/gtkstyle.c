@@ -59,6 +59,9 @@ typedef struct _GtkStylePrivate GtkStylePrivate;
 
 struct _GtkStylePrivate {
   GSList *color_hashes;
+
+  /* States whose bg_pixmap_name hasn't been loaded yet */
+  guint bg_pixmap_pending : 5;
 };
 
 /* --- prototypes --- */
@@ -67,6 +70,8 @@ static void	 gtk_style_realize		(GtkStyle	*style,
 						 GdkColormap	*colormap);
 static void      gtk_style_real_realize        (GtkStyle	*style);
 static void      gtk_style_real_unrealize      (GtkStyle	*style);
+static void      gtk_style_ensure_bg_pixmap    (GtkStyle	*style,
+						GtkStateType	 state_type);
 static void      gtk_style_real_copy           (GtkStyle	*style,
 						GtkStyle	*src);
 static void      gtk_style_real_set_background (GtkStyle	*style,
@@ -1634,6 +1639,8 @@ gtk_style_set_background (GtkStyle    *style,
   g_return_if_fail (GTK_IS_STYLE (style));
   g_return_if_fail (window != NULL);
   
+  gtk_style_ensure_bg_pixmap (style, state_type);
+
   GTK_STYLE_GET_CLASS (style)->set_background (style, window, state_type);
 }
 
@@ -1978,24 +1985,130 @@ _gtk_style_peek_property_value (GtkStyle           *style,
   return &pcache->value;
 }
 
+/* Background pixmaps shared between styles, keyed by what they
+ * are rendered from. The cache holds no references; entries go
+ * away with their pixmap.
+ */
+typedef struct
+{
+  gchar       *filename;
+  GdkColormap *colormap;
+  guint16      red;
+  guint16      green;
+  guint16      blue;
+} BgImageKey;
+
+static GHashTable *bg_image_cache = NULL;
+
+static guint
+bg_image_key_hash (gconstpointer v)
+{
+  const BgImageKey *key = v;
+
+  return g_str_hash (key->filename) ^
+         GPOINTER_TO_UINT (key->colormap) ^
+         (key->red << 16) ^ (key->green << 8) ^ key->blue;
+}
+
+static gboolean
+bg_image_key_equal (gconstpointer a,
+                    gconstpointer b)
+{
+  const BgImageKey *key_a = a;
+  const BgImageKey *key_b = b;
+
+  return key_a->colormap == key_b->colormap &&
+         key_a->red == key_b->red &&
+         key_a->green == key_b->green &&
+         key_a->blue == key_b->blue &&
+         strcmp (key_a->filename, key_b->filename) == 0;
+}
+
+static void
+bg_image_key_free (gpointer data)
+{
+  BgImageKey *key = data;
+
+  g_free (key->filename);
+  g_slice_free (BgImageKey, key);
+}
+
+static void
+bg_image_finalized (gpointer  data,
+                    GObject  *where_the_object_was)
+{
+  g_hash_table_remove (bg_image_cache, data);
+}
+
 static GdkPixmap *
 load_bg_image (GdkColormap *colormap,
 	       GdkColor    *bg_color,
 	       const gchar *filename)
 {
+  BgImageKey lookup;
+  BgImageKey *key;
+  GdkPixmap *pixmap;
+
   if (strcmp (filename, "<parent>") == 0)
     return (GdkPixmap*) GDK_PARENT_RELATIVE;
-  else
+
+  if (!bg_image_cache)
+    bg_image_cache = g_hash_table_new_full (bg_image_key_hash,
+                                            bg_image_key_equal,
+                                            bg_image_key_free,
+                                            NULL);
+
+  lookup.filename = (gchar *) filename;
+  lookup.colormap = colormap;
+  lookup.red = bg_color->red;
+  lookup.green = bg_color->green;
+  lookup.blue = bg_color->blue;
+
+  pixmap = g_hash_table_lookup (bg_image_cache, &lookup);
+  if (pixmap)
+    return g_object_ref (pixmap);
+
+  pixmap = gdk_pixmap_colormap_create_from_xpm (NULL, colormap, NULL,
+                                                bg_color,
+                                                filename);
+  if (pixmap)
     {
-      return gdk_pixmap_colormap_create_from_xpm (NULL, colormap, NULL,
-						  bg_color,
-						  filename);
+      key = g_slice_new (BgImageKey);
+      *key = lookup;
+      key->filename = g_strdup (filename);
+
+      g_hash_table_insert (bg_image_cache, key, pixmap);
+      g_object_weak_ref (G_OBJECT (pixmap), bg_image_finalized, key);
     }
+
+  return pixmap;
+}
+
+/* Background pixmaps are loaded the first time a state is painted
+ * with, since most widgets never use most states.
+ */
+static void
+gtk_style_ensure_bg_pixmap (GtkStyle     *style,
+                            GtkStateType  state_type)
+{
+  GtkStylePrivate *priv = GTK_STYLE_GET_PRIVATE (style);
+
+  if (!(priv->bg_pixmap_pending & (1 << state_type)))
+    return;
+
+  priv->bg_pixmap_pending &= ~(1 << state_type);
+
+  /* Engines may have set up their own */
+  if (!style->bg_pixmap[state_type])
+    style->bg_pixmap[state_type] = load_bg_image (style->colormap,
+                                                  &style->bg[state_type],
+                                                  style->rc_style->bg_pixmap_name[state_type]);
 }
 
 static void
 gtk_style_real_realize (GtkStyle *style)
 {
+  GtkStylePrivate *priv = GTK_STYLE_GET_PRIVATE (style);
   GdkGCValues gc_values;
   GdkGCValuesMask gc_values_mask;
   
@@ -2040,9 +2153,7 @@ gtk_style_real_realize (GtkStyle *style)
   for (i = 0; i < 5; i++)
     {
       if (style->rc_style && style->rc_style->bg_pixmap_name[i])
-	style->bg_pixmap[i] = load_bg_image (style->colormap,
-					     &style->bg[i],
-					     style->rc_style->bg_pixmap_name[i]);
+	priv->bg_pixmap_pending |= 1 << i;
       
       if (!gdk_colormap_alloc_color (style->colormap, &style->fg[i], FALSE, TRUE))
         g_warning ("unable to allocate color: ( %d %d %d )",
@@ -2093,13 +2204,30 @@ gtk_style_real_realize (GtkStyle *style)
       gc_values.foreground = style->text_aa[i];
       style->text_aa_gc[i] = gtk_gc_get (style->depth, style->colormap, &gc_values, gc_values_mask);
     }
+
+  /* Every widget paints in the normal state, and code outside
+   * GtkStyle reads bg_pixmap[GTK_STATE_NORMAL] directly.  Theme
+   * engines subclass GtkStyle to replace the draw functions, and
+   * those read bg_pixmap[] of any state directly, so their styles
+   * get all states loaded up front.
+   */
+  if (G_OBJECT_TYPE (style) != GTK_TYPE_STYLE)
+    {
+      for (i = 0; i < 5; i++)
+        gtk_style_ensure_bg_pixmap (style, i);
+    }
+  else
+    gtk_style_ensure_bg_pixmap (style, GTK_STATE_NORMAL);
 }
 
 static void
 gtk_style_real_unrealize (GtkStyle *style)
 {
+  GtkStylePrivate *priv = GTK_STYLE_GET_PRIVATE (style);
   int i;
 
+  priv->bg_pixmap_pending = 0;
+
   gtk_gc_release (style->black_gc);
   gtk_gc_release (style->white_gc);
       
@@ -2244,6 +2372,8 @@ gtk_style_apply_default_background (GtkStyle          *style,
       new_rect.width = width;
       new_rect.height = height;
     }
+
+  gtk_style_ensure_bg_pixmap (style, state_type);
   
   if (!style->bg_pixmap[state_type] ||
       GDK_IS_PIXMAP (window) ||
@@ -2409,6 +2539,83 @@ sanitize_size (GdkWindow *window,
     gdk_drawable_get_size (window, NULL, height);
 }
 
+/* Returns @area, or %NULL if @area already contains the given
+ * rectangle and clipping to it would only cost extra requests.
+ * Exposes usually cover whole widgets, so this is the common case.
+ */
+static GdkRectangle *
+effective_clip_area (GdkRectangle *area,
+                     gint          x,
+                     gint          y,
+                     gint          width,
+                     gint          height)
+{
+  if (area &&
+      x >= area->x && y >= area->y &&
+      x + width <= area->x + area->width &&
+      y + height <= area->y + area->height)
+    return NULL;
+
+  return area;
+}
+
+/* Collects consecutive lines drawn with the same GC and sends them
+ * as a single gdk_draw_segments() call. Switching GCs flushes the
+ * pending lines, so the painting order is the same as with
+ * individual gdk_draw_line() calls.
+ */
+#define LINE_BATCH_SIZE 8
+
+typedef struct
+{
+  GdkDrawable *drawable;
+  GdkGC       *gc;
+  GdkSegment   segs[LINE_BATCH_SIZE];
+  gint         n_segs;
+} LineBatch;
+
+static void
+line_batch_init (LineBatch   *batch,
+                 GdkDrawable *drawable)
+{
+  batch->drawable = drawable;
+  batch->gc = NULL;
+  batch->n_segs = 0;
+}
+
+static void
+line_batch_flush (LineBatch *batch)
+{
+  if (batch->n_segs > 0)
+    gdk_draw_segments (batch->drawable, batch->gc,
+                       batch->segs, batch->n_segs);
+
+  batch->n_segs = 0;
+}
+
+static void
+line_batch_add (LineBatch *batch,
+                GdkGC     *gc,
+                gint       x1,
+                gint       y1,
+                gint       x2,
+                gint       y2)
+{
+  GdkSegment *seg;
+
+  if (gc != batch->gc || batch->n_segs == LINE_BATCH_SIZE)
+    {
+      line_batch_flush (batch);
+      batch->gc = gc;
+    }
+
+  seg = &batch->segs[batch->n_segs++];
+  seg->x1 = x1;
+  seg->y1 = y1;
+  seg->x2 = x2;
+  seg->y2 = y2;
+}
+
 static void
 gtk_default_draw_hline (GtkStyle     *style,
                         GdkWindow    *window,
@@ -2516,27 +2723,33 @@ draw_thin_shadow (GtkStyle      *style,
 		  gint           height)
 {
   GdkGC *gc1, *gc2;
+  LineBatch batch;
 
   sanitize_size (window, &width, &height);
   
   gc1 = style->light_gc[state];
   gc2 = style->dark_gc[state];
   
+  area = effective_clip_area (area, x, y, width, height);
   if (area)
     {
       gdk_gc_set_clip_rectangle (gc1, area);
       gdk_gc_set_clip_rectangle (gc2, area);
     }
   
-  gdk_draw_line (window, gc1,
-		 x, y + height - 1, x + width - 1, y + height - 1);
-  gdk_draw_line (window, gc1,
-		 x + width - 1, y,  x + width - 1, y + height - 1);
+  line_batch_init (&batch, window);
+
+  line_batch_add (&batch, gc1,
+		  x, y + height - 1, x + width - 1, y + height - 1);
+  line_batch_add (&batch, gc1,
+		  x + width - 1, y,  x + width - 1, y + height - 1);
       
-  gdk_draw_line (window, gc2,
-		 x, y, x + width - 2, y);
-  gdk_draw_line (window, gc2,
-		 x, y, x, y + height - 2);
+  line_batch_add (&batch, gc2,
+		  x, y, x + width - 2, y);
+  line_batch_add (&batch, gc2,
+		  x, y, x, y + height - 2);
+
+  line_batch_flush (&batch);
 
   if (area)
     {
@@ -2702,6 +2915,7 @@ gtk_default_draw_shadow (GtkStyle      *style,
   gint thickness_light;
   gint thickness_dark;
   gint i;
+  LineBatch batch;
   
   if (shadow_type == GTK_SHADOW_IN)
     {
@@ -2754,6 +2968,8 @@ gtk_default_draw_shadow (GtkStyle      *style,
       break;
     }
   
+  /* The one pixel etched shadow draws one pixel past the rectangle */
+  area = effective_clip_area (area, x, y, width + 1, height + 1);
   if (area)
     {
       gdk_gc_set_clip_rectangle (gc1, area);
@@ -2766,6 +2982,8 @@ gtk_default_draw_shadow (GtkStyle      *style,
         }
     }
   
+  line_batch_init (&batch, window);
+
   switch (shadow_type)
     {
     case GTK_SHADOW_NONE:
@@ -2775,34 +2993,34 @@ gtk_default_draw_shadow (GtkStyle      *style,
       /* Light around right and bottom edge */
 
       if (style->ythickness > 0)
-        gdk_draw_line (window, gc1,
-                       x, y + height - 1, x + width - 1, y + height - 1);
+        line_batch_add (&batch, gc1,
+                        x, y + height - 1, x + width - 1, y + height - 1);
       if (style->xthickness > 0)
-        gdk_draw_line (window, gc1,
-                       x + width - 1, y, x + width - 1, y + height - 1);
+        line_batch_add (&batch, gc1,
+                        x + width - 1, y, x + width - 1, y + height - 1);
 
       if (style->ythickness > 1)
-        gdk_draw_line (window, style->bg_gc[state_type],
-                       x + 1, y + height - 2, x + width - 2, y + height - 2);
+        line_batch_add (&batch, style->bg_gc[state_type],
+                        x + 1, y + height - 2, x + width - 2, y + height - 2);
       if (style->xthickness > 1)
-        gdk_draw_line (window, style->bg_gc[state_type],
-                       x + width - 2, y + 1, x + width - 2, y + height - 2);
+        line_batch_add (&batch, style->bg_gc[state_type],
+                        x + width - 2, y + 1, x + width - 2, y + height - 2);
 
       /* Dark around left and top */
 
       if (style->ythickness > 1)
-        gdk_draw_line (window, style->black_gc,
-                       x + 1, y + 1, x + width - 2, y + 1);
+        line_batch_add (&batch, style->black_gc,
+                        x + 1, y + 1, x + width - 2, y + 1);
       if (style->xthickness > 1)
-        gdk_draw_line (window, style->black_gc,
-                       x + 1, y + 1, x + 1, y + height - 2);
+        line_batch_add (&batch, style->black_gc,
+                        x + 1, y + 1, x + 1, y + height - 2);
 
       if (style->ythickness > 0)
-        gdk_draw_line (window, gc2,
-                       x, y, x + width - 1, y);
+        line_batch_add (&batch, gc2,
+                        x, y, x + width - 1, y);
       if (style->xthickness > 0)
-        gdk_draw_line (window, gc2,
-                       x, y, x, y + height - 1);
+        line_batch_add (&batch, gc2,
+                        x, y, x, y + height - 1);
       break;
       
     case GTK_SHADOW_OUT:
@@ -2812,15 +3030,15 @@ gtk_default_draw_shadow (GtkStyle      *style,
         {
           if (style->ythickness > 1)
             {
-              gdk_draw_line (window, gc1,
-                             x + 1, y + height - 2, x + width - 2, y + height - 2);
-              gdk_draw_line (window, style->black_gc,
-                             x, y + height - 1, x + width - 1, y + height - 1);
+              line_batch_add (&batch, gc1,
+                              x + 1, y + height - 2, x + width - 2, y + height - 2);
+              line_batch_add (&batch, style->black_gc,
+                              x, y + height - 1, x + width - 1, y + height - 1);
             }
           else
             {
-              gdk_draw_line (window, gc1,
-                             x + 1, y + height - 1, x + width - 1, y + height - 1);
+              line_batch_add (&batch, gc1,
+                              x + 1, y + height - 1, x + width - 1, y + height - 1);
             }
         }
 
@@ -2828,34 +3046,34 @@ gtk_default_draw_shadow (GtkStyle      *style,
         {
           if (style->xthickness > 1)
             {
-              gdk_draw_line (window, gc1,
-                             x + width - 2, y + 1, x + width - 2, y + height - 2);
+              line_batch_add (&batch, gc1,
+                              x + width - 2, y + 1, x + width - 2, y + height - 2);
               
-              gdk_draw_line (window, style->black_gc,
-                             x + width - 1, y, x + width - 1, y + height - 1);
+              line_batch_add (&batch, style->black_gc,
+                              x + width - 1, y, x + width - 1, y + height - 1);
             }
           else
             {
-              gdk_draw_line (window, gc1,
-                             x + width - 1, y + 1, x + width - 1, y + height - 1);
+              line_batch_add (&batch, gc1,
+                              x + width - 1, y + 1, x + width - 1, y + height - 1);
             }
         }
       
       /* Light around top and left */
 
       if (style->ythickness > 0)
-        gdk_draw_line (window, gc2,
-                       x, y, x + width - 2, y);
+        line_batch_add (&batch, gc2,
+                        x, y, x + width - 2, y);
       if (style->xthickness > 0)
-        gdk_draw_line (window, gc2,
-                       x, y, x, y + height - 2);
+        line_batch_add (&batch, gc2,
+                        x, y, x, y + height - 2);
 
       if (style->ythickness > 1)
-        gdk_draw_line (window, style->bg_gc[state_type],
-                       x + 1, y + 1, x + width - 3, y + 1);
+        line_batch_add (&batch, style->bg_gc[state_type],
+                        x + 1, y + 1, x + width - 3, y + 1);
       if (style->xthickness > 1)
-        gdk_draw_line (window, style->bg_gc[state_type],
-                       x + 1, y + 1, x + 1, y + height - 3);
+        line_batch_add (&batch, style->bg_gc[state_type],
+                        x + 1, y + 1, x + 1, y + height - 3);
       break;
       
     case GTK_SHADOW_ETCHED_IN:
@@ -2867,42 +3085,43 @@ gtk_default_draw_shadow (GtkStyle      *style,
               thickness_light = 1;
               thickness_dark = 1;
       
+              /* None of the gc1 lines overlap an earlier gc2 line,
+               * so they can be drawn first and batched together.
+               */
               for (i = 0; i < thickness_dark; i++)
-                {
-                  gdk_draw_line (window, gc1,
-                                 x + width - i - 1,
-                                 y + i,
-                                 x + width - i - 1,
-                                 y + height - i - 1);
-                  gdk_draw_line (window, gc2,
-                                 x + i,
-                                 y + i,
-                                 x + i,
-                                 y + height - i - 2);
-                }
-      
+                line_batch_add (&batch, gc1,
+                                x + width - i - 1,
+                                y + i,
+                                x + width - i - 1,
+                                y + height - i - 1);
               for (i = 0; i < thickness_light; i++)
-                {
-                  gdk_draw_line (window, gc1,
-                                 x + thickness_dark + i,
-                                 y + thickness_dark + i,
-                                 x + thickness_dark + i,
-                                 y + height - thickness_dark - i - 1);
-                  gdk_draw_line (window, gc2,
-                                 x + width - thickness_light - i - 1,
-                                 y + thickness_dark + i,
-                                 x + width - thickness_light - i - 1,
-                                 y + height - thickness_light - 1);
-                }
+                line_batch_add (&batch, gc1,
+                                x + thickness_dark + i,
+                                y + thickness_dark + i,
+                                x + thickness_dark + i,
+                                y + height - thickness_dark - i - 1);
+
+              for (i = 0; i < thickness_dark; i++)
+                line_batch_add (&batch, gc2,
+                                x + i,
+                                y + i,
+                                x + i,
+                                y + height - i - 2);
+              for (i = 0; i < thickness_light; i++)
+                line_batch_add (&batch, gc2,
+                                x + width - thickness_light - i - 1,
+                                y + thickness_dark + i,
+                                x + width - thickness_light - i - 1,
+                                y + height - thickness_light - 1);
             }
           else
             {
-              gdk_draw_line (window, 
-                             style->dark_gc[state_type],
-                             x, y, x, y + height);                         
-              gdk_draw_line (window, 
-                             style->dark_gc[state_type],
-                             x + width, y, x + width, y + height);
+              line_batch_add (&batch,
+                              style->dark_gc[state_type],
+                              x, y, x, y + height);                         
+              line_batch_add (&batch,
+                              style->dark_gc[state_type],
+                              x + width, y, x + width, y + height);
             }
         }
 
@@ -2914,49 +3133,47 @@ gtk_default_draw_shadow (GtkStyle      *style,
               thickness_dark = 1;
       
               for (i = 0; i < thickness_dark; i++)
-                {
-                  gdk_draw_line (window, gc1,
-                                 x + i,
-                                 y + height - i - 1,
-                                 x + width - i - 1,
-                                 y + height - i - 1);
-          
-                  gdk_draw_line (window, gc2,
-                                 x + i,
-                                 y + i,
-                                 x + width - i - 2,
-                                 y + i);
-                }
-      
+                line_batch_add (&batch, gc1,
+                                x + i,
+                                y + height - i - 1,
+                                x + width - i - 1,
+                                y + height - i - 1);
               for (i = 0; i < thickness_light; i++)
-                {
-                  gdk_draw_line (window, gc1,
-                                 x + thickness_dark + i,
-                                 y + thickness_dark + i,
-                                 x + width - thickness_dark - i - 2,
-                                 y + thickness_dark + i);
-          
-                  gdk_draw_line (window, gc2,
-                                 x + thickness_dark + i,
-                                 y + height - thickness_light - i - 1,
-                                 x + width - thickness_light - 1,
-                                 y + height - thickness_light - i - 1);
-                }
+                line_batch_add (&batch, gc1,
+                                x + thickness_dark + i,
+                                y + thickness_dark + i,
+                                x + width - thickness_dark - i - 2,
+                                y + thickness_dark + i);
+
+              for (i = 0; i < thickness_dark; i++)
+                line_batch_add (&batch, gc2,
+                                x + i,
+                                y + i,
+                                x + width - i - 2,
+                                y + i);
+              for (i = 0; i < thickness_light; i++)
+                line_batch_add (&batch, gc2,
+                                x + thickness_dark + i,
+                                y + height - thickness_light - i - 1,
+                                x + width - thickness_light - 1,
+                                y + height - thickness_light - i - 1);
             }
           else
             {
-              gdk_draw_line (window, 
-                             style->dark_gc[state_type],
-                             x, y, x + width, y);
-              gdk_draw_line (window, 
-                             style->dark_gc[state_type],
-                             x, y + height, x + width, y + height);
+              line_batch_add (&batch,
+                              style->dark_gc[state_type],
+                              x, y, x + width, y);
+              line_batch_add (&batch,
+                              style->dark_gc[state_type],
+                              x, y + height, x + width, y + height);
             }
         }
       
       break;
     }
 
+  line_batch_flush (&batch);
+
   if (shadow_type == GTK_SHADOW_IN &&
       GTK_IS_SPIN_BUTTON (widget) &&
       detail && strcmp (detail, "entry") == 0)
@@ -3145,25 +3362,17 @@ gtk_default_draw_polygon (GtkStyle      *style,
     }
 }
 
+/* Appends the arrow outline to the current path of @cr, so that
+ * several arrows of the same color can be filled at once.
+ */
 static void
-draw_arrow (GdkWindow     *window,
-	    GdkColor      *color,
-	    GdkRectangle  *area,
+arrow_path (cairo_t       *cr,
 	    GtkArrowType   arrow_type,
 	    gint           x,
 	    gint           y,
 	    gint           width,
 	    gint           height)
 {
-  cairo_t *cr = gdk_cairo_create (window);
-  gdk_cairo_set_source_color (cr, color);
-  
-  if (area)
-    {
-      gdk_cairo_rectangle (cr, area);
-      cairo_clip (cr);
-    }
-    
   if (arrow_type == GTK_ARROW_DOWN)
     {
       cairo_move_to (cr, x,              y);
@@ -3190,9 +3399,6 @@ draw_arrow (GdkWindow     *window,
     }
 
   cairo_close_path (cr);
-  cairo_fill (cr);
-
-  cairo_destroy (cr);
 }
 
 static void
@@ -3279,6 +3485,8 @@ gtk_default_draw_arrow (GtkStyle      *style,
 			gint           width,
 			gint           height)
 {
+  cairo_t *cr;
+
   sanitize_size (window, &width, &height);
 
   calculate_arrow_geometry (arrow_type, &x, &y, &width, &height);
@@ -3286,11 +3494,28 @@ gtk_default_draw_arrow (GtkStyle      *style,
   if (detail && strcmp (detail, "menu_scroll_arrow_up") == 0)
     y++;
 
+  cr = gdk_cairo_create (window);
+
+  /* The insensitive shadow is offset by one pixel */
+  area = effective_clip_area (area, x, y, width + 1, height + 1);
+  if (area)
+    {
+      gdk_cairo_rectangle (cr, area);
+      cairo_clip (cr);
+    }
+
   if (state == GTK_STATE_INSENSITIVE)
-    draw_arrow (window, &style->white, area, arrow_type,
-		x + 1, y + 1, width, height);
-  draw_arrow (window, &style->fg[state], area, arrow_type,
-	      x, y, width, height);
+    {
+      gdk_cairo_set_source_color (cr, &style->white);
+      arrow_path (cr, arrow_type, x + 1, y + 1, width, height);
+      cairo_fill (cr);
+    }
+
+  gdk_cairo_set_source_color (cr, &style->fg[state]);
+  arrow_path (cr, arrow_type, x, y, width, height);
+  cairo_fill (cr);
+
+  cairo_destroy (cr);
 }
 
 static void
@@ -3537,23 +3762,27 @@ gtk_default_draw_box (GtkStyle      *style,
 	}
     }
   
+  gtk_style_ensure_bg_pixmap (style, state_type);
+
   if (!style->bg_pixmap[state_type] || 
       GDK_IS_PIXMAP (window))
     {
       GdkGC *gc = style->bg_gc[state_type];
-      
+      GdkRectangle *clip;
+
       if (state_type == GTK_STATE_SELECTED && detail && strcmp (detail, "paned") == 0)
 	{
 	  if (widget && !gtk_widget_has_focus (widget))
 	    gc = style->base_gc[GTK_STATE_ACTIVE];
 	}
 
-      if (area)
-	gdk_gc_set_clip_rectangle (gc, area);
+      clip = effective_clip_area (area, x, y, width, height);
+      if (clip)
+	gdk_gc_set_clip_rectangle (gc, clip);
 
       gdk_draw_rectangle (window, gc, TRUE,
                           x, y, width, height);
-      if (area)
+      if (clip)
 	gdk_gc_set_clip_rectangle (gc, NULL);
     }
   else
@@ -3565,6 +3794,8 @@ gtk_default_draw_box (GtkStyle      *style,
     {
       GdkGC *upper_gc;
       GdkGC *lower_gc;
+      GdkRectangle *clip;
+      LineBatch batch;
       
       lower_gc = style->dark_gc[state_type];
       if (shadow_type == GTK_SHADOW_OUT)
@@ -3572,19 +3803,22 @@ gtk_default_draw_box (GtkStyle      *style,
       else
 	upper_gc = style->dark_gc[state_type];
 
-      if (area)
+      clip = effective_clip_area (area, x, y, width, height);
+      if (clip)
 	{
-	  gdk_gc_set_clip_rectangle (style->dark_gc[state_type], area);
-	  gdk_gc_set_clip_rectangle (style->light_gc[state_type], area);
+	  gdk_gc_set_clip_rectangle (upper_gc, clip);
+	  gdk_gc_set_clip_rectangle (lower_gc, clip);
 	}
       
-      gdk_draw_line (window, upper_gc, x, y, x + width - 1, y);
-      gdk_draw_line (window, lower_gc, x, y + height - 1, x + width - 1, y + height - 1);
+      line_batch_init (&batch, window);
+      line_batch_add (&batch, upper_gc, x, y, x + width - 1, y);
+      line_batch_add (&batch, lower_gc, x, y + height - 1, x + width - 1, y + height - 1);
+      line_batch_flush (&batch);
 
-      if (area)
+      if (clip)
 	{
-	  gdk_gc_set_clip_rectangle (style->dark_gc[state_type], NULL);
-	  gdk_gc_set_clip_rectangle (style->light_gc[state_type], NULL);
+	  gdk_gc_set_clip_rectangle (upper_gc, NULL);
+	  gdk_gc_set_clip_rectangle (lower_gc, NULL);
 	}
       return;
     }
@@ -3816,6 +4050,8 @@ gtk_default_draw_flat_box (GtkStyle      *style,
   else
     gc1 = style->bg_gc[state_type];
   
+  gtk_style_ensure_bg_pixmap (style, state_type);
+
   if (!style->bg_pixmap[state_type] || gc1 != style->bg_gc[state_type] ||
       GDK_IS_PIXMAP (window))
     {
@@ -4105,6 +4341,7 @@ gtk_default_draw_tab (GtkStyle      *style,
   GtkRequisition indicator_size;
   GtkBorder indicator_spacing;
   gint arrow_height;
+  cairo_t *cr;
   
   option_menu_get_props (widget, &indicator_size, &indicator_spacing);
 
@@ -4114,25 +4351,34 @@ gtk_default_draw_tab (GtkStyle      *style,
   x += (width - indicator_size.width) / 2;
   y += (height - (2 * arrow_height + ARROW_SPACE)) / 2;
 
+  cr = gdk_cairo_create (window);
+
+  area = effective_clip_area (area, x, y, indicator_size.width + 1,
+                              2 * arrow_height + ARROW_SPACE + 1);
+  if (area)
+    {
+      gdk_cairo_rectangle (cr, area);
+      cairo_clip (cr);
+    }
+
   if (state_type == GTK_STATE_INSENSITIVE)
     {
-      draw_arrow (window, &style->white, area,
-		  GTK_ARROW_UP, x + 1, y + 1,
+      gdk_cairo_set_source_color (cr, &style->white);
+      arrow_path (cr, GTK_ARROW_UP, x + 1, y + 1,
 		  indicator_size.width, arrow_height);
-      
-      draw_arrow (window, &style->white, area,
-		  GTK_ARROW_DOWN, x + 1, y + arrow_height + ARROW_SPACE + 1,
+      arrow_path (cr, GTK_ARROW_DOWN, x + 1, y + arrow_height + ARROW_SPACE + 1,
 		  indicator_size.width, arrow_height);
+      cairo_fill (cr);
     }
   
-  draw_arrow (window, &style->fg[state_type], area,
-	      GTK_ARROW_UP, x, y,
+  gdk_cairo_set_source_color (cr, &style->fg[state_type]);
+  arrow_path (cr, GTK_ARROW_UP, x, y,
 	      indicator_size.width, arrow_height);
-  
-  
-  draw_arrow (window, &style->fg[state_type], area,
-	      GTK_ARROW_DOWN, x, y + arrow_height + ARROW_SPACE,
+  arrow_path (cr, GTK_ARROW_DOWN, x, y + arrow_height + ARROW_SPACE,
 	      indicator_size.width, arrow_height);
+  cairo_fill (cr);
+
+  cairo_destroy (cr);
 }
 
 static void 
@@ -4814,6 +5060,7 @@ gtk_default_draw_focus (GtkStyle      *style,
       g_free (dashes);
     }
 
+  area = effective_clip_area (area, x, y, width, height);
   if (area)
     {
       gdk_cairo_rectangle (cr, area);
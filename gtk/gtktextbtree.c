@@ -213,6 +213,12 @@ struct _GtkTextBTree {
   guint end_iter_segment_stamp;
   
   GHashTable *child_anchor_table;
+
+  /* While invalidation is frozen, the lines whose layout needs
+   * to be invalidated once it thaws
+   */
+  guint invalidate_freeze_count;
+  GHashTable *invalidated_lines;
 };
 
 
@@ -251,6 +257,7 @@ static BTreeView        *gtk_text_btree_get_view                 (GtkTextBTree
                                                                   gpointer          view_id);
 static void              gtk_text_btree_rebalance                (GtkTextBTree     *tree,
                                                                   GtkTextBTreeNode *node);
+static void              gtk_text_btree_build_from_root_leaf     (GtkTextBTree     *tree);
 static GtkTextLine     * get_last_line                           (GtkTextBTree     *tree);
 static void              post_insert_fixup                       (GtkTextBTree     *tree,
                                                                   GtkTextLine      *insert_line,
@@ -270,6 +277,7 @@ static void             gtk_text_line_destroy           (GtkTextBTree     *tree,
                                                          GtkTextLine      *line);
 static void             gtk_text_line_set_parent        (GtkTextLine      *line,
                                                          GtkTextBTreeNode *node);
+static void             gtk_text_line_forget_index      (GtkTextLine      *line);
 static void             gtk_text_btree_node_remove_data (GtkTextBTreeNode *node,
                                                          gpointer          view_id);
 
@@ -526,6 +534,9 @@ _gtk_text_btree_unref (GtkTextBTree *tree)
       g_object_unref (tree->selection_bound_mark);
       tree->selection_bound_mark = NULL;
 
+      if (tree->invalidated_lines)
+        g_hash_table_destroy (tree->invalidated_lines);
+
       g_free (tree);
     }
 }
@@ -901,9 +912,9 @@ _gtk_text_btree_delete (GtkTextIter *start,
 	       * cleanup_line() below. See bug 317125.
 	       */
 	      next2 = prev_seg->next->next;
-	      g_free ((char *)prev_seg->next);
+	      _gtk_toggle_segment_free (prev_seg->next);
 	      prev_seg->next = next2;
-	      g_free ((char *)seg);
+	      _gtk_toggle_segment_free (seg);
 	      seg = NULL;
 	    }
 	  else
@@ -1071,6 +1082,8 @@ _gtk_text_btree_delete (GtkTextIter *start,
 
   gtk_text_btree_rebalance (tree, start_line->parent);
 
+  gtk_text_line_forget_index (start_line);
+
   /* Notify outstanding iterators that they
      are now hosed */
   chars_changed (tree);
@@ -1138,6 +1151,8 @@ _gtk_text_btree_insert (GtkTextIter *iter,
   prev_seg = gtk_text_line_segment_split (iter);
   cur_seg = prev_seg;
 
+  gtk_text_line_forget_index (start_line);
+
   /* Invalidate all iterators */
   chars_changed (tree);
   segments_changed (tree);
@@ -1223,7 +1238,19 @@ _gtk_text_btree_insert (GtkTextIter *iter,
       cleanup_line (line);
     }
 
-  post_insert_fixup (tree, line, line_count_delta, char_count_delta);
+  /* Loading text into a (nearly) empty buffer: rather than splitting
+   * the root node over and over, build the whole tree in one go.
+   */
+  if (line_count_delta > MAX_CHILDREN && tree->root_node->level == 0)
+    {
+      tree->root_node->num_children += line_count_delta;
+      gtk_text_btree_build_from_root_leaf (tree);
+
+      if (gtk_debug_flags & GTK_DEBUG_TEXT)
+        _gtk_text_btree_check (tree);
+    }
+  else
+    post_insert_fixup (tree, line, line_count_delta, char_count_delta);
 
   /* Invalidate our region, and reset the iterator the user
      passed in to point to the end of the inserted text. */
@@ -1283,6 +1310,8 @@ insert_pixbuf_or_widget_segment (GtkTextIter        *iter,
 
   post_insert_fixup (tree, line, 0, seg->char_count);
 
+  gtk_text_line_forget_index (line);
+
   chars_changed (tree);
   segments_changed (tree);
 
@@ -1634,6 +1663,42 @@ _gtk_text_btree_invalidate_region (GtkTextBTree      *tree,
 {
   BTreeView *view;
 
+  if (tree->invalidate_freeze_count > 0 && !cursors_only)
+    {
+      GtkTextLine *line;
+      GtkTextLine *last_line;
+
+      if (tree->views == NULL)
+        return;
+
+      /* Stale displays must not be handed out during the freeze;
+       * only the relayout waits for the thaw.
+       */
+      for (view = tree->views; view != NULL; view = view->next)
+        _gtk_text_layout_invalidate_frozen (view->layout, start, end);
+
+      if (tree->invalidated_lines == NULL)
+        tree->invalidated_lines = g_hash_table_new (NULL, NULL);
+
+      /* Like gtk_text_layout_invalidate(), this includes the
+       * line of @start even if the range is empty
+       */
+      last_line = _gtk_text_iter_get_text_line (end);
+      line = _gtk_text_iter_get_text_line (start);
+
+      while (TRUE)
+        {
+          g_hash_table_insert (tree->invalidated_lines, line, line);
+
+          if (line == last_line)
+            break;
+
+          line = _gtk_text_line_next_excluding_last (line);
+        }
+
+      return;
+    }
+
   view = tree->views;
 
   while (view != NULL)
@@ -1647,6 +1712,53 @@ _gtk_text_btree_invalidate_region (GtkTextBTree      *tree,
     }
 }
 
+/* Makes _gtk_text_btree_invalidate_region() only remember the lines
+ * it is given after dropping their cached displays; the views are told
+ * to relayout all of them at once when the last freeze is undone.
+ * Cursor invalidation is not deferred.
+ */
+void
+_gtk_text_btree_freeze_invalidation (GtkTextBTree *tree)
+{
+  tree->invalidate_freeze_count++;
+}
+
+void
+_gtk_text_btree_thaw_invalidation (GtkTextBTree *tree)
+{
+  GHashTable *lines;
+  GHashTableIter hash_iter;
+  GtkTextLine **array;
+  gpointer line;
+  BTreeView *view;
+  guint n_lines, i;
+
+  g_return_if_fail (tree->invalidate_freeze_count > 0);
+
+  tree->invalidate_freeze_count--;
+
+  if (tree->invalidate_freeze_count > 0 || tree->invalidated_lines == NULL)
+    return;
+
+  lines = tree->invalidated_lines;
+  tree->invalidated_lines = NULL;
+
+  n_lines = g_hash_table_size (lines);
+  array = g_new (GtkTextLine *, n_lines);
+
+  i = 0;
+  g_hash_table_iter_init (&hash_iter, lines);
+  while (g_hash_table_iter_next (&hash_iter, &line, NULL))
+    array[i++] = line;
+
+  g_hash_table_destroy (lines);
+
+  for (view = tree->views; view != NULL; view = view->next)
+    gtk_text_layout_invalidate_lines (view->layout, array, n_lines);
+
+  g_free (array);
+}
+
 void
 _gtk_text_btree_get_view_size (GtkTextBTree *tree,
                               gpointer view_id,
@@ -1773,6 +1885,7 @@ _gtk_text_btree_tag (const GtkTextIter *start_orig,
   GtkTextBTree *tree;
   IterStack *stack;
   GtkTextTagInfo *info;
+  BTreeView *view;
 
   g_return_if_fail (start_orig != NULL);
   g_return_if_fail (end_orig != NULL);
@@ -1801,6 +1914,10 @@ _gtk_text_btree_tag (const GtkTextIter *start_orig,
 
   queue_tag_redisplay (tree, tag, &start, &end);
 
+  /* The views remember which tags apply where */
+  for (view = tree->views; view != NULL; view = view->next)
+    _gtk_text_layout_tags_changed (view->layout, &start, &end);
+
   info = gtk_text_btree_get_tag_info (tree, tag);
 
   start_line = _gtk_text_iter_get_text_line (&start);
@@ -1952,7 +2069,7 @@ _gtk_text_btree_tag (const GtkTextIter *start_orig,
           seg->body.toggle.inNodeCounts = FALSE;
         }
 
-      g_free (seg);
+      _gtk_toggle_segment_free (seg);
 
       /* We only clean up lines when we're done with them, saves some
          gratuitous line-segment-traversals */
@@ -3812,6 +3929,166 @@ _gtk_text_line_char_index (GtkTextLine *target_line)
   return num_chars;
 }
 
+/*
+ * Long lines
+ *
+ * Converting between char and byte offsets means walking the UTF-8
+ * text of a segment, and cleanup_line() merges the text of a line into
+ * as few segments as possible, so for very long lines this is as slow
+ * as the line is long. Lines with long segments therefore get an index
+ * of the byte offset of every LINE_INDEX_CHUNK-th char, so that no more
+ * than LINE_INDEX_CHUNK chars need to be walked. Marks and toggles
+ * don't move any text, so the index only needs to be dropped when text
+ * is inserted into or deleted from the line.
+ */
+
+#define LINE_INDEX_CHUNK     1024
+#define LINE_INDEX_MIN_CHARS (4 * LINE_INDEX_CHUNK)
+
+typedef struct _GtkTextLineIndex GtkTextLineIndex;
+
+struct _GtkTextLineIndex
+{
+  gint n_chunks;
+  gint bytes[1];  /* byte offset of char i * LINE_INDEX_CHUNK */
+};
+
+static void
+gtk_text_line_forget_index (GtkTextLine *line)
+{
+  g_free (line->index);
+  line->index = NULL;
+}
+
+static GtkTextLineIndex *
+gtk_text_line_get_index (GtkTextLine *line)
+{
+  GtkTextLineIndex *index;
+  GtkTextLineSegment *seg;
+  gint n_chunks, k;
+  gint chars, bytes;
+
+  if (line->index)
+    return line->index;
+
+  n_chunks = _gtk_text_line_char_count (line) / LINE_INDEX_CHUNK + 1;
+
+  index = g_malloc (G_STRUCT_OFFSET (GtkTextLineIndex, bytes) +
+                    n_chunks * sizeof (gint));
+  index->n_chunks = n_chunks;
+
+  k = 0;
+  chars = 0;
+  bytes = 0;
+  for (seg = line->segments; seg != NULL; seg = seg->next)
+    {
+      const gchar *p = seg->body.chars;
+      gint seg_chars = 0;
+
+      while (k < n_chunks &&
+             k * LINE_INDEX_CHUNK < chars + seg->char_count)
+        {
+          /* Only char segments hold more than one char */
+          if (seg->type == &gtk_text_char_type)
+            {
+              p = g_utf8_offset_to_pointer (p, k * LINE_INDEX_CHUNK - chars - seg_chars);
+              seg_chars = k * LINE_INDEX_CHUNK - chars;
+              index->bytes[k] = bytes + (p - seg->body.chars);
+            }
+          else
+            index->bytes[k] = bytes;
+
+          k++;
+        }
+
+      chars += seg->char_count;
+      bytes += seg->byte_count;
+    }
+
+  /* A chunk may start right at the end of the line */
+  while (k < n_chunks)
+    index->bytes[k++] = bytes;
+
+  line->index = index;
+
+  return index;
+}
+
+/* Returns the byte offset of char @char_offset in the char segment
+ * @seg, which starts at @seg_char_start and @seg_byte_start in @line.
+ */
+static gint
+char_segment_char_to_byte (GtkTextLine        *line,
+                           GtkTextLineSegment *seg,
+                           gint                seg_char_start,
+                           gint                seg_byte_start,
+                           gint                char_offset)
+{
+  const gchar *start = seg->body.chars;
+  const gchar *p;
+
+  if (seg->char_count >= LINE_INDEX_MIN_CHARS)
+    {
+      GtkTextLineIndex *index = gtk_text_line_get_index (line);
+      gint k = (seg_char_start + char_offset) / LINE_INDEX_CHUNK;
+
+      if (k * LINE_INDEX_CHUNK > seg_char_start)
+        {
+          start = seg->body.chars + index->bytes[k] - seg_byte_start;
+          char_offset -= k * LINE_INDEX_CHUNK - seg_char_start;
+        }
+    }
+  else if (seg->char_count - char_offset < seg->char_count / 4)
+    {
+      /* if in the last fourth of the segment walk backwards */
+      p = g_utf8_offset_to_pointer (seg->body.chars + seg->byte_count,
+                                    char_offset - seg->char_count);
+
+      return p - seg->body.chars;
+    }
+
+  p = g_utf8_offset_to_pointer (start, char_offset);
+
+  return p - seg->body.chars;
+}
+
+/* Returns the number of chars in the first @byte_offset bytes of
+ * the char segment @seg, which starts at @seg_char_start and
+ * @seg_byte_start in @line.
+ */
+static gint
+char_segment_byte_to_char (GtkTextLine        *line,
+                           GtkTextLineSegment *seg,
+                           gint                seg_char_start,
+                           gint                seg_byte_start,
+                           gint                byte_offset)
+{
+  if (seg->char_count >= LINE_INDEX_MIN_CHARS)
+    {
+      GtkTextLineIndex *index = gtk_text_line_get_index (line);
+      gint target = seg_byte_start + byte_offset;
+      gint lo = 0, hi = index->n_chunks - 1;
+
+      /* Find the last chunk starting at or before the target */
+      while (lo < hi)
+        {
+          gint mid = (lo + hi + 1) / 2;
+
+          if (index->bytes[mid] <= target)
+            lo = mid;
+          else
+            hi = mid - 1;
+        }
+
+      if (lo * LINE_INDEX_CHUNK > seg_char_start)
+        return lo * LINE_INDEX_CHUNK - seg_char_start +
+          g_utf8_strlen (seg->body.chars + index->bytes[lo] - seg_byte_start,
+                         target - index->bytes[lo]);
+    }
+
+  return g_utf8_strlen (seg->body.chars, byte_offset);
+}
+
 GtkTextLineSegment*
 _gtk_text_line_byte_to_segment (GtkTextLine *line,
                                gint byte_offset,
@@ -3921,18 +4198,21 @@ _gtk_text_line_byte_to_char (GtkTextLine *line,
                             gint byte_offset)
 {
   gint char_offset;
+  gint seg_byte_start;
   GtkTextLineSegment *seg;
 
   g_return_val_if_fail (line != NULL, 0);
   g_return_val_if_fail (byte_offset >= 0, 0);
 
   char_offset = 0;
+  seg_byte_start = 0;
   seg = line->segments;
   while (byte_offset >= seg->byte_count) /* while (we need to go farther than
                                             the next segment) */
     {
       byte_offset -= seg->byte_count;
       char_offset += seg->char_count;
+      seg_byte_start += seg->byte_count;
       seg = seg->next;
       g_assert (seg != NULL); /* our byte_index was bogus if this happens */
     }
@@ -3947,7 +4227,10 @@ _gtk_text_line_byte_to_char (GtkTextLine *line,
   else
     {
       if (seg->type == &gtk_text_char_type)
-        return char_offset + g_utf8_strlen (seg->body.chars, byte_offset);
+        return char_offset + char_segment_byte_to_char (line, seg,
+                                                        char_offset,
+                                                        seg_byte_start,
+                                                        byte_offset);
       else
         {
           g_assert (seg->char_count == 1);
@@ -4154,7 +4437,10 @@ _gtk_text_line_byte_to_char_offsets (GtkTextLine *line,
 
   if (seg->type == &gtk_text_char_type)
     {
-      *seg_char_offset = g_utf8_strlen (seg->body.chars, offset);
+      *seg_char_offset = char_segment_byte_to_char (line, seg,
+                                                    *line_char_offset,
+                                                    byte_offset - offset,
+                                                    offset);
 
       g_assert (*seg_char_offset < seg->char_count);
 
@@ -4199,16 +4485,10 @@ _gtk_text_line_char_to_byte_offsets (GtkTextLine *line,
 
   if (seg->type == &gtk_text_char_type)
     {
-      const char *p;
-
-      /* if in the last fourth of the segment walk backwards */
-      if (seg->char_count - offset < seg->char_count / 4)
-        p = g_utf8_offset_to_pointer (seg->body.chars + seg->byte_count, 
-                                      offset - seg->char_count);
-      else
-        p = g_utf8_offset_to_pointer (seg->body.chars, offset);
-
-      *seg_byte_offset = p - seg->body.chars;
+      *seg_byte_offset = char_segment_char_to_byte (line, seg,
+                                                    char_offset - offset,
+                                                    *line_byte_offset,
+                                                    offset);
 
       g_assert (*seg_byte_offset < seg->byte_count);
 
@@ -4715,12 +4995,23 @@ get_last_line (GtkTextBTree *tree)
  * Lines
  */
 
+/* Lines come from the slice allocator, like segments; see
+ * _gtk_text_segment_alloc().
+ */
+#ifdef G_ENABLE_DEBUG
+static gsize n_text_lines = 0;
+#endif
+
 static GtkTextLine*
 gtk_text_line_new (void)
 {
   GtkTextLine *line;
 
-  line = g_new0(GtkTextLine, 1);
+#ifdef G_ENABLE_DEBUG
+  n_text_lines++;
+#endif
+
+  line = g_slice_new0 (GtkTextLine);
   line->dir_strong = PANGO_DIRECTION_NEUTRAL;
   line->dir_propagated_forward = PANGO_DIRECTION_NEUTRAL;
   line->dir_propagated_back = PANGO_DIRECTION_NEUTRAL;
@@ -4751,7 +5042,38 @@ gtk_text_line_destroy (GtkTextBTree *tree, GtkTextLine *line)
       ld = next;
     }
 
-  g_free (line);
+  gtk_text_line_forget_index (line);
+
+  if (tree->invalidated_lines)
+    g_hash_table_remove (tree->invalidated_lines, line);
+
+#ifdef G_ENABLE_DEBUG
+  n_text_lines--;
+#endif
+
+  g_slice_free (GtkTextLine, line);
+}
+
+/* The counts are only kept with G_ENABLE_DEBUG, and are zero otherwise */
+void
+_gtk_text_btree_get_memory_stats (gsize *n_segments,
+                                  gsize *segment_bytes,
+                                  gsize *n_lines,
+                                  gsize *line_bytes)
+{
+  _gtk_text_segment_get_memory_stats (n_segments, segment_bytes);
+
+#ifdef G_ENABLE_DEBUG
+  if (n_lines)
+    *n_lines = n_text_lines;
+  if (line_bytes)
+    *line_bytes = n_text_lines * sizeof (GtkTextLine);
+#else
+  if (n_lines)
+    *n_lines = 0;
+  if (line_bytes)
+    *line_bytes = 0;
+#endif
 }
 
 static void
@@ -5036,6 +5358,60 @@ _gtk_text_btree_is_valid (GtkTextBTree *tree,
   return (nd && nd->valid);
 }
 
+/**
+ * _gtk_text_btree_find_first_invalid_line:
+ * @tree: a #GtkTextBTree
+ * @view_id: view id
+ *
+ * Finds the first line that is not valid for the given view, without
+ * validating anything.
+ *
+ * Return value: the first invalid line, or %NULL if the tree is valid
+ **/
+GtkTextLine*
+_gtk_text_btree_find_first_invalid_line (GtkTextBTree *tree,
+                                         gpointer      view_id)
+{
+  GtkTextBTreeNode *node;
+  GtkTextLine *line;
+  NodeData *nd;
+
+  g_return_val_if_fail (tree != NULL, NULL);
+
+  node = tree->root_node;
+  nd = node_data_find (node->node_data, view_id);
+  if (nd && nd->valid)
+    return NULL;
+
+  while (node->level > 0)
+    {
+      GtkTextBTreeNode *child = node->children.node;
+
+      while (child != NULL)
+        {
+          nd = node_data_find (child->node_data, view_id);
+          if (!nd || !nd->valid)
+            break;
+          child = child->next;
+        }
+
+      if (child == NULL)
+        return NULL;
+
+      node = child;
+    }
+
+  for (line = node->children.line; line != NULL; line = line->next)
+    {
+      GtkTextLineData *ld = _gtk_text_line_get_data (line, view_id);
+
+      if (!ld || !ld->valid)
+        return line;
+    }
+
+  return NULL;
+}
+
 typedef struct _ValidateState ValidateState;
 
 struct _ValidateState
@@ -5701,6 +6077,145 @@ _gtk_text_btree_notify_will_remove_tag (GtkTextBTree    *tree,
 }
 
 
+/* Number of children per node when building a tree from scratch;
+ * half way between the limits, so that later edits don't need to
+ * rebalance right away.
+ */
+#define BUILD_CHILDREN ((MIN_CHILDREN + MAX_CHILDREN) / 2)
+
+/* Makes parent nodes at @level for the @n_children children starting
+ * at @first, spreading them evenly.  Returns the first new node.
+ */
+static GtkTextBTreeNode *
+gtk_text_btree_build_level (gint      level,
+                            gpointer  first,
+                            gint      n_children,
+                            gint     *n_nodes)
+{
+  GtkTextBTreeNode *first_node = NULL;
+  GtkTextBTreeNode *prev_node = NULL;
+  GtkTextLine *line = NULL;
+  GtkTextBTreeNode *child = NULL;
+  gint nodes, i, j;
+
+  nodes = MAX (1, (n_children + BUILD_CHILDREN - 1) / BUILD_CHILDREN);
+
+  if (level == 0)
+    line = first;
+  else
+    child = first;
+
+  for (i = 0; i < nodes; i++)
+    {
+      GtkTextBTreeNode *node;
+      gint count;
+
+      /* the first n_children % nodes nodes get one child more */
+      count = n_children / nodes + (i < n_children % nodes ? 1 : 0);
+
+      node = gtk_text_btree_node_new ();
+      node->parent = NULL;
+      node->next = NULL;
+      node->summary = NULL;
+      node->level = level;
+      node->num_children = count;
+      node->num_lines = 0;
+      node->num_chars = 0;
+
+      if (level == 0)
+        {
+          GtkTextLine *last = NULL;
+
+          node->children.line = line;
+          for (j = 0; j < count; j++)
+            {
+              line->parent = node;
+              last = line;
+              line = line->next;
+            }
+          last->next = NULL;
+        }
+      else
+        {
+          GtkTextBTreeNode *last = NULL;
+
+          node->children.node = child;
+          for (j = 0; j < count; j++)
+            {
+              child->parent = node;
+              last = child;
+              child = child->next;
+            }
+          last->next = NULL;
+        }
+
+      if (prev_node)
+        prev_node->next = node;
+      else
+        first_node = node;
+      prev_node = node;
+    }
+
+  *n_nodes = nodes;
+
+  return first_node;
+}
+
+static void
+recompute_subtree_counts (GtkTextBTree     *tree,
+                          GtkTextBTreeNode *node)
+{
+  if (node->level > 0)
+    {
+      GtkTextBTreeNode *child;
+
+      for (child = node->children.node; child != NULL; child = child->next)
+        recompute_subtree_counts (tree, child);
+    }
+
+  recompute_node_counts (tree, node);
+}
+
+/* Replaces a root node that is a leaf, but has far too many lines,
+ * with a balanced tree over the same lines.  This is linear in the
+ * number of lines, unlike splitting the leaf with
+ * gtk_text_btree_rebalance().
+ */
+static void
+gtk_text_btree_build_from_root_leaf (GtkTextBTree *tree)
+{
+  GtkTextBTreeNode *old_root = tree->root_node;
+  GtkTextBTreeNode *nodes;
+  gint n_nodes;
+  gint level = 0;
+
+  g_assert (old_root->level == 0);
+
+  nodes = gtk_text_btree_build_level (0, old_root->children.line,
+                                      old_root->num_children, &n_nodes);
+
+  /* Each level is built over the whole list of nodes of the level
+   * below, so they must stay chained until their parents exist.
+   * gtk_text_btree_build_level() then cuts the chain between groups.
+   */
+  while (n_nodes > 1)
+    {
+      level++;
+      nodes = gtk_text_btree_build_level (level, nodes, n_nodes, &n_nodes);
+    }
+
+  tree->root_node = nodes;
+
+  /* Fill in the counts bottom-up, now that every node has its parent.
+   * This also moves tag roots from the old root to where the toggles
+   * are, and computes the per-view validity of the new nodes.
+   */
+  recompute_subtree_counts (tree, tree->root_node);
+
+  old_root->children.line = NULL;
+  gtk_text_btree_node_free_empty (tree, old_root);
+}
+
 /* Rebalance the out-of-whack node "node" */
 static void
 gtk_text_btree_rebalance (GtkTextBTree *tree,
@@ -7095,6 +7610,16 @@ _gtk_text_btree_spew (GtkTextBTree *tree)
   printf ("%d lines in tree %p\n",
           _gtk_text_btree_line_count (tree), tree);
 
+  {
+    gsize n_segments, segment_bytes, n_lines, line_bytes;
+
+    _gtk_text_btree_get_memory_stats (&n_segments, &segment_bytes,
+                                      &n_lines, &line_bytes);
+    printf ("%" G_GSIZE_FORMAT " segments (%" G_GSIZE_FORMAT " bytes), "
+            "%" G_GSIZE_FORMAT " lines (%" G_GSIZE_FORMAT " bytes) in all trees\n",
+            n_segments, segment_bytes, n_lines, line_bytes);
+  }
+
   line = _gtk_text_btree_get_line (tree, 0, &real_line);
 
   while (line != NULL)
@@ -94,12 +94,16 @@ void         _gtk_text_btree_invalidate_region (GtkTextBTree      *tree,
                                                 const GtkTextIter *start,
                                                 const GtkTextIter *end,
                                                 gboolean           cursors_only);
+void         _gtk_text_btree_freeze_invalidation (GtkTextBTree    *tree);
+void         _gtk_text_btree_thaw_invalidation   (GtkTextBTree    *tree);
 void         _gtk_text_btree_get_view_size     (GtkTextBTree      *tree,
                                                 gpointer           view_id,
                                                 gint              *width,
                                                 gint              *height);
 gboolean     _gtk_text_btree_is_valid          (GtkTextBTree      *tree,
                                                 gpointer           view_id);
+GtkTextLine *_gtk_text_btree_find_first_invalid_line (GtkTextBTree *tree,
+                                                    gpointer      view_id);
 gboolean     _gtk_text_btree_validate          (GtkTextBTree      *tree,
                                                 gpointer           view_id,
                                                 gint               max_pixels,
@@ -242,6 +246,8 @@ struct _GtkTextLine {
   GtkTextLineSegment *segments; /* First in ordered list of segments
                                  * that make up the line. */
   GtkTextLineData *views;      /* data stored here by views */
+  struct _GtkTextLineIndex *index; /* offsets into long lines, built
+                                    * on demand; may be NULL */
   guchar dir_strong;                /* BiDi algo dir of line */
   guchar dir_propagated_back;       /* BiDi algo dir of next line */
   guchar dir_propagated_forward;    /* BiDi algo dir of prev line */
@@ -324,6 +330,10 @@ GtkTextLineData    *_gtk_text_line_data_new                   (GtkTextLayout
 /* Debug */
 void _gtk_text_btree_check (GtkTextBTree *tree);
 void _gtk_text_btree_spew (GtkTextBTree *tree);
+void _gtk_text_btree_get_memory_stats (gsize *n_segments,
+                                       gsize *segment_bytes,
+                                       gsize *n_lines,
+                                       gsize *line_bytes);
 extern gboolean _gtk_text_view_debug_btree;
 
 /* ignore, exported only for gtktextsegment.c */
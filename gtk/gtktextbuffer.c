@@ -56,6 +56,12 @@ struct _GtkTextBufferPrivate
   GtkTargetList  *paste_target_list;
   GtkTargetEntry *paste_target_entries;
   gint            n_paste_target_entries;
+
+  /* See gtk_text_buffer_freeze_changes() */
+  guint           freeze_count;
+  guint           changed_pending : 1;
+  GSList         *pending_marks;
+  GHashTable     *pending_marks_set;
 };
 
 
@@ -128,6 +134,7 @@ static void gtk_text_buffer_real_changed               (GtkTextBuffer     *buffe
 static void gtk_text_buffer_real_mark_set              (GtkTextBuffer     *buffer,
                                                         const GtkTextIter *iter,
                                                         GtkTextMark       *mark);
+static void gtk_text_buffer_emit_changed               (GtkTextBuffer     *buffer);
 
 static GtkTextBTree* get_btree (GtkTextBuffer *buffer);
 static void          free_log_attr_cache (GtkTextLogAttrCache *cache);
@@ -755,8 +762,10 @@ static void
 gtk_text_buffer_finalize (GObject *object)
 {
   GtkTextBuffer *buffer;
+  GtkTextBufferPrivate *priv;
 
   buffer = GTK_TEXT_BUFFER (object);
+  priv = GTK_TEXT_BUFFER_GET_PRIVATE (buffer);
 
   remove_all_selection_clipboards (buffer);
 
@@ -780,6 +789,11 @@ gtk_text_buffer_finalize (GObject *object)
 
   gtk_text_buffer_free_target_lists (buffer);
 
+  g_slist_foreach (priv->pending_marks, (GFunc) g_object_unref, NULL);
+  g_slist_free (priv->pending_marks);
+  if (priv->pending_marks_set)
+    g_hash_table_destroy (priv->pending_marks_set);
+
   G_OBJECT_CLASS (gtk_text_buffer_parent_class)->finalize (object);
 }
 
@@ -823,6 +837,10 @@ gtk_text_buffer_get_tag_table (GtkTextBuffer *buffer)
  *
  * Deletes current contents of @buffer, and inserts @text instead. If
  * @len is -1, @text must be nul-terminated. @text must be valid UTF-8.
+ *
+ * Text set on an empty buffer is laid out in the buffer's internal
+ * tree in a single pass, so this is the fastest way to load a large
+ * file, for example straight from the contents of a #GMappedFile.
  **/
 void
 gtk_text_buffer_set_text (GtkTextBuffer *buffer,
@@ -867,7 +885,7 @@ gtk_text_buffer_real_insert_text (GtkTextBuffer *buffer,
   
   _gtk_text_btree_insert (iter, text, len);
 
-  g_signal_emit (buffer, signals[CHANGED], 0);
+  gtk_text_buffer_emit_changed (buffer);
   g_object_notify (G_OBJECT (buffer), "cursor-position");
 }
 
@@ -1592,7 +1610,7 @@ gtk_text_buffer_real_delete_range (GtkTextBuffer *buffer,
       g_object_notify (G_OBJECT (buffer), "has-selection");
     }
 
-  g_signal_emit (buffer, signals[CHANGED], 0);
+  gtk_text_buffer_emit_changed (buffer);
   g_object_notify (G_OBJECT (buffer), "cursor-position");
 }
 
@@ -1872,7 +1890,7 @@ gtk_text_buffer_real_insert_pixbuf (GtkTextBuffer *buffer,
 { 
   _gtk_text_btree_insert_pixbuf (iter, pixbuf);
 
-  g_signal_emit (buffer, signals[CHANGED], 0);
+  gtk_text_buffer_emit_changed (buffer);
 }
 
 /**
@@ -1916,7 +1934,7 @@ gtk_text_buffer_real_insert_anchor (GtkTextBuffer      *buffer,
 {
   _gtk_text_btree_insert_child_anchor (iter, anchor);
 
-  g_signal_emit (buffer, signals[CHANGED], 0);
+  gtk_text_buffer_emit_changed (buffer);
 }
 
 /**
@@ -2003,6 +2021,26 @@ gtk_text_buffer_mark_set (GtkTextBuffer     *buffer,
    * default behavior.
    */
 
+  GtkTextBufferPrivate *priv = GTK_TEXT_BUFFER_GET_PRIVATE (buffer);
+
+  /* While frozen, only remember the mark; it is announced at its
+   * final location by gtk_text_buffer_thaw_changes()
+   */
+  if (priv->freeze_count > 0)
+    {
+      if (priv->pending_marks_set == NULL)
+        priv->pending_marks_set = g_hash_table_new (NULL, NULL);
+
+      if (!g_hash_table_lookup (priv->pending_marks_set, mark))
+        {
+          g_hash_table_insert (priv->pending_marks_set, mark, mark);
+          priv->pending_marks = g_slist_prepend (priv->pending_marks,
+                                                 g_object_ref (mark));
+        }
+
+      return;
+    }
+
   g_object_ref (mark);
 
   g_signal_emit (buffer,
@@ -4102,6 +4140,124 @@ gtk_text_buffer_end_user_action (GtkTextBuffer *buffer)
     }
 }
 
+static void
+gtk_text_buffer_emit_changed (GtkTextBuffer *buffer)
+{
+  GtkTextBufferPrivate *priv = GTK_TEXT_BUFFER_GET_PRIVATE (buffer);
+
+  if (priv->freeze_count > 0)
+    priv->changed_pending = TRUE;
+  else
+    g_signal_emit (buffer, signals[CHANGED], 0);
+}
+
+/**
+ * gtk_text_buffer_freeze_changes:
+ * @buffer: a #GtkTextBuffer
+ *
+ * Starts a batch of changes to @buffer, for example the edits of a
+ * "replace all" command. Until the matching call to
+ * gtk_text_buffer_thaw_changes(), the #GtkTextBuffer::changed and
+ * #GtkTextBuffer::mark-set signals and property notifications are
+ * held back, and the views of @buffer are not told to update their
+ * layout. All of that happens once, when the buffer is thawed; this
+ * includes the default handler of ::changed, so the buffer only
+ * becomes modified at that point.
+ *
+ * Signals that describe the edits themselves, like
+ * #GtkTextBuffer::insert-text and #GtkTextBuffer::delete-range, are
+ * still emitted for every change. To make the batch a single step for
+ * undo, also wrap it in gtk_text_buffer_begin_user_action() and
+ * gtk_text_buffer_end_user_action().
+ *
+ * Since the views are not updated, control should not return to the
+ * main loop while the buffer is frozen. Calls to this function nest.
+ *
+ * Since: 2.22
+ **/
+void
+gtk_text_buffer_freeze_changes (GtkTextBuffer *buffer)
+{
+  GtkTextBufferPrivate *priv;
+
+  g_return_if_fail (GTK_IS_TEXT_BUFFER (buffer));
+
+  priv = GTK_TEXT_BUFFER_GET_PRIVATE (buffer);
+
+  priv->freeze_count += 1;
+
+  if (priv->freeze_count == 1)
+    {
+      g_object_freeze_notify (G_OBJECT (buffer));
+      _gtk_text_btree_freeze_invalidation (get_btree (buffer));
+    }
+}
+
+/**
+ * gtk_text_buffer_thaw_changes:
+ * @buffer: a #GtkTextBuffer
+ *
+ * Ends a batch of changes started with gtk_text_buffer_freeze_changes().
+ * When the outermost batch ends, the lines it changed are invalidated
+ * in the views of @buffer, #GtkTextBuffer::mark-set is emitted once for
+ * each mark that was set, at its current location, and
+ * #GtkTextBuffer::changed is emitted once if the text changed.
+ *
+ * Since: 2.22
+ **/
+void
+gtk_text_buffer_thaw_changes (GtkTextBuffer *buffer)
+{
+  GtkTextBufferPrivate *priv;
+  GSList *marks, *list;
+
+  g_return_if_fail (GTK_IS_TEXT_BUFFER (buffer));
+
+  priv = GTK_TEXT_BUFFER_GET_PRIVATE (buffer);
+
+  g_return_if_fail (priv->freeze_count > 0);
+
+  priv->freeze_count -= 1;
+
+  if (priv->freeze_count > 0)
+    return;
+
+  _gtk_text_btree_thaw_invalidation (get_btree (buffer));
+
+  marks = g_slist_reverse (priv->pending_marks);
+  priv->pending_marks = NULL;
+
+  if (priv->pending_marks_set)
+    {
+      g_hash_table_destroy (priv->pending_marks_set);
+      priv->pending_marks_set = NULL;
+    }
+
+  for (list = marks; list; list = list->next)
+    {
+      GtkTextMark *mark = list->data;
+      GtkTextIter location;
+
+      if (!gtk_text_mark_get_deleted (mark))
+        {
+          gtk_text_buffer_get_iter_at_mark (buffer, &location, mark);
+          gtk_text_buffer_mark_set (buffer, &location, mark);
+        }
+
+      g_object_unref (mark);
+    }
+
+  g_slist_free (marks);
+
+  if (priv->changed_pending)
+    {
+      priv->changed_pending = FALSE;
+      g_signal_emit (buffer, signals[CHANGED], 0);
+    }
+
+  g_object_thaw_notify (G_OBJECT (buffer));
+}
+
 static void
 gtk_text_buffer_free_target_lists (GtkTextBuffer *buffer)
 {
@@ -39,6 +39,16 @@ typedef struct
   GDestroyNotify  user_data_destroy;
 } GtkRichTextFormat;
 
+typedef struct
+{
+  GtkTextBuffer  *buffer;
+  GSList         *tags;
+  GSList         *left_start_list;
+  GSList         *right_end_list;
+  GtkTextMark    *left_end;
+  GtkTextMark    *right_start;
+} SplitTags;
+
 
 static GList   * register_format   (GList             *formats,
                                     const gchar       *mime_type,
@@ -50,11 +60,18 @@ static GList   * unregister_format (GList             *formats,
                                     GdkAtom            atom);
 static GdkAtom * get_formats       (GList             *formats,
                                     gint              *n_formats);
+static GtkRichTextFormat *
+                 lookup_format     (GList             *formats,
+                                    GdkAtom            format);
 static void      free_format       (GtkRichTextFormat *format);
 static void      free_format_list  (GList             *formats);
 static GQuark    serialize_quark   (void);
 static GQuark    deserialize_quark (void);
 
+static SplitTags * split_tags_at_iter (GtkTextBuffer     *content_buffer,
+                                       GtkTextIter       *iter);
+static void        rejoin_split_tags  (SplitTags         *split);
+
 
 /**
  * gtk_text_buffer_register_serialize_format:
@@ -567,78 +584,9 @@ gtk_text_buffer_deserialize (GtkTextBuffer  *register_buffer,
         {
           GtkTextBufferDeserializeFunc function = fmt->function;
           gboolean                     success;
-          GSList                      *split_tags;
-          GSList                      *list;
-          GtkTextMark                 *left_end        = NULL;
-          GtkTextMark                 *right_start     = NULL;
-          GSList                      *left_start_list = NULL;
-          GSList                      *right_end_list  = NULL;
-
-          /*  We don't want the tags that are effective at the insertion
-           *  point to affect the pasted text, therefore we remove and
-           *  remember them, so they can be re-applied left and right of
-           *  the inserted text after pasting
-           */
-          split_tags = gtk_text_iter_get_tags (iter);
-
-          list = split_tags;
-          while (list)
-            {
-              GtkTextTag *tag = list->data;
+          SplitTags                   *split;
 
-              list = g_slist_next (list);
-
-              /*  If a tag begins at the insertion point, ignore it
-               *  because it doesn't affect the pasted text
-               */
-              if (gtk_text_iter_begins_tag (iter, tag))
-                split_tags = g_slist_remove (split_tags, tag);
-            }
-
-          if (split_tags)
-            {
-              /*  Need to remember text marks, because text iters
-               *  don't survive pasting
-               */
-              left_end = gtk_text_buffer_create_mark (content_buffer,
-                                                      NULL, iter, TRUE);
-              right_start = gtk_text_buffer_create_mark (content_buffer,
-                                                         NULL, iter, FALSE);
-
-              for (list = split_tags; list; list = g_slist_next (list))
-                {
-                  GtkTextTag  *tag             = list->data;
-                  GtkTextIter *backward_toggle = gtk_text_iter_copy (iter);
-                  GtkTextIter *forward_toggle  = gtk_text_iter_copy (iter);
-                  GtkTextMark *left_start      = NULL;
-                  GtkTextMark *right_end       = NULL;
-
-                  gtk_text_iter_backward_to_tag_toggle (backward_toggle, tag);
-                  left_start = gtk_text_buffer_create_mark (content_buffer,
-                                                            NULL,
-                                                            backward_toggle,
-                                                            FALSE);
-
-                  gtk_text_iter_forward_to_tag_toggle (forward_toggle, tag);
-                  right_end = gtk_text_buffer_create_mark (content_buffer,
-                                                           NULL,
-                                                           forward_toggle,
-                                                           TRUE);
-
-                  left_start_list = g_slist_prepend (left_start_list, left_start);
-                  right_end_list = g_slist_prepend (right_end_list, right_end);
-
-                  gtk_text_buffer_remove_tag (content_buffer, tag,
-                                              backward_toggle,
-                                              forward_toggle);
-
-                  gtk_text_iter_free (forward_toggle);
-                  gtk_text_iter_free (backward_toggle);
-                }
-
-              left_start_list = g_slist_reverse (left_start_list);
-              right_end_list = g_slist_reverse (right_end_list);
-            }
+          split = split_tags_at_iter (content_buffer, iter);
 
           success = function (register_buffer, content_buffer,
                               iter, data, length,
@@ -651,56 +599,7 @@ gtk_text_buffer_deserialize (GtkTextBuffer  *register_buffer,
                          _("Unknown error when trying to deserialize %s"),
                          gdk_atom_name (format));
 
-          if (split_tags)
-            {
-              GSList      *left_list;
-              GSList      *right_list;
-              GtkTextIter  left_e;
-              GtkTextIter  right_s;
-
-              /*  Turn the remembered marks back into iters so they
-               *  can by used to re-apply the remembered tags
-               */
-              gtk_text_buffer_get_iter_at_mark (content_buffer,
-                                                &left_e, left_end);
-              gtk_text_buffer_get_iter_at_mark (content_buffer,
-                                                &right_s, right_start);
-
-              for (list = split_tags,
-                     left_list = left_start_list,
-                     right_list = right_end_list;
-                   list && left_list && right_list;
-                   list = g_slist_next (list),
-                     left_list = g_slist_next (left_list),
-                     right_list = g_slist_next (right_list))
-                {
-                  GtkTextTag  *tag        = list->data;
-                  GtkTextMark *left_start = left_list->data;
-                  GtkTextMark *right_end  = right_list->data;
-                  GtkTextIter  left_s;
-                  GtkTextIter  right_e;
-
-                  gtk_text_buffer_get_iter_at_mark (content_buffer,
-                                                    &left_s, left_start);
-                  gtk_text_buffer_get_iter_at_mark (content_buffer,
-                                                    &right_e, right_end);
-
-                  gtk_text_buffer_apply_tag (content_buffer, tag,
-                                             &left_s, &left_e);
-                  gtk_text_buffer_apply_tag (content_buffer, tag,
-                                             &right_s, &right_e);
-
-                  gtk_text_buffer_delete_mark (content_buffer, left_start);
-                  gtk_text_buffer_delete_mark (content_buffer, right_end);
-                }
-
-              gtk_text_buffer_delete_mark (content_buffer, left_end);
-              gtk_text_buffer_delete_mark (content_buffer, right_start);
-
-              g_slist_free (split_tags);
-              g_slist_free (left_start_list);
-              g_slist_free (right_end_list);
-            }
+          rejoin_split_tags (split);
 
           return success;
         }
@@ -713,6 +612,733 @@ gtk_text_buffer_deserialize (GtkTextBuffer  *register_buffer,
   return FALSE;
 }
 
+/**
+ * gtk_text_buffer_serialize_to_stream:
+ * @register_buffer: the #GtkTextBuffer @format is registered with
+ * @content_buffer: the #GtkTextBuffer to serialize
+ * @format: the rich text format to use for serializing
+ * @start: start of block of text to serialize
+ * @end: end of block of test to serialize
+ * @stream: the #GOutputStream to write the serialized data to
+ * @cancellable: optional #GCancellable object, %NULL to ignore
+ * @error: return location for a #GError
+ *
+ * Like gtk_text_buffer_serialize(), but writes the serialized data
+ * to @stream instead of returning it.
+ *
+ * For formats registered with gtk_text_buffer_register_serialize_tagset()
+ * the data is produced and written in pieces, so the serialized form
+ * of the text is never held in memory as a whole. Other formats are
+ * serialized by their function first and then written.
+ *
+ * Return value: %TRUE on success, %FALSE if an error occurred
+ *
+ * Since: 2.22
+ **/
+gboolean
+gtk_text_buffer_serialize_to_stream (GtkTextBuffer     *register_buffer,
+                                     GtkTextBuffer     *content_buffer,
+                                     GdkAtom            format,
+                                     const GtkTextIter *start,
+                                     const GtkTextIter *end,
+                                     GOutputStream     *stream,
+                                     GCancellable      *cancellable,
+                                     GError           **error)
+{
+  GtkRichTextFormat *fmt;
+  gboolean           success;
+
+  g_return_val_if_fail (GTK_IS_TEXT_BUFFER (register_buffer), FALSE);
+  g_return_val_if_fail (GTK_IS_TEXT_BUFFER (content_buffer), FALSE);
+  g_return_val_if_fail (format != GDK_NONE, FALSE);
+  g_return_val_if_fail (start != NULL, FALSE);
+  g_return_val_if_fail (end != NULL, FALSE);
+  g_return_val_if_fail (G_IS_OUTPUT_STREAM (stream), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  fmt = lookup_format (g_object_get_qdata (G_OBJECT (register_buffer),
+                                           serialize_quark ()),
+                       format);
+
+  if (!fmt)
+    {
+      g_set_error (error, 0, 0,
+                   _("No serialize function found for format %s"),
+                   gdk_atom_name (format));
+      return FALSE;
+    }
+
+  if (fmt->function == _gtk_text_buffer_serialize_rich_text)
+    {
+      GtkTextBufferSerializer *serializer;
+      const guint8            *data;
+      gsize                    length;
+      gboolean                 done = FALSE;
+
+      serializer = _gtk_text_buffer_serializer_new (content_buffer, start, end);
+
+      success = TRUE;
+      while (success && !done)
+        {
+          success = _gtk_text_buffer_serializer_next (serializer,
+                                                      &data, &length,
+                                                      &done, error);
+
+          if (success && length > 0)
+            success = g_output_stream_write_all (stream, data, length,
+                                                 NULL, cancellable, error);
+          else if (success)
+            success = !g_cancellable_set_error_if_cancelled (cancellable, error);
+        }
+
+      _gtk_text_buffer_serializer_free (serializer);
+    }
+  else
+    {
+      GtkTextBufferSerializeFunc function = fmt->function;
+      guint8                    *data;
+      gsize                      length = 0;
+
+      data = function (register_buffer, content_buffer,
+                       start, end, &length, fmt->user_data);
+
+      success = g_output_stream_write_all (stream, data, length,
+                                           NULL, cancellable, error);
+
+      g_free (data);
+    }
+
+  return success;
+}
+
+typedef struct
+{
+  GSimpleAsyncResult      *simple;
+  GOutputStream           *stream;
+  GCancellable            *cancellable;
+  gint                     io_priority;
+
+  /* NULL for formats that are not serialized incrementally */
+  GtkTextBufferSerializer *serializer;
+  guint8                  *data;
+  gsize                    length;
+
+  const guint8            *chunk;
+  gsize                    chunk_length;
+  gboolean                 done;
+} SerializeStreamData;
+
+static void
+serialize_stream_complete (SerializeStreamData *data,
+                           GError              *error)
+{
+  if (error)
+    {
+      g_simple_async_result_set_from_error (data->simple, error);
+      g_error_free (error);
+    }
+  else
+    g_simple_async_result_set_op_res_gboolean (data->simple, TRUE);
+
+  g_simple_async_result_complete (data->simple);
+
+  if (data->serializer)
+    _gtk_text_buffer_serializer_free (data->serializer);
+  g_free (data->data);
+  g_object_unref (data->stream);
+  if (data->cancellable)
+    g_object_unref (data->cancellable);
+  g_object_unref (data->simple);
+  g_free (data);
+}
+
+static gboolean serialize_stream_next (gpointer user_data);
+
+static void
+serialize_stream_write_cb (GObject      *source,
+                           GAsyncResult *result,
+                           gpointer      user_data)
+{
+  SerializeStreamData *data = user_data;
+  GError              *error = NULL;
+  gssize               written;
+
+  written = g_output_stream_write_finish (G_OUTPUT_STREAM (source),
+                                          result, &error);
+
+  if (written < 0)
+    {
+      serialize_stream_complete (data, error);
+      return;
+    }
+
+  data->chunk += written;
+  data->chunk_length -= written;
+
+  if (data->chunk_length > 0)
+    g_output_stream_write_async (data->stream,
+                                 data->chunk, data->chunk_length,
+                                 data->io_priority, data->cancellable,
+                                 serialize_stream_write_cb, data);
+  else if (data->done)
+    serialize_stream_complete (data, NULL);
+  else
+    gdk_threads_add_idle (serialize_stream_next, data);
+}
+
+static gboolean
+serialize_stream_next (gpointer user_data)
+{
+  SerializeStreamData *data = user_data;
+  GError              *error = NULL;
+
+  if (g_cancellable_set_error_if_cancelled (data->cancellable, &error))
+    {
+      serialize_stream_complete (data, error);
+      return FALSE;
+    }
+
+  if (data->serializer)
+    {
+      if (!_gtk_text_buffer_serializer_next (data->serializer,
+                                             &data->chunk, &data->chunk_length,
+                                             &data->done, &error))
+        {
+          serialize_stream_complete (data, error);
+          return FALSE;
+        }
+    }
+  else
+    {
+      data->chunk = data->data;
+      data->chunk_length = data->length;
+      data->done = TRUE;
+    }
+
+  if (data->chunk_length > 0)
+    g_output_stream_write_async (data->stream,
+                                 data->chunk, data->chunk_length,
+                                 data->io_priority, data->cancellable,
+                                 serialize_stream_write_cb, data);
+  else if (data->done)
+    serialize_stream_complete (data, NULL);
+  else
+    return TRUE;
+
+  return FALSE;
+}
+
+/**
+ * gtk_text_buffer_serialize_to_stream_async:
+ * @register_buffer: the #GtkTextBuffer @format is registered with
+ * @content_buffer: the #GtkTextBuffer to serialize
+ * @format: the rich text format to use for serializing
+ * @start: start of block of text to serialize
+ * @end: end of block of test to serialize
+ * @stream: the #GOutputStream to write the serialized data to
+ * @io_priority: the I/O priority of the request
+ * @cancellable: optional #GCancellable object, %NULL to ignore
+ * @callback: a #GAsyncReadyCallback to call when the data is written
+ * @user_data: the data to pass to @callback
+ *
+ * Asynchronous version of gtk_text_buffer_serialize_to_stream().
+ * The text is serialized piece by piece from the main loop while
+ * earlier pieces are being written.
+ *
+ * @content_buffer must not be modified until @callback is called;
+ * if it is, the operation fails with %G_IO_ERROR_FAILED.
+ *
+ * Since: 2.22
+ **/
+void
+gtk_text_buffer_serialize_to_stream_async (GtkTextBuffer       *register_buffer,
+                                           GtkTextBuffer       *content_buffer,
+                                           GdkAtom              format,
+                                           const GtkTextIter   *start,
+                                           const GtkTextIter   *end,
+                                           GOutputStream       *stream,
+                                           gint                 io_priority,
+                                           GCancellable        *cancellable,
+                                           GAsyncReadyCallback  callback,
+                                           gpointer             user_data)
+{
+  GtkRichTextFormat   *fmt;
+  GSimpleAsyncResult  *simple;
+  SerializeStreamData *data;
+
+  g_return_if_fail (GTK_IS_TEXT_BUFFER (register_buffer));
+  g_return_if_fail (GTK_IS_TEXT_BUFFER (content_buffer));
+  g_return_if_fail (format != GDK_NONE);
+  g_return_if_fail (start != NULL);
+  g_return_if_fail (end != NULL);
+  g_return_if_fail (G_IS_OUTPUT_STREAM (stream));
+
+  simple = g_simple_async_result_new (G_OBJECT (register_buffer),
+                                      callback, user_data,
+                                      gtk_text_buffer_serialize_to_stream_async);
+
+  fmt = lookup_format (g_object_get_qdata (G_OBJECT (register_buffer),
+                                           serialize_quark ()),
+                       format);
+
+  if (!fmt)
+    {
+      g_simple_async_result_set_error (simple, 0, 0,
+                                       _("No serialize function found for format %s"),
+                                       gdk_atom_name (format));
+      g_simple_async_result_complete_in_idle (simple);
+      g_object_unref (simple);
+
+      return;
+    }
+
+  data = g_new0 (SerializeStreamData, 1);
+  data->simple = simple;
+  data->stream = g_object_ref (stream);
+  data->cancellable = cancellable ? g_object_ref (cancellable) : NULL;
+  data->io_priority = io_priority;
+
+  if (fmt->function == _gtk_text_buffer_serialize_rich_text)
+    data->serializer = _gtk_text_buffer_serializer_new (content_buffer,
+                                                        start, end);
+  else
+    {
+      GtkTextBufferSerializeFunc function = fmt->function;
+
+      data->data = function (register_buffer, content_buffer,
+                             start, end, &data->length, fmt->user_data);
+    }
+
+  gdk_threads_add_idle (serialize_stream_next, data);
+}
+
+/**
+ * gtk_text_buffer_serialize_to_stream_finish:
+ * @register_buffer: the #GtkTextBuffer @format is registered with
+ * @result: a #GAsyncResult
+ * @error: return location for a #GError
+ *
+ * Finishes an operation started with
+ * gtk_text_buffer_serialize_to_stream_async().
+ *
+ * Return value: %TRUE on success, %FALSE if an error occurred
+ *
+ * Since: 2.22
+ **/
+gboolean
+gtk_text_buffer_serialize_to_stream_finish (GtkTextBuffer  *register_buffer,
+                                            GAsyncResult   *result,
+                                            GError        **error)
+{
+  GSimpleAsyncResult *simple;
+
+  g_return_val_if_fail (GTK_IS_TEXT_BUFFER (register_buffer), FALSE);
+  g_return_val_if_fail (g_simple_async_result_is_valid (result,
+                                                        G_OBJECT (register_buffer),
+                                                        gtk_text_buffer_serialize_to_stream_async),
+                        FALSE);
+
+  simple = G_SIMPLE_ASYNC_RESULT (result);
+
+  if (g_simple_async_result_propagate_error (simple, error))
+    return FALSE;
+
+  return g_simple_async_result_get_op_res_gboolean (simple);
+}
+
+#define DESERIALIZE_CHUNK_SIZE 65536
+
+/**
+ * gtk_text_buffer_deserialize_from_stream:
+ * @register_buffer: the #GtkTextBuffer @format is registered with
+ * @content_buffer: the #GtkTextBuffer to deserialize into
+ * @format: the rich text format to use for deserializing
+ * @iter: insertion point for the deserialized text
+ * @stream: the #GInputStream to read the serialized data from
+ * @cancellable: optional #GCancellable object, %NULL to ignore
+ * @error: return location for a #GError
+ *
+ * Like gtk_text_buffer_deserialize(), but reads the data to
+ * deserialize from @stream.
+ *
+ * For formats registered with gtk_text_buffer_register_deserialize_tagset()
+ * the text is inserted while the stream is being read, so on error the
+ * text that was read before the error remains in @content_buffer. Other
+ * formats read the whole stream before calling their function.
+ *
+ * On success, @iter is revalidated to point to the end of the inserted
+ * text.
+ *
+ * Return value: %TRUE on success, %FALSE otherwise.
+ *
+ * Since: 2.22
+ **/
+gboolean
+gtk_text_buffer_deserialize_from_stream (GtkTextBuffer  *register_buffer,
+                                         GtkTextBuffer  *content_buffer,
+                                         GdkAtom         format,
+                                         GtkTextIter    *iter,
+                                         GInputStream   *stream,
+                                         GCancellable   *cancellable,
+                                         GError        **error)
+{
+  GtkRichTextFormat *fmt;
+  SplitTags         *split;
+  guint8            *buffer;
+  gssize             n_read;
+  gboolean           success = TRUE;
+
+  g_return_val_if_fail (GTK_IS_TEXT_BUFFER (register_buffer), FALSE);
+  g_return_val_if_fail (GTK_IS_TEXT_BUFFER (content_buffer), FALSE);
+  g_return_val_if_fail (format != GDK_NONE, FALSE);
+  g_return_val_if_fail (iter != NULL, FALSE);
+  g_return_val_if_fail (G_IS_INPUT_STREAM (stream), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  fmt = lookup_format (g_object_get_qdata (G_OBJECT (register_buffer),
+                                           deserialize_quark ()),
+                       format);
+
+  if (!fmt)
+    {
+      g_set_error (error, 0, 0,
+                   _("No deserialize function found for format %s"),
+                   gdk_atom_name (format));
+      return FALSE;
+    }
+
+  buffer = g_malloc (DESERIALIZE_CHUNK_SIZE);
+  split = split_tags_at_iter (content_buffer, iter);
+
+  if (fmt->function == _gtk_text_buffer_deserialize_rich_text)
+    {
+      GtkTextBufferDeserializer *deserializer;
+
+      deserializer = _gtk_text_buffer_deserializer_new (content_buffer, iter,
+                                                        fmt->can_create_tags);
+
+      while (success)
+        {
+          n_read = g_input_stream_read (stream, buffer, DESERIALIZE_CHUNK_SIZE,
+                                        cancellable, error);
+
+          if (n_read <= 0)
+            {
+              success = n_read == 0;
+              break;
+            }
+
+          success = _gtk_text_buffer_deserializer_feed (deserializer,
+                                                        buffer, n_read,
+                                                        error);
+        }
+
+      if (success)
+        success = _gtk_text_buffer_deserializer_finish (deserializer,
+                                                        iter, error);
+
+      _gtk_text_buffer_deserializer_free (deserializer);
+    }
+  else
+    {
+      GtkTextBufferDeserializeFunc  function = fmt->function;
+      GByteArray                   *bytes;
+
+      bytes = g_byte_array_new ();
+
+      while (TRUE)
+        {
+          n_read = g_input_stream_read (stream, buffer, DESERIALIZE_CHUNK_SIZE,
+                                        cancellable, error);
+
+          if (n_read <= 0)
+            {
+              success = n_read == 0;
+              break;
+            }
+
+          g_byte_array_append (bytes, buffer, n_read);
+        }
+
+      if (success)
+        {
+          success = function (register_buffer, content_buffer,
+                              iter, bytes->data, bytes->len,
+                              fmt->can_create_tags,
+                              fmt->user_data,
+                              error);
+
+          if (!success && error != NULL && *error == NULL)
+            g_set_error (error, 0, 0,
+                         _("Unknown error when trying to deserialize %s"),
+                         gdk_atom_name (format));
+        }
+
+      g_byte_array_free (bytes, TRUE);
+    }
+
+  rejoin_split_tags (split);
+  g_free (buffer);
+
+  return success;
+}
+
+typedef struct
+{
+  GSimpleAsyncResult        *simple;
+  GtkTextBuffer             *register_buffer;
+  GtkTextBuffer             *content_buffer;
+  GInputStream              *stream;
+  GCancellable              *cancellable;
+  gint                       io_priority;
+  SplitTags                 *split;
+
+  /*  For formats that are not deserialized incrementally, the data
+   *  is collected and handed to their function at the end
+   */
+  GtkTextBufferDeserializer *deserializer;
+  GByteArray                *bytes;
+  GtkTextMark               *mark;
+  GdkAtom                    format;
+  GtkTextBufferDeserializeFunc function;
+  gpointer                   function_data;
+  gboolean                   can_create_tags;
+
+  guint8                     buffer[DESERIALIZE_CHUNK_SIZE];
+} DeserializeStreamData;
+
+static void
+deserialize_stream_complete (DeserializeStreamData *data,
+                             GError                *error)
+{
+  if (data->deserializer)
+    _gtk_text_buffer_deserializer_free (data->deserializer);
+
+  if (data->mark)
+    gtk_text_buffer_delete_mark (data->content_buffer, data->mark);
+  if (data->bytes)
+    g_byte_array_free (data->bytes, TRUE);
+
+  rejoin_split_tags (data->split);
+
+  if (error)
+    {
+      g_simple_async_result_set_from_error (data->simple, error);
+      g_error_free (error);
+    }
+  else
+    g_simple_async_result_set_op_res_gboolean (data->simple, TRUE);
+
+  g_simple_async_result_complete (data->simple);
+
+  g_object_unref (data->content_buffer);
+  g_object_unref (data->stream);
+  if (data->cancellable)
+    g_object_unref (data->cancellable);
+  g_object_unref (data->simple);
+  g_free (data);
+}
+
+static void
+deserialize_stream_finish_data (DeserializeStreamData *data)
+{
+  GError *error = NULL;
+
+  if (data->deserializer)
+    {
+      _gtk_text_buffer_deserializer_finish (data->deserializer, NULL, &error);
+    }
+  else
+    {
+      GtkTextIter iter;
+
+      gtk_text_buffer_get_iter_at_mark (data->content_buffer, &iter, data->mark);
+
+      if (!data->function (data->register_buffer, data->content_buffer,
+                           &iter, data->bytes->data, data->bytes->len,
+                           data->can_create_tags,
+                           data->function_data,
+                           &error) &&
+          error == NULL)
+        {
+          error = g_error_new (0, 0,
+                               _("Unknown error when trying to deserialize %s"),
+                               gdk_atom_name (data->format));
+        }
+    }
+
+  deserialize_stream_complete (data, error);
+}
+
+static void
+deserialize_stream_read_cb (GObject      *source,
+                            GAsyncResult *result,
+                            gpointer      user_data)
+{
+  DeserializeStreamData *data = user_data;
+  GError                *error = NULL;
+  gssize                 n_read;
+
+  n_read = g_input_stream_read_finish (G_INPUT_STREAM (source),
+                                       result, &error);
+
+  if (n_read < 0)
+    {
+      deserialize_stream_complete (data, error);
+      return;
+    }
+
+  if (n_read == 0)
+    {
+      deserialize_stream_finish_data (data);
+      return;
+    }
+
+  if (data->deserializer)
+    {
+      if (!_gtk_text_buffer_deserializer_feed (data->deserializer,
+                                               data->buffer, n_read,
+                                               &error))
+        {
+          deserialize_stream_complete (data, error);
+          return;
+        }
+    }
+  else
+    g_byte_array_append (data->bytes, data->buffer, n_read);
+
+  g_input_stream_read_async (data->stream,
+                             data->buffer, DESERIALIZE_CHUNK_SIZE,
+                             data->io_priority, data->cancellable,
+                             deserialize_stream_read_cb, data);
+}
+
+/**
+ * gtk_text_buffer_deserialize_from_stream_async:
+ * @register_buffer: the #GtkTextBuffer @format is registered with
+ * @content_buffer: the #GtkTextBuffer to deserialize into
+ * @format: the rich text format to use for deserializing
+ * @iter: insertion point for the deserialized text
+ * @stream: the #GInputStream to read the serialized data from
+ * @io_priority: the I/O priority of the request
+ * @cancellable: optional #GCancellable object, %NULL to ignore
+ * @callback: a #GAsyncReadyCallback to call when the data is inserted
+ * @user_data: the data to pass to @callback
+ *
+ * Asynchronous version of gtk_text_buffer_deserialize_from_stream().
+ * The insertion point is tracked with a mark, so @content_buffer may
+ * be modified elsewhere while the operation is running; @iter is only
+ * used when this function is called.
+ *
+ * Since: 2.22
+ **/
+void
+gtk_text_buffer_deserialize_from_stream_async (GtkTextBuffer       *register_buffer,
+                                               GtkTextBuffer       *content_buffer,
+                                               GdkAtom              format,
+                                               GtkTextIter         *iter,
+                                               GInputStream        *stream,
+                                               gint                 io_priority,
+                                               GCancellable        *cancellable,
+                                               GAsyncReadyCallback  callback,
+                                               gpointer             user_data)
+{
+  GtkRichTextFormat     *fmt;
+  GSimpleAsyncResult    *simple;
+  DeserializeStreamData *data;
+
+  g_return_if_fail (GTK_IS_TEXT_BUFFER (register_buffer));
+  g_return_if_fail (GTK_IS_TEXT_BUFFER (content_buffer));
+  g_return_if_fail (format != GDK_NONE);
+  g_return_if_fail (iter != NULL);
+  g_return_if_fail (G_IS_INPUT_STREAM (stream));
+
+  simple = g_simple_async_result_new (G_OBJECT (register_buffer),
+                                      callback, user_data,
+                                      gtk_text_buffer_deserialize_from_stream_async);
+
+  fmt = lookup_format (g_object_get_qdata (G_OBJECT (register_buffer),
+                                           deserialize_quark ()),
+                       format);
+
+  if (!fmt)
+    {
+      g_simple_async_result_set_error (simple, 0, 0,
+                                       _("No deserialize function found for format %s"),
+                                       gdk_atom_name (format));
+      g_simple_async_result_complete_in_idle (simple);
+      g_object_unref (simple);
+
+      return;
+    }
+
+  data = g_new0 (DeserializeStreamData, 1);
+  data->simple = simple;
+  data->register_buffer = register_buffer;
+  data->content_buffer = g_object_ref (content_buffer);
+  data->stream = g_object_ref (stream);
+  data->cancellable = cancellable ? g_object_ref (cancellable) : NULL;
+  data->io_priority = io_priority;
+
+  data->split = split_tags_at_iter (content_buffer, iter);
+
+  if (fmt->function == _gtk_text_buffer_deserialize_rich_text)
+    data->deserializer = _gtk_text_buffer_deserializer_new (content_buffer, iter,
+                                                            fmt->can_create_tags);
+  else
+    {
+      /*  The format may be unregistered before the stream is read  */
+      data->format = format;
+      data->function = fmt->function;
+      data->function_data = fmt->user_data;
+      data->can_create_tags = fmt->can_create_tags;
+
+      data->bytes = g_byte_array_new ();
+      data->mark = gtk_text_buffer_create_mark (content_buffer, NULL,
+                                                iter, TRUE);
+    }
+
+  g_input_stream_read_async (stream,
+                             data->buffer, DESERIALIZE_CHUNK_SIZE,
+                             io_priority, cancellable,
+                             deserialize_stream_read_cb, data);
+}
+
+/**
+ * gtk_text_buffer_deserialize_from_stream_finish:
+ * @register_buffer: the #GtkTextBuffer @format is registered with
+ * @result: a #GAsyncResult
+ * @error: return location for a #GError
+ *
+ * Finishes an operation started with
+ * gtk_text_buffer_deserialize_from_stream_async().
+ *
+ * Return value: %TRUE on success, %FALSE otherwise.
+ *
+ * Since: 2.22
+ **/
+gboolean
+gtk_text_buffer_deserialize_from_stream_finish (GtkTextBuffer  *register_buffer,
+                                                GAsyncResult   *result,
+                                                GError        **error)
+{
+  GSimpleAsyncResult *simple;
+
+  g_return_val_if_fail (GTK_IS_TEXT_BUFFER (register_buffer), FALSE);
+  g_return_val_if_fail (g_simple_async_result_is_valid (result,
+                                                        G_OBJECT (register_buffer),
+                                                        gtk_text_buffer_deserialize_from_stream_async),
+                        FALSE);
+
+  simple = G_SIMPLE_ASYNC_RESULT (result);
+
+  if (g_simple_async_result_propagate_error (simple, error))
+    return FALSE;
+
+  return g_simple_async_result_get_op_res_gboolean (simple);
+}
+
+
 
 /*  private functions  */
 
@@ -784,6 +1410,23 @@ get_formats (GList *formats,
   return array;
 }
 
+static GtkRichTextFormat *
+lookup_format (GList   *formats,
+               GdkAtom  format)
+{
+  GList *list;
+
+  for (list = formats; list; list = g_list_next (list))
+    {
+      GtkRichTextFormat *fmt = list->data;
+
+      if (fmt->atom == format)
+        return fmt;
+    }
+
+  return NULL;
+}
+
 static void
 free_format (GtkRichTextFormat *format)
 {
@@ -823,5 +1466,148 @@ deserialize_quark (void)
   return quark;
 }
 
+static SplitTags *
+split_tags_at_iter (GtkTextBuffer *content_buffer,
+                    GtkTextIter   *iter)
+{
+  SplitTags *split;
+  GSList    *split_tags;
+  GSList    *list;
+
+  /*  We don't want the tags that are effective at the insertion
+   *  point to affect the pasted text, therefore we remove and
+   *  remember them, so they can be re-applied left and right of
+   *  the inserted text after pasting
+   */
+  split_tags = gtk_text_iter_get_tags (iter);
+
+  list = split_tags;
+  while (list)
+    {
+      GtkTextTag *tag = list->data;
+
+      list = g_slist_next (list);
+
+      /*  If a tag begins at the insertion point, ignore it
+       *  because it doesn't affect the pasted text
+       */
+      if (gtk_text_iter_begins_tag (iter, tag))
+        split_tags = g_slist_remove (split_tags, tag);
+    }
+
+  if (! split_tags)
+    return NULL;
+
+  split = g_new0 (SplitTags, 1);
+  split->buffer = content_buffer;
+  split->tags = split_tags;
+
+  /*  Need to remember text marks, because text iters
+   *  don't survive pasting
+   */
+  split->left_end = gtk_text_buffer_create_mark (content_buffer,
+                                                 NULL, iter, TRUE);
+  split->right_start = gtk_text_buffer_create_mark (content_buffer,
+                                                    NULL, iter, FALSE);
+
+  for (list = split_tags; list; list = g_slist_next (list))
+    {
+      GtkTextTag  *tag             = list->data;
+      GtkTextIter *backward_toggle = gtk_text_iter_copy (iter);
+      GtkTextIter *forward_toggle  = gtk_text_iter_copy (iter);
+      GtkTextMark *left_start      = NULL;
+      GtkTextMark *right_end       = NULL;
+
+      gtk_text_iter_backward_to_tag_toggle (backward_toggle, tag);
+      left_start = gtk_text_buffer_create_mark (content_buffer,
+                                                NULL,
+                                                backward_toggle,
+                                                FALSE);
+
+      gtk_text_iter_forward_to_tag_toggle (forward_toggle, tag);
+      right_end = gtk_text_buffer_create_mark (content_buffer,
+                                               NULL,
+                                               forward_toggle,
+                                               TRUE);
+
+      split->left_start_list = g_slist_prepend (split->left_start_list,
+                                                left_start);
+      split->right_end_list = g_slist_prepend (split->right_end_list,
+                                               right_end);
+
+      gtk_text_buffer_remove_tag (content_buffer, tag,
+                                  backward_toggle,
+                                  forward_toggle);
+
+      gtk_text_iter_free (forward_toggle);
+      gtk_text_iter_free (backward_toggle);
+    }
+
+  split->left_start_list = g_slist_reverse (split->left_start_list);
+  split->right_end_list = g_slist_reverse (split->right_end_list);
+
+  return split;
+}
+
+static void
+rejoin_split_tags (SplitTags *split)
+{
+  GtkTextBuffer *content_buffer;
+  GSList        *list;
+  GSList        *left_list;
+  GSList        *right_list;
+  GtkTextIter    left_e;
+  GtkTextIter    right_s;
+
+  if (! split)
+    return;
+
+  content_buffer = split->buffer;
+
+  /*  Turn the remembered marks back into iters so they
+   *  can by used to re-apply the remembered tags
+   */
+  gtk_text_buffer_get_iter_at_mark (content_buffer,
+                                    &left_e, split->left_end);
+  gtk_text_buffer_get_iter_at_mark (content_buffer,
+                                    &right_s, split->right_start);
+
+  for (list = split->tags,
+         left_list = split->left_start_list,
+         right_list = split->right_end_list;
+       list && left_list && right_list;
+       list = g_slist_next (list),
+         left_list = g_slist_next (left_list),
+         right_list = g_slist_next (right_list))
+    {
+      GtkTextTag  *tag        = list->data;
+      GtkTextMark *left_start = left_list->data;
+      GtkTextMark *right_end  = right_list->data;
+      GtkTextIter  left_s;
+      GtkTextIter  right_e;
+
+      gtk_text_buffer_get_iter_at_mark (content_buffer,
+                                        &left_s, left_start);
+      gtk_text_buffer_get_iter_at_mark (content_buffer,
+                                        &right_e, right_end);
+
+      gtk_text_buffer_apply_tag (content_buffer, tag,
+                                 &left_s, &left_e);
+      gtk_text_buffer_apply_tag (content_buffer, tag,
+                                 &right_s, &right_e);
+
+      gtk_text_buffer_delete_mark (content_buffer, left_start);
+      gtk_text_buffer_delete_mark (content_buffer, right_end);
+    }
+
+  gtk_text_buffer_delete_mark (content_buffer, split->left_end);
+  gtk_text_buffer_delete_mark (content_buffer, split->right_start);
+
+  g_slist_free (split->tags);
+  g_slist_free (split->left_start_list);
+  g_slist_free (split->right_end_list);
+  g_free (split);
+}
+
 #define __GTK_TEXT_BUFFER_RICH_TEXT_C__
 #include "gtkaliasdef.c"
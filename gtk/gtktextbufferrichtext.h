@@ -26,6 +26,7 @@
 #ifndef __GTK_TEXT_BUFFER_RICH_TEXT_H__
 #define __GTK_TEXT_BUFFER_RICH_TEXT_H__
 
+#include <gio/gio.h>
 #include <gtk/gtktextbuffer.h>
 
 G_BEGIN_DECLS
@@ -91,6 +92,48 @@ gboolean  gtk_text_buffer_deserialize                 (GtkTextBuffer
                                                        gsize                         length,
                                                        GError                      **error);
 
+gboolean  gtk_text_buffer_serialize_to_stream         (GtkTextBuffer                *register_buffer,
+                                                       GtkTextBuffer                *content_buffer,
+                                                       GdkAtom                       format,
+                                                       const GtkTextIter            *start,
+                                                       const GtkTextIter            *end,
+                                                       GOutputStream                *stream,
+                                                       GCancellable                 *cancellable,
+                                                       GError                      **error);
+void      gtk_text_buffer_serialize_to_stream_async   (GtkTextBuffer                *register_buffer,
+                                                       GtkTextBuffer                *content_buffer,
+                                                       GdkAtom                       format,
+                                                       const GtkTextIter            *start,
+                                                       const GtkTextIter            *end,
+                                                       GOutputStream                *stream,
+                                                       gint                          io_priority,
+                                                       GCancellable                 *cancellable,
+                                                       GAsyncReadyCallback           callback,
+                                                       gpointer                      user_data);
+gboolean  gtk_text_buffer_serialize_to_stream_finish  (GtkTextBuffer                *register_buffer,
+                                                       GAsyncResult                 *result,
+                                                       GError                      **error);
+
+gboolean  gtk_text_buffer_deserialize_from_stream        (GtkTextBuffer             *register_buffer,
+                                                          GtkTextBuffer             *content_buffer,
+                                                          GdkAtom                    format,
+                                                          GtkTextIter               *iter,
+                                                          GInputStream              *stream,
+                                                          GCancellable              *cancellable,
+                                                          GError                   **error);
+void      gtk_text_buffer_deserialize_from_stream_async  (GtkTextBuffer             *register_buffer,
+                                                          GtkTextBuffer             *content_buffer,
+                                                          GdkAtom                    format,
+                                                          GtkTextIter               *iter,
+                                                          GInputStream              *stream,
+                                                          gint                       io_priority,
+                                                          GCancellable              *cancellable,
+                                                          GAsyncReadyCallback        callback,
+                                                          gpointer                   user_data);
+gboolean  gtk_text_buffer_deserialize_from_stream_finish (GtkTextBuffer             *register_buffer,
+                                                          GAsyncResult              *result,
+                                                          GError                   **error);
+
 G_END_DECLS
 
 #endif /* __GTK_TEXT_BUFFER_RICH_TEXT_H__ */
@@ -29,6 +29,8 @@
 #include <string.h>
 #include <stdlib.h>
 
+#include <gio/gio.h>
+
 #include "gdk-pixbuf/gdk-pixdata.h"
 #include "gtktextbufferserialize.h"
 #include "gtkintl.h"
@@ -46,8 +48,23 @@ typedef struct
   GList *pixbufs;
   gint tag_id;
   GHashTable *tag_id_tags;
+
+  /* Where serialize_text_step() stopped */
+  GtkTextIter iter;
+  GSList *tag_list;
+  GSList *active_tags;
+  gboolean text_started;
+  gboolean text_finished;
 } SerializationContext;
 
+/* Upper bound on the characters serialize_text_step() copies out of
+ * the buffer with one slice, so long untagged runs are split up.
+ */
+#define SERIALIZE_CHUNK_CHARS 16384
+
+/* serialize_text_step() returns once this much markup is pending */
+#define SERIALIZE_CHUNK_SIZE  65536
+
 static gchar *
 serialize_value (GValue *value)
 {
@@ -428,28 +445,35 @@ serialize_section_header (GString     *str,
   g_string_append_c (str, length & 0xff);
 }
 
-static void
-serialize_text (GtkTextBuffer        *buffer,
-                SerializationContext *context)
+static gboolean
+serialize_text_step (SerializationContext *context)
 {
   GtkTextIter iter, old_iter;
-  GSList *tag_list, *new_tag_list;
-  GSList *active_tags;
+  GSList *new_tag_list;
+  GSList *tmp_list;
+
+  if (context->text_finished)
+    return TRUE;
 
-  g_string_append (context->text_str, "<text>");
+  if (!context->text_started)
+    {
+      g_string_append (context->text_str, "<text>");
+
+      context->iter = context->start;
+      context->text_started = TRUE;
+    }
 
-  iter = context->start;
-  tag_list = NULL;
-  active_tags = NULL;
+  iter = context->iter;
 
   do
     {
       GList *added, *removed;
       GList *tmp;
       gchar *tmp_text, *escaped_text;
+      gint n_chars;
 
       new_tag_list = gtk_text_iter_get_tags (&iter);
-      find_list_delta (tag_list, new_tag_list, &added, &removed);
+      find_list_delta (context->tag_list, new_tag_list, &added, &removed);
 
       /* Handle removed tags */
       for (tmp = removed; tmp; tmp = tmp->next)
@@ -459,21 +483,23 @@ serialize_text (GtkTextBuffer        *buffer,
           /* Only close the tag if we didn't close it before (by using
            * the stack logic in the while() loop below)
            */
-          if (g_slist_find (active_tags, tag))
+          if (g_slist_find (context->active_tags, tag))
             {
               g_string_append (context->text_str, "</apply_tag>");
 
               /* Drop all tags that were opened after this one (which are
                * above this on in the stack)
                */
-              while (active_tags->data != tag)
+              while (context->active_tags->data != tag)
                 {
-                  added = g_list_prepend (added, active_tags->data);
-                  active_tags = g_slist_remove (active_tags, active_tags->data);
+                  added = g_list_prepend (added, context->active_tags->data);
+                  context->active_tags = g_slist_remove (context->active_tags,
+                                                         context->active_tags->data);
                   g_string_append_printf (context->text_str, "</apply_tag>");
                 }
 
-              active_tags = g_slist_remove (active_tags, active_tags->data);
+              context->active_tags = g_slist_remove (context->active_tags,
+                                                     context->active_tags->data);
             }
 	}
 
@@ -484,7 +510,8 @@ serialize_text (GtkTextBuffer        *buffer,
 	  gchar *tag_name;
 
 	  /* Add it to the tag hash table */
-	  g_hash_table_insert (context->tags, tag, tag);
+	  if (!g_hash_table_lookup (context->tags, tag))
+	    g_hash_table_insert (context->tags, g_object_ref (tag), tag);
 
 	  if (tag->name)
 	    {
@@ -509,61 +536,57 @@ serialize_text (GtkTextBuffer        *buffer,
 	      g_string_append_printf (context->text_str, "<apply_tag id=\"%d\">", GPOINTER_TO_INT (tag_id));
 	    }
 
-	  active_tags = g_slist_prepend (active_tags, tag);
+	  context->active_tags = g_slist_prepend (context->active_tags, tag);
 	}
 
-      g_slist_free (tag_list);
-      tag_list = new_tag_list;
+      g_slist_free (context->tag_list);
+      context->tag_list = new_tag_list;
 
       g_list_free (added);
       g_list_free (removed);
 
       old_iter = iter;
+      n_chars = 0;
 
       /* Now try to go to either the next tag toggle, or if a pixbuf appears */
-      while (TRUE)
+      while (n_chars < SERIALIZE_CHUNK_CHARS &&
+             gtk_text_iter_compare (&iter, &context->end) < 0)
 	{
 	  gunichar ch = gtk_text_iter_get_char (&iter);
+	  GdkPixbuf *pixbuf = NULL;
 
 	  if (ch == 0xFFFC)
-	    {
-	      GdkPixbuf *pixbuf = gtk_text_iter_get_pixbuf (&iter);
+	    pixbuf = gtk_text_iter_get_pixbuf (&iter);
 
-	      if (pixbuf)
-		{
-		  /* Append the text before the pixbuf */
-		  tmp_text = gtk_text_iter_get_slice (&old_iter, &iter);
-		  escaped_text = g_markup_escape_text (tmp_text, -1);
-		  g_free (tmp_text);
+	  if (pixbuf)
+	    {
+	      /* Append the text before the pixbuf */
+	      tmp_text = gtk_text_iter_get_slice (&old_iter, &iter);
+	      escaped_text = g_markup_escape_text (tmp_text, -1);
+	      g_free (tmp_text);
 
-		  /* Forward so we don't get the 0xfffc char */
-		  gtk_text_iter_forward_char (&iter);
-		  old_iter = iter;
+	      /* Forward so we don't get the 0xfffc char */
+	      gtk_text_iter_forward_char (&iter);
+	      old_iter = iter;
 
-		  g_string_append (context->text_str, escaped_text);
-		  g_free (escaped_text);
+	      g_string_append (context->text_str, escaped_text);
+	      g_free (escaped_text);
 
-		  g_string_append_printf (context->text_str, "<pixbuf index=\"%d\" />", context->n_pixbufs);
+	      g_string_append_printf (context->text_str, "<pixbuf index=\"%d\" />", context->n_pixbufs);
 
-		  context->n_pixbufs++;
-		  context->pixbufs = g_list_prepend (context->pixbufs, pixbuf);
-		}
+	      context->n_pixbufs++;
+	      context->pixbufs = g_list_prepend (context->pixbufs,
+	                                         g_object_ref (pixbuf));
 	    }
-          else if (ch == 0)
-            {
-                break;
-            }
 	  else
 	    gtk_text_iter_forward_char (&iter);
 
+	  n_chars++;
+
 	  if (gtk_text_iter_toggles_tag (&iter, NULL))
 	    break;
 	}
 
-      /* We might have moved too far */
-      if (gtk_text_iter_compare (&iter, &context->end) > 0)
-	iter = context->end;
-
       /* Append the text */
       tmp_text = gtk_text_iter_get_slice (&old_iter, &iter);
       escaped_text = g_markup_escape_text (tmp_text, -1);
@@ -572,14 +595,51 @@ serialize_text (GtkTextBuffer        *buffer,
       g_string_append (context->text_str, escaped_text);
       g_free (escaped_text);
     }
-  while (!gtk_text_iter_equal (&iter, &context->end));
+  while (!gtk_text_iter_equal (&iter, &context->end) &&
+         context->text_str->len < SERIALIZE_CHUNK_SIZE);
+
+  context->iter = iter;
+
+  if (!gtk_text_iter_equal (&iter, &context->end))
+    return FALSE;
 
   /* Close any open tags */
-  for (tag_list = active_tags; tag_list; tag_list = tag_list->next)
+  for (tmp_list = context->active_tags; tmp_list; tmp_list = tmp_list->next)
     g_string_append (context->text_str, "</apply_tag>");
 
-  g_slist_free (active_tags);
+  g_slist_free (context->active_tags);
+  context->active_tags = NULL;
+  g_slist_free (context->tag_list);
+  context->tag_list = NULL;
+
   g_string_append (context->text_str, "</text>\n</text_view_markup>\n");
+  context->text_finished = TRUE;
+
+  return TRUE;
+}
+
+static void
+serialize_text (GtkTextBuffer        *buffer,
+                SerializationContext *context)
+{
+  while (!serialize_text_step (context))
+    ;
+}
+
+static void
+serialize_pixbuf (GdkPixbuf *pixbuf,
+                  GString   *text)
+{
+  GdkPixdata pixdata;
+  guint8 *tmp;
+  guint len;
+
+  gdk_pixdata_from_pixbuf (&pixdata, pixbuf, FALSE);
+  tmp = gdk_pixdata_serialize (&pixdata, &len);
+
+  serialize_section_header (text, "GTKTEXTBUFFERPIXBDATA-0001", len);
+  g_string_append_len (text, (gchar *) tmp, len);
+  g_free (tmp);
 }
 
 static void
@@ -589,19 +649,60 @@ serialize_pixbufs (SerializationContext *context,
   GList *list;
 
   for (list = context->pixbufs; list != NULL; list = list->next)
-    {
-      GdkPixbuf *pixbuf = list->data;
-      GdkPixdata pixdata;
-      guint8 *tmp;
-      guint len;
+    serialize_pixbuf (list->data, text);
+}
 
-      gdk_pixdata_from_pixbuf (&pixdata, pixbuf, FALSE);
-      tmp = gdk_pixdata_serialize (&pixdata, &len);
+static void
+serialization_context_init (SerializationContext *context,
+                            const GtkTextIter    *start,
+                            const GtkTextIter    *end)
+{
+  context->tags = g_hash_table_new_full (NULL, NULL, g_object_unref, NULL);
+  context->text_str = g_string_new (NULL);
+  context->tag_table_str = g_string_new (NULL);
+  context->start = *start;
+  context->end = *end;
+  context->n_pixbufs = 0;
+  context->pixbufs = NULL;
+  context->tag_id = 0;
+  context->tag_id_tags = g_hash_table_new (NULL, NULL);
+  context->tag_list = NULL;
+  context->active_tags = NULL;
+  context->text_started = FALSE;
+  context->text_finished = FALSE;
+}
 
-      serialize_section_header (text, "GTKTEXTBUFFERPIXBDATA-0001", len);
-      g_string_append_len (text, (gchar *) tmp, len);
-      g_free (tmp);
-    }
+/* Prepares @context for another pass over the text. The tags and
+ * anonymous tag ids found so far are kept, so the second pass
+ * produces the same markup as the first.
+ */
+static void
+serialization_context_restart (SerializationContext *context)
+{
+  g_list_foreach (context->pixbufs, (GFunc) g_object_unref, NULL);
+  g_list_free (context->pixbufs);
+  context->pixbufs = NULL;
+  context->n_pixbufs = 0;
+
+  g_slist_free (context->tag_list);
+  context->tag_list = NULL;
+  g_slist_free (context->active_tags);
+  context->active_tags = NULL;
+
+  g_string_truncate (context->text_str, 0);
+  context->text_started = FALSE;
+  context->text_finished = FALSE;
+}
+
+static void
+serialization_context_free (SerializationContext *context)
+{
+  serialization_context_restart (context);
+
+  g_hash_table_destroy (context->tags);
+  g_string_free (context->text_str, TRUE);
+  g_string_free (context->tag_table_str, TRUE);
+  g_hash_table_destroy (context->tag_id_tags);
 }
 
 guint8 *
@@ -615,15 +716,7 @@ _gtk_text_buffer_serialize_rich_text (GtkTextBuffer     *register_buffer,
   SerializationContext context;
   GString *text;
 
-  context.tags = g_hash_table_new (NULL, NULL);
-  context.text_str = g_string_new (NULL);
-  context.tag_table_str = g_string_new (NULL);
-  context.start = *start;
-  context.end = *end;
-  context.n_pixbufs = 0;
-  context.pixbufs = NULL;
-  context.tag_id = 0;
-  context.tag_id_tags = g_hash_table_new (NULL, NULL);
+  serialization_context_init (&context, start, end);
 
   /* We need to serialize the text before the tag table so we know
      what tags are used */
@@ -640,17 +733,207 @@ _gtk_text_buffer_serialize_rich_text (GtkTextBuffer     *register_buffer,
   context.pixbufs = g_list_reverse (context.pixbufs);
   serialize_pixbufs (&context, text);
 
-  g_hash_table_destroy (context.tags);
-  g_list_free (context.pixbufs);
-  g_string_free (context.text_str, TRUE);
-  g_string_free (context.tag_table_str, TRUE);
-  g_hash_table_destroy (context.tag_id_tags);
+  serialization_context_free (&context);
 
   *length = text->len;
 
   return (guint8 *) g_string_free (text, FALSE);
 }
 
+typedef enum
+{
+  SERIALIZER_COUNT_TEXT,
+  SERIALIZER_TEXT,
+  SERIALIZER_PIXBUFS,
+  SERIALIZER_DONE
+} SerializerPhase;
+
+struct _GtkTextBufferSerializer
+{
+  SerializationContext context;
+
+  GtkTextBuffer *buffer;
+  gulong changed_handler;
+  gulong apply_tag_handler;
+  gulong remove_tag_handler;
+  gboolean modified;
+
+  SerializerPhase phase;
+  gsize text_length;
+  gsize text_written;
+  GList *next_pixbuf;
+
+  /* Section headers and pixbuf data handed out by _next() */
+  GString *chunk;
+};
+
+static void
+serializer_buffer_modified (GtkTextBufferSerializer *serializer)
+{
+  serializer->modified = TRUE;
+}
+
+/* The contents section starts with its length, and the tag table in
+ * it can only be written once all the text has been looked at. The
+ * serializer therefore walks the text twice: first to find the tags
+ * and measure the markup, then to hand the markup out in chunks of
+ * about SERIALIZE_CHUNK_SIZE bytes, followed by one chunk per pixbuf.
+ * Nothing is ever held in memory for the whole range at once.
+ */
+GtkTextBufferSerializer *
+_gtk_text_buffer_serializer_new (GtkTextBuffer     *content_buffer,
+                                 const GtkTextIter *start,
+                                 const GtkTextIter *end)
+{
+  GtkTextBufferSerializer *serializer;
+
+  serializer = g_new0 (GtkTextBufferSerializer, 1);
+
+  serialization_context_init (&serializer->context, start, end);
+
+  serializer->buffer = g_object_ref (content_buffer);
+  serializer->changed_handler =
+    g_signal_connect_swapped (content_buffer, "changed",
+                              G_CALLBACK (serializer_buffer_modified), serializer);
+  serializer->apply_tag_handler =
+    g_signal_connect_swapped (content_buffer, "apply-tag",
+                              G_CALLBACK (serializer_buffer_modified), serializer);
+  serializer->remove_tag_handler =
+    g_signal_connect_swapped (content_buffer, "remove-tag",
+                              G_CALLBACK (serializer_buffer_modified), serializer);
+
+  serializer->phase = SERIALIZER_COUNT_TEXT;
+  serializer->chunk = g_string_new (NULL);
+
+  return serializer;
+}
+
+/* Produces the next piece of serialized data in @data and @length.
+ * The data stays valid until the next call. @length may be 0 while
+ * the first pass over the text is still running; @done is set once
+ * everything has been handed out.
+ */
+gboolean
+_gtk_text_buffer_serializer_next (GtkTextBufferSerializer  *serializer,
+                                  const guint8            **data,
+                                  gsize                    *length,
+                                  gboolean                 *done,
+                                  GError                  **error)
+{
+  SerializationContext *context = &serializer->context;
+  gboolean finished;
+
+  *data = NULL;
+  *length = 0;
+  *done = FALSE;
+
+  if (serializer->modified)
+    {
+      serializer->phase = SERIALIZER_DONE;
+
+      g_set_error_literal (error,
+                           G_IO_ERROR,
+                           G_IO_ERROR_FAILED,
+                           _("The text buffer was modified while it was being serialized"));
+
+      return FALSE;
+    }
+
+  g_string_truncate (serializer->chunk, 0);
+
+  switch (serializer->phase)
+    {
+    case SERIALIZER_COUNT_TEXT:
+      finished = serialize_text_step (context);
+
+      serializer->text_length += context->text_str->len;
+      g_string_truncate (context->text_str, 0);
+
+      if (!finished)
+        break;
+
+      serialize_tags (context);
+
+      serialize_section_header (serializer->chunk, "GTKTEXTBUFFERCONTENTS-0001",
+                                context->tag_table_str->len + serializer->text_length);
+      g_string_append_len (serializer->chunk,
+                           context->tag_table_str->str,
+                           context->tag_table_str->len);
+
+      serialization_context_restart (context);
+      serializer->phase = SERIALIZER_TEXT;
+
+      *data = (const guint8 *) serializer->chunk->str;
+      *length = serializer->chunk->len;
+      break;
+
+    case SERIALIZER_TEXT:
+      g_string_truncate (context->text_str, 0);
+
+      finished = serialize_text_step (context);
+
+      serializer->text_written += context->text_str->len;
+
+      if (finished)
+        {
+          /* Can only happen if the buffer changed behind our back */
+          if (serializer->text_written != serializer->text_length)
+            {
+              serializer->phase = SERIALIZER_DONE;
+
+              g_set_error_literal (error,
+                                   G_IO_ERROR,
+                                   G_IO_ERROR_FAILED,
+                                   _("The text buffer was modified while it was being serialized"));
+
+              return FALSE;
+            }
+
+          context->pixbufs = g_list_reverse (context->pixbufs);
+          serializer->next_pixbuf = context->pixbufs;
+          serializer->phase = SERIALIZER_PIXBUFS;
+        }
+
+      *data = (const guint8 *) context->text_str->str;
+      *length = context->text_str->len;
+      break;
+
+    case SERIALIZER_PIXBUFS:
+      if (serializer->next_pixbuf)
+        {
+          serialize_pixbuf (serializer->next_pixbuf->data, serializer->chunk);
+          serializer->next_pixbuf = serializer->next_pixbuf->next;
+
+          *data = (const guint8 *) serializer->chunk->str;
+          *length = serializer->chunk->len;
+          break;
+        }
+
+      serializer->phase = SERIALIZER_DONE;
+      /* fall through */
+
+    case SERIALIZER_DONE:
+      *done = TRUE;
+      break;
+    }
+
+  return TRUE;
+}
+
+void
+_gtk_text_buffer_serializer_free (GtkTextBufferSerializer *serializer)
+{
+  g_signal_handler_disconnect (serializer->buffer, serializer->changed_handler);
+  g_signal_handler_disconnect (serializer->buffer, serializer->apply_tag_handler);
+  g_signal_handler_disconnect (serializer->buffer, serializer->remove_tag_handler);
+  g_object_unref (serializer->buffer);
+
+  serialization_context_free (&serializer->context);
+  g_string_free (serializer->chunk, TRUE);
+
+  g_free (serializer);
+}
+
 typedef enum
 {
   STATE_START,
@@ -667,9 +950,17 @@ typedef struct
 {
   gchar *text;
   GdkPixbuf *pixbuf;
+  gint pixbuf_index;
   GSList *tags;
 } TextSpan;
 
+typedef struct
+{
+  gint index;
+  GtkTextMark *mark;
+  GSList *tags;
+} PixbufPlaceholder;
+
 typedef struct
 {
   GtkTextTag *tag;
@@ -713,6 +1004,12 @@ typedef struct
 
   gboolean parsed_text;
   gboolean parsed_tags;
+
+  /* Set when the pixbuf sections are read after the markup, see
+   * GtkTextBufferDeserializer
+   */
+  gboolean streaming;
+  GSList *pixbuf_placeholders;
 } ParseInfo;
 
 static void
@@ -1125,15 +1422,23 @@ parse_apply_tag_element (GMarkupParseContext  *context,
 	return;
 
       int_id = atoi (pixbuf_id);
-      pixbuf = get_pixbuf_from_headers (info->headers, int_id, error);
+
+      /* When streaming, the pixbuf data has not been read yet;
+       * insert_text() leaves a placeholder mark for it instead
+       */
+      if (info->streaming)
+        pixbuf = NULL;
+      else
+        pixbuf = get_pixbuf_from_headers (info->headers, int_id, error);
 
       span = g_new0 (TextSpan, 1);
       span->pixbuf = pixbuf;
+      span->pixbuf_index = int_id;
       span->tags = NULL;
 
       info->spans = g_list_prepend (info->spans, span);
 
-      if (!pixbuf)
+      if (!pixbuf && !info->streaming)
 	return;
 
       push_state (info, STATE_PIXBUF);
@@ -1610,6 +1915,8 @@ parse_info_init (ParseInfo     *info,
   info->current_tag = NULL;
   info->current_tag_prio = -1;
   info->tag_priorities = NULL;
+  info->streaming = FALSE;
+  info->pixbuf_placeholders = NULL;
 
   info->buffer = buffer;
 }
@@ -1622,10 +1929,21 @@ text_span_free (TextSpan *span)
   g_free (span);
 }
 
+static void
+pixbuf_placeholder_free (GtkTextBuffer     *buffer,
+                         PixbufPlaceholder *placeholder)
+{
+  gtk_text_buffer_delete_mark (buffer, placeholder->mark);
+  g_slist_foreach (placeholder->tags, (GFunc) g_object_unref, NULL);
+  g_slist_free (placeholder->tags);
+  g_free (placeholder);
+}
+
 static void
 parse_info_free (ParseInfo *info)
 {
   GList *list;
+  GSList *slist;
 
   g_slist_free (info->tag_stack);
   g_slist_free (info->states);
@@ -1658,6 +1976,14 @@ parse_info_free (ParseInfo *info)
     }
   g_list_free (info->tag_priorities);
 
+  slist = info->pixbuf_placeholders;
+  while (slist)
+    {
+      pixbuf_placeholder_free (info->buffer, slist->data);
+
+      slist = slist->next;
+    }
+  g_slist_free (info->pixbuf_placeholders);
 }
 
 static void
@@ -1681,11 +2007,26 @@ insert_text (ParseInfo   *info,
 
       if (span->text)
 	gtk_text_buffer_insert (info->buffer, iter, span->text, -1);
-      else
+      else if (span->pixbuf)
 	{
 	  gtk_text_buffer_insert_pixbuf (info->buffer, iter, span->pixbuf);
 	  g_object_unref (span->pixbuf);
 	}
+      else
+        {
+          PixbufPlaceholder *placeholder;
+
+          placeholder = g_new (PixbufPlaceholder, 1);
+          placeholder->index = span->pixbuf_index;
+          placeholder->mark = gtk_text_buffer_create_mark (info->buffer, NULL,
+                                                           iter, TRUE);
+          /* The pixbuf arrives later, so its tags are applied then */
+          placeholder->tags = g_slist_copy (span->tags);
+          g_slist_foreach (placeholder->tags, (GFunc) g_object_ref, NULL);
+
+          info->pixbuf_placeholders = g_slist_prepend (info->pixbuf_placeholders,
+                                                       placeholder);
+        }
       gtk_text_buffer_get_iter_at_mark (info->buffer, &start_iter, mark);
 
       /* Apply tags */
@@ -1870,3 +2211,309 @@ _gtk_text_buffer_deserialize_rich_text (GtkTextBuffer *register_buffer,
 
   return retval;
 }
+
+typedef enum
+{
+  DESERIALIZER_CONTENTS_HEADER,
+  DESERIALIZER_CONTENTS,
+  DESERIALIZER_SECTION_HEADER,
+  DESERIALIZER_PIXBUF,
+  DESERIALIZER_SKIP
+} DeserializerState;
+
+struct _GtkTextBufferDeserializer
+{
+  ParseInfo info;
+  GMarkupParseContext *context;
+
+  /* Right gravity, so it stays behind the inserted text */
+  GtkTextMark *insert_mark;
+
+  DeserializerState state;
+
+  /* Partial section header, or the pixbuf data read so far */
+  GString *section;
+  gsize section_remaining;
+  gint n_pixbufs;
+};
+
+static void
+set_malformed_error (GError **error)
+{
+  g_set_error_literal (error,
+                       G_MARKUP_ERROR,
+                       G_MARKUP_ERROR_PARSE,
+                       _("Serialized data is malformed"));
+}
+
+/* Unlike _gtk_text_buffer_deserialize_rich_text(), which parses all
+ * of the markup before it touches the buffer, the deserializer inserts
+ * text as soon as the parser has seen it. Pixbufs are inserted at
+ * placeholder marks when their sections, which follow the markup,
+ * have been read.
+ */
+GtkTextBufferDeserializer *
+_gtk_text_buffer_deserializer_new (GtkTextBuffer *content_buffer,
+                                   GtkTextIter   *iter,
+                                   gboolean       create_tags)
+{
+  GtkTextBufferDeserializer *deserializer;
+
+  static const GMarkupParser rich_text_parser = {
+    start_element_handler,
+    end_element_handler,
+    text_handler,
+    NULL,
+    NULL
+  };
+
+  deserializer = g_new0 (GtkTextBufferDeserializer, 1);
+
+  g_object_ref (content_buffer);
+
+  parse_info_init (&deserializer->info, content_buffer, create_tags, NULL);
+  deserializer->info.streaming = TRUE;
+
+  deserializer->context = g_markup_parse_context_new (&rich_text_parser, 0,
+                                                      &deserializer->info,
+                                                      NULL);
+
+  deserializer->insert_mark = gtk_text_buffer_create_mark (content_buffer, NULL,
+                                                           iter, FALSE);
+
+  deserializer->state = DESERIALIZER_CONTENTS_HEADER;
+  deserializer->section = g_string_new (NULL);
+
+  return deserializer;
+}
+
+static void
+deserializer_insert_spans (GtkTextBufferDeserializer *deserializer)
+{
+  ParseInfo *info = &deserializer->info;
+  GtkTextIter iter;
+  GList *list;
+
+  if (!info->spans)
+    return;
+
+  /* end_element_handler() has already put them in order if it saw </text> */
+  if (!info->parsed_text)
+    info->spans = g_list_reverse (info->spans);
+
+  gtk_text_buffer_get_iter_at_mark (info->buffer, &iter, deserializer->insert_mark);
+  insert_text (info, &iter);
+
+  for (list = info->spans; list; list = list->next)
+    text_span_free (list->data);
+  g_list_free (info->spans);
+  info->spans = NULL;
+}
+
+static gboolean
+deserializer_insert_pixbuf (GtkTextBufferDeserializer *deserializer,
+                            GError                   **error)
+{
+  ParseInfo *info = &deserializer->info;
+  GdkPixdata pixdata;
+  GdkPixbuf *pixbuf;
+  GSList *list;
+  gint index;
+
+  index = deserializer->n_pixbufs++;
+
+  if (!gdk_pixdata_deserialize (&pixdata, deserializer->section->len,
+                                (const guint8 *) deserializer->section->str,
+                                error))
+    return FALSE;
+
+  pixbuf = gdk_pixbuf_from_pixdata (&pixdata, TRUE, error);
+
+  if (!pixbuf)
+    return FALSE;
+
+  list = info->pixbuf_placeholders;
+  while (list)
+    {
+      PixbufPlaceholder *placeholder = list->data;
+
+      list = list->next;
+
+      if (placeholder->index == index)
+        {
+          GtkTextIter start, iter;
+          GSList *tags;
+
+          gtk_text_buffer_get_iter_at_mark (info->buffer, &iter, placeholder->mark);
+          gtk_text_buffer_insert_pixbuf (info->buffer, &iter, pixbuf);
+
+          /* The mark has left gravity, so it stays before the pixbuf */
+          gtk_text_buffer_get_iter_at_mark (info->buffer, &start, placeholder->mark);
+          for (tags = placeholder->tags; tags; tags = tags->next)
+            gtk_text_buffer_apply_tag (info->buffer, tags->data, &start, &iter);
+
+          info->pixbuf_placeholders = g_slist_remove (info->pixbuf_placeholders,
+                                                      placeholder);
+          pixbuf_placeholder_free (info->buffer, placeholder);
+        }
+    }
+
+  g_object_unref (pixbuf);
+
+  return TRUE;
+}
+
+static gboolean
+deserializer_read_header (GtkTextBufferDeserializer *deserializer,
+                          GError                   **error)
+{
+  const gchar *header = deserializer->section->str;
+  gint length;
+
+  length = read_int ((const guchar *) header + 26);
+
+  /* Neither the markup nor a pixbuf can be empty */
+  if (length <= 0)
+    {
+      set_malformed_error (error);
+      return FALSE;
+    }
+
+  if (deserializer->state == DESERIALIZER_CONTENTS_HEADER)
+    {
+      if (strncmp (header, "GTKTEXTBUFFERCONTENTS-0001", 26) != 0)
+        {
+          g_set_error_literal (error,
+                               G_MARKUP_ERROR,
+                               G_MARKUP_ERROR_PARSE,
+                               _("Serialized data is malformed. First section isn't GTKTEXTBUFFERCONTENTS-0001"));
+          return FALSE;
+        }
+
+      deserializer->state = DESERIALIZER_CONTENTS;
+    }
+  else if (strncmp (header, "GTKTEXTBUFFERPIXBDATA-0001", 26) == 0)
+    deserializer->state = DESERIALIZER_PIXBUF;
+  else
+    {
+      /* Like read_headers(), ignore everything after the
+       * first section that isn't ours
+       */
+      deserializer->state = DESERIALIZER_SKIP;
+    }
+
+  deserializer->section_remaining = length;
+  g_string_truncate (deserializer->section, 0);
+
+  return TRUE;
+}
+
+gboolean
+_gtk_text_buffer_deserializer_feed (GtkTextBufferDeserializer *deserializer,
+                                    const guint8              *data,
+                                    gsize                      length,
+                                    GError                   **error)
+{
+  while (length > 0)
+    {
+      gsize n = length;
+
+      switch (deserializer->state)
+        {
+        case DESERIALIZER_CONTENTS_HEADER:
+        case DESERIALIZER_SECTION_HEADER:
+          n = MIN (length, 30 - deserializer->section->len);
+          g_string_append_len (deserializer->section, (const gchar *) data, n);
+
+          if (deserializer->section->len == 30 &&
+              !deserializer_read_header (deserializer, error))
+            return FALSE;
+          break;
+
+        case DESERIALIZER_CONTENTS:
+          n = MIN (length, deserializer->section_remaining);
+
+          if (!g_markup_parse_context_parse (deserializer->context,
+                                             (const gchar *) data, n,
+                                             error))
+            return FALSE;
+
+          deserializer->section_remaining -= n;
+
+          if (deserializer->section_remaining == 0)
+            {
+              if (!g_markup_parse_context_end_parse (deserializer->context, error))
+                return FALSE;
+
+              deserializer->state = DESERIALIZER_SECTION_HEADER;
+            }
+
+          deserializer_insert_spans (deserializer);
+          break;
+
+        case DESERIALIZER_PIXBUF:
+          n = MIN (length, deserializer->section_remaining);
+          g_string_append_len (deserializer->section, (const gchar *) data, n);
+
+          deserializer->section_remaining -= n;
+
+          if (deserializer->section_remaining == 0)
+            {
+              if (!deserializer_insert_pixbuf (deserializer, error))
+                return FALSE;
+
+              g_string_truncate (deserializer->section, 0);
+              deserializer->state = DESERIALIZER_SECTION_HEADER;
+            }
+          break;
+
+        case DESERIALIZER_SKIP:
+          break;
+        }
+
+      data += n;
+      length -= n;
+    }
+
+  return TRUE;
+}
+
+/* Checks that the data fed so far was complete and moves @iter, if
+ * given, behind the inserted text.
+ */
+gboolean
+_gtk_text_buffer_deserializer_finish (GtkTextBufferDeserializer *deserializer,
+                                      GtkTextIter               *iter,
+                                      GError                   **error)
+{
+  if (deserializer->state != DESERIALIZER_SKIP &&
+      (deserializer->state != DESERIALIZER_SECTION_HEADER ||
+       deserializer->section->len > 0))
+    {
+      set_malformed_error (error);
+      return FALSE;
+    }
+
+  if (iter)
+    gtk_text_buffer_get_iter_at_mark (deserializer->info.buffer, iter,
+                                      deserializer->insert_mark);
+
+  return TRUE;
+}
+
+void
+_gtk_text_buffer_deserializer_free (GtkTextBufferDeserializer *deserializer)
+{
+  GtkTextBuffer *buffer = deserializer->info.buffer;
+
+  gtk_text_buffer_delete_mark (buffer, deserializer->insert_mark);
+
+  /* Drops the placeholders of pixbufs that never arrived */
+  parse_info_free (&deserializer->info);
+  g_markup_parse_context_free (deserializer->context);
+  g_string_free (deserializer->section, TRUE);
+
+  g_free (deserializer);
+
+  g_object_unref (buffer);
+}
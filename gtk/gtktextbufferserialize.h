@@ -39,5 +39,32 @@ gboolean _gtk_text_buffer_deserialize_rich_text (GtkTextBuffer     *register_buf
                                                  gpointer           user_data,
                                                  GError           **error);
 
+typedef struct _GtkTextBufferSerializer   GtkTextBufferSerializer;
+typedef struct _GtkTextBufferDeserializer GtkTextBufferDeserializer;
+
+GtkTextBufferSerializer *
+         _gtk_text_buffer_serializer_new        (GtkTextBuffer            *content_buffer,
+                                                 const GtkTextIter        *start,
+                                                 const GtkTextIter        *end);
+gboolean _gtk_text_buffer_serializer_next       (GtkTextBufferSerializer  *serializer,
+                                                 const guint8            **data,
+                                                 gsize                    *length,
+                                                 gboolean                 *done,
+                                                 GError                  **error);
+void     _gtk_text_buffer_serializer_free       (GtkTextBufferSerializer  *serializer);
+
+GtkTextBufferDeserializer *
+         _gtk_text_buffer_deserializer_new      (GtkTextBuffer            *content_buffer,
+                                                 GtkTextIter              *iter,
+                                                 gboolean                  create_tags);
+gboolean _gtk_text_buffer_deserializer_feed     (GtkTextBufferDeserializer *deserializer,
+                                                 const guint8              *data,
+                                                 gsize                      length,
+                                                 GError                   **error);
+gboolean _gtk_text_buffer_deserializer_finish   (GtkTextBufferDeserializer *deserializer,
+                                                 GtkTextIter               *iter,
+                                                 GError                   **error);
+void     _gtk_text_buffer_deserializer_free     (GtkTextBufferDeserializer *deserializer);
+
 
 #endif /* __GTK_TEXT_BUFFER_SERIALIZE_H__ */
@@ -74,6 +74,9 @@
       }                                                                 \
   } G_STMT_END
 
+#define PIXBUF_SEG_SIZE ((unsigned) (G_STRUCT_OFFSET (GtkTextLineSegment, body) \
+        + sizeof (GtkTextPixbuf)))
+
 static GtkTextLineSegment *
 pixbuf_segment_cleanup_func (GtkTextLineSegment *seg,
                              GtkTextLine        *line)
@@ -90,7 +93,7 @@ pixbuf_segment_delete_func (GtkTextLineSegment *seg,
   if (seg->body.pixbuf.pixbuf)
     g_object_unref (seg->body.pixbuf.pixbuf);
 
-  g_free (seg);
+  _gtk_text_segment_free (PIXBUF_SEG_SIZE, seg);
 
   return 0;
 }
@@ -121,15 +124,12 @@ const GtkTextLineSegmentClass gtk_text_pixbuf_type = {
 
 };
 
-#define PIXBUF_SEG_SIZE ((unsigned) (G_STRUCT_OFFSET (GtkTextLineSegment, body) \
-        + sizeof (GtkTextPixbuf)))
-
 GtkTextLineSegment *
 _gtk_pixbuf_segment_new (GdkPixbuf *pixbuf)
 {
   GtkTextLineSegment *seg;
 
-  seg = g_malloc (PIXBUF_SEG_SIZE);
+  seg = _gtk_text_segment_alloc (PIXBUF_SEG_SIZE);
 
   seg->type = &gtk_text_pixbuf_type;
 
@@ -226,7 +226,7 @@ _gtk_widget_segment_new (GtkTextChildAnchor *anchor)
 {
   GtkTextLineSegment *seg;
 
-  seg = g_malloc (WIDGET_SEG_SIZE);
+  seg = _gtk_text_segment_alloc (WIDGET_SEG_SIZE);
 
   seg->type = &gtk_text_child_type;
 
@@ -370,7 +370,7 @@ gtk_text_child_anchor_finalize (GObject *obj)
   
       g_slist_free (seg->body.child.widgets);
   
-      g_free (seg);
+      _gtk_text_segment_free (WIDGET_SEG_SIZE, seg);
     }
 
   anchor->segment = NULL;
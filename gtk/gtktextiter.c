@@ -4409,18 +4409,322 @@ forward_chars_with_skipping (GtkTextIter *iter,
     }
 }
 
+/* strsplit () that retains the delimiter as part of the string. */
+static gchar **
+strbreakup (const char *string,
+            const char *delimiter,
+            gint        max_tokens)
+{
+  GSList *string_list = NULL, *slist;
+  gchar **str_array, *s;
+  guint i, n = 1;
+
+  g_return_val_if_fail (string != NULL, NULL);
+  g_return_val_if_fail (delimiter != NULL, NULL);
+
+  if (max_tokens < 1)
+    max_tokens = G_MAXINT;
+
+  s = strstr (string, delimiter);
+  if (s)
+    {
+      guint delimiter_len = strlen (delimiter);
+
+      do
+        {
+          guint len;
+          gchar *new_string;
+
+          len = s - string + delimiter_len;
+          new_string = g_new (gchar, len + 1);
+          strncpy (new_string, string, len);
+          new_string[len] = 0;
+          string_list = g_slist_prepend (string_list, new_string);
+          n++;
+          string = s + delimiter_len;
+          s = strstr (string, delimiter);
+        }
+      while (--max_tokens && s);
+    }
+  if (*string)
+    {
+      n++;
+      string_list = g_slist_prepend (string_list, g_strdup (string));
+    }
+
+  str_array = g_new (gchar*, n);
+
+  i = n - 1;
+
+  str_array[i--] = NULL;
+  for (slist = string_list; slist; slist = slist->next)
+    str_array[i--] = slist->data;
+
+  g_slist_free (string_list);
+
+  return str_array;
+}
+
+/*
+ * Searching
+ *
+ * Unless only visible text is searched, the text of each line is read
+ * straight from its segments; only lines split into several segments
+ * by tags or embedded objects are copied, into a scratch buffer that is
+ * reused for the whole search. Exact searches use Boyer-Moore-Horspool
+ * on the first line of the search string, which skips over most of the
+ * text without looking at it.
+ */
+
+typedef struct _TextSearch TextSearch;
+
+struct _TextSearch
+{
+  gchar **lines;
+  gboolean visible_only;
+  gboolean slice;
+  gboolean case_insensitive;
+
+  /* Boyer-Moore-Horspool shift table for lines[0] */
+  gsize first_line_len;
+  gsize shift[256];
+
+  GString *scratch;
+};
+
+static void
+text_search_init (TextSearch        *search,
+                  const gchar       *str,
+                  GtkTextSearchFlags flags)
+{
+  const guchar *needle;
+  gsize i;
+
+  search->lines = strbreakup (str, "\n", -1);
+  search->visible_only = (flags & GTK_TEXT_SEARCH_VISIBLE_ONLY) != 0;
+  search->slice = (flags & GTK_TEXT_SEARCH_TEXT_ONLY) == 0;
+  search->case_insensitive = (flags & GTK_TEXT_SEARCH_CASE_INSENSITIVE) != 0;
+  search->scratch = g_string_new (NULL);
+
+  needle = (const guchar *) search->lines[0];
+  search->first_line_len = strlen (search->lines[0]);
+
+  for (i = 0; i < 256; i++)
+    search->shift[i] = search->first_line_len;
+
+  for (i = 0; i + 1 < search->first_line_len; i++)
+    search->shift[needle[i]] = search->first_line_len - 1 - i;
+}
+
+static void
+text_search_free (TextSearch *search)
+{
+  g_strfreev (search->lines);
+  g_string_free (search->scratch, TRUE);
+}
+
+/* Finds the first occurrence of lines[0] in @text */
+static const gchar *
+text_search_find_first_line (const TextSearch *search,
+                             const gchar      *text,
+                             gsize             len)
+{
+  const guchar *haystack = (const guchar *) text;
+  const guchar *needle = (const guchar *) search->lines[0];
+  gsize needle_len = search->first_line_len;
+  gsize last, i;
+
+  if (len < needle_len)
+    return NULL;
+
+  if (needle_len == 1)
+    return memchr (text, needle[0], len);
+
+  last = needle_len - 1;
+  i = 0;
+
+  while (i <= len - needle_len)
+    {
+      guchar c = haystack[i + last];
+
+      if (c == needle[last] &&
+          memcmp (haystack + i, needle, last) == 0)
+        return text + i;
+
+      i += search->shift[c];
+    }
+
+  return NULL;
+}
+
+/* Compares @text with @prefix a character at a time, ignoring case.
+ * Returns the number of bytes of @text that matched @prefix, or -1.
+ */
+static gint
+utf8_caseless_prefix (const gchar *text,
+                      const gchar *text_end,
+                      const gchar *prefix)
+{
+  const gchar *p = text;
+
+  while (*prefix)
+    {
+      if (p >= text_end)
+        return -1;
+
+      if (g_unichar_tolower (g_utf8_get_char (p)) !=
+          g_unichar_tolower (g_utf8_get_char (prefix)))
+        return -1;
+
+      p = g_utf8_next_char (p);
+      prefix = g_utf8_next_char (prefix);
+    }
+
+  return p - text;
+}
+
+/* Finds @needle in the @len bytes at @text; only at the start of
+ * @text if @anchored. Returns the match, and its length in @text
+ * in @match_len.
+ */
+static const gchar *
+text_search_find (const TextSearch *search,
+                  const gchar      *text,
+                  gsize             len,
+                  const gchar      *needle,
+                  gboolean          anchored,
+                  gsize            *match_len)
+{
+  const gchar *text_end = text + len;
+  const gchar *p;
+  gint n;
+
+  if (!search->case_insensitive)
+    {
+      gsize needle_len = strlen (needle);
+
+      *match_len = needle_len;
+
+      if (!anchored)
+        return text_search_find_first_line (search, text, len);
+      else if (len >= needle_len && memcmp (text, needle, needle_len) == 0)
+        return text;
+      else
+        return NULL;
+    }
+
+  for (p = text; p < text_end; p = g_utf8_next_char (p))
+    {
+      n = utf8_caseless_prefix (p, text_end, needle);
+      if (n >= 0)
+        {
+          *match_len = n;
+          return p;
+        }
+
+      if (anchored)
+        break;
+    }
+
+  return NULL;
+}
+
+/* Gets the text from @start to the start of the next line, like
+ * gtk_text_iter_get_slice() or gtk_text_iter_get_text() would, but
+ * without copying it if it is stored in a single segment.
+ */
+static const gchar *
+text_search_get_line_text (TextSearch        *search,
+                           const GtkTextIter *start,
+                           gsize             *len)
+{
+  GtkTextLine *line;
+  GtkTextLineSegment *seg;
+  const gchar *in_place = NULL;
+  gsize in_place_len = 0;
+  gint index;
+  gint remaining;
+
+  line = _gtk_text_iter_get_text_line (start);
+  index = gtk_text_iter_get_line_index (start);
+
+  /* The line holding the end iter ends in a newline that isn't part
+   * of the buffer; gtk_text_iter_get_bytes_in_line() leaves it out.
+   */
+  remaining = gtk_text_iter_get_bytes_in_line (start) - index;
+
+  /* Find the segment containing @start */
+  seg = line->segments;
+  while (seg != NULL && index >= seg->byte_count)
+    {
+      index -= seg->byte_count;
+      seg = seg->next;
+    }
+
+  g_string_truncate (search->scratch, 0);
+
+  for (; seg != NULL && remaining > 0; seg = seg->next, index = 0)
+    {
+      const gchar *text;
+      gsize text_len;
+      gint seg_len;
+
+      seg_len = MIN (seg->byte_count - index, remaining);
+      remaining -= seg_len;
+
+      if (seg->type == &gtk_text_char_type)
+        {
+          text = seg->body.chars + index;
+          text_len = seg_len;
+        }
+      else if (search->slice &&
+               (seg->type == &gtk_text_pixbuf_type ||
+                seg->type == &gtk_text_child_type))
+        {
+          text = gtk_text_unknown_char_utf8;
+          text_len = 3;
+        }
+      else
+        continue;
+
+      if (in_place == NULL && search->scratch->len == 0)
+        {
+          in_place = text;
+          in_place_len = text_len;
+        }
+      else
+        {
+          if (in_place != NULL)
+            {
+              g_string_append_len (search->scratch, in_place, in_place_len);
+              in_place = NULL;
+            }
+          g_string_append_len (search->scratch, text, text_len);
+        }
+    }
+
+  if (in_place != NULL)
+    {
+      *len = in_place_len;
+      return in_place;
+    }
+
+  *len = search->scratch->len;
+  return search->scratch->str;
+}
+
 static gboolean
-lines_match (const GtkTextIter *start,
-             const gchar **lines,
-             gboolean visible_only,
-             gboolean slice,
-             GtkTextIter *match_start,
-             GtkTextIter *match_end)
+lines_match (TextSearch        *search,
+             const GtkTextIter *start,
+             const gchar      **lines,
+             GtkTextIter       *match_start,
+             GtkTextIter       *match_end)
 {
   GtkTextIter next;
-  gchar *line_text;
+  gchar *line_text = NULL;
+  const gchar *text;
   const gchar *found;
-  gint offset;
+  gsize len, match_len;
 
   if (*lines == NULL || **lines == '\0')
     {
@@ -4432,70 +4736,83 @@ lines_match (const GtkTextIter *start,
       return TRUE;
     }
 
-  next = *start;
-  gtk_text_iter_forward_line (&next);
-
-  /* No more text in buffer, but *lines is nonempty */
-  if (gtk_text_iter_equal (start, &next))
+  if (search->visible_only)
     {
-      return FALSE;
-    }
+      next = *start;
+      gtk_text_iter_forward_line (&next);
 
-  if (slice)
-    {
-      if (visible_only)
+      if (search->slice)
         line_text = gtk_text_iter_get_visible_slice (start, &next);
       else
-        line_text = gtk_text_iter_get_slice (start, &next);
-    }
-  else
-    {
-      if (visible_only)
         line_text = gtk_text_iter_get_visible_text (start, &next);
-      else
-        line_text = gtk_text_iter_get_text (start, &next);
-    }
 
-  if (match_start) /* if this is the first line we're matching */
-    found = strstr (line_text, *lines);
+      text = line_text;
+      len = strlen (line_text);
+    }
   else
+    text = text_search_get_line_text (search, start, &len);
+
+  /* No more text in buffer, but *lines is nonempty */
+  if (len == 0)
     {
-      /* If it's not the first line, we have to match from the
-       * start of the line.
-       */
-      if (strncmp (line_text, *lines, strlen (*lines)) == 0)
-        found = line_text;
-      else
-        found = NULL;
+      g_free (line_text);
+      return FALSE;
     }
 
+  /* If it's not the first line we're matching, we have to match
+   * from the start of the line.
+   */
+  found = text_search_find (search, text, len, *lines,
+                            match_start == NULL, &match_len);
+
   if (found == NULL)
     {
       g_free (line_text);
       return FALSE;
     }
 
-  /* Get offset to start of search string */
-  offset = g_utf8_strlen (line_text, found - line_text);
-
   next = *start;
 
-  /* If match start needs to be returned, set it to the
-   * start of the search string.
-   */
-  if (match_start)
+  if (!search->visible_only && search->slice)
     {
-      *match_start = next;
+      /* Line text and line indexes are the same bytes */
+      gint index = gtk_text_iter_get_line_index (start);
+
+      if (match_start)
+        {
+          *match_start = next;
+          gtk_text_iter_set_line_index (match_start, index + (found - text));
+        }
 
-      forward_chars_with_skipping (match_start, offset,
-                                   visible_only, !slice);
+      if (found + match_len == text + len)
+        gtk_text_iter_forward_line (&next);
+      else
+        gtk_text_iter_set_line_index (&next, index + (found + match_len - text));
     }
+  else
+    {
+      gint offset;
 
-  /* Go to end of search string */
-  offset += g_utf8_strlen (*lines, -1);
+      /* Get offset to start of search string */
+      offset = g_utf8_strlen (text, found - text);
 
-  forward_chars_with_skipping (&next, offset,
-                               visible_only, !slice);
+      /* If match start needs to be returned, set it to the
+       * start of the search string.
+       */
+      if (match_start)
+        {
+          *match_start = next;
+
+          forward_chars_with_skipping (match_start, offset,
+                                       search->visible_only, !search->slice);
+        }
+
+      /* Go to end of search string */
+      offset += g_utf8_strlen (found, match_len);
+
+      forward_chars_with_skipping (&next, offset,
+                                   search->visible_only, !search->slice);
+    }
 
   g_free (line_text);
 
@@ -4507,63 +4824,47 @@ lines_match (const GtkTextIter *start,
   /* pass NULL for match_start, since we don't need to find the
    * start again.
    */
-  return lines_match (&next, lines, visible_only, slice, NULL, match_end);
+  return lines_match (search, &next, lines, NULL, match_end);
 }
 
-/* strsplit () that retains the delimiter as part of the string. */
-static gchar **
-strbreakup (const char *string,
-            const char *delimiter,
-            gint        max_tokens)
+static gboolean
+text_search_forward (TextSearch        *search,
+                     const GtkTextIter *iter,
+                     const GtkTextIter *limit,
+                     GtkTextIter       *match_start,
+                     GtkTextIter       *match_end)
 {
-  GSList *string_list = NULL, *slist;
-  gchar **str_array, *s;
-  guint i, n = 1;
-
-  g_return_val_if_fail (string != NULL, NULL);
-  g_return_val_if_fail (delimiter != NULL, NULL);
+  GtkTextIter pos;
+  GtkTextIter match;
+  GtkTextIter end;
 
-  if (max_tokens < 1)
-    max_tokens = G_MAXINT;
+  pos = *iter;
 
-  s = strstr (string, delimiter);
-  if (s)
+  do
     {
-      guint delimiter_len = strlen (delimiter);
-
-      do
+      if (limit &&
+          gtk_text_iter_compare (&pos, limit) >= 0)
+        break;
+      
+      if (lines_match (search, &pos, (const gchar**)search->lines,
+                       &match, &end))
         {
-          guint len;
-          gchar *new_string;
-
-          len = s - string + delimiter_len;
-          new_string = g_new (gchar, len + 1);
-          strncpy (new_string, string, len);
-          new_string[len] = 0;
-          string_list = g_slist_prepend (string_list, new_string);
-          n++;
-          string = s + delimiter_len;
-          s = strstr (string, delimiter);
-        }
-      while (--max_tokens && s);
-    }
-  if (*string)
-    {
-      n++;
-      string_list = g_slist_prepend (string_list, g_strdup (string));
-    }
-
-  str_array = g_new (gchar*, n);
+          if (limit &&
+              gtk_text_iter_compare (&end, limit) > 0)
+            return FALSE;
 
-  i = n - 1;
+          if (match_start)
+            *match_start = match;
 
-  str_array[i--] = NULL;
-  for (slist = string_list; slist; slist = slist->next)
-    str_array[i--] = slist->data;
+          if (match_end)
+            *match_end = end;
 
-  g_slist_free (string_list);
+          return TRUE;
+        }
+    }
+  while (gtk_text_iter_forward_line (&pos));
 
-  return str_array;
+  return FALSE;
 }
 
 /**
@@ -4589,6 +4890,8 @@ strbreakup (const char *string,
  * pixbufs or child widgets mixed inside the matched range. If these
  * flags are not given, the match must be exact; the special 0xFFFC
  * character in @str will match embedded pixbufs or child widgets.
+ * If #GTK_TEXT_SEARCH_CASE_INSENSITIVE is given, characters are
+ * compared ignoring case, one character at a time (since 2.22).
  *
  * Return value: whether a match was found
  **/
@@ -4600,12 +4903,9 @@ gtk_text_iter_forward_search (const GtkTextIter *iter,
                               GtkTextIter       *match_end,
                               const GtkTextIter *limit)
 {
-  gchar **lines = NULL;
   GtkTextIter match;
-  gboolean retval = FALSE;
-  GtkTextIter search;
-  gboolean visible_only;
-  gboolean slice;
+  TextSearch search;
+  gboolean retval;
   
   g_return_val_if_fail (iter != NULL, FALSE);
   g_return_val_if_fail (str != NULL, FALSE);
@@ -4635,56 +4935,111 @@ gtk_text_iter_forward_search (const GtkTextIter *iter,
         return FALSE;
     }
 
-  visible_only = (flags & GTK_TEXT_SEARCH_VISIBLE_ONLY) != 0;
-  slice = (flags & GTK_TEXT_SEARCH_TEXT_ONLY) == 0;
-  
-  /* locate all lines */
+  text_search_init (&search, str, flags);
 
-  lines = strbreakup (str, "\n", -1);
+  retval = text_search_forward (&search, iter, limit, match_start, match_end);
 
-  search = *iter;
+  text_search_free (&search);
 
-  do
+  return retval;
+}
+
+/**
+ * gtk_text_iter_forward_search_all:
+ * @iter: start of search
+ * @str: a search string
+ * @flags: flags affecting how the search is done
+ * @limit: (allow-none): bound for the search, or %NULL for the end of the buffer
+ * @n_matches: (out): return location for the number of matches
+ *
+ * Finds all non-overlapping occurrences of @str between @iter and
+ * @limit, in a single pass over the text, as
+ * gtk_text_iter_forward_search() would find them one after the other.
+ * This is useful to highlight all matches of a search.
+ *
+ * The matches are returned as an array of 2 * @n_matches iterators,
+ * holding the start and the end of each match in turn.
+ *
+ * Return value: a newly-allocated array of iterators, free it with
+ *   g_free(), or %NULL if there are no matches or @str is empty
+ *
+ * Since: 2.22
+ **/
+GtkTextIter *
+gtk_text_iter_forward_search_all (const GtkTextIter *iter,
+                                  const gchar       *str,
+                                  GtkTextSearchFlags flags,
+                                  const GtkTextIter *limit,
+                                  guint             *n_matches)
+{
+  GArray *matches;
+  TextSearch search;
+  GtkTextIter match[2];
+  GtkTextIter pos;
+
+  g_return_val_if_fail (iter != NULL, NULL);
+  g_return_val_if_fail (str != NULL, NULL);
+  g_return_val_if_fail (n_matches != NULL, NULL);
+
+  *n_matches = 0;
+
+  if (*str == '\0')
+    return NULL;
+
+  matches = g_array_new (FALSE, FALSE, sizeof (GtkTextIter));
+
+  text_search_init (&search, str, flags);
+
+  pos = *iter;
+  while ((limit == NULL || gtk_text_iter_compare (&pos, limit) < 0) &&
+         text_search_forward (&search, &pos, limit, &match[0], &match[1]))
     {
-      /* This loop has an inefficient worst-case, where
-       * gtk_text_iter_get_text () is called repeatedly on
-       * a single line.
+      /* @str isn't empty, so neither are its matches; an empty match,
+       * or one that doesn't move on, would only be found again.
        */
-      GtkTextIter end;
-
-      if (limit &&
-          gtk_text_iter_compare (&search, limit) >= 0)
+      if (gtk_text_iter_equal (&match[0], &match[1]) ||
+          gtk_text_iter_compare (&match[1], &pos) <= 0)
         break;
-      
-      if (lines_match (&search, (const gchar**)lines,
-                       visible_only, slice, &match, &end))
-        {
-          if (limit == NULL ||
-              (limit &&
-               gtk_text_iter_compare (&end, limit) <= 0))
-            {
-              retval = TRUE;
-              
-              if (match_start)
-                *match_start = match;
-              
-              if (match_end)
-                *match_end = end;
-            }
-          
-          break;
-        }
+
+      g_array_append_vals (matches, match, 2);
+      pos = match[1];
     }
-  while (gtk_text_iter_forward_line (&search));
 
-  g_strfreev ((gchar**)lines);
+  text_search_free (&search);
 
-  return retval;
+  *n_matches = matches->len / 2;
+
+  return (GtkTextIter *) g_array_free (matches, matches->len == 0);
+}
+
+/* Whether @text equals @prefix, or only starts with it if @trailing */
+static gboolean
+line_equal (const gchar *text,
+            const gchar *prefix,
+            gboolean     trailing,
+            gboolean     case_insensitive)
+{
+  gint len = strlen (text);
+
+  if (case_insensitive)
+    {
+      gint n = utf8_caseless_prefix (text, text + len, prefix);
+
+      return n == len || (trailing && n >= 0);
+    }
+  else
+    {
+      gint prefix_len = strlen (prefix);
+
+      return (len == prefix_len || (trailing && len > prefix_len)) &&
+             strncmp (text, prefix, prefix_len) == 0;
+    }
 }
 
 static gboolean
-vectors_equal_ignoring_trailing (gchar **vec1,
-                                 gchar **vec2)
+vectors_equal_ignoring_trailing (gchar  **vec1,
+                                 gchar  **vec2,
+                                 gboolean case_insensitive)
 {
   /* Ignores trailing chars in vec2's last line */
 
@@ -4695,29 +5050,11 @@ vectors_equal_ignoring_trailing (gchar **vec1,
 
   while (*i1 && *i2)
     {
-      if (strcmp (*i1, *i2) != 0)
-        {
-          if (*(i2 + 1) == NULL) /* if this is the last line */
-            {
-              gint len1 = strlen (*i1);
-              gint len2 = strlen (*i2);
-
-              if (len2 >= len1 &&
-                  strncmp (*i1, *i2, len1) == 0)
-                {
-                  /* We matched ignoring the trailing stuff in vec2 */
-                  return TRUE;
-                }
-              else
-                {
-                  return FALSE;
-                }
-            }
-          else
-            {
-              return FALSE;
-            }
-        }
+      gboolean last = *(i2 + 1) == NULL;
+
+      if (!line_equal (*i2, *i1, last, case_insensitive))
+        return FALSE;
+
       ++i1;
       ++i2;
     }
@@ -4730,6 +5067,24 @@ vectors_equal_ignoring_trailing (gchar **vec1,
     return TRUE;
 }
 
+/* Finds the last occurrence of @needle in @text, ignoring case */
+static const gchar *
+utf8_caseless_strrstr (const gchar *text,
+                       const gchar *needle)
+{
+  const gchar *text_end = text + strlen (text);
+  const gchar *p;
+  const gchar *found = NULL;
+
+  for (p = text; p < text_end; p = g_utf8_next_char (p))
+    {
+      if (utf8_caseless_prefix (p, text_end, needle) >= 0)
+        found = p;
+    }
+
+  return found;
+}
+
 typedef struct _LinesWindow LinesWindow;
 
 struct _LinesWindow
@@ -4891,6 +5246,7 @@ gtk_text_iter_backward_search (const GtkTextIter *iter,
   gboolean retval = FALSE;
   gboolean visible_only;
   gboolean slice;
+  gboolean case_insensitive;
   
   g_return_val_if_fail (iter != NULL, FALSE);
   g_return_val_if_fail (str != NULL, FALSE);
@@ -4921,6 +5277,7 @@ gtk_text_iter_backward_search (const GtkTextIter *iter,
 
   visible_only = (flags & GTK_TEXT_SEARCH_VISIBLE_ONLY) != 0;
   slice = (flags & GTK_TEXT_SEARCH_TEXT_ONLY) == 0;
+  case_insensitive = (flags & GTK_TEXT_SEARCH_CASE_INSENSITIVE) != 0;
   
   /* locate all lines */
 
@@ -4945,7 +5302,7 @@ gtk_text_iter_backward_search (const GtkTextIter *iter,
 
   do
     {
-      gchar *first_line_match;
+      const gchar *first_line_match;
 
       if (limit &&
           gtk_text_iter_compare (limit, &win.first_line_end) > 0)
@@ -4958,10 +5315,14 @@ gtk_text_iter_backward_search (const GtkTextIter *iter,
        * end in '\n', so this will only match at the
        * end of the first line, which is correct.
        */
-      first_line_match = g_strrstr (*win.lines, *lines);
+      if (case_insensitive)
+        first_line_match = utf8_caseless_strrstr (*win.lines, *lines);
+      else
+        first_line_match = g_strrstr (*win.lines, *lines);
 
       if (first_line_match &&
-          vectors_equal_ignoring_trailing (lines + 1, win.lines + 1))
+          vectors_equal_ignoring_trailing (lines + 1, win.lines + 1,
+                                           case_insensitive))
         {
           /* Match! */
           gint offset;
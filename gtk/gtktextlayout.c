@@ -91,6 +91,11 @@
 
 #define GTK_TEXT_LAYOUT_GET_PRIVATE(o)  (G_TYPE_INSTANCE_GET_PRIVATE ((o), GTK_TYPE_TEXT_LAYOUT, GtkTextLayoutPrivate))
 
+/* Number of line displays kept around; enough for a screenful of
+ * text plus the lines around it that cursor movement looks at.
+ */
+#define LINE_DISPLAY_CACHE_SIZE 128
+
 typedef struct _GtkTextLayoutPrivate GtkTextLayoutPrivate;
 
 struct _GtkTextLayoutPrivate
@@ -99,6 +104,60 @@ struct _GtkTextLayoutPrivate
      direction only influences the direction of the cursor line.
   */
   GtkTextLine *cursor_line;
+
+  /* Recently used line displays, most recent first, and a map
+   * from each GtkTextLine to its link in the queue.
+   */
+  GQueue      line_display_lru;
+  GHashTable *line_display_cache;
+  guint       line_display_hits;
+  guint       line_display_misses;
+
+  /* Lines measured ahead of validation by worker threads,
+   * see gtk_text_layout_set_shaping_threads().
+   */
+  gint         shaping_threads;
+  GThreadPool *shape_pool;
+  GHashTable  *shaped_lines;   /* GtkTextLine -> ShapeLine */
+  GSList      *shape_batches;
+
+  /* Interned tag sets, and the tag runs of the lines laid out;
+   * the runs of a line are dropped when it is invalidated or tags
+   * are applied to it.
+   */
+  GHashTable  *tag_sets;        /* TagSet -> TagSet */
+  GHashTable  *line_tag_runs;   /* GtkTextLine -> LineTagRuns */
+};
+
+/* A set of tags in priority order. All text carrying the same tags
+ * shares one TagSet, and so one GtkTextAttributes.
+ */
+typedef struct _TagSet TagSet;
+
+struct _TagSet
+{
+  GtkTextAttributes *style;     /* created on first use */
+  guint              n_tags;
+  GtkTextTag        *tags[1];
+};
+
+/* The tags along a line: runs[i].set is in effect from byte
+ * runs[i].byte_index of the line up to the next run.  Byte indexes,
+ * unlike segment indexes, don't change when marks are moved.
+ */
+typedef struct _TagRun TagRun;
+typedef struct _LineTagRuns LineTagRuns;
+
+struct _TagRun
+{
+  guint   byte_index;
+  TagSet *set;
+};
+
+struct _LineTagRuns
+{
+  guint   n_runs;
+  TagRun *runs;
 };
 
 static GtkTextLineData *gtk_text_layout_real_wrap (GtkTextLayout *layout,
@@ -129,6 +188,41 @@ static void gtk_text_layout_emit_changed           (GtkTextLayout     *layout,
 
 static void gtk_text_layout_invalidate_all (GtkTextLayout *layout);
 
+static void line_display_cache_clear (GtkTextLayout *layout);
+static void line_display_cache_invalidate_lines (GtkTextLayout *layout,
+                                                 GtkTextLine   *first_line,
+                                                 GtkTextLine   *last_line,
+                                                 gboolean       cursors_only);
+
+static PangoLayout *create_para_layout (PangoContext      *ltr_context,
+                                        PangoContext      *rtl_context,
+                                        gint               screen_width,
+                                        PangoDirection     base_dir,
+                                        GtkTextAttributes *style,
+                                        GtkTextDirection  *direction);
+static void add_generic_attrs (GtkTextLayout      *layout,
+                               GtkTextAppearance  *appearance,
+                               gint                byte_count,
+                               PangoAttrList      *attrs,
+                               gint                start,
+                               gboolean            size_only,
+                               gboolean            is_text);
+static void add_text_attrs    (GtkTextLayout      *layout,
+                               GtkTextAttributes  *style,
+                               gint                byte_count,
+                               PangoAttrList      *attrs,
+                               gint                start,
+                               gboolean            size_only);
+static gint strip_paragraph_delimiter (const gchar *text,
+                                       gint         len);
+
+static void shape_ahead  (GtkTextLayout *layout);
+static void shape_cancel (GtkTextLayout *layout);
+static void shape_forget_line (GtkTextLayout *layout,
+                               GtkTextLine   *line);
+static void shape_free_batches (GtkTextLayout *layout,
+                                gboolean       all);
+
 static PangoAttribute *gtk_text_attr_appearance_new (const GtkTextAppearance *appearance);
 
 static void gtk_text_layout_mark_set_handler    (GtkTextBuffer     *buffer,
@@ -145,8 +239,29 @@ static void gtk_text_layout_buffer_delete_range (GtkTextBuffer     *textbuffer,
 						 GtkTextIter       *end,
 						 gpointer           data);
 
+static void gtk_text_layout_tag_changed (GtkTextTagTable *table,
+                                         GtkTextTag      *tag,
+                                         gboolean         size_changed,
+                                         gpointer         data);
+static void gtk_text_layout_tag_removed (GtkTextTagTable *table,
+                                         GtkTextTag      *tag,
+                                         gpointer         data);
+
 static void gtk_text_layout_update_cursor_line (GtkTextLayout *layout);
 
+static guint    tag_set_hash          (gconstpointer  key);
+static gboolean tag_set_equal         (gconstpointer  a,
+                                       gconstpointer  b);
+static void     tag_set_free          (gpointer       data);
+static void     line_tag_runs_free    (gpointer       data);
+static void     tag_sets_clear        (GtkTextLayout *layout,
+                                       gboolean       styles_only);
+static LineTagRuns *get_line_tag_runs (GtkTextLayout *layout,
+                                       GtkTextLine   *line);
+static GPtrArray *get_tags_array_at_iter (GtkTextIter *iter);
+static GPtrArray *tags_array_toggle_tag  (GPtrArray   *array,
+                                          GtkTextTag  *tag);
+
 static void line_display_index_to_iter (GtkTextLayout      *layout,
 	                                GtkTextLineDisplay *display,
 			                GtkTextIter        *iter,
@@ -233,7 +348,20 @@ gtk_text_layout_class_init (GtkTextLayoutClass *klass)
 static void
 gtk_text_layout_init (GtkTextLayout *text_layout)
 {
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (text_layout);
+
   text_layout->cursor_visible = TRUE;
+
+  g_queue_init (&priv->line_display_lru);
+  priv->line_display_cache = g_hash_table_new (NULL, NULL);
+
+  priv->shaping_threads = 1;
+  priv->shaped_lines = g_hash_table_new (NULL, NULL);
+
+  priv->tag_sets = g_hash_table_new_full (tag_set_hash, tag_set_equal,
+                                          tag_set_free, NULL);
+  priv->line_tag_runs = g_hash_table_new_full (NULL, NULL,
+                                               NULL, line_tag_runs_free);
 }
 
 GtkTextLayout*
@@ -256,8 +384,10 @@ static void
 gtk_text_layout_finalize (GObject *object)
 {
   GtkTextLayout *layout;
+  GtkTextLayoutPrivate *priv;
 
   layout = GTK_TEXT_LAYOUT (object);
+  priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
 
   gtk_text_layout_set_buffer (layout, NULL);
 
@@ -276,12 +406,17 @@ gtk_text_layout_finalize (GObject *object)
       layout->rtl_context = NULL;
     }
   
-  if (layout->one_display_cache) 
-    {
-      GtkTextLineDisplay *tmp_display = layout->one_display_cache;
-      layout->one_display_cache = NULL;
-      gtk_text_layout_free_line_display (layout, tmp_display);
-    }
+  line_display_cache_clear (layout);
+  g_hash_table_destroy (priv->line_display_cache);
+
+  shape_cancel (layout);
+  if (priv->shape_pool)
+    g_thread_pool_free (priv->shape_pool, FALSE, TRUE);
+  shape_free_batches (layout, TRUE);
+  g_hash_table_destroy (priv->shaped_lines);
+
+  g_hash_table_destroy (priv->line_tag_runs);
+  g_hash_table_destroy (priv->tag_sets);
 
   if (layout->preedit_string)
     {
@@ -317,6 +452,10 @@ gtk_text_layout_set_buffer (GtkTextLayout *layout,
 
   if (layout->buffer)
     {
+      /* the cached displays point to lines of the old buffer */
+      line_display_cache_clear (layout);
+      shape_cancel (layout);
+
       _gtk_text_btree_remove_view (_gtk_text_buffer_get_btree (layout->buffer),
                                   layout);
 
@@ -329,6 +468,15 @@ gtk_text_layout_set_buffer (GtkTextLayout *layout,
       g_signal_handlers_disconnect_by_func (layout->buffer, 
                                             G_CALLBACK (gtk_text_layout_buffer_delete_range), 
                                             layout);
+      g_signal_handlers_disconnect_by_func (gtk_text_buffer_get_tag_table (layout->buffer),
+                                            G_CALLBACK (gtk_text_layout_tag_changed),
+                                            layout);
+      g_signal_handlers_disconnect_by_func (gtk_text_buffer_get_tag_table (layout->buffer),
+                                            G_CALLBACK (gtk_text_layout_tag_removed),
+                                            layout);
+
+      /* the tag sets hold tags of the old buffer */
+      tag_sets_clear (layout, FALSE);
 
       g_object_unref (layout->buffer);
       layout->buffer = NULL;
@@ -350,6 +498,12 @@ gtk_text_layout_set_buffer (GtkTextLayout *layout,
       g_signal_connect_after (layout->buffer, "delete-range",
                               G_CALLBACK (gtk_text_layout_buffer_delete_range), layout);
 
+      /* Styles of tag sets depend on the tags' values */
+      g_signal_connect (gtk_text_buffer_get_tag_table (layout->buffer), "tag-changed",
+                        G_CALLBACK (gtk_text_layout_tag_changed), layout);
+      g_signal_connect (gtk_text_buffer_get_tag_table (layout->buffer), "tag-removed",
+                        G_CALLBACK (gtk_text_layout_tag_removed), layout);
+
       gtk_text_layout_update_cursor_line (layout);
     }
 }
@@ -360,6 +514,7 @@ gtk_text_layout_default_style_changed (GtkTextLayout *layout)
   g_return_if_fail (GTK_IS_TEXT_LAYOUT (layout));
 
   DV (g_print ("invalidating all due to default style change (%s)\n", G_STRLOC));
+  tag_sets_clear (layout, TRUE);
   gtk_text_layout_invalidate_all (layout);
 }
 
@@ -639,18 +794,25 @@ text_layout_changed (GtkTextLayout *layout,
                      gint           new_height,
                      gboolean       cursors_only)
 {
-  /* Check if the range intersects our cached line display,
-   * and invalidate the cached line if so.
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+  GtkTextBTree *btree = _gtk_text_buffer_get_btree (layout->buffer);
+  GtkTextLine *first_line, *last_line;
+
+  /* Check if the range intersects our cached line displays,
+   * and invalidate the cached lines if so.  The range is turned
+   * into lines once, instead of looking up the position of each
+   * cached line.
    */
-  if (layout->one_display_cache)
+  if (old_height > 0 && priv->line_display_lru.length > 0)
     {
-      GtkTextLine *line = layout->one_display_cache->line;
-      gint cache_y = _gtk_text_btree_find_line_top (_gtk_text_buffer_get_btree (layout->buffer),
-						    line, layout);
-      gint cache_height = layout->one_display_cache->height;
-
-      if (cache_y + cache_height > y && cache_y < y + old_height)
-	gtk_text_layout_invalidate_cache (layout, line, cursors_only);
+      first_line = _gtk_text_btree_find_line_by_y (btree, layout, y, NULL);
+      last_line = _gtk_text_btree_find_line_by_y (btree, layout, y + old_height - 1, NULL);
+      if (last_line == NULL)
+        last_line = _gtk_text_btree_get_end_iter_line (btree);
+
+      if (first_line != NULL)
+        line_display_cache_invalidate_lines (layout, first_line, last_line,
+                                             cursors_only);
     }
 
   gtk_text_layout_emit_changed (layout, y, old_height, new_height);
@@ -698,6 +860,48 @@ gtk_text_layout_invalidate_cursors (GtkTextLayout *layout,
   GTK_TEXT_LAYOUT_GET_CLASS (layout)->invalidate_cursors (layout, start_index, end_index);
 }
 
+/* Invalidates a set of lines in any order, emitting ::invalidated only
+ * once. The btree uses this to flush the lines changed while the buffer
+ * was frozen, see gtk_text_buffer_freeze_changes(). @lines must have
+ * been passed to _gtk_text_layout_invalidate_frozen() when they changed.
+ */
+void
+gtk_text_layout_invalidate_lines (GtkTextLayout  *layout,
+                                  GtkTextLine   **lines,
+                                  guint           n_lines)
+{
+  GtkTextLayoutClass *klass;
+  guint i;
+
+  g_return_if_fail (GTK_IS_TEXT_LAYOUT (layout));
+
+  if (n_lines == 0)
+    return;
+
+  klass = GTK_TEXT_LAYOUT_GET_CLASS (layout);
+
+  /* Subclasses that override invalidate get to see each line */
+  if (klass->invalidate != gtk_text_layout_real_invalidate)
+    {
+      GtkTextBTree *btree = _gtk_text_buffer_get_btree (layout->buffer);
+
+      for (i = 0; i < n_lines; i++)
+        {
+          GtkTextIter iter;
+
+          _gtk_text_btree_get_iter_at_line (btree, &iter, lines[i], 0);
+          klass->invalidate (layout, &iter, &iter);
+        }
+
+      return;
+    }
+
+  /* The caches of the lines were already dropped by
+   * _gtk_text_layout_invalidate_frozen() as they changed
+   */
+  gtk_text_layout_invalidated (layout);
+}
+
 GtkTextLineData*
 gtk_text_layout_wrap (GtkTextLayout *layout,
                       GtkTextLine  *line,
@@ -812,19 +1016,113 @@ gtk_text_layout_invalidate_all (GtkTextLayout *layout)
   if (layout->buffer == NULL)
     return;
 
+  /* Every line is measured differently now */
+  shape_cancel (layout);
+
   gtk_text_buffer_get_bounds (layout->buffer, &start, &end);
 
   gtk_text_layout_invalidate (layout, &start, &end);
 }
 
+/* The line display cache. Displays are looked up by line and kept in
+ * most recently used order; layout->one_display_cache always points to
+ * the most recently used one.
+ */
+static void
+line_display_cache_remove (GtkTextLayout *layout,
+			   GList         *link)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+  GtkTextLineDisplay *display = link->data;
+
+  g_hash_table_remove (priv->line_display_cache, display->line);
+  g_queue_delete_link (&priv->line_display_lru, link);
+  layout->one_display_cache = g_queue_peek_head (&priv->line_display_lru);
+
+  /* not cached anymore, so this really frees it */
+  gtk_text_layout_free_line_display (layout, display);
+}
+
+static void
+line_display_cache_insert (GtkTextLayout      *layout,
+			   GtkTextLineDisplay *display)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+
+  g_queue_push_head (&priv->line_display_lru, display);
+  g_hash_table_insert (priv->line_display_cache, display->line,
+		       priv->line_display_lru.head);
+  layout->one_display_cache = display;
+
+  if (priv->line_display_lru.length > LINE_DISPLAY_CACHE_SIZE)
+    line_display_cache_remove (layout, priv->line_display_lru.tail);
+}
+
+static GtkTextLineDisplay *
+line_display_cache_lookup (GtkTextLayout *layout,
+			   GtkTextLine   *line,
+			   gboolean       size_only)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+  GtkTextLineDisplay *display;
+  GList *link;
+
+  link = g_hash_table_lookup (priv->line_display_cache, line);
+  if (link == NULL)
+    return NULL;
+
+  display = link->data;
+
+  /* a size-only display lacks the cursors and can't be drawn */
+  if (!size_only && display->size_only)
+    {
+      line_display_cache_remove (layout, link);
+      return NULL;
+    }
+
+  if (link != priv->line_display_lru.head)
+    {
+      g_queue_unlink (&priv->line_display_lru, link);
+      g_queue_push_head_link (&priv->line_display_lru, link);
+      layout->one_display_cache = display;
+    }
+
+  return display;
+}
+
+static gboolean
+line_display_is_cached (GtkTextLayout      *layout,
+			GtkTextLineDisplay *display)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+  GList *link;
+
+  link = g_hash_table_lookup (priv->line_display_cache, display->line);
+
+  return link != NULL && link->data == display;
+}
+
+static void
+line_display_cache_clear (GtkTextLayout *layout)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+
+  while (priv->line_display_lru.head)
+    line_display_cache_remove (layout, priv->line_display_lru.head);
+}
+
 static void
 gtk_text_layout_invalidate_cache (GtkTextLayout *layout,
                                   GtkTextLine   *line,
 				  gboolean       cursors_only)
 {
-  if (layout->one_display_cache && line == layout->one_display_cache->line)
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+  GList *link;
+
+  link = g_hash_table_lookup (priv->line_display_cache, line);
+  if (link)
     {
-      GtkTextLineDisplay *display = layout->one_display_cache;
+      GtkTextLineDisplay *display = link->data;
 
       if (cursors_only)
 	{
@@ -835,10 +1133,50 @@ gtk_text_layout_invalidate_cache (GtkTextLayout *layout,
 	  display->has_block_cursor = FALSE;
 	}
       else
-	{
-	  layout->one_display_cache = NULL;
-	  gtk_text_layout_free_line_display (layout, display);
-	}
+	line_display_cache_remove (layout, link);
+    }
+}
+
+/* Invalidates the cached displays of the lines from @first_line to
+ * @last_line.  Short ranges are walked line by line; once more lines
+ * than there are cached displays have been looked at, the rest of the
+ * range is matched against the cached lines by line number instead.
+ */
+static void
+line_display_cache_invalidate_lines (GtkTextLayout *layout,
+                                     GtkTextLine   *first_line,
+                                     GtkTextLine   *last_line,
+                                     gboolean       cursors_only)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+  GtkTextLine *line;
+  guint n_lines = 0;
+
+  for (line = first_line; line != NULL; line = _gtk_text_line_next_excluding_last (line))
+    {
+      gtk_text_layout_invalidate_cache (layout, line, cursors_only);
+
+      if (line == last_line)
+        break;
+
+      if (++n_lines >= priv->line_display_lru.length)
+        {
+          gint first = _gtk_text_line_get_number (line);
+          gint last = _gtk_text_line_get_number (last_line);
+          GList *l, *next;
+
+          for (l = priv->line_display_lru.head; l != NULL; l = next)
+            {
+              GtkTextLineDisplay *display = l->data;
+              gint number = _gtk_text_line_get_number (display->line);
+
+              next = l->next;
+
+              if (number > first && number <= last)
+                gtk_text_layout_invalidate_cache (layout, display->line, cursors_only);
+            }
+          break;
+        }
     }
 }
 
@@ -873,22 +1211,63 @@ static void
 gtk_text_layout_update_cursor_line(GtkTextLayout *layout)
 {
   GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+  GtkTextLine *old_line = priv->cursor_line;
   GtkTextIter iter;
 
   gtk_text_buffer_get_iter_at_mark (layout->buffer, &iter,
                                     gtk_text_buffer_get_insert (layout->buffer));
 
   priv->cursor_line = _gtk_text_iter_get_text_line (&iter);
+
+  /* The base direction of the cursor line may come from the keyboard,
+   * so cached displays of the old and new cursor lines are stale.
+   */
+  if (priv->cursor_line != old_line)
+    {
+      if (old_line)
+        gtk_text_layout_invalidate_cache (layout, old_line, FALSE);
+      gtk_text_layout_invalidate_cache (layout, priv->cursor_line, FALSE);
+    }
 }
 
+/* Drops what is cached about the lines from @start to @end, without
+ * telling anyone that the layout needs to be validated again.
+ */
 static void
-gtk_text_layout_real_invalidate (GtkTextLayout *layout,
-                                 const GtkTextIter *start,
-                                 const GtkTextIter *end)
+gtk_text_layout_invalidate_line_caches (GtkTextLayout     *layout,
+                                        const GtkTextIter *start,
+                                        const GtkTextIter *end)
 {
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
   GtkTextLine *line;
   GtkTextLine *last_line;
 
+  last_line = _gtk_text_iter_get_text_line (end);
+  line = _gtk_text_iter_get_text_line (start);
+
+  while (TRUE)
+    {
+      GtkTextLineData *line_data = _gtk_text_line_get_data (line, layout);
+
+      gtk_text_layout_invalidate_cache (layout, line, FALSE);
+      shape_forget_line (layout, line);
+      g_hash_table_remove (priv->line_tag_runs, line);
+      
+      if (line_data)
+        _gtk_text_line_invalidate_wrap (line, line_data);
+
+      if (line == last_line)
+        break;
+
+      line = _gtk_text_line_next_excluding_last (line);
+    }
+}
+
+static void
+gtk_text_layout_real_invalidate (GtkTextLayout *layout,
+                                 const GtkTextIter *start,
+                                 const GtkTextIter *end)
+{
   g_return_if_fail (GTK_IS_TEXT_LAYOUT (layout));
   g_return_if_fail (layout->wrap_loop_count == 0);
 
@@ -904,25 +1283,62 @@ gtk_text_layout_real_invalidate (GtkTextLayout *layout,
   gtk_text_view_index_spew (end_index, "invalidate end");
 #endif
 
+  gtk_text_layout_invalidate_line_caches (layout, start, end);
+
+  gtk_text_layout_invalidated (layout);
+}
+
+/* Used by the btree instead of gtk_text_layout_invalidate() while the
+ * buffer is frozen. Cached displays and sizes are dropped right away,
+ * so queries made during the freeze see the new text; only the
+ * ::invalidated emission waits for gtk_text_layout_invalidate_lines().
+ */
+void
+_gtk_text_layout_invalidate_frozen (GtkTextLayout     *layout,
+                                    const GtkTextIter *start,
+                                    const GtkTextIter *end)
+{
+  g_return_if_fail (GTK_IS_TEXT_LAYOUT (layout));
+  g_return_if_fail (layout->wrap_loop_count == 0);
+
+  /* Subclasses that override invalidate see the lines at thaw */
+  if (GTK_TEXT_LAYOUT_GET_CLASS (layout)->invalidate != gtk_text_layout_real_invalidate)
+    return;
+
+  gtk_text_layout_invalidate_line_caches (layout, start, end);
+}
+
+/* Called by the btree when a tag is applied to or removed from the
+ * range from @start to @end, before the toggles change.  The tags at
+ * the start of the lines in the range change, so their tag runs have
+ * to be computed again; the btree takes care of redrawing them.
+ */
+void
+_gtk_text_layout_tags_changed (GtkTextLayout     *layout,
+                               const GtkTextIter *start,
+                               const GtkTextIter *end)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+  GtkTextLine *line;
+  GtkTextLine *last_line;
+
+  g_return_if_fail (GTK_IS_TEXT_LAYOUT (layout));
+
+  if (g_hash_table_size (priv->line_tag_runs) == 0)
+    return;
+
   last_line = _gtk_text_iter_get_text_line (end);
   line = _gtk_text_iter_get_text_line (start);
 
   while (TRUE)
     {
-      GtkTextLineData *line_data = _gtk_text_line_get_data (line, layout);
-
-      gtk_text_layout_invalidate_cache (layout, line, FALSE);
-      
-      if (line_data)
-        _gtk_text_line_invalidate_wrap (line, line_data);
+      g_hash_table_remove (priv->line_tag_runs, line);
 
       if (line == last_line)
         break;
 
       line = _gtk_text_line_next_excluding_last (line);
     }
-
-  gtk_text_layout_invalidated (layout);
 }
 
 static void
@@ -930,34 +1346,22 @@ gtk_text_layout_real_invalidate_cursors (GtkTextLayout     *layout,
 					 const GtkTextIter *start,
 					 const GtkTextIter *end)
 {
-  /* Check if the range intersects our cached line display,
-   * and invalidate the cached line if so.
-   */
-  if (layout->one_display_cache)
-    {
-      GtkTextIter line_start, line_end;
-      GtkTextLine *line = layout->one_display_cache->line;
-
-      _gtk_text_btree_get_iter_at_line (_gtk_text_buffer_get_btree (layout->buffer),
-                                        &line_start, line, 0);
-      line_end = line_start;
-      if (!gtk_text_iter_ends_line (&line_end))
-	gtk_text_iter_forward_to_line_end (&line_end);
-
-      if (gtk_text_iter_compare (start, end) > 0)
-	{
-	  const GtkTextIter *tmp = start;
-	  start = end;
-	  end = tmp;
-	}
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
 
-      if (gtk_text_iter_compare (&line_start, end) <= 0 &&
-	  gtk_text_iter_compare (start, &line_end) <= 0)
-	{
-	  gtk_text_layout_invalidate_cache (layout, line, TRUE);
-	}
+  if (gtk_text_iter_compare (start, end) > 0)
+    {
+      const GtkTextIter *tmp = start;
+      start = end;
+      end = tmp;
     }
 
+  /* Invalidate the cursors of the cached lines in the range */
+  if (priv->line_display_lru.length > 0)
+    line_display_cache_invalidate_lines (layout,
+                                         _gtk_text_iter_get_text_line (start),
+                                         _gtk_text_iter_get_text_line (end),
+                                         TRUE);
+
   gtk_text_layout_invalidated (layout);
 }
 
@@ -966,7 +1370,11 @@ gtk_text_layout_real_free_line_data (GtkTextLayout     *layout,
                                      GtkTextLine       *line,
                                      GtkTextLineData   *line_data)
 {
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+
   gtk_text_layout_invalidate_cache (layout, line, FALSE);
+  shape_forget_line (layout, line);
+  g_hash_table_remove (priv->line_tag_runs, line);
 
   g_free (line_data);
 }
@@ -1088,63 +1496,570 @@ gtk_text_layout_validate_yrange (GtkTextLayout *layout,
           
           if (!first_line)
             {
-              first_line = line;
-              first_line_y = seen;
+              first_line = line;
+              first_line_y = seen;
+            }
+          last_line = line;
+          last_line_y = seen + new_height;
+        }
+
+      seen += line_data ? line_data->height : 0;
+      line = _gtk_text_line_next_excluding_last (line);
+    }
+
+  /* If we found and validated any invalid lines, update size and
+   * emit the changed signal
+   */
+  if (first_line)
+    {
+      gint line_top;
+
+      update_layout_size (layout);
+
+      line_top = _gtk_text_btree_find_line_top (_gtk_text_buffer_get_btree (layout->buffer),
+                                                first_line, layout);
+
+      gtk_text_layout_emit_changed (layout,
+				    line_top,
+				    last_line_y - first_line_y - delta_height,
+				    last_line_y - first_line_y);
+    }
+}
+
+/**
+ * gtk_text_layout_validate:
+ * @tree: a #GtkTextLayout
+ * @max_pixels: the maximum number of pixels to validate. (No more
+ *              than one paragraph beyond this limit will be validated)
+ *
+ * Validate regions of a #GtkTextLayout. The ::changed signal will
+ * be emitted for each region validated.
+ **/
+void
+gtk_text_layout_validate (GtkTextLayout *layout,
+                          gint           max_pixels)
+{
+  gint y, old_height, new_height;
+
+  g_return_if_fail (GTK_IS_TEXT_LAYOUT (layout));
+
+  shape_ahead (layout);
+
+  while (max_pixels > 0 &&
+         _gtk_text_btree_validate (_gtk_text_buffer_get_btree (layout->buffer),
+                                   layout,  max_pixels,
+                                   &y, &old_height, &new_height))
+    {
+      max_pixels -= new_height;
+
+      update_layout_size (layout);
+      gtk_text_layout_emit_changed (layout, y, old_height, new_height);
+    }
+}
+
+/*
+ * Background shaping
+ *
+ * When enabled with gtk_text_layout_set_shaping_threads(), the lines
+ * following the first invalid line are measured by a pool of worker
+ * threads while the main thread validates.  Only lines whose layout
+ * depends on nothing but their text and the default style are handed
+ * out: no tags, no pixbufs or child widgets, and not the cursor line.
+ * The workers get a copy of the text and of the default style and use
+ * their own Pango contexts, so they never look at the buffer.
+ *
+ * gtk_text_layout_real_wrap() then takes the measured size instead of
+ * shaping the line, and the btree merges it like any other line data.
+ * Invalidating a line only drops the result for that line, which the
+ * workers skip if they haven't got to it yet; changes that affect all
+ * lines, like a new default style, cancel all batches.
+ */
+
+#define SHAPE_BATCH_LINES 128
+
+typedef struct _ShapeBatch ShapeBatch;
+typedef struct _ShapeLine  ShapeLine;
+
+enum {
+  SHAPE_PENDING,
+  SHAPE_RUNNING,
+  SHAPE_DONE,
+  SHAPE_SKIPPED
+};
+
+struct _ShapeLine
+{
+  ShapeBatch    *batch;
+  GtkTextLine   *line;          /* only used on the main thread */
+  gchar         *text;
+  gint           n_bytes;
+  PangoDirection base_dir;
+
+  volatile gint  state;
+  gint           width;
+  gint           height;
+};
+
+struct _ShapeBatch
+{
+  volatile gint cancelled;
+  volatile gint finished;
+
+  /* What the lines are measured with */
+  GtkTextAttributes    *style;
+  gint                  screen_width;
+  PangoFontDescription *font_desc;
+  PangoLanguage        *language;
+  cairo_font_options_t *font_options;
+  gdouble               resolution;
+
+  GMutex *mutex;
+  GCond  *cond;
+
+  ShapeLine lines[SHAPE_BATCH_LINES];
+  guint     n_lines;
+  guint     n_consumed;
+};
+
+static ShapeBatch *
+shape_batch_new (GtkTextLayout *layout)
+{
+  ShapeBatch *batch;
+  const cairo_font_options_t *options;
+
+  batch = g_slice_new0 (ShapeBatch);
+
+  batch->style = gtk_text_attributes_copy (layout->default_style);
+  batch->screen_width = layout->screen_width;
+  batch->font_desc = pango_font_description_copy (pango_context_get_font_description (layout->ltr_context));
+  batch->language = pango_context_get_language (layout->ltr_context);
+  options = pango_cairo_context_get_font_options (layout->ltr_context);
+  if (options)
+    batch->font_options = cairo_font_options_copy (options);
+  batch->resolution = pango_cairo_context_get_resolution (layout->ltr_context);
+
+  batch->mutex = g_mutex_new ();
+  batch->cond = g_cond_new ();
+
+  return batch;
+}
+
+/* Must be called on the main thread, once the worker is done */
+static void
+shape_batch_free (ShapeBatch *batch)
+{
+  guint i;
+
+  for (i = 0; i < batch->n_lines; i++)
+    g_free (batch->lines[i].text);
+
+  gtk_text_attributes_unref (batch->style);
+  pango_font_description_free (batch->font_desc);
+  if (batch->font_options)
+    cairo_font_options_destroy (batch->font_options);
+
+  g_mutex_free (batch->mutex);
+  g_cond_free (batch->cond);
+
+  g_slice_free (ShapeBatch, batch);
+}
+
+static PangoContext *
+shape_context_new (ShapeBatch     *batch,
+                   PangoDirection  base_dir)
+{
+  /* Font maps aren't thread-safe, so each worker has its own */
+  static GStaticPrivate font_map_key = G_STATIC_PRIVATE_INIT;
+  PangoFontMap *font_map;
+  PangoContext *context;
+
+  font_map = g_static_private_get (&font_map_key);
+  if (font_map == NULL)
+    {
+      font_map = pango_cairo_font_map_new ();
+      g_static_private_set (&font_map_key, font_map, g_object_unref);
+    }
+
+  context = pango_cairo_font_map_create_context (PANGO_CAIRO_FONT_MAP (font_map));
+  pango_cairo_context_set_resolution (context, batch->resolution);
+  if (batch->font_options)
+    pango_cairo_context_set_font_options (context, batch->font_options);
+  pango_context_set_language (context, batch->language);
+  pango_context_set_font_description (context, batch->font_desc);
+  pango_context_set_base_dir (context, base_dir);
+
+  return context;
+}
+
+/* Does for @sl what gtk_text_layout_get_line_display() does for
+ * a line without tags, pixbufs or children, in size-only mode.
+ */
+static void
+shape_line_measure (ShapeBatch   *batch,
+                    ShapeLine    *sl,
+                    PangoContext *contexts[2])
+{
+  GtkTextAttributes *style = batch->style;
+  GtkTextDirection direction;
+  PangoLayout *layout;
+  PangoAttrList *attrs;
+  PangoRectangle extents;
+
+  if (contexts[0] == NULL)
+    {
+      contexts[0] = shape_context_new (batch, PANGO_DIRECTION_LTR);
+      contexts[1] = shape_context_new (batch, PANGO_DIRECTION_RTL);
+    }
+
+  layout = create_para_layout (contexts[0], contexts[1],
+                               batch->screen_width,
+                               sl->base_dir, style, &direction);
+
+  attrs = pango_attr_list_new ();
+  add_generic_attrs (NULL, &style->appearance, sl->n_bytes,
+                     attrs, 0, TRUE, TRUE);
+  add_text_attrs (NULL, style, sl->n_bytes, attrs, 0, TRUE);
+
+  pango_layout_set_text (layout, sl->text,
+                         strip_paragraph_delimiter (sl->text, sl->n_bytes));
+  pango_layout_set_attributes (layout, attrs);
+  pango_layout_get_extents (layout, NULL, &extents);
+
+  sl->width = PIXEL_BOUND (extents.width) + style->left_margin + style->right_margin;
+  sl->height = style->pixels_above_lines + style->pixels_below_lines +
+               PANGO_PIXELS (extents.height);
+
+  pango_attr_list_unref (attrs);
+  g_object_unref (layout);
+}
+
+static void
+shape_batch_worker (gpointer data,
+                    gpointer user_data)
+{
+  ShapeBatch *batch = data;
+  PangoContext *contexts[2] = { NULL, NULL };
+  guint i;
+
+  for (i = 0; i < batch->n_lines; i++)
+    {
+      ShapeLine *sl = &batch->lines[i];
+
+      if (g_atomic_int_get (&batch->cancelled))
+        break;
+
+      /* the main thread may have got there first */
+      if (!g_atomic_int_compare_and_exchange (&sl->state, SHAPE_PENDING, SHAPE_RUNNING))
+        continue;
+
+      shape_line_measure (batch, sl, contexts);
+
+      g_mutex_lock (batch->mutex);
+      g_atomic_int_set (&sl->state, SHAPE_DONE);
+      g_cond_broadcast (batch->cond);
+      g_mutex_unlock (batch->mutex);
+    }
+
+  if (contexts[0])
+    {
+      g_object_unref (contexts[0]);
+      g_object_unref (contexts[1]);
+    }
+
+  g_atomic_int_set (&batch->finished, TRUE);
+}
+
+/* Frees the batches the workers are done with and that are either
+ * cancelled or used up; or all of them, when the pool is gone.
+ */
+static void
+shape_free_batches (GtkTextLayout *layout,
+                    gboolean       all)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+  GSList *l, *next;
+
+  for (l = priv->shape_batches; l != NULL; l = next)
+    {
+      ShapeBatch *batch = l->data;
+
+      next = l->next;
+
+      if (all ||
+          (g_atomic_int_get (&batch->finished) &&
+           (batch->cancelled || batch->n_consumed == batch->n_lines)))
+        {
+          priv->shape_batches = g_slist_delete_link (priv->shape_batches, l);
+          shape_batch_free (batch);
+        }
+    }
+}
+
+static void
+shape_cancel (GtkTextLayout *layout)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+  GSList *l;
+
+  if (priv->shape_batches == NULL)
+    return;
+
+  for (l = priv->shape_batches; l != NULL; l = l->next)
+    {
+      ShapeBatch *batch = l->data;
+
+      g_atomic_int_set (&batch->cancelled, TRUE);
+    }
+
+  g_hash_table_remove_all (priv->shaped_lines);
+  shape_free_batches (layout, FALSE);
+}
+
+/* Drops the pending result for @line, if any; the worker skips the
+ * line unless it is already measuring it.
+ */
+static void
+shape_forget_line (GtkTextLayout *layout,
+                   GtkTextLine   *line)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+  ShapeLine *sl;
+
+  if (g_hash_table_size (priv->shaped_lines) == 0)
+    return;
+
+  sl = g_hash_table_lookup (priv->shaped_lines, line);
+  if (sl == NULL)
+    return;
+
+  g_hash_table_remove (priv->shaped_lines, line);
+  sl->batch->n_consumed++;
+
+  g_atomic_int_compare_and_exchange (&sl->state, SHAPE_PENDING, SHAPE_SKIPPED);
+}
+
+/* Copies what the workers need to measure @line into @sl, if the line
+ * is simple enough for them.
+ */
+static gboolean
+shape_line_snapshot (GtkTextLayout *layout,
+                     GtkTextLine   *line,
+                     ShapeLine     *sl)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+  GtkTextLineSegment *seg;
+  LineTagRuns *runs;
+  gint n_bytes = 0;
+  gchar *p;
+
+  if (line == priv->cursor_line)
+    return FALSE;
+
+  for (seg = line->segments; seg != NULL; seg = seg->next)
+    {
+      if (seg->type == &gtk_text_char_type)
+        n_bytes += seg->byte_count;
+      else if (seg->type != &gtk_text_right_mark_type &&
+               seg->type != &gtk_text_left_mark_type)
+        return FALSE;
+    }
+
+  /* No toggles in the line, so this is the only run */
+  runs = get_line_tag_runs (layout, line);
+  if (runs->runs[0].set->n_tags > 0)
+    return FALSE;
+
+  sl->line = line;
+  sl->n_bytes = n_bytes;
+  sl->text = p = g_malloc (n_bytes);
+  for (seg = line->segments; seg != NULL; seg = seg->next)
+    {
+      if (seg->type == &gtk_text_char_type)
+        {
+          memcpy (p, seg->body.chars, seg->byte_count);
+          p += seg->byte_count;
+        }
+    }
+
+  sl->base_dir = line->dir_propagated_forward;
+  if (sl->base_dir == PANGO_DIRECTION_NEUTRAL)
+    sl->base_dir = line->dir_propagated_back;
+
+  sl->state = SHAPE_PENDING;
+
+  return TRUE;
+}
+
+/* Hands the next invalid lines out to the workers */
+static void
+shape_ahead (GtkTextLayout *layout)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+  GtkTextBTree *btree;
+  GtkTextLine *line;
+  gint n_batches = 0;
+  gint n_scanned = 0;
+
+  if (priv->shaping_threads <= 1 ||
+      layout->buffer == NULL ||
+      layout->ltr_context == NULL ||
+      layout->default_style == NULL ||
+      layout->default_style->invisible)
+    return;
+
+  shape_free_batches (layout, FALSE);
+
+  /* still enough work queued */
+  if (g_hash_table_size (priv->shaped_lines) >= priv->shaping_threads * SHAPE_BATCH_LINES / 2)
+    return;
+
+  if (priv->shape_pool == NULL)
+    {
+      priv->shape_pool = g_thread_pool_new (shape_batch_worker, NULL,
+                                            priv->shaping_threads,
+                                            FALSE, NULL);
+      if (priv->shape_pool == NULL)
+        return;
+    }
+
+  btree = _gtk_text_buffer_get_btree (layout->buffer);
+  line = _gtk_text_btree_find_first_invalid_line (btree, layout);
+
+  while (line != NULL && n_batches < priv->shaping_threads &&
+         n_scanned < 4 * priv->shaping_threads * SHAPE_BATCH_LINES)
+    {
+      ShapeBatch *batch = shape_batch_new (layout);
+
+      while (line != NULL && batch->n_lines < SHAPE_BATCH_LINES &&
+             n_scanned < 4 * priv->shaping_threads * SHAPE_BATCH_LINES)
+        {
+          GtkTextLineData *line_data = _gtk_text_line_get_data (line, layout);
+          ShapeLine *sl = &batch->lines[batch->n_lines];
+
+          if ((line_data == NULL || !line_data->valid) &&
+              !_gtk_text_line_is_last (line, btree) &&
+              g_hash_table_lookup (priv->shaped_lines, line) == NULL &&
+              shape_line_snapshot (layout, line, sl))
+            {
+              sl->batch = batch;
+              g_hash_table_insert (priv->shaped_lines, line, sl);
+              batch->n_lines++;
             }
-          last_line = line;
-          last_line_y = seen + new_height;
+
+          n_scanned++;
+          line = _gtk_text_line_next_excluding_last (line);
         }
 
-      seen += line_data ? line_data->height : 0;
-      line = _gtk_text_line_next_excluding_last (line);
+      if (batch->n_lines == 0)
+        {
+          shape_batch_free (batch);
+          break;
+        }
+
+      priv->shape_batches = g_slist_prepend (priv->shape_batches, batch);
+      g_thread_pool_push (priv->shape_pool, batch, NULL);
+      n_batches++;
     }
+}
 
-  /* If we found and validated any invalid lines, update size and
-   * emit the changed signal
-   */
-  if (first_line)
-    {
-      gint line_top;
+/* Takes the size of @line measured by a worker, waiting for it if the
+ * worker is busy with it.  Returns %FALSE if the line must be measured
+ * by the caller.
+ */
+static gboolean
+shape_take_result (GtkTextLayout *layout,
+                   GtkTextLine   *line,
+                   gint          *width,
+                   gint          *height)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+  ShapeLine *sl;
+  ShapeBatch *batch;
 
-      update_layout_size (layout);
+  sl = g_hash_table_lookup (priv->shaped_lines, line);
+  if (sl == NULL)
+    return FALSE;
 
-      line_top = _gtk_text_btree_find_line_top (_gtk_text_buffer_get_btree (layout->buffer),
-                                                first_line, layout);
+  g_hash_table_remove (priv->shaped_lines, line);
+  batch = sl->batch;
+  batch->n_consumed++;
 
-      gtk_text_layout_emit_changed (layout,
-				    line_top,
-				    last_line_y - first_line_y - delta_height,
-				    last_line_y - first_line_y);
-    }
+  if (g_atomic_int_compare_and_exchange (&sl->state, SHAPE_PENDING, SHAPE_SKIPPED))
+    return FALSE;
+
+  g_mutex_lock (batch->mutex);
+  while (g_atomic_int_get (&sl->state) == SHAPE_RUNNING)
+    g_cond_wait (batch->cond, batch->mutex);
+  g_mutex_unlock (batch->mutex);
+
+  /* the cursor may have moved onto the line in the meantime */
+  if (line == priv->cursor_line)
+    return FALSE;
+
+  *width = sl->width;
+  *height = sl->height;
+
+  return TRUE;
 }
 
 /**
- * gtk_text_layout_validate:
- * @tree: a #GtkTextLayout
- * @max_pixels: the maximum number of pixels to validate. (No more
- *              than one paragraph beyond this limit will be validated)
+ * gtk_text_layout_set_shaping_threads:
+ * @layout: a #GtkTextLayout
+ * @n_threads: the number of threads to use, at least 1
  *
- * Validate regions of a #GtkTextLayout. The ::changed signal will
- * be emitted for each region validated.
- **/
+ * Sets the number of threads used to measure lines during
+ * gtk_text_layout_validate().  With more than one thread, the sizes
+ * of untagged lines without embedded pixbufs or widgets are computed
+ * ahead of time in the background, which makes validating large
+ * plain text buffers a lot faster.  The default is 1, which measures
+ * every line on the calling thread.
+ *
+ * Each worker thread uses its own Pango font map, so this should only
+ * be enabled if Pango and fontconfig may be used from several threads,
+ * and the GLib thread system has been initialized.
+ */
 void
-gtk_text_layout_validate (GtkTextLayout *layout,
-                          gint           max_pixels)
+gtk_text_layout_set_shaping_threads (GtkTextLayout *layout,
+                                     gint           n_threads)
 {
-  gint y, old_height, new_height;
+  GtkTextLayoutPrivate *priv;
 
   g_return_if_fail (GTK_IS_TEXT_LAYOUT (layout));
+  g_return_if_fail (n_threads >= 1);
 
-  while (max_pixels > 0 &&
-         _gtk_text_btree_validate (_gtk_text_buffer_get_btree (layout->buffer),
-                                   layout,  max_pixels,
-                                   &y, &old_height, &new_height))
-    {
-      max_pixels -= new_height;
+  priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
 
-      update_layout_size (layout);
-      gtk_text_layout_emit_changed (layout, y, old_height, new_height);
-    }
+  if (!g_thread_supported ())
+    n_threads = 1;
+
+  n_threads = MIN (n_threads, SHAPE_MAX_THREADS);
+
+  if (priv->shaping_threads == n_threads)
+    return;
+
+  priv->shaping_threads = n_threads;
+
+  if (n_threads == 1)
+    shape_cancel (layout);
+  else if (priv->shape_pool)
+    g_thread_pool_set_max_threads (priv->shape_pool, n_threads, NULL);
+}
+
+/**
+ * gtk_text_layout_get_shaping_threads:
+ * @layout: a #GtkTextLayout
+ *
+ * Returns the number of threads used to measure lines, see
+ * gtk_text_layout_set_shaping_threads().
+ *
+ * Return value: the number of shaping threads
+ */
+gint
+gtk_text_layout_get_shaping_threads (GtkTextLayout *layout)
+{
+  g_return_val_if_fail (GTK_IS_TEXT_LAYOUT (layout), 1);
+
+  return GTK_TEXT_LAYOUT_GET_PRIVATE (layout)->shaping_threads;
 }
 
 static GtkTextLineData*
@@ -1164,6 +2079,12 @@ gtk_text_layout_real_wrap (GtkTextLayout   *layout,
       _gtk_text_line_add_data (line, line_data);
     }
 
+  if (shape_take_result (layout, line, &line_data->width, &line_data->height))
+    {
+      line_data->valid = TRUE;
+      return line_data;
+    }
+
   display = gtk_text_layout_get_line_display (layout, line, TRUE);
   line_data->width = display->width;
   line_data->height = display->height;
@@ -1177,11 +2098,209 @@ gtk_text_layout_real_wrap (GtkTextLayout   *layout,
  * Layout utility functions
  */
 
+/*
+ * Tag sets
+ */
+
+static guint
+tag_set_hash (gconstpointer key)
+{
+  const TagSet *set = key;
+  guint hash = set->n_tags;
+  guint i;
+
+  for (i = 0; i < set->n_tags; i++)
+    hash = (hash << 5) - hash + GPOINTER_TO_UINT (set->tags[i]);
+
+  return hash;
+}
+
+static gboolean
+tag_set_equal (gconstpointer a,
+               gconstpointer b)
+{
+  const TagSet *set_a = a;
+  const TagSet *set_b = b;
+
+  return set_a->n_tags == set_b->n_tags &&
+         memcmp (set_a->tags, set_b->tags, set_a->n_tags * sizeof (GtkTextTag *)) == 0;
+}
+
+static void
+tag_set_free (gpointer data)
+{
+  TagSet *set = data;
+
+  if (set->style)
+    gtk_text_attributes_unref (set->style);
+
+  g_free (set);
+}
+
+#define TAG_SET_SIZE(n_tags) \
+  (G_STRUCT_OFFSET (TagSet, tags) + MAX (n_tags, 1) * sizeof (GtkTextTag *))
+
+/* Returns the shared TagSet for @tags, which must be sorted by priority */
+static TagSet *
+tag_set_intern (GtkTextLayout *layout,
+                GtkTextTag   **tags,
+                guint          n_tags)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+  TagSet *key;
+  TagSet *set;
+
+  key = g_alloca (TAG_SET_SIZE (n_tags));
+  key->n_tags = n_tags;
+  if (n_tags > 0)
+    memcpy (key->tags, tags, n_tags * sizeof (GtkTextTag *));
+
+  set = g_hash_table_lookup (priv->tag_sets, key);
+  if (set == NULL)
+    {
+      set = g_memdup (key, TAG_SET_SIZE (n_tags));
+      set->style = NULL;
+      g_hash_table_insert (priv->tag_sets, set, set);
+    }
+
+  return set;
+}
+
+static void
+forget_style_foreach (gpointer key,
+                      gpointer value,
+                      gpointer data)
+{
+  TagSet *set = value;
+
+  if (set->style)
+    {
+      gtk_text_attributes_unref (set->style);
+      set->style = NULL;
+    }
+}
+
+/* Drops the styles computed for the tag sets, or the tag sets
+ * themselves along with the tag runs referring to them.
+ */
+static void
+tag_sets_clear (GtkTextLayout *layout,
+                gboolean       styles_only)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+
+  free_style_cache (layout);
+
+  if (styles_only)
+    g_hash_table_foreach (priv->tag_sets, forget_style_foreach, NULL);
+  else
+    {
+      g_hash_table_remove_all (priv->line_tag_runs);
+      g_hash_table_remove_all (priv->tag_sets);
+    }
+}
+
+static void
+line_tag_runs_free (gpointer data)
+{
+  LineTagRuns *runs = data;
+
+  g_free (runs->runs);
+  g_free (runs);
+}
+
+/* Gets the tag runs of @line, computing them if they aren't known.
+ * Toggles at the start of the line are already accounted for by the
+ * tags at the start of the line, like in
+ * gtk_text_layout_get_line_display().
+ */
+static LineTagRuns *
+get_line_tag_runs (GtkTextLayout *layout,
+                   GtkTextLine   *line)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+  GtkTextBTree *btree = _gtk_text_buffer_get_btree (layout->buffer);
+  GtkTextLineSegment *seg;
+  LineTagRuns *runs;
+  GtkTextIter iter;
+  GPtrArray *tags;
+  GArray *array;
+  TagRun run;
+
+  runs = g_hash_table_lookup (priv->line_tag_runs, line);
+  if (runs)
+    return runs;
+
+  _gtk_text_btree_get_iter_at_line (btree, &iter, line, 0);
+  tags = get_tags_array_at_iter (&iter);
+
+  array = g_array_new (FALSE, FALSE, sizeof (TagRun));
+
+  run.byte_index = 0;
+  run.set = tag_set_intern (layout,
+                            tags ? (GtkTextTag **) tags->pdata : NULL,
+                            tags ? tags->len : 0);
+  g_array_append_val (array, run);
+
+  for (seg = line->segments; seg != NULL; seg = seg->next)
+    {
+      if ((seg->type == &gtk_text_toggle_on_type ||
+           seg->type == &gtk_text_toggle_off_type) &&
+          run.byte_index > 0)
+        {
+          TagRun *last = &g_array_index (array, TagRun, array->len - 1);
+
+          tags = tags_array_toggle_tag (tags, seg->body.toggle.info->tag);
+          run.set = tag_set_intern (layout,
+                                    (GtkTextTag **) tags->pdata, tags->len);
+
+          /* of several toggles at the same place, the last one counts */
+          if (last->byte_index == run.byte_index)
+            {
+              last->set = run.set;
+              if (array->len > 1 &&
+                  g_array_index (array, TagRun, array->len - 2).set == run.set)
+                g_array_set_size (array, array->len - 1);
+            }
+          else if (last->set != run.set)
+            g_array_append_val (array, run);
+        }
+
+      run.byte_index += seg->byte_count;
+    }
+
+  if (tags != NULL)
+    g_ptr_array_free (tags, TRUE);
+
+  runs = g_new (LineTagRuns, 1);
+  runs->n_runs = array->len;
+  runs->runs = (TagRun *) g_array_free (array, FALSE);
+
+  g_hash_table_insert (priv->line_tag_runs, line, runs);
+
+  return runs;
+}
+
+/* Returns the tag set in effect at byte @byte_index of the line,
+ * advancing *@run, which must not be past that byte.
+ */
+static TagSet *
+tag_runs_lookup (LineTagRuns *runs,
+                 guint        byte_index,
+                 guint       *run)
+{
+  while (*run + 1 < runs->n_runs &&
+         runs->runs[*run + 1].byte_index <= byte_index)
+    (*run)++;
+
+  return runs->runs[*run].set;
+}
+
 /* If you get the style with get_style () you need to call
    release_style () to free it. */
 static GtkTextAttributes*
 get_style (GtkTextLayout *layout,
-	   GPtrArray     *tags)
+	   TagSet        *tags)
 {
   GtkTextAttributes *style;
 
@@ -1198,7 +2317,7 @@ get_style (GtkTextLayout *layout,
   g_assert (layout->one_style_cache == NULL);
 
   /* No tags, use default style */
-  if (tags == NULL || tags->len == 0)
+  if (tags == NULL || tags->n_tags == 0)
     {
       /* One ref for the return value, one ref for the
          layout->one_style_cache reference */
@@ -1209,23 +2328,29 @@ get_style (GtkTextLayout *layout,
       return layout->default_style;
     }
 
-  style = gtk_text_attributes_new ();
+  /* The style of a tag set is only computed once */
+  if (tags->style == NULL)
+    {
+      style = gtk_text_attributes_new ();
+
+      gtk_text_attributes_copy_values (layout->default_style,
+                                       style);
 
-  gtk_text_attributes_copy_values (layout->default_style,
-                                   style);
+      _gtk_text_attributes_fill_from_tags (style,
+                                           tags->tags,
+                                           tags->n_tags);
 
-  _gtk_text_attributes_fill_from_tags (style,
-                                       (GtkTextTag**) tags->pdata,
-                                       tags->len);
+      tags->style = style;
+    }
 
-  g_assert (style->refcount == 1);
+  style = tags->style;
 
   /* Leave this style as the last one seen */
-  g_assert (layout->one_style_cache == NULL);
   gtk_text_attributes_ref (style); /* ref held by layout->one_style_cache */
   layout->one_style_cache = style;
 
   /* Returning yet another refcount */
+  gtk_text_attributes_ref (style);
   return style;
 }
 
@@ -1307,12 +2432,19 @@ totally_invisible_line (GtkTextLayout *layout,
   return TRUE;
 }
 
-static void
-set_para_values (GtkTextLayout      *layout,
-                 PangoDirection      base_dir,
-                 GtkTextAttributes  *style,
-                 GtkTextLineDisplay *display)
+/* Creates the PangoLayout for a paragraph with the paragraph-global
+ * values of @style.  This must not touch any GtkTextLayout state, as
+ * it is also used from the shaping threads.
+ */
+static PangoLayout *
+create_para_layout (PangoContext      *ltr_context,
+                    PangoContext      *rtl_context,
+                    gint               screen_width,
+                    PangoDirection     base_dir,
+                    GtkTextAttributes *style,
+                    GtkTextDirection  *direction)
 {
+  PangoLayout *layout;
   PangoAlignment pango_align = PANGO_ALIGN_LEFT;
   PangoWrapMode pango_wrap = PANGO_WRAP_WORD;
 
@@ -1320,27 +2452,27 @@ set_para_values (GtkTextLayout      *layout,
     {
     /* If no base direction was found, then use the style direction */
     case PANGO_DIRECTION_NEUTRAL :
-      display->direction = style->direction;
+      *direction = style->direction;
 
       /* Override the base direction */
-      if (display->direction == GTK_TEXT_DIR_RTL)
+      if (*direction == GTK_TEXT_DIR_RTL)
         base_dir = PANGO_DIRECTION_RTL;
       else
         base_dir = PANGO_DIRECTION_LTR;
       
       break;
     case PANGO_DIRECTION_RTL :
-      display->direction = GTK_TEXT_DIR_RTL;
+      *direction = GTK_TEXT_DIR_RTL;
       break;
     default:
-      display->direction = GTK_TEXT_DIR_LTR;
+      *direction = GTK_TEXT_DIR_LTR;
       break;
     }
   
-  if (display->direction == GTK_TEXT_DIR_RTL)
-    display->layout = pango_layout_new (layout->rtl_context);
+  if (*direction == GTK_TEXT_DIR_RTL)
+    layout = pango_layout_new (rtl_context);
   else
-    display->layout = pango_layout_new (layout->ltr_context);
+    layout = pango_layout_new (ltr_context);
 
   switch (style->justification)
     {
@@ -1355,29 +2487,21 @@ set_para_values (GtkTextLayout      *layout,
       break;
     case GTK_JUSTIFY_FILL:
       pango_align = (base_dir == PANGO_DIRECTION_LTR) ? PANGO_ALIGN_LEFT : PANGO_ALIGN_RIGHT;
-      pango_layout_set_justify (display->layout, TRUE);
+      pango_layout_set_justify (layout, TRUE);
       break;
     default:
       g_assert_not_reached ();
       break;
     }
 
-  pango_layout_set_alignment (display->layout, pango_align);
-  pango_layout_set_spacing (display->layout,
+  pango_layout_set_alignment (layout, pango_align);
+  pango_layout_set_spacing (layout,
                             style->pixels_inside_wrap * PANGO_SCALE);
 
   if (style->tabs)
-    pango_layout_set_tabs (display->layout, style->tabs);
-
-  display->top_margin = style->pixels_above_lines;
-  display->height = style->pixels_above_lines + style->pixels_below_lines;
-  display->bottom_margin = style->pixels_below_lines;
-  display->left_margin = style->left_margin;
-  display->right_margin = style->right_margin;
-  
-  display->x_offset = display->left_margin;
+    pango_layout_set_tabs (layout, style->tabs);
 
-  pango_layout_set_indent (display->layout,
+  pango_layout_set_indent (layout,
                            style->indent * PANGO_SCALE);
 
   switch (style->wrap_mode)
@@ -1399,11 +2523,34 @@ set_para_values (GtkTextLayout      *layout,
 
   if (style->wrap_mode != GTK_WRAP_NONE)
     {
-      int layout_width = (layout->screen_width - display->left_margin - display->right_margin);
-      pango_layout_set_width (display->layout, layout_width * PANGO_SCALE);
-      pango_layout_set_wrap (display->layout, pango_wrap);
+      int layout_width = (screen_width - style->left_margin - style->right_margin);
+      pango_layout_set_width (layout, layout_width * PANGO_SCALE);
+      pango_layout_set_wrap (layout, pango_wrap);
     }
 
+  return layout;
+}
+
+static void
+set_para_values (GtkTextLayout      *layout,
+                 PangoDirection      base_dir,
+                 GtkTextAttributes  *style,
+                 GtkTextLineDisplay *display)
+{
+  display->layout = create_para_layout (layout->ltr_context,
+                                        layout->rtl_context,
+                                        layout->screen_width,
+                                        base_dir, style,
+                                        &display->direction);
+
+  display->top_margin = style->pixels_above_lines;
+  display->height = style->pixels_above_lines + style->pixels_below_lines;
+  display->bottom_margin = style->pixels_below_lines;
+  display->left_margin = style->left_margin;
+  display->right_margin = style->right_margin;
+  
+  display->x_offset = display->left_margin;
+
   display->total_width = MAX (layout->screen_width, layout->width) - display->left_margin - display->right_margin;
   
   if (style->pg_bg_color)
@@ -2085,6 +3232,36 @@ update_text_display_cursors (GtkTextLayout      *layout,
   g_slist_free (cursor_segs);
 }
 
+/* Returns the length of @text without the trailing paragraph delimiter */
+static gint
+strip_paragraph_delimiter (const gchar *text,
+                           gint         len)
+{
+  /* Only one character has type G_UNICODE_PARAGRAPH_SEPARATOR in
+   * Unicode 3.0; update this if that changes.
+   */
+#define PARAGRAPH_SEPARATOR 0x2029
+  gunichar ch = 0;
+
+  if (len > 0)
+    {
+      const char *prev = g_utf8_prev_char (text + len);
+      ch = g_utf8_get_char (prev);
+      if (ch == PARAGRAPH_SEPARATOR || ch == '\r' || ch == '\n')
+        len = prev - text; /* chop off */
+
+      if (ch == '\n' && len > 0)
+        {
+          /* Possibly chop a CR as well */
+          prev = g_utf8_prev_char (text + len);
+          if (*prev == '\r')
+            --len;
+        }
+    }
+
+  return len;
+}
+
 /* Same as _gtk_text_btree_get_tags(), except it returns GPtrArray,
  * to be used in gtk_text_layout_get_line_display(). */
 static GPtrArray *
@@ -2157,29 +3334,24 @@ gtk_text_layout_get_line_display (GtkTextLayout *layout,
   GSList *tmp_list1, *tmp_list2;
   gboolean saw_widget = FALSE;
   PangoDirection base_dir;
-  GPtrArray *tags;
-  gboolean initial_toggle_segments;
+  LineTagRuns *runs;
+  guint run;
   
   g_return_val_if_fail (line != NULL, NULL);
 
-  if (layout->one_display_cache)
+  display = line_display_cache_lookup (layout, line, size_only);
+  if (display)
     {
-      if (line == layout->one_display_cache->line &&
-          (size_only || !layout->one_display_cache->size_only))
-	{
-	  if (!size_only)
-            update_text_display_cursors (layout, line, layout->one_display_cache);
-	  return layout->one_display_cache;
-	}
-      else
-        {
-          GtkTextLineDisplay *tmp_display = layout->one_display_cache;
-          layout->one_display_cache = NULL;
-          gtk_text_layout_free_line_display (layout, tmp_display);
-        }
+      priv->line_display_hits++;
+
+      if (!size_only)
+        update_text_display_cursors (layout, line, display);
+      return display;
     }
 
-  DV (g_print ("creating one line display cache (%s)\n", G_STRLOC));
+  priv->line_display_misses++;
+
+  DV (g_print ("creating line display (%s)\n", G_STRLOC));
 
   display = g_new0 (GtkTextLineDisplay, 1);
 
@@ -2227,8 +3399,8 @@ gtk_text_layout_get_line_display (GtkTextLayout *layout,
   layout_byte_offset = 0; /* current length of layout text (includes preedit, does not include invisible text) */
   buffer_byte_offset = 0; /* position in the buffer line */
   seg = _gtk_text_iter_get_any_segment (&iter);
-  tags = get_tags_array_at_iter (&iter);
-  initial_toggle_segments = TRUE;
+  runs = get_line_tag_runs (layout, line);
+  run = 0;
   while (seg != NULL)
     {
       /* Displayable segments */
@@ -2236,8 +3408,7 @@ gtk_text_layout_get_line_display (GtkTextLayout *layout,
           seg->type == &gtk_text_pixbuf_type ||
           seg->type == &gtk_text_child_type)
         {
-          style = get_style (layout, tags);
-	  initial_toggle_segments = FALSE;
+          style = get_style (layout, tag_runs_lookup (runs, buffer_byte_offset, &run));
 
           /* We have to delay setting the paragraph values until we
            * hit the first pixbuf or text segment because toggles at
@@ -2366,10 +3537,6 @@ gtk_text_layout_get_line_display (GtkTextLayout *layout,
           /* Style may have changed, drop our
              current cached style */
           invalidate_cached_style (layout);
-	  /* Add the tag only after we have seen some non-toggle non-mark segment,
-	   * otherwise the tag is already accounted for by _gtk_text_btree_get_tags(). */
-	  if (!initial_toggle_segments)
-	    tags = tags_array_toggle_tag (tags, seg->body.toggle.info->tag);
         }
 
       /* Marks */
@@ -2390,7 +3557,7 @@ gtk_text_layout_get_line_display (GtkTextLayout *layout,
 		  text_allocated += layout->preedit_len;
 		  text = g_realloc (text, text_allocated);
 
-		  style = get_style (layout, tags);
+		  style = get_style (layout, tag_runs_lookup (runs, buffer_byte_offset, &run));
 		  add_preedit_attrs (layout, style, attrs, layout_byte_offset, size_only);
 		  release_style (layout, style);
                   
@@ -2421,36 +3588,13 @@ gtk_text_layout_get_line_display (GtkTextLayout *layout,
   
   if (!para_values_set)
     {
-      style = get_style (layout, tags);
+      style = get_style (layout, tag_runs_lookup (runs, buffer_byte_offset, &run));
       set_para_values (layout, base_dir, style, display);
       release_style (layout, style);
     }
   
   /* Pango doesn't want the trailing paragraph delimiters */
-
-  {
-    /* Only one character has type G_UNICODE_PARAGRAPH_SEPARATOR in
-     * Unicode 3.0; update this if that changes.
-     */
-#define PARAGRAPH_SEPARATOR 0x2029
-    gunichar ch = 0;
-
-    if (layout_byte_offset > 0)
-      {
-        const char *prev = g_utf8_prev_char (text + layout_byte_offset);
-        ch = g_utf8_get_char (prev);
-        if (ch == PARAGRAPH_SEPARATOR || ch == '\r' || ch == '\n')
-          layout_byte_offset = prev - text; /* chop off */
-
-        if (ch == '\n' && layout_byte_offset > 0)
-          {
-            /* Possibly chop a CR as well */
-            prev = g_utf8_prev_char (text + layout_byte_offset);
-            if (*prev == '\r')
-              --layout_byte_offset;
-          }
-      }
-  }
+  layout_byte_offset = strip_paragraph_delimiter (text, layout_byte_offset);
   
   pango_layout_set_text (display->layout, text, layout_byte_offset);
   pango_layout_set_attributes (display->layout, attrs);
@@ -2498,10 +3642,8 @@ gtk_text_layout_get_line_display (GtkTextLayout *layout,
 
   g_free (text);
   pango_attr_list_unref (attrs);
-  if (tags != NULL)
-    g_ptr_array_free (tags, TRUE);
 
-  layout->one_display_cache = display;
+  line_display_cache_insert (layout, display);
 
   if (saw_widget)
     allocate_child_widgets (layout, display);
@@ -2513,7 +3655,7 @@ void
 gtk_text_layout_free_line_display (GtkTextLayout      *layout,
                                    GtkTextLineDisplay *display)
 {
-  if (display != layout->one_display_cache)
+  if (!line_display_is_cached (layout, display))
     {
       if (display->layout)
         g_object_unref (display->layout);
@@ -2532,6 +3674,40 @@ gtk_text_layout_free_line_display (GtkTextLayout      *layout,
     }
 }
 
+/**
+ * gtk_text_layout_get_line_display_stats:
+ * @layout: a #GtkTextLayout
+ * @n_cached: (out) (allow-none): return location for the number of
+ *     line displays currently cached, or %NULL
+ * @hits: (out) (allow-none): return location for the number of
+ *     gtk_text_layout_get_line_display() calls served from the cache,
+ *     or %NULL
+ * @misses: (out) (allow-none): return location for the number of
+ *     line displays that had to be created, or %NULL
+ *
+ * Retrieves statistics about the line display cache of @layout,
+ * for profiling.
+ */
+void
+gtk_text_layout_get_line_display_stats (GtkTextLayout *layout,
+                                        guint         *n_cached,
+                                        guint         *hits,
+                                        guint         *misses)
+{
+  GtkTextLayoutPrivate *priv;
+
+  g_return_if_fail (GTK_IS_TEXT_LAYOUT (layout));
+
+  priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+
+  if (n_cached)
+    *n_cached = priv->line_display_lru.length;
+  if (hits)
+    *hits = priv->line_display_hits;
+  if (misses)
+    *misses = priv->line_display_misses;
+}
+
 /* Functions to convert iter <=> index for the line of a GtkTextLineDisplay
  * taking into account the preedit string and invisible text if necessary.
  */
@@ -3722,5 +4898,32 @@ gtk_text_layout_buffer_delete_range (GtkTextBuffer *textbuffer,
   gtk_text_layout_update_cursor_line (layout);
 }
 
+static void
+gtk_text_layout_tag_changed (GtkTextTagTable *table,
+                             GtkTextTag      *tag,
+                             gboolean         size_changed,
+                             gpointer         data)
+{
+  GtkTextLayout *layout = GTK_TEXT_LAYOUT (data);
+
+  /* The btree has already queued the redraw or relayout; make
+   * sure no display is built with the old values of the tag.
+   */
+  tag_sets_clear (layout, TRUE);
+  line_display_cache_clear (layout);
+}
+
+static void
+gtk_text_layout_tag_removed (GtkTextTagTable *table,
+                             GtkTextTag      *tag,
+                             gpointer         data)
+{
+  GtkTextLayout *layout = GTK_TEXT_LAYOUT (data);
+
+  /* The tag's address may be reused by another tag */
+  tag_sets_clear (layout, FALSE);
+  line_display_cache_clear (layout);
+}
+
 #define __GTK_TEXT_LAYOUT_C__
 #include "gtkaliasdef.c"
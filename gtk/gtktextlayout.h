@@ -146,8 +146,8 @@ struct _GtkTextLayout
    * over long runs with the same style. */
   GtkTextAttributes *one_style_cache;
 
-  /* A cache of one line display. Getting the same line
-   * many times in a row is the most common case.
+  /* The most recently used line display; the layout keeps
+   * a bounded cache of recently used ones.
    */
   GtkTextLineDisplay *one_display_cache;
 
@@ -321,6 +321,10 @@ GtkTextLineDisplay* gtk_text_layout_get_line_display  (GtkTextLayout      *layou
                                                        gboolean            size_only);
 void                gtk_text_layout_free_line_display (GtkTextLayout      *layout,
                                                        GtkTextLineDisplay *display);
+void                gtk_text_layout_get_line_display_stats (GtkTextLayout *layout,
+                                                            guint         *n_cached,
+                                                            guint         *hits,
+                                                            guint         *misses);
 
 void gtk_text_layout_get_line_at_y     (GtkTextLayout     *layout,
                                         GtkTextIter       *target_iter,
@@ -341,6 +345,15 @@ void gtk_text_layout_invalidate        (GtkTextLayout     *layout,
 void gtk_text_layout_invalidate_cursors(GtkTextLayout     *layout,
                                         const GtkTextIter *start,
                                         const GtkTextIter *end);
+void gtk_text_layout_invalidate_lines  (GtkTextLayout     *layout,
+                                        GtkTextLine      **lines,
+                                        guint              n_lines);
+void _gtk_text_layout_invalidate_frozen (GtkTextLayout     *layout,
+                                         const GtkTextIter *start,
+                                         const GtkTextIter *end);
+void _gtk_text_layout_tags_changed      (GtkTextLayout     *layout,
+                                         const GtkTextIter *start,
+                                         const GtkTextIter *end);
 void gtk_text_layout_free_line_data    (GtkTextLayout     *layout,
                                         GtkTextLine       *line,
                                         GtkTextLineData   *line_data);
@@ -352,6 +365,12 @@ void     gtk_text_layout_validate_yrange (GtkTextLayout *layout,
                                           gint           y1_);
 void     gtk_text_layout_validate        (GtkTextLayout *layout,
                                           gint           max_pixels);
+/* More shaping threads than this are not used */
+#define SHAPE_MAX_THREADS 16
+
+void     gtk_text_layout_set_shaping_threads (GtkTextLayout *layout,
+                                              gint           n_threads);
+gint     gtk_text_layout_get_shaping_threads (GtkTextLayout *layout);
 
 /* This function should return the passed-in line data,
  * OR remove the existing line data from the line, and
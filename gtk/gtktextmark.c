@@ -66,6 +66,13 @@ static void gtk_text_mark_finalize     (GObject         *object);
 
 static GtkTextLineSegment *gtk_mark_segment_new (GtkTextMark *mark_obj);
 
+/*
+ * Macro that determines the size of a mark segment:
+ */
+
+#define MSEG_SIZE ((unsigned) (G_STRUCT_OFFSET (GtkTextLineSegment, body) \
+        + sizeof (GtkTextMarkBody)))
+
 G_DEFINE_TYPE (GtkTextMark, gtk_text_mark, G_TYPE_OBJECT)
 
 enum {
@@ -124,7 +131,7 @@ gtk_text_mark_finalize (GObject *obj)
                    "impending");
 
       g_free (seg->body.mark.name);
-      g_free (seg);
+      _gtk_text_segment_free (MSEG_SIZE, seg);
 
       mark->segment = NULL;
     }
@@ -321,20 +328,13 @@ gtk_text_mark_get_left_gravity (GtkTextMark *mark)
   return seg->type == &gtk_text_left_mark_type;
 }
 
-/*
- * Macro that determines the size of a mark segment:
- */
-
-#define MSEG_SIZE ((unsigned) (G_STRUCT_OFFSET (GtkTextLineSegment, body) \
-        + sizeof (GtkTextMarkBody)))
-
 
 static GtkTextLineSegment *
 gtk_mark_segment_new (GtkTextMark *mark_obj)
 {
   GtkTextLineSegment *mark;
 
-  mark = (GtkTextLineSegment *) g_malloc0 (MSEG_SIZE);
+  mark = _gtk_text_segment_alloc (MSEG_SIZE);
   mark->body.mark.name = NULL;
   mark->type = &gtk_text_right_mark_type;
 
@@ -159,6 +159,91 @@ gtk_text_line_segment_split (const GtkTextIter *iter)
 #define TSEG_SIZE ((unsigned) (G_STRUCT_OFFSET (GtkTextLineSegment, body) \
         + sizeof (GtkTextToggleBody)))
 
+/*
+ * Segment storage
+ *
+ * Buffers hold huge numbers of small segments that are created and
+ * destroyed on every edit, so they come from the slice allocator
+ * rather than from malloc.  Character segments vary in size with
+ * their text; their sizes are rounded up to a few size classes so
+ * that segments of similar length share the same slabs and freed
+ * memory is readily reused, instead of spreading over one slab per
+ * byte count.  Segments larger than SEGMENT_MAX_SLICE come from malloc.
+ */
+
+#define SEGMENT_MAX_SLICE 1024
+
+#ifdef G_ENABLE_DEBUG
+/* Not thread-safe, like the rest of the text widget; debugging only */
+static gsize n_segments = 0;
+static gsize segment_bytes = 0;
+#endif
+
+static inline gsize
+segment_size_class (gsize size)
+{
+  if (size <= 64)
+    return (size + 15) & ~(gsize) 15;
+  else if (size <= 256)
+    return (size + 31) & ~(gsize) 31;
+  else
+    return (size + 127) & ~(gsize) 127;
+}
+
+gpointer
+_gtk_text_segment_alloc (gsize size)
+{
+  size = segment_size_class (size);
+
+#ifdef G_ENABLE_DEBUG
+  n_segments++;
+  segment_bytes += size;
+#endif
+
+  if (size > SEGMENT_MAX_SLICE)
+    return g_malloc (size);
+  else
+    return g_slice_alloc (size);
+}
+
+/* @size must be the size that was passed to _gtk_text_segment_alloc() */
+void
+_gtk_text_segment_free (gsize    size,
+                        gpointer mem)
+{
+  if (mem == NULL)
+    return;
+
+  size = segment_size_class (size);
+
+#ifdef G_ENABLE_DEBUG
+  n_segments--;
+  segment_bytes -= size;
+#endif
+
+  if (size > SEGMENT_MAX_SLICE)
+    g_free (mem);
+  else
+    g_slice_free1 (size, mem);
+}
+
+void
+_gtk_text_segment_get_memory_stats (gsize *n_allocated,
+                                    gsize *n_bytes)
+{
+#ifdef G_ENABLE_DEBUG
+  if (n_allocated)
+    *n_allocated = n_segments;
+  if (n_bytes)
+    *n_bytes = segment_bytes;
+#else
+  if (n_allocated)
+    *n_allocated = 0;
+  if (n_bytes)
+    *n_bytes = 0;
+#endif
+}
+
 /*
  * Type functions
  */
@@ -195,7 +280,7 @@ _gtk_char_segment_new (const gchar *text, guint len)
 
   g_assert (gtk_text_byte_begins_utf8_char (text));
 
-  seg = g_malloc (CSEG_SIZE (len));
+  seg = _gtk_text_segment_alloc (CSEG_SIZE (len));
   seg->type = (GtkTextLineSegmentClass *)&gtk_text_char_type;
   seg->next = NULL;
   seg->byte_count = len;
@@ -223,7 +308,7 @@ _gtk_char_segment_new_from_two_strings (const gchar *text1,
   g_assert (gtk_text_byte_begins_utf8_char (text1));
   g_assert (gtk_text_byte_begins_utf8_char (text2));
 
-  seg = g_malloc (CSEG_SIZE (len1+len2));
+  seg = _gtk_text_segment_alloc (CSEG_SIZE (len1+len2));
   seg->type = &gtk_text_char_type;
   seg->next = NULL;
   seg->byte_count = len1 + len2;
@@ -286,7 +371,7 @@ char_segment_split_func (GtkTextLineSegment *seg, int index)
       char_segment_self_check (new2);
     }
 
-  g_free (seg);
+  _gtk_text_segment_free (CSEG_SIZE (seg->byte_count), seg);
   return new1;
 }
 
@@ -341,8 +426,8 @@ char_segment_cleanup_func (GtkTextLineSegment *segPtr, GtkTextLine *line)
   if (gtk_debug_flags & GTK_DEBUG_TEXT)
     char_segment_self_check (newPtr);
 
-  g_free (segPtr);
-  g_free (segPtr2);
+  _gtk_text_segment_free (CSEG_SIZE (segPtr->byte_count), segPtr);
+  _gtk_text_segment_free (CSEG_SIZE (segPtr2->byte_count), segPtr2);
   return newPtr;
 }
 
@@ -372,7 +457,7 @@ char_segment_cleanup_func (GtkTextLineSegment *segPtr, GtkTextLine *line)
 static int
 char_segment_delete_func (GtkTextLineSegment *segPtr, GtkTextLine *line, int treeGone)
 {
-  g_free ((char*) segPtr);
+  _gtk_text_segment_free (CSEG_SIZE (segPtr->byte_count), segPtr);
   return 0;
 }
 
@@ -418,7 +503,7 @@ _gtk_toggle_segment_new (GtkTextTagInfo *info, gboolean on)
 {
   GtkTextLineSegment *seg;
 
-  seg = g_malloc (TSEG_SIZE);
+  seg = _gtk_text_segment_alloc (TSEG_SIZE);
 
   seg->type = on ? &gtk_text_toggle_on_type : &gtk_text_toggle_off_type;
 
@@ -433,6 +518,12 @@ _gtk_toggle_segment_new (GtkTextTagInfo *info, gboolean on)
   return seg;
 }
 
+void
+_gtk_toggle_segment_free (GtkTextLineSegment *seg)
+{
+  _gtk_text_segment_free (TSEG_SIZE, seg);
+}
+
 /*
  *--------------------------------------------------------------
  *
@@ -463,7 +554,7 @@ toggle_segment_delete_func (GtkTextLineSegment *segPtr, GtkTextLine *line, int t
 {
   if (treeGone)
     {
-      g_free ((char *) segPtr);
+      _gtk_text_segment_free (TSEG_SIZE, segPtr);
       return 0;
     }
 
@@ -546,9 +637,9 @@ toggle_segment_cleanup_func (GtkTextLineSegment *segPtr, GtkTextLine *line)
                                              segPtr->body.toggle.info, -counts);
             }
           prevPtr->next = segPtr2->next;
-          g_free ((char *) segPtr2);
+          _gtk_text_segment_free (TSEG_SIZE, segPtr2);
           segPtr2 = segPtr->next;
-          g_free ((char *) segPtr);
+          _gtk_text_segment_free (TSEG_SIZE, segPtr);
           return segPtr2;
         }
     }
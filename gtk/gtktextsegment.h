@@ -164,6 +164,13 @@ GtkTextLineSegment *_gtk_char_segment_new_from_two_strings (const gchar    *text
 							    guint           chars2);
 GtkTextLineSegment *_gtk_toggle_segment_new                (GtkTextTagInfo *info,
                                                             gboolean        on);
+void                _gtk_toggle_segment_free               (GtkTextLineSegment *seg);
+
+gpointer            _gtk_text_segment_alloc                (gsize           size);
+void                _gtk_text_segment_free                 (gsize           size,
+                                                            gpointer        mem);
+void                _gtk_text_segment_get_memory_stats     (gsize          *n_allocated,
+                                                            gsize          *n_bytes);
 
 
 G_END_DECLS
@@ -109,6 +109,7 @@ struct _GtkTextViewPrivate
   guint blink_time;  /* time in msec the cursor has blinked since last user event */
   guint im_spot_idle;
   gchar *im_module;
+  gint shaping_threads;
   guint scroll_after_paste : 1;
 };
 
@@ -160,7 +161,8 @@ enum
   PROP_BUFFER,
   PROP_OVERWRITE,
   PROP_ACCEPTS_TAB,
-  PROP_IM_MODULE
+  PROP_IM_MODULE,
+  PROP_SHAPING_THREADS
 };
 
 static void gtk_text_view_destroy              (GtkObject        *object);
@@ -687,6 +689,22 @@ gtk_text_view_class_init (GtkTextViewClass *klass)
                                                          NULL,
                                                          GTK_PARAM_READWRITE));
 
+  /**
+   * GtkTextView:shaping-threads:
+   *
+   * The number of threads used to measure lines of text in the
+   * background. See gtk_text_view_set_shaping_threads().
+   *
+   * Since: 2.22
+   */
+  g_object_class_install_property (gobject_class,
+                                   PROP_SHAPING_THREADS,
+                                   g_param_spec_int ("shaping-threads",
+                                                     P_("Shaping threads"),
+                                                     P_("Number of threads used to measure lines of text in the background"),
+                                                     1, SHAPE_MAX_THREADS, 1,
+                                                     GTK_PARAM_READWRITE));
+
   /*
    * Style properties
    */
@@ -1297,6 +1315,8 @@ gtk_text_view_init (GtkTextView *text_view)
 
   gtk_widget_set_can_focus (widget, TRUE);
 
+  priv->shaping_threads = 1;
+
   /* Set up default style */
   text_view->wrap_mode = GTK_WRAP_NONE;
   text_view->pixels_above_lines = 0;
@@ -3037,6 +3057,10 @@ gtk_text_view_set_property (GObject         *object,
         gtk_im_multicontext_set_context_id (GTK_IM_MULTICONTEXT (text_view->im_context), priv->im_module);
       break;
 
+    case PROP_SHAPING_THREADS:
+      gtk_text_view_set_shaping_threads (text_view, g_value_get_int (value));
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -3117,6 +3141,10 @@ gtk_text_view_get_property (GObject         *object,
       g_value_set_string (value, priv->im_module);
       break;
 
+    case PROP_SHAPING_THREADS:
+      g_value_set_int (value, priv->shaping_threads);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -3278,7 +3306,76 @@ gtk_text_view_child_allocated (GtkTextLayout *layout,
   vc->from_left_of_buffer = x;
   vc->from_top_of_line = y;
 
-  gtk_text_view_update_child_allocation (text_view, vc);
+  /* Offscreen children only remember their position; they are
+   * allocated when they come back into view.
+   */
+  if (gtk_widget_get_child_visible (child))
+    gtk_text_view_update_child_allocation (text_view, vc);
+}
+
+static gboolean
+gtk_text_view_child_is_near_screen (GtkTextView      *text_view,
+                                    GtkTextViewChild *vc)
+{
+  GtkAllocation allocation;
+  gint margin;
+
+  /* Keep a screenful above and below the visible area, so that
+   * short scrolls don't map and unmap children all the time.
+   */
+  margin = SCREEN_HEIGHT (text_view);
+
+  gtk_text_view_compute_child_allocation (text_view, vc, &allocation);
+
+  return allocation.y + allocation.height > -margin &&
+         allocation.y < SCREEN_HEIGHT (text_view) + margin;
+}
+
+/* Anchored children far away from the visible area are hidden with
+ * gtk_widget_set_child_visible() and unrealized, so a buffer with
+ * thousands of embedded widgets doesn't keep thousands of windows
+ * around. Their requisitions stay cached in the widgets, which is all
+ * the layout needs to size their lines.
+ */
+static void
+gtk_text_view_update_child_visibility (GtkTextView *text_view)
+{
+  GSList *tmp_list;
+
+  if (text_view->layout == NULL)
+    return;
+
+  tmp_list = text_view->children;
+  while (tmp_list != NULL)
+    {
+      GtkTextViewChild *vc = tmp_list->data;
+      gboolean near_screen;
+
+      tmp_list = g_slist_next (tmp_list);
+
+      if (vc->anchor == NULL)
+        continue;
+
+      near_screen = gtk_text_view_child_is_near_screen (text_view, vc) ||
+                    GTK_CONTAINER (text_view)->focus_child == vc->widget;
+
+      if (near_screen == gtk_widget_get_child_visible (vc->widget))
+        continue;
+
+      if (near_screen)
+        {
+          /* The allocation went stale while the child was hidden */
+          gtk_text_view_update_child_allocation (text_view, vc);
+          gtk_widget_set_child_visible (vc->widget, TRUE);
+        }
+      else
+        {
+          gtk_widget_set_child_visible (vc->widget, FALSE);
+
+          if (gtk_widget_get_realized (vc->widget))
+            gtk_widget_unrealize (vc->widget);
+        }
+    }
 }
 
 static void
@@ -3287,6 +3384,8 @@ gtk_text_view_allocate_children (GtkTextView *text_view)
   GSList *tmp_list;
 
   DV(g_print(G_STRLOC"\n"));
+
+  gtk_text_view_update_child_visibility (text_view);
   
   tmp_list = text_view->children;
   while (tmp_list != NULL)
@@ -3297,10 +3396,21 @@ gtk_text_view_allocate_children (GtkTextView *text_view)
           
       if (child->anchor)
         {
+          GtkTextIter child_loc;
+
+          /* Hidden children are dealt with when they come back into
+           * view; validating all of their lines here would lay out
+           * the whole buffer.
+           */
+          if (!gtk_widget_get_child_visible (child->widget))
+            {
+              tmp_list = g_slist_next (tmp_list);
+              continue;
+            }
+
           /* We need to force-validate the regions containing
            * children.
            */
-          GtkTextIter child_loc;
           gtk_text_buffer_get_iter_at_child_anchor (get_buffer (text_view),
                                                     &child_loc,
                                                     child->anchor);
@@ -3790,14 +3900,18 @@ changed_handler (GtkTextLayout     *layout,
           gtk_adjustment_value_changed (get_vadjustment (text_view));
         }
 
-      /* FIXME be smarter about which anchored widgets we update */
+      /* Validation moves lines around, so children may have come
+       * near the screen or gone far from it. Hidden children get
+       * reallocated when they come back into view.
+       */
+      gtk_text_view_update_child_visibility (text_view);
 
       tmp_list = text_view->children;
       while (tmp_list != NULL)
         {
           GtkTextViewChild *child = tmp_list->data;
 
-          if (child->anchor)
+          if (child->anchor && gtk_widget_get_child_visible (child->widget))
             gtk_text_view_update_child_allocation (text_view, child);
 
           tmp_list = g_slist_next (tmp_list);
@@ -5944,6 +6058,65 @@ gtk_text_view_get_accepts_tab (GtkTextView *text_view)
   return text_view->accepts_tab;
 }
 
+/**
+ * gtk_text_view_set_shaping_threads:
+ * @text_view: A #GtkTextView
+ * @n_threads: the number of threads to use, from 1 to 16
+ *
+ * Sets the number of threads used to measure the lines of the buffer
+ * while @text_view computes its size in the background.  With more
+ * than one thread, untagged lines without embedded pixbufs or widgets
+ * are measured ahead of time by worker threads, so that the scrollbar
+ * of a large plain text buffer settles much sooner and typing doesn't
+ * stutter while the rest of the buffer is being measured.
+ *
+ * Only set @n_threads to a value larger than 1 if the GLib thread
+ * system has been initialized and Pango and fontconfig may be used
+ * from several threads; each worker uses a font map of its own.
+ *
+ * Since: 2.22
+ **/
+void
+gtk_text_view_set_shaping_threads (GtkTextView *text_view,
+                                   gint         n_threads)
+{
+  GtkTextViewPrivate *priv;
+
+  g_return_if_fail (GTK_IS_TEXT_VIEW (text_view));
+  g_return_if_fail (n_threads >= 1 && n_threads <= SHAPE_MAX_THREADS);
+
+  priv = GTK_TEXT_VIEW_GET_PRIVATE (text_view);
+
+  if (priv->shaping_threads != n_threads)
+    {
+      priv->shaping_threads = n_threads;
+
+      if (text_view->layout)
+        gtk_text_layout_set_shaping_threads (text_view->layout, n_threads);
+
+      g_object_notify (G_OBJECT (text_view), "shaping-threads");
+    }
+}
+
+/**
+ * gtk_text_view_get_shaping_threads:
+ * @text_view: A #GtkTextView
+ *
+ * Returns the number of threads used to measure lines in the
+ * background. See gtk_text_view_set_shaping_threads().
+ *
+ * Return value: the number of shaping threads
+ *
+ * Since: 2.22
+ **/
+gint
+gtk_text_view_get_shaping_threads (GtkTextView *text_view)
+{
+  g_return_val_if_fail (GTK_IS_TEXT_VIEW (text_view), 1);
+
+  return GTK_TEXT_VIEW_GET_PRIVATE (text_view)->shaping_threads;
+}
+
 static void
 gtk_text_view_compat_move_focus (GtkTextView     *text_view,
                                  GtkDirectionType direction_type)
@@ -6455,6 +6628,9 @@ gtk_text_view_ensure_layout (GtkTextView *text_view)
       gtk_text_layout_set_overwrite_mode (text_view->layout,
 					  text_view->overwrite_mode && text_view->editable);
 
+      gtk_text_layout_set_shaping_threads (text_view->layout,
+                                           GTK_TEXT_VIEW_GET_PRIVATE (text_view)->shaping_threads);
+
       ltr_context = gtk_widget_create_pango_context (GTK_WIDGET (text_view));
       pango_context_set_base_dir (ltr_context, PANGO_DIRECTION_LTR);
       rtl_context = gtk_widget_create_pango_context (GTK_WIDGET (text_view));
@@ -7313,7 +7489,7 @@ gtk_text_view_value_changed (GtkAdjustment *adj,
         {
           GtkTextViewChild *child = tmp_list->data;
           
-          if (child->anchor)
+          if (child->anchor && gtk_widget_get_child_visible (child->widget))
             adjust_allocation (child->widget, dx, dy);
           
           tmp_list = g_slist_next (tmp_list);
@@ -7338,6 +7514,11 @@ gtk_text_view_value_changed (GtkAdjustment *adj,
    * that, or shouldn't be.
    */
   gtk_text_view_validate_onscreen (text_view);
+
+  /* Map the children scrolled into view, and drop the ones that
+   * went far out of it.
+   */
+  gtk_text_view_update_child_visibility (text_view);
   
   /* process exposes */
   if (gtk_widget_get_realized (GTK_WIDGET (text_view)))
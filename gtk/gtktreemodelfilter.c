@@ -56,6 +56,9 @@
 
 typedef struct _FilterElt FilterElt;
 typedef struct _FilterLevel FilterLevel;
+typedef struct _FilterRefilter FilterRefilter;
+typedef struct _FilterRefilterRow FilterRefilterRow;
+typedef struct _FilterRefilterSlice FilterRefilterSlice;
 
 struct _FilterElt
 {
@@ -77,6 +80,49 @@ struct _FilterLevel
   FilterLevel *parent_level;
 };
 
+/* An asynchronous refilter walks the child model in pre-order, like
+ * gtk_tree_model_foreach() does.  Rows are collected in batches of
+ * REFILTER_BATCH_SIZE, their visibility is evaluated (possibly spread
+ * over worker threads) and the resulting transitions are applied in one
+ * go.  @next_path is the child path of the first row of the next batch;
+ * it is kept up to date by the child model signal handlers so that the
+ * walk survives changes to the child model between two idles.
+ */
+#define REFILTER_BATCH_SIZE        256
+#define REFILTER_MAX_THREADS       16
+#define REFILTER_TIME_MS_PER_IDLE  15
+
+struct _FilterRefilterRow
+{
+  GtkTreePath *c_path;
+  GtkTreeIter c_iter;
+  gboolean visible;
+};
+
+struct _FilterRefilterSlice
+{
+  GtkTreeModelFilter *filter;
+  gint start;
+  gint end;
+};
+
+struct _FilterRefilter
+{
+  GtkTreePath *next_path;
+  gint base_depth;
+
+  FilterRefilterRow rows[REFILTER_BATCH_SIZE];
+  gint n_rows;
+
+  /* set when the child model changed since the batch was collected */
+  guint child_changed : 1;
+
+  /* worker thread synchronization */
+  GMutex *lock;
+  GCond *cond;
+  gint pending;
+};
+
 #define GTK_TREE_MODEL_FILTER_GET_PRIVATE(obj)  (G_TYPE_INSTANCE_GET_PRIVATE ((obj), GTK_TYPE_TREE_MODEL_FILTER, GtkTreeModelFilterPrivate))
 
 struct _GtkTreeModelFilterPrivate
@@ -107,6 +153,12 @@ struct _GtkTreeModelFilterPrivate
   gboolean in_row_deleted;
   gboolean virtual_root_deleted;
 
+  /* asynchronous refilter */
+  FilterRefilter *refilter;
+  guint refilter_idle_id;
+  gint refilter_threads;
+  GThreadPool *refilter_pool;
+
   /* signal ids */
   guint changed_id;
   guint inserted_id;
@@ -120,7 +172,9 @@ enum
 {
   PROP_0,
   PROP_CHILD_MODEL,
-  PROP_VIRTUAL_ROOT
+  PROP_VIRTUAL_ROOT,
+  PROP_REFILTERING,
+  PROP_REFILTER_THREADS
 };
 
 #define GTK_TREE_MODEL_FILTER_CACHE_CHILD_ITERS(filter) \
@@ -286,6 +340,21 @@ static void         gtk_tree_model_filter_update_children                 (GtkTr
 static FilterElt   *bsearch_elt_with_offset                               (GArray                 *array,
                                                                            gint                   offset,
                                                                            gint                  *index);
+static gboolean     gtk_tree_model_filter_update_row                      (GtkTreeModelFilter     *filter,
+                                                                           GtkTreeModel           *c_model,
+                                                                           GtkTreePath            *c_path,
+                                                                           GtkTreeIter            *c_iter,
+                                                                           gboolean                requested_state,
+                                                                           gboolean                emit_changed);
+static gboolean     gtk_tree_model_filter_stop_refilter                   (GtkTreeModelFilter     *filter);
+static void         gtk_tree_model_filter_refilter_row_inserted           (GtkTreeModelFilter     *filter,
+                                                                           GtkTreePath            *c_path);
+static void         gtk_tree_model_filter_refilter_row_deleted            (GtkTreeModelFilter     *filter,
+                                                                           GtkTreePath            *c_path);
+static void         gtk_tree_model_filter_refilter_rows_reordered         (GtkTreeModelFilter     *filter,
+                                                                           GtkTreePath            *c_path,
+                                                                           GtkTreeIter            *c_iter,
+                                                                           gint                   *new_order);
 
 
 G_DEFINE_TYPE_WITH_CODE (GtkTreeModelFilter, gtk_tree_model_filter, G_TYPE_OBJECT,
@@ -305,6 +374,7 @@ gtk_tree_model_filter_init (GtkTreeModelFilter *filter)
   filter->priv->modify_func_set = FALSE;
   filter->priv->in_row_deleted = FALSE;
   filter->priv->virtual_root_deleted = FALSE;
+  filter->priv->refilter_threads = 1;
 }
 
 static void
@@ -341,6 +411,38 @@ gtk_tree_model_filter_class_init (GtkTreeModelFilterClass *filter_class)
                                                        GTK_TYPE_TREE_PATH,
                                                        GTK_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY));
 
+  /**
+   * GtkTreeModelFilter:refiltering:
+   *
+   * Whether an asynchronous refilter started with
+   * gtk_tree_model_filter_refilter_async() is in progress.
+   *
+   * Since: 2.22
+   */
+  g_object_class_install_property (object_class,
+                                   PROP_REFILTERING,
+                                   g_param_spec_boolean ("refiltering",
+                                                         P_("Refiltering"),
+                                                         P_("Whether an asynchronous refilter is in progress"),
+                                                         FALSE,
+                                                         GTK_PARAM_READABLE));
+
+  /**
+   * GtkTreeModelFilter:refilter-threads:
+   *
+   * The number of threads used to evaluate the visible function during
+   * an asynchronous refilter. See gtk_tree_model_filter_set_refilter_threads().
+   *
+   * Since: 2.22
+   */
+  g_object_class_install_property (object_class,
+                                   PROP_REFILTER_THREADS,
+                                   g_param_spec_int ("refilter-threads",
+                                                     P_("Refilter threads"),
+                                                     P_("Number of threads used to evaluate the visible function during an asynchronous refilter"),
+                                                     1, REFILTER_MAX_THREADS, 1,
+                                                     GTK_PARAM_READWRITE));
+
   g_type_class_add_private (object_class, sizeof (GtkTreeModelFilterPrivate));
 }
 
@@ -377,6 +479,11 @@ gtk_tree_model_filter_finalize (GObject *object)
 {
   GtkTreeModelFilter *filter = (GtkTreeModelFilter *) object;
 
+  gtk_tree_model_filter_stop_refilter (filter);
+
+  if (filter->priv->refilter_pool)
+    g_thread_pool_free (filter->priv->refilter_pool, FALSE, TRUE);
+
   if (filter->priv->virtual_root && !filter->priv->virtual_root_deleted)
     {
       gtk_tree_model_filter_unref_path (filter, filter->priv->virtual_root);
@@ -419,6 +526,9 @@ gtk_tree_model_filter_set_property (GObject      *object,
       case PROP_VIRTUAL_ROOT:
         gtk_tree_model_filter_set_root (filter, g_value_get_boxed (value));
         break;
+      case PROP_REFILTER_THREADS:
+        gtk_tree_model_filter_set_refilter_threads (filter, g_value_get_int (value));
+        break;
       default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -441,6 +551,12 @@ gtk_tree_model_filter_get_property (GObject    *object,
       case PROP_VIRTUAL_ROOT:
         g_value_set_boxed (value, filter->priv->virtual_root);
         break;
+      case PROP_REFILTERING:
+        g_value_set_boolean (value, filter->priv->refilter != NULL);
+        break;
+      case PROP_REFILTER_THREADS:
+        g_value_set_int (value, filter->priv->refilter_threads);
+        break;
       default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -1230,47 +1346,32 @@ bsearch_elt_with_offset (GArray *array,
 }
 
 /* TreeModel signals */
-static void
-gtk_tree_model_filter_row_changed (GtkTreeModel *c_model,
-                                   GtkTreePath  *c_path,
-                                   GtkTreeIter  *c_iter,
-                                   gpointer      data)
+
+/* Brings the filter model in sync with the visibility @requested_state
+ * of the child row at @c_path.  When @emit_changed is %FALSE, rows which
+ * stay visible do not get a ::row-changed; this is used by the
+ * asynchronous refilter, where the row data itself did not change.
+ *
+ * Returns %TRUE if any signals have been emitted on the filter model.
+ */
+static gboolean
+gtk_tree_model_filter_update_row (GtkTreeModelFilter *filter,
+                                  GtkTreeModel       *c_model,
+                                  GtkTreePath        *c_path,
+                                  GtkTreeIter        *c_iter,
+                                  gboolean            requested_state,
+                                  gboolean            emit_changed)
 {
-  GtkTreeModelFilter *filter = GTK_TREE_MODEL_FILTER (data);
   GtkTreeIter iter;
   GtkTreeIter children;
-  GtkTreeIter real_c_iter;
   GtkTreePath *path = NULL;
 
   FilterElt *elt;
   FilterLevel *level;
 
-  gboolean requested_state;
   gboolean current_state;
-  gboolean free_c_path = FALSE;
   gboolean signals_emitted = FALSE;
-
-  g_return_if_fail (c_path != NULL || c_iter != NULL);
-
-  if (!c_path)
-    {
-      c_path = gtk_tree_model_get_path (c_model, c_iter);
-      free_c_path = TRUE;
-    }
-
-  if (c_iter)
-    real_c_iter = *c_iter;
-  else
-    gtk_tree_model_get_iter (c_model, &real_c_iter, c_path);
-
-  /* is this node above the virtual root? */
-  if (filter->priv->virtual_root
-      && (gtk_tree_path_get_depth (filter->priv->virtual_root)
-          >= gtk_tree_path_get_depth (c_path)))
-    goto done;
-
-  /* what's the requested state? */
-  requested_state = gtk_tree_model_filter_visible (filter, &real_c_iter);
+  gboolean retval = FALSE;
 
   /* now, let's see whether the item is there */
   path = gtk_real_tree_model_filter_convert_child_path_to_path (filter,
@@ -1298,12 +1399,16 @@ gtk_tree_model_filter_row_changed (GtkTreeModel *c_model,
       level->visible_nodes--;
 
       gtk_tree_model_filter_remove_node (filter, &iter);
+      retval = TRUE;
 
       goto done;
     }
 
   if (current_state == TRUE && requested_state == TRUE)
     {
+      if (!emit_changed)
+        goto done;
+
       /* propagate the signal; also get a path taking only visible
        * nodes into account.
        */
@@ -1316,9 +1421,10 @@ gtk_tree_model_filter_row_changed (GtkTreeModel *c_model,
       if (gtk_tree_model_filter_elt_is_visible_in_target (level, elt))
         {
           gtk_tree_model_row_changed (GTK_TREE_MODEL (filter), path, &iter);
+          retval = TRUE;
 
           /* and update the children */
-          if (gtk_tree_model_iter_children (c_model, &children, &real_c_iter))
+          if (gtk_tree_model_iter_children (c_model, &children, c_iter))
             gtk_tree_model_filter_update_children (filter, level, elt);
         }
 
@@ -1328,7 +1434,8 @@ gtk_tree_model_filter_row_changed (GtkTreeModel *c_model,
   /* only current == FALSE and requested == TRUE is left,
    * pull in the child
    */
-  g_return_if_fail (current_state == FALSE && requested_state == TRUE);
+  g_return_val_if_fail (current_state == FALSE && requested_state == TRUE,
+                        FALSE);
 
   /* make sure the new item has been pulled in */
   if (!filter->priv->root)
@@ -1342,6 +1449,7 @@ gtk_tree_model_filter_row_changed (GtkTreeModel *c_model,
        * for it.
        */
       signals_emitted = TRUE;
+      retval = TRUE;
 
       root = FILTER_LEVEL (filter->priv->root);
     }
@@ -1382,6 +1490,7 @@ gtk_tree_model_filter_row_changed (GtkTreeModel *c_model,
 
       if (!signals_emitted)
         gtk_tree_model_row_inserted (GTK_TREE_MODEL (filter), path, &iter);
+      retval = TRUE;
 
       if (level->parent_level && level->visible_nodes == 1)
         {
@@ -1407,6 +1516,47 @@ done:
   if (path)
     gtk_tree_path_free (path);
 
+  return retval;
+}
+
+static void
+gtk_tree_model_filter_row_changed (GtkTreeModel *c_model,
+                                   GtkTreePath  *c_path,
+                                   GtkTreeIter  *c_iter,
+                                   gpointer      data)
+{
+  GtkTreeModelFilter *filter = GTK_TREE_MODEL_FILTER (data);
+  GtkTreeIter real_c_iter;
+
+  gboolean requested_state;
+  gboolean free_c_path = FALSE;
+
+  g_return_if_fail (c_path != NULL || c_iter != NULL);
+
+  if (!c_path)
+    {
+      c_path = gtk_tree_model_get_path (c_model, c_iter);
+      free_c_path = TRUE;
+    }
+
+  if (c_iter)
+    real_c_iter = *c_iter;
+  else
+    gtk_tree_model_get_iter (c_model, &real_c_iter, c_path);
+
+  /* is this node above the virtual root? */
+  if (filter->priv->virtual_root
+      && (gtk_tree_path_get_depth (filter->priv->virtual_root)
+          >= gtk_tree_path_get_depth (c_path)))
+    goto done;
+
+  /* what's the requested state? */
+  requested_state = gtk_tree_model_filter_visible (filter, &real_c_iter);
+
+  gtk_tree_model_filter_update_row (filter, c_model, c_path, &real_c_iter,
+                                    requested_state, TRUE);
+
+done:
   if (free_c_path)
     gtk_tree_path_free (c_path);
 }
@@ -1445,6 +1595,8 @@ gtk_tree_model_filter_row_inserted (GtkTreeModel *c_model,
   else
     gtk_tree_model_get_iter (c_model, &real_c_iter, c_path);
 
+  gtk_tree_model_filter_refilter_row_inserted (filter, c_path);
+
   /* the row has already been inserted. so we need to fixup the
    * virtual root here first
    */
@@ -1762,6 +1914,8 @@ gtk_tree_model_filter_row_deleted (GtkTreeModel *c_model,
 
   g_return_if_fail (c_path != NULL);
 
+  gtk_tree_model_filter_refilter_row_deleted (filter, c_path);
+
   /* special case the deletion of an ancestor of the virtual root */
   if (filter->priv->virtual_root &&
       (gtk_tree_path_is_ancestor (c_path, filter->priv->virtual_root) ||
@@ -2016,6 +2170,9 @@ gtk_tree_model_filter_rows_reordered (GtkTreeModel *c_model,
 
   g_return_if_fail (new_order != NULL);
 
+  gtk_tree_model_filter_refilter_rows_reordered (filter, c_path, c_iter,
+                                                 new_order);
+
   if (c_path == NULL || gtk_tree_path_get_depth (c_path) == 0)
     {
       length = gtk_tree_model_iter_n_children (c_model, NULL);
@@ -2893,6 +3050,7 @@ gtk_tree_model_filter_set_model (GtkTreeModelFilter *filter,
         gtk_tree_model_filter_free_level (filter, filter->priv->root);
 
       filter->priv->root = NULL;
+      gtk_tree_model_filter_stop_refilter (filter);
       g_object_unref (filter->priv->child_model);
       filter->priv->visible_column = -1;
 
@@ -3501,12 +3659,631 @@ gtk_tree_model_filter_refilter (GtkTreeModelFilter *filter)
 {
   g_return_if_fail (GTK_IS_TREE_MODEL_FILTER (filter));
 
+  /* a synchronous refilter supersedes any pending asynchronous one */
+  if (gtk_tree_model_filter_stop_refilter (filter))
+    g_object_notify (G_OBJECT (filter), "refiltering");
+
   /* S L O W */
   gtk_tree_model_foreach (filter->priv->child_model,
                           gtk_tree_model_filter_refilter_helper,
                           filter);
 }
 
+/* asynchronous refilter */
+
+static void
+gtk_tree_model_filter_refilter_clear_rows (FilterRefilter *refilter)
+{
+  gint i;
+
+  for (i = 0; i < refilter->n_rows; i++)
+    if (refilter->rows[i].c_path)
+      gtk_tree_path_free (refilter->rows[i].c_path);
+
+  refilter->n_rows = 0;
+}
+
+/* Returns %TRUE if an asynchronous refilter was in progress; the caller
+ * is responsible for notifying the #GtkTreeModelFilter:refiltering
+ * property (this also runs during finalization).
+ */
+static gboolean
+gtk_tree_model_filter_stop_refilter (GtkTreeModelFilter *filter)
+{
+  FilterRefilter *refilter = filter->priv->refilter;
+
+  if (!refilter)
+    return FALSE;
+
+  if (filter->priv->refilter_idle_id)
+    {
+      g_source_remove (filter->priv->refilter_idle_id);
+      filter->priv->refilter_idle_id = 0;
+    }
+
+  gtk_tree_model_filter_refilter_clear_rows (refilter);
+
+  if (refilter->next_path)
+    gtk_tree_path_free (refilter->next_path);
+
+  if (refilter->lock)
+    {
+      g_mutex_free (refilter->lock);
+      g_cond_free (refilter->cond);
+    }
+
+  g_slice_free (FilterRefilter, refilter);
+  filter->priv->refilter = NULL;
+
+  return TRUE;
+}
+
+/* The following functions keep the position of an asynchronous refilter,
+ * and the child paths of the batch being applied, valid while the child
+ * model changes under it.  A change only moves a path if it happens at a
+ * level on the way from the root to that path.
+ */
+static gboolean
+gtk_tree_model_filter_refilter_path_affected (GtkTreePath *path,
+                                              GtkTreePath *c_path)
+{
+  gint *indices, *cursor;
+  gint depth, i;
+
+  depth = gtk_tree_path_get_depth (c_path);
+
+  if (depth == 0 || depth > gtk_tree_path_get_depth (path))
+    return FALSE;
+
+  indices = gtk_tree_path_get_indices (c_path);
+  cursor = gtk_tree_path_get_indices (path);
+
+  for (i = 0; i < depth - 1; i++)
+    if (indices[i] != cursor[i])
+      return FALSE;
+
+  return TRUE;
+}
+
+static void
+gtk_tree_model_filter_refilter_path_inserted (GtkTreePath *path,
+                                              GtkTreePath *c_path)
+{
+  gint depth;
+
+  if (!gtk_tree_model_filter_refilter_path_affected (path, c_path))
+    return;
+
+  depth = gtk_tree_path_get_depth (c_path);
+
+  if (gtk_tree_path_get_indices (c_path)[depth - 1] <= gtk_tree_path_get_indices (path)[depth - 1])
+    gtk_tree_path_get_indices (path)[depth - 1]++;
+}
+
+/* Returns %FALSE if @path itself has been deleted along with @c_path. */
+static gboolean
+gtk_tree_model_filter_refilter_path_deleted (GtkTreePath *path,
+                                             GtkTreePath *c_path)
+{
+  gint *cursor;
+  gint depth, index;
+
+  if (!gtk_tree_model_filter_refilter_path_affected (path, c_path))
+    return TRUE;
+
+  depth = gtk_tree_path_get_depth (c_path);
+  cursor = gtk_tree_path_get_indices (path);
+  index = gtk_tree_path_get_indices (c_path)[depth - 1];
+
+  if (index == cursor[depth - 1])
+    return FALSE;
+
+  if (index < cursor[depth - 1])
+    cursor[depth - 1]--;
+
+  return TRUE;
+}
+
+static void
+gtk_tree_model_filter_refilter_path_reordered (GtkTreePath *path,
+                                               GtkTreePath *c_path,
+                                               gint        *new_order,
+                                               gint         length)
+{
+  gint *cursor;
+  gint depth, i;
+
+  depth = c_path ? gtk_tree_path_get_depth (c_path) : 0;
+
+  if (depth >= gtk_tree_path_get_depth (path)
+      || (depth > 0 && !gtk_tree_path_is_ancestor (c_path, path)))
+    return;
+
+  cursor = gtk_tree_path_get_indices (path);
+  for (i = 0; i < length; i++)
+    if (new_order[i] == cursor[depth])
+      {
+        cursor[depth] = i;
+        break;
+      }
+}
+
+static void
+gtk_tree_model_filter_refilter_row_inserted (GtkTreeModelFilter *filter,
+                                             GtkTreePath        *c_path)
+{
+  FilterRefilter *refilter = filter->priv->refilter;
+  gint i;
+
+  if (!refilter)
+    return;
+
+  refilter->child_changed = TRUE;
+
+  for (i = 0; i < refilter->n_rows; i++)
+    if (refilter->rows[i].c_path)
+      gtk_tree_model_filter_refilter_path_inserted (refilter->rows[i].c_path,
+                                                    c_path);
+
+  /* The inserted row itself is evaluated by the row-inserted handler,
+   * so next_path just skips over it.
+   */
+  if (refilter->next_path)
+    gtk_tree_model_filter_refilter_path_inserted (refilter->next_path, c_path);
+}
+
+static void
+gtk_tree_model_filter_refilter_row_deleted (GtkTreeModelFilter *filter,
+                                            GtkTreePath        *c_path)
+{
+  FilterRefilter *refilter = filter->priv->refilter;
+  gint depth;
+  gint i;
+
+  if (!refilter)
+    return;
+
+  refilter->child_changed = TRUE;
+
+  for (i = 0; i < refilter->n_rows; i++)
+    if (refilter->rows[i].c_path
+        && !gtk_tree_model_filter_refilter_path_deleted (refilter->rows[i].c_path,
+                                                         c_path))
+      {
+        gtk_tree_path_free (refilter->rows[i].c_path);
+        refilter->rows[i].c_path = NULL;
+      }
+
+  if (!refilter->next_path
+      || gtk_tree_model_filter_refilter_path_deleted (refilter->next_path,
+                                                      c_path))
+    return;
+
+  depth = gtk_tree_path_get_depth (c_path);
+
+  if (depth <= refilter->base_depth)
+    {
+      /* the virtual root is gone, and with it everything left to walk */
+      gtk_tree_path_free (refilter->next_path);
+      refilter->next_path = NULL;
+      return;
+    }
+
+  /* next_path or one of its ancestors is gone; continue with the row
+   * which took its place.
+   */
+  while (gtk_tree_path_get_depth (refilter->next_path) > depth)
+    gtk_tree_path_up (refilter->next_path);
+}
+
+static void
+gtk_tree_model_filter_refilter_rows_reordered (GtkTreeModelFilter *filter,
+                                               GtkTreePath        *c_path,
+                                               GtkTreeIter        *c_iter,
+                                               gint               *new_order)
+{
+  FilterRefilter *refilter = filter->priv->refilter;
+  GtkTreeIter real_c_iter;
+  gint depth, length;
+  gint i;
+
+  if (!refilter)
+    return;
+
+  depth = c_path ? gtk_tree_path_get_depth (c_path) : 0;
+
+  if (depth > 0 && !c_iter)
+    {
+      gtk_tree_model_get_iter (filter->priv->child_model, &real_c_iter, c_path);
+      c_iter = &real_c_iter;
+    }
+
+  length = gtk_tree_model_iter_n_children (filter->priv->child_model,
+                                           depth > 0 ? c_iter : NULL);
+
+  refilter->child_changed = TRUE;
+
+  for (i = 0; i < refilter->n_rows; i++)
+    if (refilter->rows[i].c_path)
+      gtk_tree_model_filter_refilter_path_reordered (refilter->rows[i].c_path,
+                                                     c_path, new_order, length);
+
+  if (!refilter->next_path
+      || (depth > 0 && !gtk_tree_path_is_ancestor (c_path, refilter->next_path)))
+    return;
+
+  if (depth < refilter->base_depth)
+    {
+      /* an ancestor level of the virtual root; the walk itself is not
+       * affected, only the prefix of next_path moves.
+       */
+      gtk_tree_model_filter_refilter_path_reordered (refilter->next_path,
+                                                     c_path, new_order, length);
+      return;
+    }
+
+  /* Rows may have moved from either side of next_path to the other,
+   * so start over at the beginning of the reordered level.
+   */
+  while (gtk_tree_path_get_depth (refilter->next_path) > depth + 1)
+    gtk_tree_path_up (refilter->next_path);
+
+  gtk_tree_path_get_indices (refilter->next_path)[depth] = 0;
+}
+
+/* Collects the next batch of rows in pre-order, starting at next_path,
+ * and advances next_path past them.
+ */
+static void
+gtk_tree_model_filter_refilter_collect (GtkTreeModelFilter *filter)
+{
+  FilterRefilter *refilter = filter->priv->refilter;
+  GtkTreeModel *c_model = filter->priv->child_model;
+  GtkTreePath *path = refilter->next_path;
+  GtkTreeIter iter, tmp;
+
+  refilter->next_path = NULL;
+
+  /* next_path may point past the end of a level if rows have been
+   * deleted at the end; continue with the next sibling of the parent.
+   */
+  while (!gtk_tree_model_get_iter (c_model, &iter, path))
+    {
+      if (gtk_tree_path_get_depth (path) <= refilter->base_depth + 1)
+        {
+          gtk_tree_path_free (path);
+          return;
+        }
+
+      gtk_tree_path_up (path);
+      gtk_tree_path_next (path);
+    }
+
+  while (refilter->n_rows < REFILTER_BATCH_SIZE)
+    {
+      FilterRefilterRow *row = &refilter->rows[refilter->n_rows++];
+
+      row->c_path = gtk_tree_path_copy (path);
+      row->c_iter = iter;
+
+      if (gtk_tree_model_iter_children (c_model, &tmp, &iter))
+        {
+          iter = tmp;
+          gtk_tree_path_down (path);
+          continue;
+        }
+
+      tmp = iter;
+      while (!gtk_tree_model_iter_next (c_model, &tmp))
+        {
+          if (gtk_tree_path_get_depth (path) <= refilter->base_depth + 1
+              || !gtk_tree_model_iter_parent (c_model, &tmp, &iter))
+            {
+              gtk_tree_path_free (path);
+              return;
+            }
+
+          iter = tmp;
+          gtk_tree_path_up (path);
+        }
+
+      iter = tmp;
+      gtk_tree_path_next (path);
+    }
+
+  refilter->next_path = path;
+}
+
+static void
+gtk_tree_model_filter_refilter_evaluate_slice (GtkTreeModelFilter *filter,
+                                               gint                start,
+                                               gint                end)
+{
+  FilterRefilter *refilter = filter->priv->refilter;
+  gint i;
+
+  for (i = start; i < end; i++)
+    refilter->rows[i].visible =
+      gtk_tree_model_filter_visible (filter, &refilter->rows[i].c_iter);
+}
+
+static void
+gtk_tree_model_filter_refilter_worker (gpointer data,
+                                       gpointer user_data)
+{
+  FilterRefilterSlice *slice = data;
+  FilterRefilter *refilter = slice->filter->priv->refilter;
+
+  gtk_tree_model_filter_refilter_evaluate_slice (slice->filter,
+                                                 slice->start, slice->end);
+
+  g_mutex_lock (refilter->lock);
+  if (--refilter->pending == 0)
+    g_cond_signal (refilter->cond);
+  g_mutex_unlock (refilter->lock);
+}
+
+static void
+gtk_tree_model_filter_refilter_evaluate (GtkTreeModelFilter *filter)
+{
+  FilterRefilter *refilter = filter->priv->refilter;
+  FilterRefilterSlice slices[REFILTER_MAX_THREADS];
+  gint n_slices, per_slice, i;
+
+  n_slices = MIN (filter->priv->refilter_threads, refilter->n_rows);
+
+  if (n_slices <= 1 || !g_thread_supported ())
+    {
+      gtk_tree_model_filter_refilter_evaluate_slice (filter, 0,
+                                                     refilter->n_rows);
+      return;
+    }
+
+  if (!filter->priv->refilter_pool)
+    filter->priv->refilter_pool =
+      g_thread_pool_new (gtk_tree_model_filter_refilter_worker, NULL,
+                         REFILTER_MAX_THREADS - 1, FALSE, NULL);
+  g_thread_pool_set_max_threads (filter->priv->refilter_pool,
+                                 n_slices - 1, NULL);
+
+  if (!refilter->lock)
+    {
+      refilter->lock = g_mutex_new ();
+      refilter->cond = g_cond_new ();
+    }
+
+  per_slice = (refilter->n_rows + n_slices - 1) / n_slices;
+  for (i = 0; i < n_slices; i++)
+    {
+      slices[i].filter = filter;
+      slices[i].start = i * per_slice;
+      slices[i].end = MIN ((i + 1) * per_slice, refilter->n_rows);
+    }
+
+  /* the first slice is evaluated on this thread */
+  refilter->pending = n_slices - 1;
+  for (i = 1; i < n_slices; i++)
+    g_thread_pool_push (filter->priv->refilter_pool, &slices[i], NULL);
+
+  gtk_tree_model_filter_refilter_evaluate_slice (filter,
+                                                 slices[0].start,
+                                                 slices[0].end);
+
+  g_mutex_lock (refilter->lock);
+  while (refilter->pending > 0)
+    g_cond_wait (refilter->cond, refilter->lock);
+  g_mutex_unlock (refilter->lock);
+}
+
+/* Applies the evaluated visibility of the current batch.  Only rows whose
+ * visibility changes cause signals to be emitted.
+ */
+static gboolean
+gtk_tree_model_filter_refilter_apply (GtkTreeModelFilter *filter)
+{
+  FilterRefilter *refilter = filter->priv->refilter;
+  GtkTreeModel *c_model = filter->priv->child_model;
+  guint idle_id = filter->priv->refilter_idle_id;
+  gint i;
+
+  for (i = 0; i < refilter->n_rows; i++)
+    {
+      FilterRefilterRow *row = &refilter->rows[i];
+
+      /* Signal handlers may have modified the child model; the child
+       * paths are kept up to date, rows which have been deleted have
+       * lost theirs, and the collected iters are only valid if they
+       * persist.
+       */
+      if (!row->c_path)
+        continue;
+
+      if (refilter->child_changed
+          && !GTK_TREE_MODEL_FILTER_CACHE_CHILD_ITERS (filter)
+          && !gtk_tree_model_get_iter (c_model, &row->c_iter, row->c_path))
+        continue;
+
+      gtk_tree_model_filter_update_row (filter, c_model,
+                                        row->c_path, &row->c_iter,
+                                        row->visible, FALSE);
+
+      /* a handler may have stopped or restarted the refilter */
+      if (filter->priv->refilter_idle_id != idle_id)
+        return FALSE;
+    }
+
+  gtk_tree_model_filter_refilter_clear_rows (refilter);
+
+  return TRUE;
+}
+
+static gboolean
+gtk_tree_model_filter_refilter_idle (gpointer data)
+{
+  GtkTreeModelFilter *filter = GTK_TREE_MODEL_FILTER (data);
+  GTimer *timer;
+
+  timer = g_timer_new ();
+
+  while (filter->priv->refilter->next_path)
+    {
+      gtk_tree_model_filter_refilter_collect (filter);
+      filter->priv->refilter->child_changed = FALSE;
+      gtk_tree_model_filter_refilter_evaluate (filter);
+
+      if (!gtk_tree_model_filter_refilter_apply (filter))
+        {
+          /* this source has already been removed */
+          g_timer_destroy (timer);
+          return FALSE;
+        }
+
+      if (g_timer_elapsed (timer, NULL) * 1000 > REFILTER_TIME_MS_PER_IDLE)
+        break;
+    }
+
+  g_timer_destroy (timer);
+
+  if (filter->priv->refilter->next_path)
+    return TRUE;
+
+  filter->priv->refilter_idle_id = 0;
+  gtk_tree_model_filter_stop_refilter (filter);
+  g_object_notify (G_OBJECT (filter), "refiltering");
+
+  return FALSE;
+}
+
+/**
+ * gtk_tree_model_filter_refilter_async:
+ * @filter: A #GtkTreeModelFilter.
+ *
+ * Re-evaluates the visibility of every row in the child model, like
+ * gtk_tree_model_filter_refilter(), but spreads the work over several
+ * main loop iterations so that the user interface stays responsive.
+ *
+ * Rows are evaluated in batches, and signals are only emitted for rows
+ * that become visible or invisible; unlike gtk_tree_model_filter_refilter()
+ * no ::row-changed is emitted for rows that stay visible.
+ *
+ * Calling this function while a previous asynchronous refilter is still
+ * in progress cancels that refilter and starts over, which makes it
+ * suitable for refiltering on every keystroke of a search entry.
+ * Use the #GtkTreeModelFilter:refiltering property to find out when the
+ * refilter has finished.
+ *
+ * Since: 2.22
+ */
+void
+gtk_tree_model_filter_refilter_async (GtkTreeModelFilter *filter)
+{
+  FilterRefilter *refilter;
+  gboolean was_refiltering;
+
+  g_return_if_fail (GTK_IS_TREE_MODEL_FILTER (filter));
+  g_return_if_fail (filter->priv->child_model != NULL);
+
+  was_refiltering = gtk_tree_model_filter_stop_refilter (filter);
+
+  if (filter->priv->virtual_root && filter->priv->virtual_root_deleted)
+    {
+      if (was_refiltering)
+        g_object_notify (G_OBJECT (filter), "refiltering");
+      return;
+    }
+
+  refilter = g_slice_new0 (FilterRefilter);
+
+  if (filter->priv->virtual_root)
+    {
+
+      refilter->next_path = gtk_tree_path_copy (filter->priv->virtual_root);
+      refilter->base_depth = gtk_tree_path_get_depth (filter->priv->virtual_root);
+      gtk_tree_path_append_index (refilter->next_path, 0);
+    }
+  else
+    refilter->next_path = gtk_tree_path_new_first ();
+
+  filter->priv->refilter = refilter;
+  filter->priv->refilter_idle_id =
+    gdk_threads_add_idle_full (G_PRIORITY_DEFAULT_IDLE,
+                               gtk_tree_model_filter_refilter_idle,
+                               filter, NULL);
+
+  g_object_notify (G_OBJECT (filter), "refiltering");
+}
+
+/**
+ * gtk_tree_model_filter_get_refiltering:
+ * @filter: A #GtkTreeModelFilter.
+ *
+ * Returns whether an asynchronous refilter started with
+ * gtk_tree_model_filter_refilter_async() is still in progress.
+ *
+ * Return value: %TRUE if @filter is refiltering.
+ *
+ * Since: 2.22
+ */
+gboolean
+gtk_tree_model_filter_get_refiltering (GtkTreeModelFilter *filter)
+{
+  g_return_val_if_fail (GTK_IS_TREE_MODEL_FILTER (filter), FALSE);
+
+  return filter->priv->refilter != NULL;
+}
+
+/**
+ * gtk_tree_model_filter_set_refilter_threads:
+ * @filter: A #GtkTreeModelFilter.
+ * @n_threads: the number of threads to use, at least 1.
+ *
+ * Sets the number of threads that gtk_tree_model_filter_refilter_async()
+ * uses to evaluate the visibility of rows.  The visibility of each batch
+ * of rows is computed concurrently, while the filter model itself is only
+ * ever updated from the main thread.
+ *
+ * Only set @n_threads to a value larger than 1 if the visible function
+ * (or the #GtkTreeModelFilterClass.visible implementation) is thread-safe
+ * and only reads from the child model.  Threads are only used if the GLib
+ * thread system has been initialized.
+ *
+ * Since: 2.22
+ */
+void
+gtk_tree_model_filter_set_refilter_threads (GtkTreeModelFilter *filter,
+                                            gint                n_threads)
+{
+  g_return_if_fail (GTK_IS_TREE_MODEL_FILTER (filter));
+  g_return_if_fail (n_threads >= 1);
+
+  n_threads = MIN (n_threads, REFILTER_MAX_THREADS);
+
+  if (filter->priv->refilter_threads != n_threads)
+    {
+      filter->priv->refilter_threads = n_threads;
+      g_object_notify (G_OBJECT (filter), "refilter-threads");
+    }
+}
+
+/**
+ * gtk_tree_model_filter_get_refilter_threads:
+ * @filter: A #GtkTreeModelFilter.
+ *
+ * Returns the number of threads used by an asynchronous refilter.
+ * See gtk_tree_model_filter_set_refilter_threads().
+ *
+ * Return value: the number of refilter threads.
+ *
+ * Since: 2.22
+ */
+gint
+gtk_tree_model_filter_get_refilter_threads (GtkTreeModelFilter *filter)
+{
+  g_return_val_if_fail (GTK_IS_TREE_MODEL_FILTER (filter), 1);
+
+  return filter->priv->refilter_threads;
+}
+
 /**
  * gtk_tree_model_filter_clear_cache:
  * @filter: A #GtkTreeModelFilter.
@@ -109,6 +109,11 @@ GtkTreePath  *gtk_tree_model_filter_convert_path_to_child_path (GtkTreeModelFilt
 
 /* extras */
 void          gtk_tree_model_filter_refilter                   (GtkTreeModelFilter           *filter);
+void          gtk_tree_model_filter_refilter_async             (GtkTreeModelFilter           *filter);
+gboolean      gtk_tree_model_filter_get_refiltering            (GtkTreeModelFilter           *filter);
+void          gtk_tree_model_filter_set_refilter_threads       (GtkTreeModelFilter           *filter,
+                                                                gint                          n_threads);
+gint          gtk_tree_model_filter_get_refilter_threads       (GtkTreeModelFilter           *filter);
 void          gtk_tree_model_filter_clear_cache                (GtkTreeModelFilter           *filter);
 
 G_END_DECLS
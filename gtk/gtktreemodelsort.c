@@ -53,6 +53,7 @@ typedef struct _SortElt SortElt;
 typedef struct _SortLevel SortLevel;
 typedef struct _SortData SortData;
 typedef struct _SortTuple SortTuple;
+typedef struct _GtkTreeModelSortPrivate GtkTreeModelSortPrivate;
 
 struct _SortElt
 {
@@ -61,6 +62,7 @@ struct _SortElt
   gint         offset;
   gint         ref_count;
   gint         zero_ref_count;
+  guint        dirty : 1;
 };
 
 struct _SortLevel
@@ -69,6 +71,7 @@ struct _SortLevel
   gint       ref_count;
   gint       parent_elt_index;
   SortLevel *parent_level;
+  gint       n_dirty;
 };
 
 struct _SortData
@@ -87,11 +90,28 @@ struct _SortTuple
   gint       offset;
 };
 
+/* In deferred resort mode, changed rows are only flagged as dirty and
+ * their level is queued.  The pending levels are resorted from an idle
+ * (or by gtk_tree_model_sort_flush_resort()) by sorting the dirty
+ * elements and merging them with the clean ones, which are still in
+ * order, emitting a single ::rows-reordered per level.
+ */
+struct _GtkTreeModelSortPrivate
+{
+  GSList *dirty_levels;
+  guint resort_idle_id;
+
+  guint deferred_resort : 1;
+};
+
+#define GTK_TREE_MODEL_SORT_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), GTK_TYPE_TREE_MODEL_SORT, GtkTreeModelSortPrivate))
+
 /* Properties */
 enum {
   PROP_0,
   /* Construct args */
-  PROP_MODEL
+  PROP_MODEL,
+  PROP_DEFERRED_RESORT
 };
 
 
@@ -240,6 +260,11 @@ static GtkTreePath *gtk_real_tree_model_sort_convert_child_path_to_path (GtkTree
 									 GtkTreePath      *child_path,
 									 gboolean          build_levels);
 
+static void         gtk_tree_model_sort_level_clear_dirty (GtkTreeModelSort *tree_model_sort,
+							   SortLevel        *level);
+static void         gtk_tree_model_sort_queue_resort      (GtkTreeModelSort *tree_model_sort);
+static void         gtk_tree_model_sort_cancel_resort     (GtkTreeModelSort *tree_model_sort);
+
 
 G_DEFINE_TYPE_WITH_CODE (GtkTreeModelSort, gtk_tree_model_sort, G_TYPE_OBJECT,
 			 G_IMPLEMENT_INTERFACE (GTK_TYPE_TREE_MODEL,
@@ -279,6 +304,25 @@ gtk_tree_model_sort_class_init (GtkTreeModelSortClass *class)
 							P_("The model for the TreeModelSort to sort"),
 							GTK_TYPE_TREE_MODEL,
 							GTK_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY));
+
+  /**
+   * GtkTreeModelSort:deferred-resort:
+   *
+   * Whether rows which changed in the child model are moved to their
+   * new position in a batch, instead of one at a time.
+   * See gtk_tree_model_sort_set_deferred_resort().
+   *
+   * Since: 2.22
+   */
+  g_object_class_install_property (object_class,
+                                   PROP_DEFERRED_RESORT,
+                                   g_param_spec_boolean ("deferred-resort",
+							 P_("Deferred resort"),
+							 P_("Whether changed rows are resorted in a batch"),
+							 FALSE,
+							 GTK_PARAM_READWRITE));
+
+  g_type_class_add_private (object_class, sizeof (GtkTreeModelSortPrivate));
 }
 
 static void
@@ -382,6 +426,9 @@ gtk_tree_model_sort_set_property (GObject      *object,
     case PROP_MODEL:
       gtk_tree_model_sort_set_model (tree_model_sort, g_value_get_object (value));
       break;
+    case PROP_DEFERRED_RESORT:
+      gtk_tree_model_sort_set_deferred_resort (tree_model_sort, g_value_get_boolean (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -401,6 +448,9 @@ gtk_tree_model_sort_get_property (GObject    *object,
     case PROP_MODEL:
       g_value_set_object (value, gtk_tree_model_sort_get_model(tree_model_sort));
       break;
+    case PROP_DEFERRED_RESORT:
+      g_value_set_boolean (value, gtk_tree_model_sort_get_deferred_resort (tree_model_sort));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -464,6 +514,34 @@ gtk_tree_model_sort_row_changed (GtkTreeModel *s_model,
 
       return;
     }
+
+  if (GTK_TREE_MODEL_SORT_GET_PRIVATE (tree_model_sort)->deferred_resort)
+    {
+      GtkTreeModelSortPrivate *priv = GTK_TREE_MODEL_SORT_GET_PRIVATE (tree_model_sort);
+
+      /* The row keeps its position until the pending resort is flushed.
+       * Handlers of ::row-changed may change the model or flush the
+       * resort, so the row is marked and released before the signal is
+       * emitted, and not touched afterwards.
+       */
+      if (!elt->dirty)
+	{
+	  elt->dirty = TRUE;
+	  if (level->n_dirty++ == 0)
+	    priv->dirty_levels = g_slist_prepend (priv->dirty_levels, level);
+
+	  gtk_tree_model_sort_queue_resort (tree_model_sort);
+	}
+
+      gtk_tree_model_sort_unref_node (GTK_TREE_MODEL (data), &iter);
+      gtk_tree_model_row_changed (GTK_TREE_MODEL (data), path, &iter);
+
+      gtk_tree_path_free (path);
+      if (free_s_path)
+	gtk_tree_path_free (start_s_path);
+
+      return;
+    }
   
   if (!GTK_TREE_MODEL_SORT_CACHE_CHILD_ITERS (tree_model_sort))
     {
@@ -780,6 +858,13 @@ gtk_tree_model_sort_row_deleted (GtkTreeModel *s_model,
     if (elt->offset == g_array_index (level->array, SortElt, i).offset)
       break;
 
+  if (g_array_index (level->array, SortElt, i).dirty)
+    {
+      g_array_index (level->array, SortElt, i).dirty = FALSE;
+      if (--level->n_dirty == 0)
+	gtk_tree_model_sort_level_clear_dirty (tree_model_sort, level);
+    }
+
   g_array_remove_index (level->array, i);
 
   /* update all offsets */
@@ -1550,6 +1635,116 @@ gtk_tree_model_sort_offset_compare_func (gconstpointer a,
   return retval;
 }
 
+/* Fills in @data for sorting @level; returns %FALSE if there is no
+ * sort function.
+ */
+static gboolean
+gtk_tree_model_sort_setup_sort_data (GtkTreeModelSort *tree_model_sort,
+				     SortLevel        *level,
+				     SortData         *data)
+{
+  if (tree_model_sort->sort_column_id == GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID)
+    return FALSE;
+
+  if (tree_model_sort->sort_column_id != GTK_TREE_SORTABLE_DEFAULT_SORT_COLUMN_ID)
+    {
+      GtkTreeDataSortHeader *header = NULL;
+
+      header = _gtk_tree_data_list_get_header (tree_model_sort->sort_list,
+					       tree_model_sort->sort_column_id);
+
+      g_return_val_if_fail (header != NULL, FALSE);
+      g_return_val_if_fail (header->func != NULL, FALSE);
+
+      data->sort_func = header->func;
+      data->sort_data = header->data;
+    }
+  else
+    {
+      /* absolutely SHOULD NOT happen: */
+      g_return_val_if_fail (tree_model_sort->default_sort_func != NULL, FALSE);
+
+      data->sort_func = tree_model_sort->default_sort_func;
+      data->sort_data = tree_model_sort->default_sort_data;
+    }
+
+  data->tree_model_sort = tree_model_sort;
+  if (level->parent_elt_index >= 0)
+    {
+      data->parent_path = gtk_tree_model_sort_elt_get_path (level->parent_level,
+							    SORT_LEVEL_PARENT_ELT (level));
+      gtk_tree_path_append_index (data->parent_path, 0);
+    }
+  else
+    {
+      data->parent_path = gtk_tree_path_new_first ();
+    }
+  data->parent_path_depth = gtk_tree_path_get_depth (data->parent_path);
+  data->parent_path_indices = gtk_tree_path_get_indices (data->parent_path);
+
+  return TRUE;
+}
+
+static void
+gtk_tree_model_sort_emit_level_reordered (GtkTreeModelSort *tree_model_sort,
+					  SortLevel        *level,
+					  gint             *new_order)
+{
+  GtkTreeIter iter;
+  GtkTreePath *path;
+
+  gtk_tree_model_sort_increment_stamp (tree_model_sort);
+  if (level->parent_elt_index >= 0)
+    {
+      iter.stamp = tree_model_sort->stamp;
+      iter.user_data = level->parent_level;
+      iter.user_data2 = SORT_LEVEL_PARENT_ELT (level);
+
+      path = gtk_tree_model_get_path (GTK_TREE_MODEL (tree_model_sort),
+				      &iter);
+
+      gtk_tree_model_rows_reordered (GTK_TREE_MODEL (tree_model_sort), path,
+				     &iter, new_order);
+    }
+  else
+    {
+      /* toplevel list */
+      path = gtk_tree_path_new ();
+      gtk_tree_model_rows_reordered (GTK_TREE_MODEL (tree_model_sort), path,
+				     NULL, new_order);
+    }
+
+  gtk_tree_path_free (path);
+}
+
+/* gtk_tree_model_sort_sort_level() and gtk_tree_model_sort_resort_level()
+ * move elements around and possibly emit signals, which can cause nodes
+ * to be unreffed.  They keep a reference on the element at @ref_offset
+ * so that @level does not get freed under them.
+ */
+static void
+gtk_tree_model_sort_level_unref_offset (GtkTreeModelSort *tree_model_sort,
+					SortLevel        *level,
+					gint              ref_offset)
+{
+  GtkTreeIter iter;
+  gint i;
+
+  iter.stamp = tree_model_sort->stamp;
+  iter.user_data = level;
+
+  for (i = 0; i < level->array->len; i++)
+    {
+      if (g_array_index (level->array, SortElt, i).offset == ref_offset)
+        {
+	  iter.user_data2 = &g_array_index (level->array, SortElt, i);
+	  break;
+	}
+    }
+
+  gtk_tree_model_sort_unref_node (GTK_TREE_MODEL (tree_model_sort), &iter);
+}
+
 static void
 gtk_tree_model_sort_sort_level (GtkTreeModelSort *tree_model_sort,
 				SortLevel        *level,
@@ -1563,7 +1758,6 @@ gtk_tree_model_sort_sort_level (GtkTreeModelSort *tree_model_sort,
   gint *new_order;
 
   GtkTreeIter iter;
-  GtkTreePath *path;
 
   SortData data;
 
@@ -1572,6 +1766,13 @@ gtk_tree_model_sort_sort_level (GtkTreeModelSort *tree_model_sort,
   if (level->array->len < 1 && !((SortElt *)level->array->data)->children)
     return;
 
+  if (!gtk_tree_model_sort_setup_sort_data (tree_model_sort, level, &data))
+    return;
+
+  /* a full sort supersedes a pending resort */
+  if (level->n_dirty > 0)
+    gtk_tree_model_sort_level_clear_dirty (tree_model_sort, level);
+
   iter.stamp = tree_model_sort->stamp;
   iter.user_data = level;
   iter.user_data2 = &g_array_index (level->array, SortElt, 0);
@@ -1579,21 +1780,6 @@ gtk_tree_model_sort_sort_level (GtkTreeModelSort *tree_model_sort,
   gtk_tree_model_sort_ref_node (GTK_TREE_MODEL (tree_model_sort), &iter);
   ref_offset = g_array_index (level->array, SortElt, 0).offset;
 
-  /* Set up data */
-  data.tree_model_sort = tree_model_sort;
-  if (level->parent_elt_index >= 0)
-    {
-      data.parent_path = gtk_tree_model_sort_elt_get_path (level->parent_level,
-							   SORT_LEVEL_PARENT_ELT (level));
-      gtk_tree_path_append_index (data.parent_path, 0);
-    }
-  else
-    {
-      data.parent_path = gtk_tree_path_new_first ();
-    }
-  data.parent_path_depth = gtk_tree_path_get_depth (data.parent_path);
-  data.parent_path_indices = gtk_tree_path_get_indices (data.parent_path);
-
   /* make the array to be sorted */
   sort_array = g_array_sized_new (FALSE, FALSE, sizeof (SortTuple), level->array->len);
   for (i = 0; i < level->array->len; i++)
@@ -1606,28 +1792,6 @@ gtk_tree_model_sort_sort_level (GtkTreeModelSort *tree_model_sort,
       g_array_append_val (sort_array, tuple);
     }
 
-    if (tree_model_sort->sort_column_id != GTK_TREE_SORTABLE_DEFAULT_SORT_COLUMN_ID)
-      {
-	GtkTreeDataSortHeader *header = NULL;
-
-	header = _gtk_tree_data_list_get_header (tree_model_sort->sort_list,
-						 tree_model_sort->sort_column_id);
-
-	g_return_if_fail (header != NULL);
-	g_return_if_fail (header->func != NULL);
-
-	data.sort_func = header->func;
-	data.sort_data = header->data;
-      }
-    else
-      {
-	/* absolutely SHOULD NOT happen: */
-	g_return_if_fail (tree_model_sort->default_sort_func != NULL);
-
-	data.sort_func = tree_model_sort->default_sort_func;
-	data.sort_data = tree_model_sort->default_sort_data;
-      }
-
   if (data.sort_func == NO_SORT_FUNC)
     g_array_sort_with_data (sort_array,
 			    gtk_tree_model_sort_offset_compare_func,
@@ -1659,30 +1823,7 @@ gtk_tree_model_sort_sort_level (GtkTreeModelSort *tree_model_sort,
   g_array_free (sort_array, TRUE);
 
   if (emit_reordered)
-    {
-      gtk_tree_model_sort_increment_stamp (tree_model_sort);
-      if (level->parent_elt_index >= 0)
-	{
-	  iter.stamp = tree_model_sort->stamp;
-	  iter.user_data = level->parent_level;
-	  iter.user_data2 = SORT_LEVEL_PARENT_ELT (level);
-
-	  path = gtk_tree_model_get_path (GTK_TREE_MODEL (tree_model_sort),
-					  &iter);
-
-	  gtk_tree_model_rows_reordered (GTK_TREE_MODEL (tree_model_sort), path,
-					 &iter, new_order);
-	}
-      else
-	{
-	  /* toplevel list */
-	  path = gtk_tree_path_new ();
-	  gtk_tree_model_rows_reordered (GTK_TREE_MODEL (tree_model_sort), path,
-					 NULL, new_order);
-	}
-
-      gtk_tree_path_free (path);
-    }
+    gtk_tree_model_sort_emit_level_reordered (tree_model_sort, level, new_order);
 
   /* recurse, if possible */
   if (recurse)
@@ -1703,19 +1844,7 @@ gtk_tree_model_sort_sort_level (GtkTreeModelSort *tree_model_sort,
   /* get the iter we referenced at the beginning of this function and
    * unref it again
    */
-  iter.stamp = tree_model_sort->stamp;
-  iter.user_data = level;
-
-  for (i = 0; i < level->array->len; i++)
-    {
-      if (g_array_index (level->array, SortElt, i).offset == ref_offset)
-        {
-	  iter.user_data2 = &g_array_index (level->array, SortElt, i);
-	  break;
-	}
-    }
-
-  gtk_tree_model_sort_unref_node (GTK_TREE_MODEL (tree_model_sort), &iter);
+  gtk_tree_model_sort_level_unref_offset (tree_model_sort, level, ref_offset);
 }
 
 static void
@@ -1745,6 +1874,279 @@ gtk_tree_model_sort_sort (GtkTreeModelSort *tree_model_sort)
 				  TRUE, TRUE);
 }
 
+/* deferred resort */
+static void
+gtk_tree_model_sort_level_clear_dirty (GtkTreeModelSort *tree_model_sort,
+				       SortLevel        *level)
+{
+  GtkTreeModelSortPrivate *priv = GTK_TREE_MODEL_SORT_GET_PRIVATE (tree_model_sort);
+  gint i;
+
+  for (i = 0; i < level->array->len; i++)
+    g_array_index (level->array, SortElt, i).dirty = FALSE;
+
+  level->n_dirty = 0;
+  priv->dirty_levels = g_slist_remove (priv->dirty_levels, level);
+}
+
+/* Moves the dirty elements of @level into place.  The clean elements are
+ * still sorted relative to each other, so only the dirty ones need to be
+ * sorted, after which both runs are merged in a single pass.  Ties are
+ * broken by the previous position, which gives the same order as a full
+ * stable sort would.
+ */
+static void
+gtk_tree_model_sort_resort_level (GtkTreeModelSort *tree_model_sort,
+				  SortLevel        *level)
+{
+  gint i, j, k;
+  gint ref_offset;
+  gint len = level->array->len;
+  GArray *clean, *dirty;
+  GArray *new_array;
+  gint *new_order;
+  gboolean reordered = FALSE;
+
+  GtkTreeIter iter;
+
+  SortData data;
+
+  if (len < 2 || !gtk_tree_model_sort_setup_sort_data (tree_model_sort, level, &data))
+    {
+      for (i = 0; i < len; i++)
+	g_array_index (level->array, SortElt, i).dirty = FALSE;
+      level->n_dirty = 0;
+      return;
+    }
+
+  iter.stamp = tree_model_sort->stamp;
+  iter.user_data = level;
+  iter.user_data2 = &g_array_index (level->array, SortElt, 0);
+
+  gtk_tree_model_sort_ref_node (GTK_TREE_MODEL (tree_model_sort), &iter);
+  ref_offset = g_array_index (level->array, SortElt, 0).offset;
+
+  clean = g_array_sized_new (FALSE, FALSE, sizeof (SortTuple), len - level->n_dirty);
+  dirty = g_array_sized_new (FALSE, FALSE, sizeof (SortTuple), level->n_dirty);
+
+  for (i = 0; i < len; i++)
+    {
+      SortTuple tuple;
+
+      tuple.elt = &g_array_index (level->array, SortElt, i);
+      tuple.offset = i;
+
+      if (tuple.elt->dirty)
+	g_array_append_val (dirty, tuple);
+      else
+	g_array_append_val (clean, tuple);
+    }
+
+  if (data.sort_func == NO_SORT_FUNC)
+    g_array_sort_with_data (dirty,
+			    gtk_tree_model_sort_offset_compare_func,
+			    &data);
+  else
+    g_array_sort_with_data (dirty,
+			    gtk_tree_model_sort_compare_func,
+			    &data);
+
+  new_array = g_array_sized_new (FALSE, FALSE, sizeof (SortElt), len);
+  new_order = g_new (gint, len);
+
+  i = j = 0;
+  for (k = 0; k < len; k++)
+    {
+      SortTuple *tuple;
+
+      if (j >= dirty->len)
+	tuple = &g_array_index (clean, SortTuple, i++);
+      else if (i >= clean->len)
+	tuple = &g_array_index (dirty, SortTuple, j++);
+      else
+	{
+	  SortTuple *a = &g_array_index (clean, SortTuple, i);
+	  SortTuple *b = &g_array_index (dirty, SortTuple, j);
+	  gint cmp;
+
+	  if (data.sort_func == NO_SORT_FUNC)
+	    cmp = gtk_tree_model_sort_offset_compare_func (a, b, &data);
+	  else
+	    cmp = gtk_tree_model_sort_compare_func (a, b, &data);
+
+	  if (cmp < 0 || (cmp == 0 && a->offset < b->offset))
+	    tuple = a, i++;
+	  else
+	    tuple = b, j++;
+	}
+
+      tuple->elt->dirty = FALSE;
+      new_order[k] = tuple->offset;
+      if (new_order[k] != k)
+	reordered = TRUE;
+
+      g_array_append_val (new_array, *tuple->elt);
+      if (tuple->elt->children)
+	tuple->elt->children->parent_elt_index = k;
+    }
+
+  gtk_tree_path_free (data.parent_path);
+  g_array_free (clean, TRUE);
+  g_array_free (dirty, TRUE);
+
+  g_array_free (level->array, TRUE);
+  level->array = new_array;
+  level->n_dirty = 0;
+
+  if (reordered)
+    gtk_tree_model_sort_emit_level_reordered (tree_model_sort, level, new_order);
+
+  g_free (new_order);
+
+  gtk_tree_model_sort_level_unref_offset (tree_model_sort, level, ref_offset);
+}
+
+static gboolean
+gtk_tree_model_sort_resort_idle (gpointer data)
+{
+  GtkTreeModelSort *tree_model_sort = GTK_TREE_MODEL_SORT (data);
+
+  GTK_TREE_MODEL_SORT_GET_PRIVATE (tree_model_sort)->resort_idle_id = 0;
+  gtk_tree_model_sort_flush_resort (tree_model_sort);
+
+  return FALSE;
+}
+
+static void
+gtk_tree_model_sort_queue_resort (GtkTreeModelSort *tree_model_sort)
+{
+  GtkTreeModelSortPrivate *priv = GTK_TREE_MODEL_SORT_GET_PRIVATE (tree_model_sort);
+
+  /* run before views get to resize or redraw */
+  if (!priv->resort_idle_id)
+    priv->resort_idle_id =
+      gdk_threads_add_idle_full (G_PRIORITY_HIGH_IDLE,
+				 gtk_tree_model_sort_resort_idle,
+				 tree_model_sort, NULL);
+}
+
+static void
+gtk_tree_model_sort_cancel_resort (GtkTreeModelSort *tree_model_sort)
+{
+  GtkTreeModelSortPrivate *priv = GTK_TREE_MODEL_SORT_GET_PRIVATE (tree_model_sort);
+
+  if (priv->resort_idle_id)
+    {
+      g_source_remove (priv->resort_idle_id);
+      priv->resort_idle_id = 0;
+    }
+
+  while (priv->dirty_levels)
+    gtk_tree_model_sort_level_clear_dirty (tree_model_sort,
+					   priv->dirty_levels->data);
+}
+
+/**
+ * gtk_tree_model_sort_set_deferred_resort:
+ * @tree_model_sort: A #GtkTreeModelSort
+ * @deferred: whether to defer resorting changed rows
+ *
+ * Normally, every row that changes in the child model is moved to its
+ * new position right away, emitting ::rows-reordered each time.  When
+ * many rows change at once, for instance in a table that is updated
+ * live, this is expensive.
+ *
+ * With deferred resort enabled, changed and inserted rows keep their
+ * position (inserted rows are appended) until the pending changes are
+ * applied from an idle handler or by gtk_tree_model_sort_flush_resort().
+ * All rows of a level are then moved into place at once, and a single
+ * ::rows-reordered is emitted per level.
+ *
+ * Disabling deferred resort flushes any pending changes.
+ *
+ * Since: 2.22
+ **/
+void
+gtk_tree_model_sort_set_deferred_resort (GtkTreeModelSort *tree_model_sort,
+					 gboolean          deferred)
+{
+  GtkTreeModelSortPrivate *priv;
+
+  g_return_if_fail (GTK_IS_TREE_MODEL_SORT (tree_model_sort));
+
+  priv = GTK_TREE_MODEL_SORT_GET_PRIVATE (tree_model_sort);
+
+  deferred = deferred != FALSE;
+
+  if (priv->deferred_resort == deferred)
+    return;
+
+  if (!deferred)
+    gtk_tree_model_sort_flush_resort (tree_model_sort);
+
+  priv->deferred_resort = deferred;
+
+  g_object_notify (G_OBJECT (tree_model_sort), "deferred-resort");
+}
+
+/**
+ * gtk_tree_model_sort_get_deferred_resort:
+ * @tree_model_sort: A #GtkTreeModelSort
+ *
+ * Returns whether deferred resort is enabled.
+ * See gtk_tree_model_sort_set_deferred_resort().
+ *
+ * Return value: %TRUE if changed rows are resorted in a batch
+ *
+ * Since: 2.22
+ **/
+gboolean
+gtk_tree_model_sort_get_deferred_resort (GtkTreeModelSort *tree_model_sort)
+{
+  g_return_val_if_fail (GTK_IS_TREE_MODEL_SORT (tree_model_sort), FALSE);
+
+  return GTK_TREE_MODEL_SORT_GET_PRIVATE (tree_model_sort)->deferred_resort;
+}
+
+/**
+ * gtk_tree_model_sort_flush_resort:
+ * @tree_model_sort: A #GtkTreeModelSort
+ *
+ * Moves all rows that changed since the last resort to their sorted
+ * position, emitting one ::rows-reordered for each affected level.
+ * This only has an effect if deferred resort is enabled, see
+ * gtk_tree_model_sort_set_deferred_resort().
+ *
+ * Since: 2.22
+ **/
+void
+gtk_tree_model_sort_flush_resort (GtkTreeModelSort *tree_model_sort)
+{
+  GtkTreeModelSortPrivate *priv;
+
+  g_return_if_fail (GTK_IS_TREE_MODEL_SORT (tree_model_sort));
+
+  priv = GTK_TREE_MODEL_SORT_GET_PRIVATE (tree_model_sort);
+
+  if (priv->resort_idle_id)
+    {
+      g_source_remove (priv->resort_idle_id);
+      priv->resort_idle_id = 0;
+    }
+
+  /* Pop one level at a time; emitting ::rows-reordered can cause other
+   * pending levels to be freed, which removes them from the list.
+   */
+  while (priv->dirty_levels)
+    {
+      SortLevel *level = priv->dirty_levels->data;
+
+      priv->dirty_levels = g_slist_delete_link (priv->dirty_levels,
+						priv->dirty_levels);
+      gtk_tree_model_sort_resort_level (tree_model_sort, level);
+    }
+}
+
 /* signal helpers */
 static gint
 gtk_tree_model_sort_level_find_insert (GtkTreeModelSort *tree_model_sort,
@@ -1849,6 +2251,7 @@ gtk_tree_model_sort_insert_value (GtkTreeModelSort *tree_model_sort,
   elt.zero_ref_count = 0;
   elt.ref_count = 0;
   elt.children = NULL;
+  elt.dirty = FALSE;
 
   /* update all larger offsets */
   tmp_elt = SORT_ELT (level->array->data);
@@ -1859,6 +2262,12 @@ gtk_tree_model_sort_insert_value (GtkTreeModelSort *tree_model_sort,
   if (tree_model_sort->sort_column_id == GTK_TREE_SORTABLE_DEFAULT_SORT_COLUMN_ID &&
       tree_model_sort->default_sort_func == NO_SORT_FUNC)
     index = offset;
+  else if (GTK_TREE_MODEL_SORT_GET_PRIVATE (tree_model_sort)->deferred_resort)
+    {
+      /* append for now, the pending resort moves it into place */
+      index = level->array->len;
+      elt.dirty = TRUE;
+    }
   else
     index = gtk_tree_model_sort_level_find_insert (tree_model_sort,
                                                    level, s_iter,
@@ -1870,6 +2279,16 @@ gtk_tree_model_sort_insert_value (GtkTreeModelSort *tree_model_sort,
     if (tmp_elt->children)
       tmp_elt->children->parent_elt_index = i;
 
+  if (elt.dirty)
+    {
+      GtkTreeModelSortPrivate *priv = GTK_TREE_MODEL_SORT_GET_PRIVATE (tree_model_sort);
+
+      if (level->n_dirty++ == 0)
+	priv->dirty_levels = g_slist_prepend (priv->dirty_levels, level);
+
+      gtk_tree_model_sort_queue_resort (tree_model_sort);
+    }
+
   return TRUE;
 }
 
@@ -1932,6 +2351,7 @@ gtk_tree_model_sort_set_model (GtkTreeModelSort *tree_model_sort,
 				   tree_model_sort->reordered_id);
 
       /* reset our state */
+      gtk_tree_model_sort_cancel_resort (tree_model_sort);
       if (tree_model_sort->root)
 	gtk_tree_model_sort_free_level (tree_model_sort, tree_model_sort->root);
       tree_model_sort->root = NULL;
@@ -2276,6 +2696,7 @@ gtk_tree_model_sort_build_level (GtkTreeModelSort *tree_model_sort,
   new_level = g_new (SortLevel, 1);
   new_level->array = g_array_sized_new (FALSE, FALSE, sizeof (SortElt), length);
   new_level->ref_count = 0;
+  new_level->n_dirty = 0;
   new_level->parent_level = parent_level;
   new_level->parent_elt_index = parent_elt_index;
 
@@ -2303,6 +2724,7 @@ gtk_tree_model_sort_build_level (GtkTreeModelSort *tree_model_sort,
       sort_elt.zero_ref_count = 0;
       sort_elt.ref_count = 0;
       sort_elt.children = NULL;
+      sort_elt.dirty = FALSE;
 
       if (GTK_TREE_MODEL_SORT_CACHE_CHILD_ITERS (tree_model_sort))
 	{
@@ -2377,6 +2799,9 @@ gtk_tree_model_sort_free_level (GtkTreeModelSort *tree_model_sort,
 	tree_model_sort->zero_ref_count--;
     }
 
+  if (sort_level->n_dirty > 0)
+    gtk_tree_model_sort_level_clear_dirty (tree_model_sort, sort_level);
+
   if (sort_level->parent_elt_index >= 0)
     SORT_LEVEL_PARENT_ELT (sort_level)->children = NULL;
   else
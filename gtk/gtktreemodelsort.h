@@ -99,6 +99,10 @@ void          gtk_tree_model_sort_reset_default_sort_func    (GtkTreeModelSort *
 void          gtk_tree_model_sort_clear_cache                (GtkTreeModelSort *tree_model_sort);
 gboolean      gtk_tree_model_sort_iter_is_valid              (GtkTreeModelSort *tree_model_sort,
                                                               GtkTreeIter      *iter);
+void          gtk_tree_model_sort_set_deferred_resort        (GtkTreeModelSort *tree_model_sort,
+                                                              gboolean          deferred);
+gboolean      gtk_tree_model_sort_get_deferred_resort        (GtkTreeModelSort *tree_model_sort);
+void          gtk_tree_model_sort_flush_resort               (GtkTreeModelSort *tree_model_sort);
 
 
 G_END_DECLS
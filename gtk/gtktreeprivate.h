@@ -77,6 +77,8 @@ enum
   */
 #define TREE_VIEW_COLUMN_DRAG_DEAD_MULTIPLIER(tree_view) (10*TREE_VIEW_HEADER_HEIGHT(tree_view))
 
+typedef struct _GtkTreeViewSearchIndex GtkTreeViewSearchIndex;
+
 typedef struct _GtkTreeViewColumnReorder GtkTreeViewColumnReorder;
 struct _GtkTreeViewColumnReorder
 {
@@ -222,6 +224,10 @@ struct _GtkTreeViewPrivate
 
   /* fixed height */
   gint fixed_height;
+  GArray *fixed_heights;	/* per depth, -1 if unknown, -2 if to be measured */
+  GtkTreeViewRowHeightFunc fixed_height_func;
+  gpointer fixed_height_data;
+  GDestroyNotify fixed_height_destroy;
 
   /* Scroll-to functionality when unrealized */
   GtkTreeRowReference *scroll_to_path;
@@ -242,6 +248,7 @@ struct _GtkTreeViewPrivate
   GtkWidget *search_entry;
   guint search_entry_changed_id;
   guint typeselect_flush_timeout;
+  GtkTreeViewSearchIndex *search_index;
 
   /* Grid and tree lines */
   GtkTreeViewGridLines grid_lines;
@@ -285,6 +292,7 @@ struct _GtkTreeViewPrivate
   guint enable_search : 1;
   guint disable_popdown : 1;
   guint search_custom_entry_set : 1;
+  guint enable_search_index : 1;
   
   guint hover_selection : 1;
   guint hover_expand : 1;
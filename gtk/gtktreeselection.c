@@ -460,6 +460,9 @@ gtk_tree_selection_get_selected_rows (GtkTreeSelection   *selection,
   tree = selection->tree_view->priv->tree;
   node = selection->tree_view->priv->tree->root;
 
+  if (node->n_selected == 0)
+    return NULL;
+
   while (node->left != tree->nil)
     node = node->left;
   path = gtk_tree_path_new_first ();
@@ -517,22 +520,6 @@ gtk_tree_selection_get_selected_rows (GtkTreeSelection   *selection,
   return g_list_reverse (list);
 }
 
-static void
-gtk_tree_selection_count_selected_rows_helper (GtkRBTree *tree,
-					       GtkRBNode *node,
-					       gpointer   data)
-{
-  gint *count = (gint *)data;
-
-  if (GTK_RBNODE_FLAG_SET (node, GTK_RBNODE_IS_SELECTED))
-    (*count)++;
-
-  if (node->children)
-    _gtk_rbtree_traverse (node->children, node->children->root,
-			  G_PRE_ORDER,
-			  gtk_tree_selection_count_selected_rows_helper, data);
-}
-
 /**
  * gtk_tree_selection_count_selected_rows:
  * @selection: A #GtkTreeSelection.
@@ -546,8 +533,6 @@ gtk_tree_selection_count_selected_rows_helper (GtkRBTree *tree,
 gint
 gtk_tree_selection_count_selected_rows (GtkTreeSelection *selection)
 {
-  gint count = 0;
-
   g_return_val_if_fail (GTK_IS_TREE_SELECTION (selection), 0);
   g_return_val_if_fail (selection->tree_view != NULL, 0);
 
@@ -564,13 +549,144 @@ gtk_tree_selection_count_selected_rows (GtkTreeSelection *selection)
 	return 0;
     }
 
-  _gtk_rbtree_traverse (selection->tree_view->priv->tree,
-                        selection->tree_view->priv->tree->root,
-			G_PRE_ORDER,
-			gtk_tree_selection_count_selected_rows_helper,
-			&count);
+  /* the root node keeps count of all selected rows */
+  return selection->tree_view->priv->tree->root->n_selected;
+}
+
+/* gtk_tree_selection_get_selected_ranges helper */
+typedef struct
+{
+  GtkTreeView *tree_view;
+  GList *list;
+  GtkRBTree *last_tree;
+  GtkRBNode *last_node;
+} RangeData;
+
+static void
+get_selected_ranges_close (RangeData *data)
+{
+  if (data->last_node == NULL)
+    return;
+
+  data->list = g_list_prepend (data->list,
+			       _gtk_tree_view_find_path (data->tree_view,
+							 data->last_tree,
+							 data->last_node));
+  data->last_tree = NULL;
+  data->last_node = NULL;
+}
+
+/* Walks the rows in display order, skipping subtrees without any
+ * selected rows.  Paths are only computed at the ends of each range.
+ */
+static void
+get_selected_ranges_helper (GtkRBTree *tree,
+			    GtkRBNode *node,
+			    RangeData *data)
+{
+  if (node == tree->nil)
+    return;
+
+  if (node->n_selected == 0)
+    {
+      /* a run of unselected rows ends the current range */
+      get_selected_ranges_close (data);
+      return;
+    }
+
+  get_selected_ranges_helper (tree, node->left, data);
+
+  if (GTK_RBNODE_FLAG_SET (node, GTK_RBNODE_IS_SELECTED))
+    {
+      if (data->last_node == NULL)
+	data->list = g_list_prepend (data->list,
+				     _gtk_tree_view_find_path (data->tree_view,
+							       tree, node));
+      data->last_tree = tree;
+      data->last_node = node;
+    }
+  else
+    get_selected_ranges_close (data);
+
+  if (node->children)
+    get_selected_ranges_helper (node->children, node->children->root, data);
+
+  get_selected_ranges_helper (tree, node->right, data);
+}
+
+/**
+ * gtk_tree_selection_get_selected_ranges:
+ * @selection: A #GtkTreeSelection.
+ * @model: (allow-none): A pointer to set to the #GtkTreeModel, or %NULL.
+ *
+ * Returns the selection as a list of ranges of consecutive selected rows,
+ * in the order they are displayed.  Each range is given by two paths, the
+ * first and the last row of the range, so the list holds two paths per
+ * range; for a range of a single row both paths are equal.  The paths can
+ * be passed on to gtk_tree_selection_select_range() and
+ * gtk_tree_selection_unselect_range().
+ *
+ * Unlike gtk_tree_selection_get_selected_rows(), this function only
+ * creates paths for the ends of each range and skips over unselected
+ * parts of the tree, which makes it suitable for large selections.
+ *
+ * To free the return value, use:
+ * |[
+ * g_list_foreach (list, (GFunc) gtk_tree_path_free, NULL);
+ * g_list_free (list);
+ * ]|
+ *
+ * Return value: (element-type GtkTreePath) (transfer full): A #GList
+ * containing the first and last #GtkTreePath of each selected range.
+ *
+ * Since: 2.22
+ **/
+GList *
+gtk_tree_selection_get_selected_ranges (GtkTreeSelection  *selection,
+					GtkTreeModel     **model)
+{
+  RangeData data;
 
-  return count;
+  g_return_val_if_fail (GTK_IS_TREE_SELECTION (selection), NULL);
+  g_return_val_if_fail (selection->tree_view != NULL, NULL);
+
+  if (model)
+    *model = selection->tree_view->priv->model;
+
+  if (selection->tree_view->priv->tree == NULL ||
+      selection->tree_view->priv->tree->root == NULL)
+    return NULL;
+
+  if (selection->type == GTK_SELECTION_NONE)
+    return NULL;
+  else if (selection->type != GTK_SELECTION_MULTIPLE)
+    {
+      GtkTreeIter iter;
+      GList *list = NULL;
+
+      if (gtk_tree_selection_get_selected (selection, NULL, &iter))
+        {
+	  GtkTreePath *path;
+
+	  path = gtk_tree_model_get_path (selection->tree_view->priv->model, &iter);
+	  list = g_list_prepend (list, gtk_tree_path_copy (path));
+	  list = g_list_prepend (list, path);
+	}
+
+      return list;
+    }
+
+  data.tree_view = selection->tree_view;
+  data.list = NULL;
+  data.last_tree = NULL;
+  data.last_node = NULL;
+
+  get_selected_ranges_helper (selection->tree_view->priv->tree,
+			      selection->tree_view->priv->tree->root,
+			      &data);
+  get_selected_ranges_close (&data);
+
+  return g_list_reverse (data.list);
 }
 
 /* gtk_tree_selection_selected_foreach helper */
@@ -629,6 +745,9 @@ gtk_tree_selection_selected_foreach (GtkTreeSelection            *selection,
 
   tree = selection->tree_view->priv->tree;
   node = selection->tree_view->priv->tree->root;
+
+  if (node->n_selected == 0)
+    return;
   
   while (node->left != tree->nil)
     node = node->left;
@@ -933,6 +1052,17 @@ struct _TempTuple {
   gint dirty;
 };
 
+/* If there is neither a select function nor a row separator function,
+ * every row can be selected, and bulk operations can flip the flags
+ * directly instead of asking about each row.
+ */
+static gboolean
+gtk_tree_selection_all_rows_selectable (GtkTreeSelection *selection)
+{
+  return (selection->user_func == NULL &&
+	  selection->tree_view->priv->row_separator_func == NULL);
+}
+
 static void
 select_all_helper (GtkRBTree  *tree,
 		   GtkRBNode  *node,
@@ -964,6 +1094,15 @@ gtk_tree_selection_real_select_all (GtkTreeSelection *selection)
   if (selection->tree_view->priv->tree == NULL)
     return FALSE;
 
+  if (gtk_tree_selection_all_rows_selectable (selection))
+    {
+      if (_gtk_rbtree_set_selected (selection->tree_view->priv->tree, TRUE) == 0)
+	return FALSE;
+
+      gtk_widget_queue_draw (GTK_WIDGET (selection->tree_view));
+      return TRUE;
+    }
+
   /* Mark all nodes selected */
   tuple = g_new (struct _TempTuple, 1);
   tuple->selection = selection;
@@ -1006,18 +1145,19 @@ gtk_tree_selection_select_all (GtkTreeSelection *selection)
 }
 
 static void
-unselect_all_helper (GtkRBTree  *tree,
-		     GtkRBNode  *node,
-		     gpointer    data)
+unselect_all_helper (GtkRBTree         *tree,
+		     GtkRBNode         *node,
+		     struct _TempTuple *tuple)
 {
-  struct _TempTuple *tuple = data;
+  /* skip subtrees without any selected rows */
+  if (node == tree->nil || node->n_selected == 0)
+    return;
 
+  unselect_all_helper (tree, node->left, tuple);
+  unselect_all_helper (tree, node->right, tuple);
   if (node->children)
-    _gtk_rbtree_traverse (node->children,
-			  node->children->root,
-			  G_PRE_ORDER,
-			  unselect_all_helper,
-			  data);
+    unselect_all_helper (node->children, node->children->root, tuple);
+
   if (GTK_RBNODE_FLAG_SET (node, GTK_RBNODE_IS_SELECTED))
     {
       tuple->dirty = gtk_tree_selection_real_select_node (tuple->selection, tree, node, FALSE) || tuple->dirty;
@@ -1065,17 +1205,23 @@ gtk_tree_selection_real_unselect_all (GtkTreeSelection *selection)
 	}
       return FALSE;
     }
+  else if (gtk_tree_selection_all_rows_selectable (selection))
+    {
+      if (_gtk_rbtree_set_selected (selection->tree_view->priv->tree, FALSE) == 0)
+	return FALSE;
+
+      gtk_widget_queue_draw (GTK_WIDGET (selection->tree_view));
+      return TRUE;
+    }
   else
     {
       tuple = g_new (struct _TempTuple, 1);
       tuple->selection = selection;
       tuple->dirty = FALSE;
 
-      _gtk_rbtree_traverse (selection->tree_view->priv->tree,
-                            selection->tree_view->priv->tree->root,
-                            G_PRE_ORDER,
-                            unselect_all_helper,
-                            tuple);
+      unselect_all_helper (selection->tree_view->priv->tree,
+                           selection->tree_view->priv->tree->root,
+                           tuple);
 
       if (tuple->dirty)
         {
@@ -1122,6 +1268,7 @@ gtk_tree_selection_real_modify_range (GtkTreeSelection *selection,
   GtkRBTree *start_tree, *end_tree;
   GtkTreePath *anchor_path = NULL;
   gboolean dirty = FALSE;
+  gboolean bulk;
 
   switch (gtk_tree_path_compare (start_path, end_path))
     {
@@ -1172,9 +1319,23 @@ gtk_tree_selection_real_modify_range (GtkTreeSelection *selection,
 					  anchor_path);
     }
 
+  /* For a plain selection, flip the flags without looking up each row
+   * and redraw the view once at the end.
+   */
+  bulk = gtk_tree_selection_all_rows_selectable (selection);
+
   do
     {
-      dirty |= gtk_tree_selection_real_select_node (selection, start_tree, start_node, (mode == RANGE_SELECT)?TRUE:FALSE);
+      if (bulk)
+	{
+	  if (GTK_RBNODE_FLAG_SET (start_node, GTK_RBNODE_IS_SELECTED) != (mode == RANGE_SELECT))
+	    {
+	      _gtk_rbtree_node_set_selected (start_tree, start_node, mode == RANGE_SELECT);
+	      dirty = TRUE;
+	    }
+	}
+      else
+	dirty |= gtk_tree_selection_real_select_node (selection, start_tree, start_node, (mode == RANGE_SELECT)?TRUE:FALSE);
 
       if (start_node == end_node)
 	break;
@@ -1193,12 +1354,15 @@ gtk_tree_selection_real_modify_range (GtkTreeSelection *selection,
 	    {
 	      /* we just ran out of tree.  That means someone passed in bogus values.
 	       */
-	      return dirty;
+	      break;
 	    }
 	}
     }
   while (TRUE);
 
+  if (bulk && dirty)
+    gtk_widget_queue_draw (GTK_WIDGET (selection->tree_view));
+
   return dirty;
 }
 
@@ -1457,7 +1621,7 @@ gtk_tree_selection_real_select_node (GtkTreeSelection *selection,
 
   if (toggle)
     {
-      node->flags ^= GTK_RBNODE_IS_SELECTED;
+      _gtk_rbtree_node_set_selected (tree, node, select);
 
       _gtk_tree_view_queue_draw_node (selection->tree_view, tree, node, NULL);
       
@@ -94,6 +94,8 @@ gboolean         gtk_tree_selection_get_selected        (GtkTreeSelection
 							 GtkTreeIter                 *iter);
 GList *          gtk_tree_selection_get_selected_rows   (GtkTreeSelection            *selection,
                                                          GtkTreeModel               **model);
+GList *          gtk_tree_selection_get_selected_ranges (GtkTreeSelection            *selection,
+                                                         GtkTreeModel               **model);
 gint             gtk_tree_selection_count_selected_rows (GtkTreeSelection            *selection);
 void             gtk_tree_selection_selected_foreach    (GtkTreeSelection            *selection,
 							 GtkTreeSelectionForeachFunc  func,
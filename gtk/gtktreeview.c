@@ -144,7 +144,8 @@ enum {
   PROP_RUBBER_BANDING,
   PROP_ENABLE_GRID_LINES,
   PROP_ENABLE_TREE_LINES,
-  PROP_TOOLTIP_COLUMN
+  PROP_TOOLTIP_COLUMN,
+  PROP_ENABLE_SEARCH_INDEX
 };
 
 /* object signals */
@@ -340,6 +341,12 @@ static gint     gtk_tree_view_new_column_width               (GtkTreeView
 							      gint               *x);
 static void     gtk_tree_view_adjustment_changed             (GtkAdjustment      *adjustment,
 							      GtkTreeView        *tree_view);
+static gint     gtk_tree_view_get_fixed_height               (GtkTreeView        *tree_view,
+							      GtkRBTree          *tree,
+							      GtkRBNode          *node,
+							      GtkTreeIter        *iter,
+							      gboolean            measure);
+static void     gtk_tree_view_forget_fixed_heights           (GtkTreeView        *tree_view);
 static void     gtk_tree_view_build_tree                     (GtkTreeView        *tree_view,
 							      GtkRBTree          *tree,
 							      GtkTreeIter        *iter,
@@ -431,6 +438,11 @@ static gboolean gtk_tree_view_search_equal_func         (GtkTreeModel     *model
 							 const gchar      *key,
 							 GtkTreeIter      *iter,
 							 gpointer          search_data);
+static void     gtk_tree_view_search_index_free         (GtkTreeView      *tree_view);
+static void     gtk_tree_view_search_index_invalidate   (GtkTreeView      *tree_view);
+static void     gtk_tree_view_search_index_row_changed  (GtkTreeView      *tree_view,
+							 GtkTreePath      *path,
+							 GtkTreeIter      *iter);
 static gboolean gtk_tree_view_search_iter               (GtkTreeModel     *model,
 							 GtkTreeSelection *selection,
 							 GtkTreeIter      *iter,
@@ -767,6 +779,22 @@ gtk_tree_view_class_init (GtkTreeViewClass *class)
 						       -1,
 						       GTK_PARAM_READWRITE));
 
+    /**
+     * GtkTreeView:enable-search-index:
+     *
+     * Whether the interactive search keeps an index of the search column.
+     * See gtk_tree_view_set_enable_search_index().
+     *
+     * Since: 2.22
+     */
+    g_object_class_install_property (o_class,
+                                     PROP_ENABLE_SEARCH_INDEX,
+                                     g_param_spec_boolean ("enable-search-index",
+                                                           P_("Enable Search Index"),
+                                                           P_("Whether the interactive search uses an index of the search column"),
+                                                           FALSE,
+                                                           GTK_PARAM_READWRITE));
+
   /* Style properties */
 #define _TREE_VIEW_EXPANDER_SIZE 12
 #define _TREE_VIEW_VERTICAL_SEPARATOR 2
@@ -1456,6 +1484,9 @@ gtk_tree_view_set_property (GObject         *object,
     case PROP_TOOLTIP_COLUMN:
       gtk_tree_view_set_tooltip_column (tree_view, g_value_get_int (value));
       break;
+    case PROP_ENABLE_SEARCH_INDEX:
+      gtk_tree_view_set_enable_search_index (tree_view, g_value_get_boolean (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1531,6 +1562,9 @@ gtk_tree_view_get_property (GObject    *object,
     case PROP_TOOLTIP_COLUMN:
       g_value_set_int (value, tree_view->priv->tooltip_column);
       break;
+    case PROP_ENABLE_SEARCH_INDEX:
+      g_value_set_boolean (value, tree_view->priv->enable_search_index);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1599,6 +1633,8 @@ gtk_tree_view_destroy (GtkObject *object)
       gtk_tree_view_free_rbtree (tree_view);
     }
 
+  gtk_tree_view_search_index_free (tree_view);
+
   if (tree_view->priv->selection != NULL)
     {
       _gtk_tree_selection_set_tree_view (tree_view->priv->selection, NULL);
@@ -1674,6 +1710,20 @@ gtk_tree_view_destroy (GtkObject *object)
       tree_view->priv->row_separator_destroy (tree_view->priv->row_separator_data);
       tree_view->priv->row_separator_data = NULL;
     }
+
+  if (tree_view->priv->fixed_height_destroy)
+    {
+      tree_view->priv->fixed_height_destroy (tree_view->priv->fixed_height_data);
+      tree_view->priv->fixed_height_destroy = NULL;
+    }
+  tree_view->priv->fixed_height_func = NULL;
+  tree_view->priv->fixed_height_data = NULL;
+
+  if (tree_view->priv->fixed_heights)
+    {
+      g_array_free (tree_view->priv->fixed_heights, TRUE);
+      tree_view->priv->fixed_heights = NULL;
+    }
   
   gtk_tree_view_set_model (tree_view, NULL);
 
@@ -3837,33 +3887,33 @@ gtk_tree_view_update_rubber_band_selection_range (GtkTreeView *tree_view,
       if (select)
         {
 	  if (tree_view->priv->rubber_band_shift)
-	    GTK_RBNODE_SET_FLAG (start_node, GTK_RBNODE_IS_SELECTED);
+	    _gtk_rbtree_node_set_selected (start_tree, start_node, TRUE);
 	  else if (tree_view->priv->rubber_band_ctrl)
 	    {
 	      /* Toggle the selection state */
 	      if (GTK_RBNODE_FLAG_SET (start_node, GTK_RBNODE_IS_SELECTED))
-		GTK_RBNODE_UNSET_FLAG (start_node, GTK_RBNODE_IS_SELECTED);
+		_gtk_rbtree_node_set_selected (start_tree, start_node, FALSE);
 	      else
-		GTK_RBNODE_SET_FLAG (start_node, GTK_RBNODE_IS_SELECTED);
+		_gtk_rbtree_node_set_selected (start_tree, start_node, TRUE);
 	    }
 	  else
-	    GTK_RBNODE_SET_FLAG (start_node, GTK_RBNODE_IS_SELECTED);
+	    _gtk_rbtree_node_set_selected (start_tree, start_node, TRUE);
 	}
       else
         {
 	  /* Mirror the above */
 	  if (tree_view->priv->rubber_band_shift)
-	    GTK_RBNODE_UNSET_FLAG (start_node, GTK_RBNODE_IS_SELECTED);
+	    _gtk_rbtree_node_set_selected (start_tree, start_node, FALSE);
 	  else if (tree_view->priv->rubber_band_ctrl)
 	    {
 	      /* Toggle the selection state */
 	      if (GTK_RBNODE_FLAG_SET (start_node, GTK_RBNODE_IS_SELECTED))
-		GTK_RBNODE_UNSET_FLAG (start_node, GTK_RBNODE_IS_SELECTED);
+		_gtk_rbtree_node_set_selected (start_tree, start_node, FALSE);
 	      else
-		GTK_RBNODE_SET_FLAG (start_node, GTK_RBNODE_IS_SELECTED);
+		_gtk_rbtree_node_set_selected (start_tree, start_node, TRUE);
 	    }
 	  else
-	    GTK_RBNODE_UNSET_FLAG (start_node, GTK_RBNODE_IS_SELECTED);
+	    _gtk_rbtree_node_set_selected (start_tree, start_node, FALSE);
 	}
 
       _gtk_tree_view_queue_draw_node (tree_view, start_tree, start_node, NULL);
@@ -6151,6 +6201,140 @@ validate_visible_area (GtkTreeView *tree_view)
     gtk_widget_queue_draw (GTK_WIDGET (tree_view));
 }
 
+/* Measures the height of @node, which must be invalid */
+static gint
+measure_fixed_height (GtkTreeView *tree_view,
+		      GtkRBTree   *tree,
+		      GtkRBNode   *node,
+		      GtkTreeIter *iter)
+{
+  GtkTreeIter tmp_iter;
+  GtkTreePath *path;
+
+  path = _gtk_tree_view_find_path (tree_view, tree, node);
+  if (!iter)
+    {
+      gtk_tree_model_get_iter (tree_view->priv->model, &tmp_iter, path);
+      iter = &tmp_iter;
+    }
+
+  validate_row (tree_view, tree, node, iter, path);
+
+  gtk_tree_path_free (path);
+
+  return ROW_HEIGHT (tree_view, GTK_RBNODE_GET_HEIGHT (node));
+}
+
+/* Values of priv->fixed_heights besides actual heights */
+#define FIXED_HEIGHT_UNKNOWN  -1	/* the height function wasn't asked yet */
+#define FIXED_HEIGHT_MEASURE  -2	/* it asked for the first row to be measured */
+
+/* Returns the fixed height for rows at the depth of @tree, or -1 if fixed
+ * height mode has not been initialized.  Without a height function, all
+ * rows share the height of the first toplevel row.
+ *
+ * If the height function wants the rows at this depth measured, @node is
+ * measured, unless @measure is %FALSE; then -1 is returned, and the
+ * caller leaves @node invalid for the validation handler, since
+ * measuring from within a model signal handler is too expensive.
+ */
+static gint
+gtk_tree_view_get_fixed_height (GtkTreeView *tree_view,
+				GtkRBTree   *tree,
+				GtkRBNode   *node,
+				GtkTreeIter *iter,
+				gboolean     measure)
+{
+  GArray *heights = tree_view->priv->fixed_heights;
+  gint depth;
+  gint height = FIXED_HEIGHT_UNKNOWN;
+
+  if (!tree_view->priv->fixed_height_mode ||
+      tree_view->priv->fixed_height < 0)
+    return -1;
+
+  if (!tree_view->priv->fixed_height_func)
+    return tree_view->priv->fixed_height;
+
+  depth = _gtk_rbtree_get_depth (tree);
+  if (depth == 0)
+    return tree_view->priv->fixed_height;
+
+  if (heights && depth < heights->len)
+    height = g_array_index (heights, gint, depth);
+
+  if (height >= 0)
+    return height;
+
+  if (height == FIXED_HEIGHT_UNKNOWN)
+    {
+      height = tree_view->priv->fixed_height_func (tree_view, depth + 1,
+						   tree_view->priv->fixed_height_data);
+      if (height < 0)
+	height = FIXED_HEIGHT_MEASURE;
+    }
+
+  if (height == FIXED_HEIGHT_MEASURE && measure)
+    height = measure_fixed_height (tree_view, tree, node, iter);
+
+  if (!heights)
+    heights = tree_view->priv->fixed_heights = g_array_new (FALSE, FALSE, sizeof (gint));
+
+  while (heights->len <= depth)
+    {
+      gint unknown = FIXED_HEIGHT_UNKNOWN;
+
+      g_array_append_val (heights, unknown);
+    }
+
+  g_array_index (heights, gint, depth) = height;
+
+  return MAX (height, -1);
+}
+
+static void
+gtk_tree_view_forget_fixed_heights (GtkTreeView *tree_view)
+{
+  tree_view->priv->fixed_height = -1;
+
+  if (tree_view->priv->fixed_heights)
+    g_array_set_size (tree_view->priv->fixed_heights, 0);
+}
+
+/* Like _gtk_rbtree_set_fixed_height(), but with the height of each
+ * subtree looked up by its depth.
+ */
+static void
+set_fixed_heights (GtkTreeView *tree_view,
+		   GtkRBTree   *tree)
+{
+  GtkRBNode *node;
+  gint height = -1;
+
+  if (!GTK_RBNODE_FLAG_SET (tree->root, GTK_RBNODE_DESCENDANTS_INVALID))
+    return;
+
+  node = tree->root;
+  while (node->left != tree->nil)
+    node = node->left;
+
+  do
+    {
+      if (GTK_RBNODE_FLAG_SET (node, GTK_RBNODE_INVALID))
+	{
+	  if (height < 0)
+	    height = gtk_tree_view_get_fixed_height (tree_view, tree, node, NULL, TRUE);
+
+	  _gtk_rbtree_node_set_height (tree, node, height);
+	  _gtk_rbtree_node_mark_valid (tree, node);
+	}
+
+      if (node->children)
+	set_fixed_heights (tree_view, node->children);
+    }
+  while ((node = _gtk_rbtree_next (tree, node)) != NULL);
+}
+
 static void
 initialize_fixed_height_mode (GtkTreeView *tree_view)
 {
@@ -6159,27 +6343,28 @@ initialize_fixed_height_mode (GtkTreeView *tree_view)
 
   if (tree_view->priv->fixed_height < 0)
     {
-      GtkTreeIter iter;
-      GtkTreePath *path;
-
       GtkRBTree *tree = NULL;
       GtkRBNode *node = NULL;
+      gint height = -1;
 
       tree = tree_view->priv->tree;
       node = tree->root;
 
-      path = _gtk_tree_view_find_path (tree_view, tree, node);
-      gtk_tree_model_get_iter (tree_view->priv->model, &iter, path);
-
-      validate_row (tree_view, tree, node, &iter, path);
+      if (tree_view->priv->fixed_height_func)
+	height = tree_view->priv->fixed_height_func (tree_view, 1,
+						     tree_view->priv->fixed_height_data);
 
-      gtk_tree_path_free (path);
+      if (height < 0)
+	height = measure_fixed_height (tree_view, tree, node, NULL);
 
-      tree_view->priv->fixed_height = ROW_HEIGHT (tree_view, GTK_RBNODE_GET_HEIGHT (node));
+      tree_view->priv->fixed_height = height;
     }
 
-   _gtk_rbtree_set_fixed_height (tree_view->priv->tree,
-                                 tree_view->priv->fixed_height, TRUE);
+  if (tree_view->priv->fixed_height_func)
+    set_fixed_heights (tree_view, tree_view->priv->tree);
+  else
+    _gtk_rbtree_set_fixed_height (tree_view->priv->tree,
+				  tree_view->priv->fixed_height, TRUE);
 }
 
 /* Our strategy for finding nodes to validate is a little convoluted.  We find
@@ -6212,6 +6397,14 @@ do_validate_rows (GtkTreeView *tree_view, gboolean queue_resize)
     {
       if (tree_view->priv->fixed_height < 0)
         initialize_fixed_height_mode (tree_view);
+      else if (tree_view->priv->fixed_height_func &&
+	       GTK_RBNODE_FLAG_SET (tree_view->priv->tree->root, GTK_RBNODE_DESCENDANTS_INVALID))
+	{
+	  /* rows left invalid for measuring by the signal handlers */
+	  set_fixed_heights (tree_view, tree_view->priv->tree);
+	  if (queue_resize)
+	    gtk_widget_queue_resize (GTK_WIDGET (tree_view));
+	}
 
       return FALSE;
     }
@@ -7684,6 +7877,8 @@ column_sizing_notify (GObject    *object,
  * rows have the same height. 
  * Only enable this option if all rows are the same height and all
  * columns are of type %GTK_TREE_VIEW_COLUMN_FIXED.
+ * See gtk_tree_view_set_fixed_height_func() for trees whose rows
+ * have a different height at each depth.
  *
  * Since: 2.6 
  **/
@@ -7701,7 +7896,7 @@ gtk_tree_view_set_fixed_height_mode (GtkTreeView *tree_view,
   if (!enable)
     {
       tree_view->priv->fixed_height_mode = 0;
-      tree_view->priv->fixed_height = -1;
+      gtk_tree_view_forget_fixed_heights (tree_view);
 
       /* force a revalidation */
       install_presize_handler (tree_view);
@@ -7722,7 +7917,7 @@ gtk_tree_view_set_fixed_height_mode (GtkTreeView *tree_view,
 			  G_CALLBACK (column_sizing_notify), tree_view);
       
       tree_view->priv->fixed_height_mode = 1;
-      tree_view->priv->fixed_height = -1;
+      gtk_tree_view_forget_fixed_heights (tree_view);
       
       if (tree_view->priv->tree)
 	initialize_fixed_height_mode (tree_view);
@@ -7747,6 +7942,56 @@ gtk_tree_view_get_fixed_height_mode (GtkTreeView *tree_view)
   return tree_view->priv->fixed_height_mode;
 }
 
+/**
+ * gtk_tree_view_set_fixed_height_func:
+ * @tree_view: a #GtkTreeView
+ * @func: (allow-none): a #GtkTreeViewRowHeightFunc, or %NULL
+ * @data: (allow-none): user data to pass to @func, or %NULL
+ * @destroy: (allow-none): destroy notifier for @data, or %NULL
+ *
+ * Lets fixed height mode use a different row height for each depth
+ * of the tree, for instance when toplevel rows show a summary and child
+ * rows show a single line.  @func is called once per depth, with 1 for
+ * toplevel rows, and returns the height of the rows at that depth in
+ * pixels, or -1 to have the tree view measure the first row it shows
+ * at that depth.  The result is cached until the model or the style of
+ * @tree_view changes.
+ *
+ * All rows at the same depth must have the same height, and the columns
+ * must be of type %GTK_TREE_VIEW_COLUMN_FIXED, as required by
+ * gtk_tree_view_set_fixed_height_mode().  Rows that are expanded then
+ * get their height without being measured, so expanding large trees
+ * is fast.
+ *
+ * If @func is %NULL, all rows have the height of the first row.
+ *
+ * Since: 2.22
+ **/
+void
+gtk_tree_view_set_fixed_height_func (GtkTreeView              *tree_view,
+				     GtkTreeViewRowHeightFunc  func,
+				     gpointer                  data,
+				     GDestroyNotify            destroy)
+{
+  g_return_if_fail (GTK_IS_TREE_VIEW (tree_view));
+
+  if (tree_view->priv->fixed_height_destroy)
+    tree_view->priv->fixed_height_destroy (tree_view->priv->fixed_height_data);
+
+  tree_view->priv->fixed_height_func = func;
+  tree_view->priv->fixed_height_data = data;
+  tree_view->priv->fixed_height_destroy = destroy;
+
+  gtk_tree_view_forget_fixed_heights (tree_view);
+
+  if (tree_view->priv->fixed_height_mode && tree_view->priv->tree)
+    {
+      _gtk_rbtree_mark_invalid (tree_view->priv->tree);
+      initialize_fixed_height_mode (tree_view);
+      gtk_widget_queue_resize (GTK_WIDGET (tree_view));
+    }
+}
+
 /* Returns TRUE if the focus is within the headers, after the focus operation is
  * done
  */
@@ -8037,7 +8282,7 @@ gtk_tree_view_style_set (GtkWidget *widget,
       _gtk_tree_view_column_cell_set_dirty (column, TRUE);
     }
 
-  tree_view->priv->fixed_height = -1;
+  gtk_tree_view_forget_fixed_heights (tree_view);
   _gtk_rbtree_mark_invalid (tree_view->priv->tree);
 
   gtk_widget_queue_resize (widget);
@@ -8297,12 +8542,25 @@ gtk_tree_view_row_changed (GtkTreeModel *model,
   if (tree == NULL)
     goto done;
 
+  gtk_tree_view_search_index_row_changed (tree_view, path, iter);
+
   if (tree_view->priv->fixed_height_mode
       && tree_view->priv->fixed_height >= 0)
     {
-      _gtk_rbtree_node_set_height (tree, node, tree_view->priv->fixed_height);
-      if (gtk_widget_get_realized (GTK_WIDGET (tree_view)))
-	gtk_tree_view_node_queue_redraw (tree_view, tree, node);
+      gint height;
+
+      height = gtk_tree_view_get_fixed_height (tree_view, tree, node, iter, FALSE);
+      if (height >= 0)
+	{
+	  _gtk_rbtree_node_set_height (tree, node, height);
+	  if (gtk_widget_get_realized (GTK_WIDGET (tree_view)))
+	    gtk_tree_view_node_queue_redraw (tree_view, tree, node);
+	}
+      else
+	{
+	  _gtk_rbtree_node_mark_invalid (tree, node);
+	  install_presize_handler (tree_view);
+	}
     }
   else
     {
@@ -8348,6 +8606,8 @@ gtk_tree_view_row_inserted (GtkTreeModel *model,
 
   g_return_if_fail (path != NULL || iter != NULL);
 
+  gtk_tree_view_search_index_invalidate (tree_view);
+
   if (tree_view->priv->fixed_height_mode
       && tree_view->priv->fixed_height >= 0)
     height = tree_view->priv->fixed_height;
@@ -8428,6 +8688,16 @@ gtk_tree_view_row_inserted (GtkTreeModel *model,
       tmpnode = _gtk_rbtree_insert_after (tree, tmpnode, height, FALSE);
     }
 
+  /* child rows may have a height of their own; if it has to be
+   * measured, the row stays invalid for the validation handler
+   */
+  if (height > 0 && tree_view->priv->fixed_height_func)
+    {
+      height = gtk_tree_view_get_fixed_height (tree_view, tree, tmpnode, iter, FALSE);
+      if (height > 0)
+	_gtk_rbtree_node_set_height (tree, tmpnode, height);
+    }
+
  done:
   if (height > 0)
     {
@@ -8529,19 +8799,6 @@ count_children_helper (GtkRBTree *tree,
   (*((gint *)data))++;
 }
 
-static void
-check_selection_helper (GtkRBTree *tree,
-                        GtkRBNode *node,
-                        gpointer   data)
-{
-  gint *value = (gint *)data;
-
-  *value = GTK_RBNODE_FLAG_SET (node, GTK_RBNODE_IS_SELECTED);
-
-  if (node->children && !*value)
-    _gtk_rbtree_traverse (node->children, node->children->root, G_POST_ORDER, check_selection_helper, data);
-}
-
 static void
 gtk_tree_view_row_deleted (GtkTreeModel *model,
 			   GtkTreePath  *path,
@@ -8557,6 +8814,8 @@ gtk_tree_view_row_deleted (GtkTreeModel *model,
 
   gtk_tree_row_reference_deleted (G_OBJECT (data), path);
 
+  gtk_tree_view_search_index_invalidate (tree_view);
+
   if (_gtk_tree_view_find_node (tree_view, path, &tree, &node))
     return;
 
@@ -8564,8 +8823,8 @@ gtk_tree_view_row_deleted (GtkTreeModel *model,
     return;
 
   /* check if the selection has been changed */
-  _gtk_rbtree_traverse (tree, node, G_POST_ORDER,
-                        check_selection_helper, &selection_changed);
+  selection_changed = GTK_RBNODE_FLAG_SET (node, GTK_RBNODE_IS_SELECTED) ||
+    (node->children && node->children->root->n_selected > 0);
 
   for (list = tree_view->priv->columns; list; list = list->next)
     if (((GtkTreeViewColumn *)list->data)->visible &&
@@ -8637,6 +8896,8 @@ gtk_tree_view_rows_reordered (GtkTreeModel *model,
 				    iter,
 				    new_order);
 
+  gtk_tree_view_search_index_invalidate (tree_view);
+
   if (_gtk_tree_view_find_node (tree_view,
 				parent,
 				&tree,
@@ -8790,6 +9051,7 @@ gtk_tree_view_build_tree (GtkTreeView *tree_view,
   GtkRBNode *temp = NULL;
   GtkTreePath *path = NULL;
   gboolean is_list = GTK_TREE_VIEW_FLAG_SET (tree_view, GTK_TREE_VIEW_IS_LIST);
+  gint height = -1;
 
   do
     {
@@ -8800,7 +9062,11 @@ gtk_tree_view_build_tree (GtkTreeView *tree_view,
         {
           if (GTK_RBNODE_FLAG_SET (temp, GTK_RBNODE_INVALID))
 	    {
-              _gtk_rbtree_node_set_height (tree, temp, tree_view->priv->fixed_height);
+	      /* all rows of this level have the same height */
+	      if (height < 0)
+		height = gtk_tree_view_get_fixed_height (tree_view, tree, temp, iter, TRUE);
+
+              _gtk_rbtree_node_set_height (tree, temp, height);
 	      _gtk_rbtree_node_mark_valid (tree, temp);
 	    }
         }
@@ -10693,6 +10959,7 @@ gtk_tree_view_set_model (GtkTreeView  *tree_view,
 
       gtk_tree_view_unref_and_check_selection_tree (tree_view, tree_view->priv->tree);
       gtk_tree_view_stop_editing (tree_view, TRUE);
+      gtk_tree_view_search_index_free (tree_view);
 
       remove_expand_collapse_timeout (tree_view);
 
@@ -10736,7 +11003,7 @@ gtk_tree_view_set_model (GtkTreeView  *tree_view,
 
       tree_view->priv->search_column = -1;
       tree_view->priv->fixed_height_check = 0;
-      tree_view->priv->fixed_height = -1;
+      gtk_tree_view_forget_fixed_heights (tree_view);
       tree_view->priv->dy = tree_view->priv->top_row_dy = 0;
       tree_view->priv->last_button_x = -1;
       tree_view->priv->last_button_y = -1;
@@ -12067,6 +12334,8 @@ gtk_tree_view_real_expand_row (GtkTreeView *tree_view,
   if (expand)
     return FALSE;
 
+  gtk_tree_view_search_index_invalidate (tree_view);
+
   node->children = _gtk_rbtree_new ();
   node->children->parent_tree = tree;
   node->children->parent_node = node;
@@ -12241,6 +12510,8 @@ gtk_tree_view_real_collapse_row (GtkTreeView *tree_view,
 
   remove_expand_collapse_timeout (tree_view);
 
+  gtk_tree_view_search_index_invalidate (tree_view);
+
   if (gtk_tree_view_unref_and_check_selection_tree (tree_view, node->children))
     {
       _gtk_rbtree_remove (node->children);
@@ -13912,6 +14183,64 @@ gtk_tree_view_get_enable_search (GtkTreeView *tree_view)
   return tree_view->priv->enable_search;
 }
 
+/**
+ * gtk_tree_view_set_enable_search_index:
+ * @tree_view: A #GtkTreeView
+ * @enable_search_index: %TRUE to index the search column
+ *
+ * Normally the interactive search compares every row with the search
+ * text on each keystroke, which gets slow for long lists.  If
+ * @enable_search_index is set, the tree view builds a sorted index of
+ * the normalized, casefolded contents of the search column the first
+ * time it is searched, and uses it to find matches by binary search.
+ * Changed rows are updated in the index as they change.  When rows are
+ * inserted, deleted, reordered, expanded or collapsed the index is
+ * rebuilt on the next search, but not more often than about once per
+ * second; searches in between compare the rows one by one.
+ *
+ * The index is only used with the default compare function; it is
+ * ignored when a function was set with
+ * gtk_tree_view_set_search_equal_func().
+ *
+ * Since: 2.22
+ */
+void
+gtk_tree_view_set_enable_search_index (GtkTreeView *tree_view,
+				       gboolean     enable_search_index)
+{
+  g_return_if_fail (GTK_IS_TREE_VIEW (tree_view));
+
+  enable_search_index = !!enable_search_index;
+
+  if (tree_view->priv->enable_search_index != enable_search_index)
+    {
+      tree_view->priv->enable_search_index = enable_search_index;
+      if (!enable_search_index)
+	gtk_tree_view_search_index_free (tree_view);
+
+      g_object_notify (G_OBJECT (tree_view), "enable-search-index");
+    }
+}
+
+/**
+ * gtk_tree_view_get_enable_search_index:
+ * @tree_view: A #GtkTreeView
+ *
+ * Returns whether the interactive search uses an index of the search
+ * column. See gtk_tree_view_set_enable_search_index().
+ *
+ * Return value: %TRUE if the search column is indexed
+ *
+ * Since: 2.22
+ */
+gboolean
+gtk_tree_view_get_enable_search_index (GtkTreeView *tree_view)
+{
+  g_return_val_if_fail (GTK_IS_TREE_VIEW (tree_view), FALSE);
+
+  return tree_view->priv->enable_search_index;
+}
+
 
 /**
  * gtk_tree_view_get_search_column:
@@ -13955,6 +14284,7 @@ gtk_tree_view_set_search_column (GtkTreeView *tree_view,
     return;
 
   tree_view->priv->search_column = column;
+  gtk_tree_view_search_index_free (tree_view);
   g_object_notify (G_OBJECT (tree_view), "search-column");
 }
 
@@ -14003,6 +14333,9 @@ gtk_tree_view_set_search_equal_func (GtkTreeView                *tree_view,
   tree_view->priv->search_destroy = search_destroy;
   if (tree_view->priv->search_equal_func == NULL)
     tree_view->priv->search_equal_func = gtk_tree_view_search_equal_func;
+
+  /* the index only implements the default compare function */
+  gtk_tree_view_search_index_free (tree_view);
 }
 
 /**
@@ -14478,19 +14811,33 @@ gtk_tree_view_search_move (GtkWidget   *window,
     }
 }
 
-static gboolean
-gtk_tree_view_search_equal_func (GtkTreeModel *model,
+/* Returns the normalized, casefolded form of @str that the default
+ * search compares, or %NULL if @str is not valid UTF-8.
+ */
+static gchar *
+gtk_tree_view_search_fold (const gchar *str)
+{
+  gchar *normalized;
+  gchar *case_normalized;
+
+  normalized = g_utf8_normalize (str, -1, G_NORMALIZE_ALL);
+  if (!normalized)
+    return NULL;
+
+  case_normalized = g_utf8_casefold (normalized, -1);
+  g_free (normalized);
+
+  return case_normalized;
+}
+
+/* Returns the folded string value of @column at @iter, or %NULL */
+static gchar *
+gtk_tree_view_search_get_folded (GtkTreeModel *model,
 				 gint          column,
-				 const gchar  *key,
-				 GtkTreeIter  *iter,
-				 gpointer      search_data)
+				 GtkTreeIter  *iter)
 {
-  gboolean retval = TRUE;
   const gchar *str;
-  gchar *normalized_string;
-  gchar *normalized_key;
-  gchar *case_normalized_string = NULL;
-  gchar *case_normalized_key = NULL;
+  gchar *retval = NULL;
   GValue value = {0,};
   GValue transformed = {0,};
 
@@ -14501,35 +14848,531 @@ gtk_tree_view_search_equal_func (GtkTreeModel *model,
   if (!g_value_transform (&value, &transformed))
     {
       g_value_unset (&value);
-      return TRUE;
+      return NULL;
     }
 
   g_value_unset (&value);
 
   str = g_value_get_string (&transformed);
-  if (!str)
+  if (str)
+    retval = gtk_tree_view_search_fold (str);
+
+  g_value_unset (&transformed);
+
+  return retval;
+}
+
+static gboolean
+gtk_tree_view_search_equal_func (GtkTreeModel *model,
+				 gint          column,
+				 const gchar  *key,
+				 GtkTreeIter  *iter,
+				 gpointer      search_data)
+{
+  gboolean retval = TRUE;
+  gchar *case_normalized_string;
+  gchar *case_normalized_key;
+
+  case_normalized_string = gtk_tree_view_search_get_folded (model, column, iter);
+  if (!case_normalized_string)
+    return TRUE;
+
+  case_normalized_key = gtk_tree_view_search_fold (key);
+
+  if (case_normalized_key &&
+      strncmp (case_normalized_key, case_normalized_string, strlen (case_normalized_key)) == 0)
+    retval = FALSE;
+
+  g_free (case_normalized_key);
+  g_free (case_normalized_string);
+
+  return retval;
+}
+
+/* The search index holds the folded search column of all rows that are
+ * currently shown, in display order, together with the positions of the
+ * rows that have a key, sorted by key and then by position.  The rows
+ * matching a prefix form one contiguous run of the latter, which can be
+ * found by binary search.  A tree of the smallest position in each
+ * range of the run array then gives the matches of a run in display
+ * order, at a cost of O(log n) for each match passed over.
+ *
+ * Changes to a row update its entry in place.  Rows being inserted,
+ * deleted, reordered, expanded or collapsed only mark the index as
+ * stale; it is rebuilt by the next search, but at most once every
+ * SEARCH_INDEX_REBUILD_INTERVAL seconds.  In between, searches fall back
+ * to comparing the rows one by one, so that a model which changes all
+ * the time does not cause a rebuild on every keystroke.
+ */
+#define SEARCH_INDEX_REBUILD_INTERVAL 1.0
+
+typedef struct
+{
+  gchar *key;
+  GtkTreePath *path;
+} SearchIndexEntry;
+
+struct _GtkTreeViewSearchIndex
+{
+  GArray *entries;	/* SearchIndexEntry, in display order */
+  GArray *order;	/* guint positions into entries, sorted by key */
+  GArray *mins;		/* guint, see gtk_tree_view_search_index_nth() */
+  guint n_leaves;
+  GTimer *timer;	/* started at the last build */
+  guint stale : 1;
+  guint mins_stale : 1;
+};
+
+static void
+gtk_tree_view_search_index_clear (GtkTreeViewSearchIndex *index)
+{
+  guint i;
+
+  for (i = 0; i < index->entries->len; i++)
     {
-      g_value_unset (&transformed);
-      return TRUE;
+      SearchIndexEntry *entry = &g_array_index (index->entries, SearchIndexEntry, i);
+
+      g_free (entry->key);
+      gtk_tree_path_free (entry->path);
     }
 
-  normalized_string = g_utf8_normalize (str, -1, G_NORMALIZE_ALL);
-  normalized_key = g_utf8_normalize (key, -1, G_NORMALIZE_ALL);
+  g_array_set_size (index->entries, 0);
+  g_array_set_size (index->order, 0);
+  g_array_set_size (index->mins, 0);
+  index->mins_stale = TRUE;
+}
+
+static void
+gtk_tree_view_search_index_free (GtkTreeView *tree_view)
+{
+  GtkTreeViewSearchIndex *index = tree_view->priv->search_index;
+
+  if (!index)
+    return;
+
+  gtk_tree_view_search_index_clear (index);
+  g_array_free (index->entries, TRUE);
+  g_array_free (index->order, TRUE);
+  g_array_free (index->mins, TRUE);
+  g_timer_destroy (index->timer);
+  g_slice_free (GtkTreeViewSearchIndex, index);
+
+  tree_view->priv->search_index = NULL;
+}
+
+static void
+gtk_tree_view_search_index_invalidate (GtkTreeView *tree_view)
+{
+  if (tree_view->priv->search_index)
+    tree_view->priv->search_index->stale = TRUE;
+}
+
+static gboolean
+gtk_tree_view_search_index_usable (GtkTreeView *tree_view)
+{
+  return (tree_view->priv->enable_search_index &&
+	  tree_view->priv->search_equal_func == gtk_tree_view_search_equal_func &&
+	  tree_view->priv->search_column >= 0 &&
+	  tree_view->priv->model != NULL);
+}
+
+static void
+gtk_tree_view_search_index_add_level (GtkTreeView *tree_view,
+				      GArray      *entries,
+				      GtkRBTree   *tree,
+				      GtkTreeIter *iter,
+				      GtkTreePath *path)
+{
+  GtkTreeModel *model = tree_view->priv->model;
+  GtkRBNode *node;
+
+  node = tree->root;
+  while (node->left != tree->nil)
+    node = node->left;
 
-  if (normalized_string && normalized_key)
+  do
     {
-      case_normalized_string = g_utf8_casefold (normalized_string, -1);
-      case_normalized_key = g_utf8_casefold (normalized_key, -1);
+      SearchIndexEntry entry;
 
-      if (strncmp (case_normalized_key, case_normalized_string, strlen (case_normalized_key)) == 0)
-        retval = FALSE;
+      entry.key = gtk_tree_view_search_get_folded (model,
+						   tree_view->priv->search_column,
+						   iter);
+      entry.path = gtk_tree_path_copy (path);
+      g_array_append_val (entries, entry);
+
+      if (node->children)
+	{
+	  GtkTreeIter child;
+
+	  if (gtk_tree_model_iter_children (model, &child, iter))
+	    {
+	      gtk_tree_path_down (path);
+	      gtk_tree_view_search_index_add_level (tree_view, entries,
+						    node->children,
+						    &child, path);
+	      gtk_tree_path_up (path);
+	    }
+	}
+
+      node = _gtk_rbtree_next (tree, node);
+      if (node == NULL || !gtk_tree_model_iter_next (model, iter))
+	break;
+
+      gtk_tree_path_next (path);
     }
+  while (TRUE);
+}
 
-  g_value_unset (&transformed);
-  g_free (normalized_key);
-  g_free (normalized_string);
-  g_free (case_normalized_key);
-  g_free (case_normalized_string);
+static gint
+search_index_compare (GtkTreeViewSearchIndex *index,
+		      guint                   a,
+		      guint                   b)
+{
+  gint retval;
+
+  retval = strcmp (g_array_index (index->entries, SearchIndexEntry, a).key,
+		   g_array_index (index->entries, SearchIndexEntry, b).key);
+  if (retval == 0)
+    retval = (a > b) - (a < b);
+
+  return retval;
+}
+
+static gint
+search_index_order_compare (gconstpointer a,
+			    gconstpointer b,
+			    gpointer      user_data)
+{
+  return search_index_compare (user_data,
+			       *(const guint *) a, *(const guint *) b);
+}
+
+/* Returns the slot in index->order at which @position is, or would be
+ * inserted, given the key of its entry.
+ */
+static guint
+gtk_tree_view_search_index_find_slot (GtkTreeViewSearchIndex *index,
+				      guint                   position)
+{
+  guint lo, hi, mid;
+
+  lo = 0;
+  hi = index->order->len;
+  while (lo < hi)
+    {
+      mid = (lo + hi) / 2;
+      if (search_index_compare (index, g_array_index (index->order, guint, mid),
+				position) < 0)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+
+  return lo;
+}
+
+static void
+gtk_tree_view_search_index_build (GtkTreeView *tree_view)
+{
+  GtkTreeViewSearchIndex *index = tree_view->priv->search_index;
+  GtkTreeIter iter;
+  GtkTreePath *path;
+  guint i;
+
+  if (index)
+    gtk_tree_view_search_index_clear (index);
+  else
+    {
+      index = g_slice_new0 (GtkTreeViewSearchIndex);
+      index->entries = g_array_new (FALSE, FALSE, sizeof (SearchIndexEntry));
+      index->order = g_array_new (FALSE, FALSE, sizeof (guint));
+      index->mins = g_array_new (FALSE, FALSE, sizeof (guint));
+      index->timer = g_timer_new ();
+      tree_view->priv->search_index = index;
+    }
+
+  if (tree_view->priv->tree &&
+      tree_view->priv->tree->root != tree_view->priv->tree->nil &&
+      gtk_tree_model_get_iter_first (tree_view->priv->model, &iter))
+    {
+      path = gtk_tree_path_new_first ();
+      gtk_tree_view_search_index_add_level (tree_view, index->entries,
+					    tree_view->priv->tree,
+					    &iter, path);
+      gtk_tree_path_free (path);
+    }
+
+  for (i = 0; i < index->entries->len; i++)
+    if (g_array_index (index->entries, SearchIndexEntry, i).key)
+      g_array_append_val (index->order, i);
+
+  g_array_sort_with_data (index->order, search_index_order_compare, index);
+
+  index->stale = FALSE;
+  g_timer_start (index->timer);
+}
+
+/* Returns whether the index can be used for the next search, building
+ * it if necessary.
+ */
+static gboolean
+gtk_tree_view_search_index_ensure (GtkTreeView *tree_view)
+{
+  GtkTreeViewSearchIndex *index = tree_view->priv->search_index;
+
+  if (index && !index->stale)
+    return TRUE;
+
+  if (index && g_timer_elapsed (index->timer, NULL) < SEARCH_INDEX_REBUILD_INTERVAL)
+    return FALSE;
+
+  gtk_tree_view_search_index_build (tree_view);
+
+  return TRUE;
+}
+
+static void
+gtk_tree_view_search_index_row_changed (GtkTreeView *tree_view,
+					GtkTreePath *path,
+					GtkTreeIter *iter)
+{
+  GtkTreeViewSearchIndex *index = tree_view->priv->search_index;
+  SearchIndexEntry *entry;
+  guint lo, hi, mid = 0;
+  gint cmp;
+
+  if (!index || index->stale)
+    return;
+
+  /* display order is the order of the paths */
+  lo = 0;
+  hi = index->entries->len;
+  while (lo < hi)
+    {
+      mid = (lo + hi) / 2;
+      cmp = gtk_tree_path_compare (g_array_index (index->entries, SearchIndexEntry, mid).path,
+				   path);
+      if (cmp == 0)
+	break;
+      else if (cmp < 0)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+
+  if (lo >= hi)
+    return;
+
+  entry = &g_array_index (index->entries, SearchIndexEntry, mid);
+
+  if (entry->key)
+    {
+      g_array_remove_index (index->order,
+			    gtk_tree_view_search_index_find_slot (index, mid));
+      g_free (entry->key);
+    }
+
+  entry->key = gtk_tree_view_search_get_folded (tree_view->priv->model,
+						tree_view->priv->search_column,
+						iter);
+
+  if (entry->key)
+    g_array_insert_val (index->order,
+			gtk_tree_view_search_index_find_slot (index, mid),
+			mid);
+
+  /* The slots in index->order moved, rebuild the tree on the next search */
+  index->mins_stale = TRUE;
+}
+
+/* index->mins is a complete binary tree over the slots of index->order,
+ * stored like a heap: node 1 is the root, the children of node i are
+ * 2i and 2i + 1, and the n_leaves leaves start at node n_leaves.  Each
+ * node holds the smallest position in the slots below it.
+ */
+static void
+gtk_tree_view_search_index_build_mins (GtkTreeViewSearchIndex *index)
+{
+  guint i;
+
+  index->n_leaves = 1;
+  while (index->n_leaves < index->order->len)
+    index->n_leaves *= 2;
+
+  g_array_set_size (index->mins, 2 * index->n_leaves);
+
+  for (i = 0; i < index->n_leaves; i++)
+    g_array_index (index->mins, guint, index->n_leaves + i) =
+      i < index->order->len ? g_array_index (index->order, guint, i) : G_MAXUINT;
+
+  for (i = index->n_leaves - 1; i > 0; i--)
+    g_array_index (index->mins, guint, i) =
+      MIN (g_array_index (index->mins, guint, 2 * i),
+	   g_array_index (index->mins, guint, 2 * i + 1));
+
+  index->mins_stale = FALSE;
+}
+
+/* A binary heap of tree nodes, smallest position first */
+static void
+search_index_heap_push (GArray *heap,
+			GArray *mins,
+			guint   node)
+{
+  guint i, parent;
+
+  g_array_append_val (heap, node);
+
+  for (i = heap->len - 1; i > 0; i = parent)
+    {
+      parent = (i - 1) / 2;
+      if (g_array_index (mins, guint, g_array_index (heap, guint, parent)) <=
+	  g_array_index (mins, guint, node))
+	break;
+
+      g_array_index (heap, guint, i) = g_array_index (heap, guint, parent);
+      g_array_index (heap, guint, parent) = node;
+    }
+}
+
+static guint
+search_index_heap_pop (GArray *heap,
+		       GArray *mins)
+{
+  guint top, last, i, child;
+
+  top = g_array_index (heap, guint, 0);
+  last = g_array_index (heap, guint, heap->len - 1);
+  g_array_set_size (heap, heap->len - 1);
+
+  for (i = 0; 2 * i + 1 < heap->len; i = child)
+    {
+      child = 2 * i + 1;
+      if (child + 1 < heap->len &&
+	  g_array_index (mins, guint, g_array_index (heap, guint, child + 1)) <
+	  g_array_index (mins, guint, g_array_index (heap, guint, child)))
+	child++;
+
+      if (g_array_index (mins, guint, last) <=
+	  g_array_index (mins, guint, g_array_index (heap, guint, child)))
+	break;
+
+      g_array_index (heap, guint, i) = g_array_index (heap, guint, child);
+    }
+
+  if (heap->len > 0)
+    g_array_index (heap, guint, i) = last;
+
+  return top;
+}
+
+/* Returns the @n-th smallest position in the slots [@first, @last) of
+ * index->order, which must hold at least @n slots.  The nodes covering
+ * the slots go into a heap; taking the smallest node and putting back
+ * its children finds the positions in increasing order.
+ */
+static guint
+gtk_tree_view_search_index_nth (GtkTreeViewSearchIndex *index,
+				guint                   first,
+				guint                   last,
+				gint                    n)
+{
+  GArray *heap;
+  guint node;
+
+  if (index->mins_stale)
+    gtk_tree_view_search_index_build_mins (index);
+
+  heap = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  for (first += index->n_leaves, last += index->n_leaves;
+       first < last;
+       first /= 2, last /= 2)
+    {
+      if (first & 1)
+	search_index_heap_push (heap, index->mins, first++);
+      if (last & 1)
+	search_index_heap_push (heap, index->mins, --last);
+    }
+
+  while (TRUE)
+    {
+      node = search_index_heap_pop (heap, index->mins);
+
+      if (node >= index->n_leaves)
+	{
+	  if (--n == 0)
+	    break;
+	}
+      else
+	{
+	  search_index_heap_push (heap, index->mins, 2 * node);
+	  search_index_heap_push (heap, index->mins, 2 * node + 1);
+	}
+    }
+
+  g_array_free (heap, TRUE);
+
+  return g_array_index (index->mins, guint, node);
+}
+
+/* Returns the path of the @n-th row, in display order, whose key starts
+ * with @text, or %NULL.  The path is owned by the index.
+ */
+static GtkTreePath *
+gtk_tree_view_search_index_lookup (GtkTreeView *tree_view,
+				   const gchar *text,
+				   gint         n)
+{
+  GtkTreeViewSearchIndex *index = tree_view->priv->search_index;
+  GtkTreePath *retval = NULL;
+  gchar *key;
+  gsize len;
+  guint lo, hi, mid;
+  guint first;
+
+  key = gtk_tree_view_search_fold (text);
+  if (!key)
+    return NULL;
+
+  len = strlen (key);
+
+  /* first entry not smaller than the key */
+  lo = 0;
+  hi = index->order->len;
+  while (lo < hi)
+    {
+      mid = (lo + hi) / 2;
+      if (strcmp (g_array_index (index->entries, SearchIndexEntry,
+				 g_array_index (index->order, guint, mid)).key,
+		  key) < 0)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+  first = lo;
+
+  /* first entry past the run that has the key as prefix */
+  hi = index->order->len;
+  while (lo < hi)
+    {
+      mid = (lo + hi) / 2;
+      if (strncmp (g_array_index (index->entries, SearchIndexEntry,
+				  g_array_index (index->order, guint, mid)).key,
+		   key, len) == 0)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+
+  /* The run is sorted by key, but the n-th match is wanted in
+   * display order.
+   */
+  if (n >= 1 && (gint) (lo - first) >= n)
+    retval = g_array_index (index->entries, SearchIndexEntry,
+			    gtk_tree_view_search_index_nth (index, first, lo, n)).path;
+
+  g_free (key);
 
   return retval;
 }
@@ -14548,6 +15391,28 @@ gtk_tree_view_search_iter (GtkTreeModel     *model,
 
   GtkTreeView *tree_view = gtk_tree_selection_get_tree_view (selection);
 
+  if (gtk_tree_view_search_index_usable (tree_view) &&
+      gtk_tree_view_search_index_ensure (tree_view))
+    {
+      path = gtk_tree_view_search_index_lookup (tree_view, text, n);
+      if (!path)
+	return FALSE;
+
+      /* the index may go away under us, so work on a copy */
+      path = gtk_tree_path_copy (path);
+      gtk_tree_model_get_iter (model, iter, path);
+      *count = n;
+
+      gtk_tree_view_scroll_to_cell (tree_view, path, NULL,
+				    TRUE, 0.5, 0.0);
+      gtk_tree_selection_select_iter (selection, iter);
+      gtk_tree_view_real_set_cursor (tree_view, path, FALSE, TRUE);
+
+      gtk_tree_path_free (path);
+
+      return TRUE;
+    }
+
   path = gtk_tree_model_get_path (model, iter);
   _gtk_tree_view_find_node (tree_view, path, &tree, &node);
 
@@ -134,6 +134,9 @@ typedef gboolean (*GtkTreeViewRowSeparatorFunc) (GtkTreeModel      *model,
 typedef void     (*GtkTreeViewSearchPositionFunc) (GtkTreeView  *tree_view,
 						   GtkWidget    *search_dialog,
 						   gpointer      user_data);
+typedef gint     (*GtkTreeViewRowHeightFunc) (GtkTreeView  *tree_view,
+					      gint          depth,
+					      gpointer      data);
 
 
 /* Creators */
@@ -310,6 +313,9 @@ GdkPixmap             *gtk_tree_view_create_row_drag_icon          (GtkTreeView
 void                       gtk_tree_view_set_enable_search     (GtkTreeView                *tree_view,
 								gboolean                    enable_search);
 gboolean                   gtk_tree_view_get_enable_search     (GtkTreeView                *tree_view);
+void                       gtk_tree_view_set_enable_search_index (GtkTreeView            *tree_view,
+								  gboolean                enable_search_index);
+gboolean                   gtk_tree_view_get_enable_search_index (GtkTreeView            *tree_view);
 gint                       gtk_tree_view_get_search_column     (GtkTreeView                *tree_view);
 void                       gtk_tree_view_set_search_column     (GtkTreeView                *tree_view,
 								gint                        column);
@@ -374,6 +380,10 @@ void gtk_tree_view_set_destroy_count_func (GtkTreeView             *tree_view,
 void     gtk_tree_view_set_fixed_height_mode (GtkTreeView          *tree_view,
 					      gboolean              enable);
 gboolean gtk_tree_view_get_fixed_height_mode (GtkTreeView          *tree_view);
+void     gtk_tree_view_set_fixed_height_func (GtkTreeView          *tree_view,
+					      GtkTreeViewRowHeightFunc func,
+					      gpointer              data,
+					      GDestroyNotify        destroy);
 void     gtk_tree_view_set_hover_selection   (GtkTreeView          *tree_view,
 					      gboolean              hover);
 gboolean gtk_tree_view_get_hover_selection   (GtkTreeView          *tree_view);
@@ -6615,9 +6615,12 @@ gtk_widget_modify_style (GtkWidget      *widget,
   g_return_if_fail (GTK_IS_WIDGET (widget));
   g_return_if_fail (GTK_IS_RC_STYLE (style));
   
+  /* Widgets modified the same way share one modifier style, and
+   * with it the realized GtkStyle.
+   */
   g_object_set_qdata_full (G_OBJECT (widget),
 			   quark_rc_style,
-			   gtk_rc_style_copy (style),
+			   _gtk_rc_style_intern (style),
 			   (GDestroyNotify) g_object_unref);
 
   /* note that "style" may be invalid here if it was the old
@@ -6666,6 +6669,17 @@ gtk_widget_get_modifier_style (GtkWidget      *widget)
 			       rc_style,
 			       (GDestroyNotify) g_object_unref);
     }
+  else if (_gtk_rc_style_is_shared (rc_style))
+    {
+      /* The caller may change the returned style, so give the
+       * widget its own copy instead of the interned one.
+       */
+      rc_style = gtk_rc_style_copy (rc_style);
+      g_object_set_qdata_full (G_OBJECT (widget),
+			       quark_rc_style,
+			       rc_style,
+			       (GDestroyNotify) g_object_unref);
+    }
 
   return rc_style;
 }
@@ -2823,10 +2823,212 @@ specific_bug_549287 (void)
 
 /* main */
 
+static gboolean
+specific_refilter_async_visible_func (GtkTreeModel *model,
+                                      GtkTreeIter  *iter,
+                                      gpointer      data)
+{
+  gint divisor = *(gint *)data;
+  gint value;
+
+  gtk_tree_model_get (model, iter, 0, &value, -1);
+
+  return value % divisor == 0;
+}
+
+static void
+specific_refilter_async (void)
+{
+  GtkTreeIter iter;
+  GtkListStore *store;
+  GtkTreeModel *filter;
+  gint divisor = 1;
+  gint i;
+
+  store = gtk_list_store_new (1, G_TYPE_INT);
+  for (i = 0; i < 3000; i++)
+    gtk_list_store_insert_with_values (store, &iter, i, 0, i, -1);
+
+  filter = gtk_tree_model_filter_new (GTK_TREE_MODEL (store), NULL);
+  gtk_tree_model_filter_set_visible_func (GTK_TREE_MODEL_FILTER (filter),
+                                          specific_refilter_async_visible_func,
+                                          &divisor, NULL);
+  gtk_tree_model_filter_set_refilter_threads (GTK_TREE_MODEL_FILTER (filter), 4);
+
+  g_assert_cmpint (gtk_tree_model_iter_n_children (filter, NULL), ==, 3000);
+
+  /* start a refilter and supersede it before it could finish */
+  divisor = 2;
+  gtk_tree_model_filter_refilter_async (GTK_TREE_MODEL_FILTER (filter));
+  g_assert (gtk_tree_model_filter_get_refiltering (GTK_TREE_MODEL_FILTER (filter)));
+
+  divisor = 3;
+  gtk_tree_model_filter_refilter_async (GTK_TREE_MODEL_FILTER (filter));
+
+  /* the walk has to cope with changes to the child model */
+  gtk_list_store_insert_with_values (store, &iter, 0, 0, 3000, -1);
+  gtk_tree_model_get_iter_first (GTK_TREE_MODEL (store), &iter);
+  gtk_list_store_remove (store, &iter);
+
+  while (gtk_tree_model_filter_get_refiltering (GTK_TREE_MODEL_FILTER (filter)))
+    gtk_main_iteration ();
+
+  g_assert_cmpint (gtk_tree_model_iter_n_children (filter, NULL), ==, 1000);
+
+  gtk_tree_model_get_iter_first (filter, &iter);
+  for (i = 0; i < 1000; i++)
+    {
+      gint value;
+
+      gtk_tree_model_get (filter, &iter, 0, &value, -1);
+      g_assert_cmpint (value, ==, i * 3);
+      gtk_tree_model_iter_next (filter, &iter);
+    }
+
+  g_object_unref (filter);
+  g_object_unref (store);
+}
+
+typedef struct
+{
+  GtkTreeStore *store;
+  gint divisor;
+  gint n_deleted;
+} RefilterThreadedData;
+
+static gboolean
+specific_refilter_threaded_visible_func (GtkTreeModel *model,
+                                         GtkTreeIter  *iter,
+                                         gpointer      user_data)
+{
+  RefilterThreadedData *data = user_data;
+  gint value;
+
+  gtk_tree_model_get (model, iter, 0, &value, -1);
+
+  return value % data->divisor == 0;
+}
+
+static void
+specific_refilter_threaded_row_deleted (GtkTreeModel *filter,
+                                        GtkTreePath  *path,
+                                        gpointer      user_data)
+{
+  RefilterThreadedData *data = user_data;
+  GtkTreeIter root, iter;
+
+  /* modify the child model while the first batch is being applied */
+  if (data->n_deleted++ != 0)
+    return;
+
+  /* Shift the virtual root, and the rows below it both before and
+   * inside the current batch.  The filter itself only copes with
+   * changes that do not touch the levels it is updating, so only
+   * invisible rows and rows after the current one are modified.
+   */
+  gtk_tree_model_get_iter_first (GTK_TREE_MODEL (data->store), &iter);
+  gtk_tree_store_remove (data->store, &iter);
+
+  gtk_tree_model_get_iter_first (GTK_TREE_MODEL (data->store), &root);
+  gtk_tree_store_insert_with_values (data->store, NULL, &root, 0, 0, 3001, -1);
+  gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (data->store), &iter, &root, 100);
+  gtk_tree_store_remove (data->store, &iter);
+}
+
+static void
+specific_refilter_async_threaded (void)
+{
+  RefilterThreadedData data;
+  GtkTreeIter iter, root, child;
+  GtkTreePath *path;
+  GtkTreeModel *filter;
+  gint n_visible = 0;
+  gint i;
+
+  data.store = gtk_tree_store_new (1, G_TYPE_INT);
+  data.divisor = 1;
+  data.n_deleted = 0;
+
+  gtk_tree_store_insert_with_values (data.store, &iter, NULL, 0, 0, 0, -1);
+  gtk_tree_store_insert_with_values (data.store, &root, NULL, 1, 0, 0, -1);
+  gtk_tree_store_insert_with_values (data.store, &iter, NULL, 2, 0, 0, -1);
+
+  for (i = 0; i < 2000; i++)
+    {
+      gtk_tree_store_insert_with_values (data.store, &iter, &root, i, 0, i, -1);
+      if (i % 10 == 0)
+        gtk_tree_store_insert_with_values (data.store, &child, &iter, 0,
+                                           0, i + 1, -1);
+    }
+
+  path = gtk_tree_path_new_from_indices (1, -1);
+  filter = gtk_tree_model_filter_new (GTK_TREE_MODEL (data.store), path);
+  gtk_tree_path_free (path);
+
+  gtk_tree_model_filter_set_visible_func (GTK_TREE_MODEL_FILTER (filter),
+                                          specific_refilter_threaded_visible_func,
+                                          &data, NULL);
+  gtk_tree_model_filter_set_refilter_threads (GTK_TREE_MODEL_FILTER (filter), 4);
+  g_signal_connect (filter, "row-deleted",
+                    G_CALLBACK (specific_refilter_threaded_row_deleted), &data);
+
+  g_assert_cmpint (gtk_tree_model_iter_n_children (filter, NULL), ==, 2000);
+
+  data.divisor = 2;
+  gtk_tree_model_filter_refilter_async (GTK_TREE_MODEL_FILTER (filter));
+
+  while (gtk_tree_model_filter_get_refiltering (GTK_TREE_MODEL_FILTER (filter)))
+    gtk_main_iteration ();
+
+  g_assert_cmpint (data.n_deleted, >, 1);
+
+  /* the filter has to match the child rows below the moved virtual root */
+  gtk_tree_model_get_iter_first (GTK_TREE_MODEL (data.store), &root);
+  gtk_tree_model_iter_children (GTK_TREE_MODEL (data.store), &child, &root);
+  gtk_tree_model_get_iter_first (filter, &iter);
+
+  do
+    {
+      gint c_value, value;
+
+      gtk_tree_model_get (GTK_TREE_MODEL (data.store), &child, 0, &c_value, -1);
+      if (c_value % 2 != 0)
+        continue;
+
+      gtk_tree_model_get (filter, &iter, 0, &value, -1);
+      g_assert_cmpint (value, ==, c_value);
+      n_visible++;
+
+      gtk_tree_model_iter_next (filter, &iter);
+    }
+  while (gtk_tree_model_iter_next (GTK_TREE_MODEL (data.store), &child));
+
+  g_assert_cmpint (gtk_tree_model_iter_n_children (filter, NULL), ==, n_visible);
+
+  /* deleting the virtual root ends the walk instead of continuing
+   * with the rows after it
+   */
+  data.divisor = 3;
+  gtk_tree_model_filter_refilter_async (GTK_TREE_MODEL_FILTER (filter));
+  gtk_tree_model_get_iter_first (GTK_TREE_MODEL (data.store), &root);
+  gtk_tree_store_remove (data.store, &root);
+
+  while (gtk_tree_model_filter_get_refiltering (GTK_TREE_MODEL_FILTER (filter)))
+    gtk_main_iteration ();
+
+  g_assert_cmpint (gtk_tree_model_iter_n_children (filter, NULL), ==, 0);
+
+  g_object_unref (filter);
+  g_object_unref (data.store);
+}
+
 int
 main (int    argc,
       char **argv)
 {
+  if (!g_thread_supported ())
+    g_thread_init (NULL);
+
   gtk_test_init (&argc, &argv, NULL);
 
   g_test_add ("/FilterModel/self/verify-test-suite",
@@ -2995,6 +3197,10 @@ main (int    argc,
                    specific_bug_540201);
   g_test_add_func ("/FilterModel/specific/bug-549287",
                    specific_bug_549287);
+  g_test_add_func ("/FilterModel/specific/refilter-async",
+                   specific_refilter_async);
+  g_test_add_func ("/FilterModel/specific/refilter-async-threaded",
+                   specific_refilter_async_threaded);
 
   return g_test_run ();
 }
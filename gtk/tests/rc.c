@@ -0,0 +1,219 @@
+/* GTK - The GIMP Toolkit
+ * rc.c: Tests for RC style matching
+ * Copyright (C) 1995-1997 Peter Mattis, Spencer Kimball and Josh MacDonald
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+#include <stdlib.h>
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+
+/* Style lookups are cached by widget path; parsing new rc
+ * statements must still be picked up.
+ */
+static void
+test_match_cache (void)
+{
+  GtkWidget *label1, *label2, *other;
+  GtkStyle *style;
+  gint default_xthickness;
+
+  label1 = g_object_ref_sink (gtk_label_new (NULL));
+  gtk_widget_set_name (label1, "rc-test-label");
+  label2 = g_object_ref_sink (gtk_label_new (NULL));
+  gtk_widget_set_name (label2, "rc-test-label");
+  other = g_object_ref_sink (gtk_label_new (NULL));
+  gtk_widget_set_name (other, "rc-test-other");
+
+  style = gtk_rc_get_style (label1);
+  default_xthickness = style->xthickness;
+  g_assert_cmpint (default_xthickness, !=, 17);
+
+  gtk_rc_parse_string ("style \"rc-test\" { xthickness = 17 }\n"
+                       "widget \"rc-test-label\" style \"rc-test\"\n");
+
+  g_assert_cmpint (gtk_rc_get_style (label1)->xthickness, ==, 17);
+  g_assert_cmpint (gtk_rc_get_style (label2)->xthickness, ==, 17);
+  g_assert (gtk_rc_get_style (label1) == gtk_rc_get_style (label2));
+  g_assert_cmpint (gtk_rc_get_style (other)->xthickness, ==, default_xthickness);
+
+  gtk_rc_parse_string ("style \"rc-test-class\" { ythickness = 13 }\n"
+                       "class \"GtkLabel\" style \"rc-test-class\"\n");
+
+  g_assert_cmpint (gtk_rc_get_style (other)->ythickness, ==, 13);
+  g_assert_cmpint (gtk_rc_get_style (label1)->xthickness, ==, 17);
+
+  style = gtk_rc_get_style_by_paths (gtk_widget_get_settings (label1),
+                                     "rc-test-label", NULL, GTK_TYPE_LABEL);
+  g_assert (style != NULL);
+  g_assert_cmpint (style->xthickness, ==, 17);
+  g_assert_cmpint (style->ythickness, ==, 13);
+
+  g_object_unref (label1);
+  g_object_unref (label2);
+  g_object_unref (other);
+}
+
+/* Widgets modified the same way share their style, and changing
+ * one of them later must not affect the others.
+ */
+static void
+test_modify_sharing (void)
+{
+  GtkWidget *label1, *label2;
+  GdkColor red = { 0, 0xffff, 0, 0 };
+  GdkColor blue = { 0, 0, 0, 0xffff };
+  GtkStyle *style1, *style2;
+
+  label1 = g_object_ref_sink (gtk_label_new (NULL));
+  label2 = g_object_ref_sink (gtk_label_new (NULL));
+
+  gtk_widget_modify_fg (label1, GTK_STATE_NORMAL, &red);
+  gtk_widget_modify_fg (label2, GTK_STATE_NORMAL, &red);
+
+  style1 = gtk_rc_get_style (label1);
+  style2 = gtk_rc_get_style (label2);
+  g_assert (style1 == style2);
+  g_assert (gdk_color_equal (&style1->fg[GTK_STATE_NORMAL], &red));
+
+  gtk_widget_modify_fg (label2, GTK_STATE_NORMAL, &blue);
+
+  style1 = gtk_rc_get_style (label1);
+  style2 = gtk_rc_get_style (label2);
+  g_assert (style1 != style2);
+  g_assert (gdk_color_equal (&style1->fg[GTK_STATE_NORMAL], &red));
+  g_assert (gdk_color_equal (&style2->fg[GTK_STATE_NORMAL], &blue));
+
+  g_object_unref (label1);
+  g_object_unref (label2);
+}
+
+/* Files that show up after a lookup failed must be found by
+ * the next reparse.
+ */
+static void
+test_lookup_reparse (void)
+{
+  GtkWidget *label;
+  GtkSettings *settings;
+  GtkStyle *style;
+  gchar *dir, *image, *rc;
+
+  dir = g_build_filename (g_get_tmp_dir (), "gtk-rc-lookup-XXXXXX", NULL);
+  g_assert (mkdtemp (dir) != NULL);
+  image = g_build_filename (dir, "later.xpm", NULL);
+
+  label = g_object_ref_sink (gtk_label_new (NULL));
+  gtk_widget_set_name (label, "rc-lookup-label");
+  settings = gtk_widget_get_settings (label);
+
+  rc = g_strdup_printf ("pixmap_path \"%s\"\n"
+                        "style \"rc-lookup\" { bg_pixmap[NORMAL] = \"later.xpm\" }\n"
+                        "widget \"rc-lookup-label\" style \"rc-lookup\"\n",
+                        dir);
+  gtk_rc_parse_string (rc);
+
+  style = gtk_rc_get_style (label);
+  g_assert (style->rc_style->bg_pixmap_name[GTK_STATE_NORMAL] == NULL);
+
+  g_assert (g_file_set_contents (image, "", 0, NULL));
+  gtk_rc_reparse_all_for_settings (settings, TRUE);
+
+  style = gtk_rc_get_style (label);
+  g_assert_cmpstr (style->rc_style->bg_pixmap_name[GTK_STATE_NORMAL], ==, image);
+
+  g_object_unref (label);
+  g_unlink (image);
+  g_rmdir (dir);
+  g_free (rc);
+  g_free (image);
+  g_free (dir);
+}
+
+/* Background pixmaps of other states than the normal one are only
+ * loaded once a style paints with them, and styles share them.
+ */
+static void
+test_bg_pixmap_on_use (void)
+{
+  static const gchar xpm[] =
+    "/* XPM */\n"
+    "static char *bg[] = {\n"
+    "\"2 2 1 1\",\n"
+    "\". c #FF0000\",\n"
+    "\"..\",\n"
+    "\"..\"};\n";
+  GtkWidget *window1, *window2;
+  GtkStyle *style1, *style2;
+  gchar *dir, *image, *rc;
+
+  dir = g_build_filename (g_get_tmp_dir (), "gtk-rc-bg-XXXXXX", NULL);
+  g_assert (mkdtemp (dir) != NULL);
+  image = g_build_filename (dir, "bg.xpm", NULL);
+  g_assert (g_file_set_contents (image, xpm, -1, NULL));
+
+  rc = g_strdup_printf ("pixmap_path \"%s\"\n"
+                        "style \"rc-bg-one\" { bg_pixmap[PRELIGHT] = \"bg.xpm\" fg[NORMAL] = \"#ff0000\" }\n"
+                        "style \"rc-bg-two\" { bg_pixmap[PRELIGHT] = \"bg.xpm\" fg[NORMAL] = \"#00ff00\" }\n"
+                        "widget \"rc-bg-one\" style \"rc-bg-one\"\n"
+                        "widget \"rc-bg-two\" style \"rc-bg-two\"\n",
+                        dir);
+  gtk_rc_parse_string (rc);
+
+  window1 = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  gtk_widget_set_name (window1, "rc-bg-one");
+  gtk_widget_realize (window1);
+  window2 = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  gtk_widget_set_name (window2, "rc-bg-two");
+  gtk_widget_realize (window2);
+
+  style1 = gtk_widget_get_style (window1);
+  style2 = gtk_widget_get_style (window2);
+  g_assert (style1 != style2);
+  g_assert (style1->bg_pixmap[GTK_STATE_PRELIGHT] == NULL);
+  g_assert (style2->bg_pixmap[GTK_STATE_PRELIGHT] == NULL);
+
+  gtk_style_set_background (style1, window1->window, GTK_STATE_PRELIGHT);
+  g_assert (GDK_IS_PIXMAP (style1->bg_pixmap[GTK_STATE_PRELIGHT]));
+  g_assert (style2->bg_pixmap[GTK_STATE_PRELIGHT] == NULL);
+
+  gtk_style_apply_default_background (style2, window2->window, TRUE,
+                                      GTK_STATE_PRELIGHT, NULL,
+                                      0, 0, 1, 1);
+  g_assert (style2->bg_pixmap[GTK_STATE_PRELIGHT] == style1->bg_pixmap[GTK_STATE_PRELIGHT]);
+
+  gtk_widget_destroy (window1);
+  gtk_widget_destroy (window2);
+  g_unlink (image);
+  g_rmdir (dir);
+  g_free (rc);
+  g_free (image);
+  g_free (dir);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  gtk_test_init (&argc, &argv);
+
+  g_test_add_func ("/rc/match-cache", test_match_cache);
+  g_test_add_func ("/rc/modify-sharing", test_modify_sharing);
+  g_test_add_func ("/rc/lookup-reparse", test_lookup_reparse);
+  g_test_add_func ("/rc/bg-pixmap-on-use", test_bg_pixmap_on_use);
+
+  return g_test_run ();
+}
@@ -0,0 +1,183 @@
+/* GTK - The GIMP Toolkit
+ * sortmodel.c: Tests for GtkTreeModelSort
+ * Copyright (C) 1995-1997 Peter Mattis, Spencer Kimball and Josh MacDonald
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <gtk/gtk.h>
+
+static void
+rows_reordered (GtkTreeModel *model,
+                GtkTreePath  *path,
+                GtkTreeIter  *iter,
+                gint         *new_order,
+                gpointer      data)
+{
+  gint *n_reordered = data;
+
+  (*n_reordered)++;
+}
+
+static void
+check_order (GtkTreeModel *model,
+             const gint   *values,
+             gint          n_values)
+{
+  GtkTreeIter iter;
+  gint i;
+
+  g_assert_cmpint (gtk_tree_model_iter_n_children (model, NULL), ==, n_values);
+
+  gtk_tree_model_get_iter_first (model, &iter);
+  for (i = 0; i < n_values; i++)
+    {
+      gint value;
+
+      gtk_tree_model_get (model, &iter, 0, &value, -1);
+      g_assert_cmpint (value, ==, values[i]);
+      gtk_tree_model_iter_next (model, &iter);
+    }
+}
+
+static void
+set_value (GtkListStore *store,
+           gint          index,
+           gint          value)
+{
+  GtkTreeIter iter;
+
+  gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (store), &iter, NULL, index);
+  gtk_list_store_set (store, &iter, 0, value, -1);
+}
+
+static GtkTreeModel *
+create_sort_model (GtkListStore *store)
+{
+  GtkTreeModel *sort;
+  gint i;
+
+  for (i = 0; i < 10; i++)
+    gtk_list_store_insert_with_values (store, NULL, i, 0, i * 10, -1);
+
+  sort = gtk_tree_model_sort_new_with_model (GTK_TREE_MODEL (store));
+  gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (sort), 0,
+                                        GTK_SORT_ASCENDING);
+  gtk_tree_model_sort_set_deferred_resort (GTK_TREE_MODEL_SORT (sort), TRUE);
+
+  return sort;
+}
+
+static void
+test_deferred_resort (void)
+{
+  const gint unchanged[] = { 95, 10, 20, 30, 40, 5, 60, 70, 80, -1 };
+  const gint sorted[] = { -1, 5, 10, 20, 30, 40, 60, 70, 80, 95 };
+  const gint inserted[] = { -1, 5, 10, 20, 30, 40, 42, 60, 70, 80, 95 };
+  GtkListStore *store;
+  GtkTreeModel *sort;
+  gint n_reordered = 0;
+
+  store = gtk_list_store_new (1, G_TYPE_INT);
+  sort = create_sort_model (store);
+  g_signal_connect (sort, "rows-reordered",
+                    G_CALLBACK (rows_reordered), &n_reordered);
+
+  /* changed rows keep their position until the resort is flushed */
+  set_value (store, 0, 95);
+  set_value (store, 5, 5);
+  set_value (store, 9, -1);
+  check_order (sort, unchanged, G_N_ELEMENTS (unchanged));
+  g_assert_cmpint (n_reordered, ==, 0);
+
+  gtk_tree_model_sort_flush_resort (GTK_TREE_MODEL_SORT (sort));
+  check_order (sort, sorted, G_N_ELEMENTS (sorted));
+  g_assert_cmpint (n_reordered, ==, 1);
+
+  /* nothing to do, nothing to emit */
+  gtk_tree_model_sort_flush_resort (GTK_TREE_MODEL_SORT (sort));
+  g_assert_cmpint (n_reordered, ==, 1);
+
+  /* inserted rows are merged in by the idle */
+  gtk_list_store_insert_with_values (store, NULL, 0, 0, 42, -1);
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+
+  check_order (sort, inserted, G_N_ELEMENTS (inserted));
+  g_assert_cmpint (n_reordered, ==, 2);
+
+  g_object_unref (sort);
+  g_object_unref (store);
+}
+
+static void
+row_changed_remove (GtkTreeModel *model,
+                    GtkTreePath  *path,
+                    GtkTreeIter  *iter,
+                    gpointer      data)
+{
+  GtkListStore *store = data;
+  GtkTreeIter child;
+
+  g_signal_handlers_disconnect_by_func (model, row_changed_remove, data);
+
+  /* drop the changed row itself, then flush */
+  gtk_tree_model_sort_convert_iter_to_child_iter (GTK_TREE_MODEL_SORT (model),
+                                                  &child, iter);
+  gtk_list_store_remove (store, &child);
+  gtk_tree_model_sort_flush_resort (GTK_TREE_MODEL_SORT (model));
+}
+
+static void
+test_deferred_resort_reentrant (void)
+{
+  const gint remaining[] = { 0, 10, 20, 30, 40, 50, 60, 70, 80 };
+  GtkListStore *store;
+  GtkTreeModel *sort;
+  gint n_reordered = 0;
+
+  store = gtk_list_store_new (1, G_TYPE_INT);
+  sort = create_sort_model (store);
+  g_assert_cmpint (gtk_tree_model_iter_n_children (sort, NULL), ==, 10);
+  g_signal_connect (sort, "rows-reordered",
+                    G_CALLBACK (rows_reordered), &n_reordered);
+  g_signal_connect (sort, "row-changed",
+                    G_CALLBACK (row_changed_remove), store);
+
+  set_value (store, 9, -1);
+
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+
+  check_order (sort, remaining, G_N_ELEMENTS (remaining));
+  g_assert_cmpint (n_reordered, ==, 0);
+
+  g_object_unref (sort);
+  g_object_unref (store);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  gtk_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/TreeModelSort/deferred-resort", test_deferred_resort);
+  g_test_add_func ("/TreeModelSort/deferred-resort-reentrant",
+                   test_deferred_resort_reentrant);
+
+  return g_test_run ();
+}
@@ -1320,6 +1320,590 @@ test_tag (void)
   g_object_unref (buffer);
 }
 
+static void
+check_search (GtkTextBuffer     *buffer,
+              gint               from,
+              const gchar       *str,
+              GtkTextSearchFlags flags,
+              gboolean           backward,
+              gint               start_offset,
+              gint               end_offset)
+{
+  GtkTextIter iter, match_start, match_end;
+  gboolean found;
+
+  gtk_text_buffer_get_iter_at_offset (buffer, &iter, from);
+
+  if (backward)
+    found = gtk_text_iter_backward_search (&iter, str, flags,
+                                           &match_start, &match_end, NULL);
+  else
+    found = gtk_text_iter_forward_search (&iter, str, flags,
+                                          &match_start, &match_end, NULL);
+
+  if (start_offset < 0)
+    {
+      g_assert (!found);
+      return;
+    }
+
+  g_assert (found);
+  g_assert_cmpint (gtk_text_iter_get_offset (&match_start), ==, start_offset);
+  g_assert_cmpint (gtk_text_iter_get_offset (&match_end), ==, end_offset);
+}
+
+static void
+test_search (void)
+{
+  GtkTextBuffer *buffer;
+  GtkTextIter start, end;
+  GtkTextIter *matches;
+  guint n_matches;
+
+  buffer = gtk_text_buffer_new (NULL);
+  gtk_text_buffer_set_text (buffer, "Hello world\nhello World\nHELLO\n", -1);
+
+  /* Split the first line into several segments */
+  gtk_text_buffer_create_tag (buffer, "bold", "weight", PANGO_WEIGHT_BOLD, NULL);
+  gtk_text_buffer_get_iter_at_offset (buffer, &start, 2);
+  gtk_text_buffer_get_iter_at_offset (buffer, &end, 8);
+  gtk_text_buffer_apply_tag_by_name (buffer, "bold", &start, &end);
+
+  check_search (buffer, 0, "world", 0, FALSE, 6, 11);
+  check_search (buffer, 0, "llo wor", 0, FALSE, 2, 9);
+  check_search (buffer, 7, "world", 0, FALSE, -1, -1);
+  check_search (buffer, 7, "WORLD", GTK_TEXT_SEARCH_CASE_INSENSITIVE, FALSE, 18, 23);
+  check_search (buffer, 0, "WORLD\nHELLO", GTK_TEXT_SEARCH_CASE_INSENSITIVE, FALSE, 6, 17);
+  check_search (buffer, 0, "d\nH", 0, FALSE, 22, 25);
+  check_search (buffer, 30, "hello", GTK_TEXT_SEARCH_CASE_INSENSITIVE, TRUE, 24, 29);
+  check_search (buffer, 30, "hello", 0, TRUE, 12, 17);
+
+  gtk_text_buffer_get_start_iter (buffer, &start);
+  matches = gtk_text_iter_forward_search_all (&start, "hello",
+                                              GTK_TEXT_SEARCH_CASE_INSENSITIVE,
+                                              NULL, &n_matches);
+  g_assert_cmpuint (n_matches, ==, 3);
+  g_assert_cmpint (gtk_text_iter_get_offset (&matches[0]), ==, 0);
+  g_assert_cmpint (gtk_text_iter_get_offset (&matches[3]), ==, 17);
+  g_assert_cmpint (gtk_text_iter_get_offset (&matches[4]), ==, 24);
+  g_free (matches);
+
+  matches = gtk_text_iter_forward_search_all (&start, "xyz", 0, NULL, &n_matches);
+  g_assert (matches == NULL);
+  g_assert_cmpuint (n_matches, ==, 0);
+
+  /* The newline ending the last line of the tree isn't in the buffer */
+  check_search (buffer, 30, "\n", 0, FALSE, -1, -1);
+  check_search (buffer, 30, "\n", GTK_TEXT_SEARCH_CASE_INSENSITIVE, FALSE, -1, -1);
+
+  matches = gtk_text_iter_forward_search_all (&start, "\n", 0, NULL, &n_matches);
+  g_assert_cmpuint (n_matches, ==, 3);
+  g_assert_cmpint (gtk_text_iter_get_offset (&matches[4]), ==, 29);
+  g_assert_cmpint (gtk_text_iter_get_offset (&matches[5]), ==, 30);
+  g_free (matches);
+
+  gtk_text_buffer_set_text (buffer, "abc", -1);
+  check_search (buffer, 0, "abc", 0, FALSE, 0, 3);
+  check_search (buffer, 0, "abc\n", 0, FALSE, -1, -1);
+  check_search (buffer, 0, "ABC\n", GTK_TEXT_SEARCH_CASE_INSENSITIVE, FALSE, -1, -1);
+  check_search (buffer, 0, "c\n", GTK_TEXT_SEARCH_TEXT_ONLY, FALSE, -1, -1);
+
+  gtk_text_buffer_get_start_iter (buffer, &start);
+  matches = gtk_text_iter_forward_search_all (&start, "\n", 0, NULL, &n_matches);
+  g_assert (matches == NULL);
+  g_assert_cmpuint (n_matches, ==, 0);
+
+  g_object_unref (buffer);
+}
+
+static void
+check_long_line_offsets (GtkTextBuffer *buffer,
+                         const gchar   *text)
+{
+  GtkTextIter iter;
+  gint n_chars = g_utf8_strlen (text, -1);
+  gint i;
+
+  for (i = 0; i < n_chars; i += 997)
+    {
+      gtk_text_buffer_get_iter_at_offset (buffer, &iter, i);
+      g_assert_cmpint (gtk_text_iter_get_line_index (&iter), ==,
+                       g_utf8_offset_to_pointer (text, i) - text);
+
+      gtk_text_buffer_get_iter_at_line_index (buffer, &iter, 0,
+                                              g_utf8_offset_to_pointer (text, i) - text);
+      g_assert_cmpint (gtk_text_iter_get_line_offset (&iter), ==, i);
+    }
+}
+
+static void
+test_long_line (void)
+{
+  GtkTextBuffer *buffer;
+  GtkTextIter iter;
+  GString *str;
+  gint i;
+
+  /* Long enough to get a line index, with multibyte chars */
+  str = g_string_new (NULL);
+  for (i = 0; i < 3000; i++)
+    g_string_append (str, (i % 3) ? "ab" : "\303\251\342\202\254");
+
+  buffer = gtk_text_buffer_new (NULL);
+  gtk_text_buffer_set_text (buffer, str->str, -1);
+  check_long_line_offsets (buffer, str->str);
+
+  /* The index must follow changes to the line */
+  gtk_text_buffer_get_iter_at_offset (buffer, &iter, 2500);
+  gtk_text_buffer_insert (buffer, &iter, "\342\202\254xyz", -1);
+  g_string_insert (str, g_utf8_offset_to_pointer (str->str, 2500) - str->str,
+                   "\342\202\254xyz");
+  check_long_line_offsets (buffer, str->str);
+
+  /* ...but not to marks */
+  gtk_text_buffer_get_iter_at_offset (buffer, &iter, 5000);
+  gtk_text_buffer_place_cursor (buffer, &iter);
+  check_long_line_offsets (buffer, str->str);
+
+  g_string_free (str, TRUE);
+  g_object_unref (buffer);
+}
+
+static void
+test_serialize_stream (void)
+{
+  GtkTextBuffer *buffer, *buffer2;
+  GtkTextIter start, end, iter, iter2;
+  GtkTextTag *tag;
+  GOutputStream *output;
+  GInputStream *input;
+  GdkAtom format;
+  GError *error = NULL;
+  guint8 *data;
+  gchar *text, *text2;
+  gsize length;
+
+  buffer = gtk_text_buffer_new (NULL);
+  fill_buffer (buffer);
+
+  /* Long enough to be serialized in several pieces */
+  text = g_strnfill (200000, 'x');
+  gtk_text_buffer_get_end_iter (buffer, &end);
+  gtk_text_buffer_insert_with_tags_by_name (buffer, &end, text, -1,
+                                            "fg_red", NULL);
+  g_free (text);
+
+  format = gtk_text_buffer_register_serialize_tagset (buffer, NULL);
+  gtk_text_buffer_get_bounds (buffer, &start, &end);
+
+  /* The stream gets the same data gtk_text_buffer_serialize() returns */
+  data = gtk_text_buffer_serialize (buffer, buffer, format,
+                                    &start, &end, &length);
+
+  output = g_memory_output_stream_new (NULL, 0, g_realloc, g_free);
+  g_assert (gtk_text_buffer_serialize_to_stream (buffer, buffer, format,
+                                                 &start, &end, output,
+                                                 NULL, &error));
+  g_assert_no_error (error);
+  g_assert_cmpuint (g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (output)), ==, length);
+  g_assert (memcmp (g_memory_output_stream_get_data (G_MEMORY_OUTPUT_STREAM (output)),
+                    data, length) == 0);
+  g_object_unref (output);
+
+  /* Read it back into a buffer sharing the tag table */
+  buffer2 = gtk_text_buffer_new (gtk_text_buffer_get_tag_table (buffer));
+  format = gtk_text_buffer_register_deserialize_tagset (buffer2, NULL);
+
+  input = g_memory_input_stream_new_from_data (data, length, NULL);
+  gtk_text_buffer_get_start_iter (buffer2, &iter);
+  g_assert (gtk_text_buffer_deserialize_from_stream (buffer2, buffer2, format,
+                                                     &iter, input,
+                                                     NULL, &error));
+  g_assert_no_error (error);
+  g_assert (gtk_text_iter_is_end (&iter));
+  g_object_unref (input);
+
+  gtk_text_buffer_get_bounds (buffer, &start, &end);
+  text = gtk_text_buffer_get_slice (buffer, &start, &end, TRUE);
+  gtk_text_buffer_get_bounds (buffer2, &start, &end);
+  text2 = gtk_text_buffer_get_slice (buffer2, &start, &end, TRUE);
+  g_assert_cmpstr (text, ==, text2);
+  g_free (text);
+  g_free (text2);
+
+  /* Pixbufs and tags end up where they were */
+  gtk_text_buffer_get_start_iter (buffer, &iter);
+  gtk_text_buffer_get_start_iter (buffer2, &iter2);
+  do
+    {
+      g_assert ((gtk_text_iter_get_pixbuf (&iter) != NULL) ==
+                (gtk_text_iter_get_pixbuf (&iter2) != NULL));
+    }
+  while (gtk_text_iter_forward_char (&iter) && gtk_text_iter_forward_char (&iter2));
+
+  tag = gtk_text_tag_table_lookup (gtk_text_buffer_get_tag_table (buffer),
+                                   "fg_red");
+  gtk_text_buffer_get_end_iter (buffer2, &iter2);
+  gtk_text_iter_backward_chars (&iter2, 100000);
+  g_assert (gtk_text_iter_has_tag (&iter2, tag));
+
+  /* Truncated data inserts what it could read, then fails */
+  gtk_text_buffer_set_text (buffer2, "", -1);
+  input = g_memory_input_stream_new_from_data (data, length / 2, NULL);
+  gtk_text_buffer_get_start_iter (buffer2, &iter);
+  g_assert (!gtk_text_buffer_deserialize_from_stream (buffer2, buffer2, format,
+                                                      &iter, input,
+                                                      NULL, &error));
+  g_assert (error != NULL);
+  g_clear_error (&error);
+  g_assert_cmpint (gtk_text_buffer_get_char_count (buffer2), >, 0);
+  g_object_unref (input);
+
+  g_free (data);
+  g_object_unref (buffer2);
+  g_object_unref (buffer);
+}
+
+static void
+test_serialize_stream_tagged_pixbuf (void)
+{
+  GtkTextBuffer *buffer, *buffer2;
+  GtkTextIter start, end, iter;
+  GtkTextTag *tag;
+  GOutputStream *output;
+  GInputStream *input;
+  GdkPixbuf *pixbuf;
+  GdkAtom format;
+  GError *error = NULL;
+
+  buffer = gtk_text_buffer_new (NULL);
+  tag = gtk_text_buffer_create_tag (buffer, "pixbuf_tag", "rise", 5, NULL);
+
+  pixbuf = gdk_pixbuf_new_from_xpm_data (book_closed_xpm);
+  gtk_text_buffer_set_text (buffer, "ab", -1);
+  gtk_text_buffer_get_iter_at_offset (buffer, &iter, 1);
+  gtk_text_buffer_insert_pixbuf (buffer, &iter, pixbuf);
+  g_object_unref (pixbuf);
+
+  gtk_text_buffer_get_iter_at_offset (buffer, &start, 1);
+  gtk_text_buffer_get_iter_at_offset (buffer, &end, 2);
+  gtk_text_buffer_apply_tag (buffer, tag, &start, &end);
+
+  format = gtk_text_buffer_register_serialize_tagset (buffer, NULL);
+  gtk_text_buffer_get_bounds (buffer, &start, &end);
+  output = g_memory_output_stream_new (NULL, 0, g_realloc, g_free);
+  g_assert (gtk_text_buffer_serialize_to_stream (buffer, buffer, format,
+                                                 &start, &end, output,
+                                                 NULL, &error));
+  g_assert_no_error (error);
+  g_output_stream_close (output, NULL, NULL);
+
+  /* Pixbufs are streamed after the markup, so their tags have to
+   * survive until the pixbuf is read.
+   */
+  buffer2 = gtk_text_buffer_new (gtk_text_buffer_get_tag_table (buffer));
+  format = gtk_text_buffer_register_deserialize_tagset (buffer2, NULL);
+  input = g_memory_input_stream_new_from_data (g_memory_output_stream_get_data (G_MEMORY_OUTPUT_STREAM (output)),
+                                               g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (output)),
+                                               NULL);
+  gtk_text_buffer_get_start_iter (buffer2, &iter);
+  g_assert (gtk_text_buffer_deserialize_from_stream (buffer2, buffer2, format,
+                                                     &iter, input,
+                                                     NULL, &error));
+  g_assert_no_error (error);
+
+  g_assert_cmpint (gtk_text_buffer_get_char_count (buffer2), ==, 3);
+  gtk_text_buffer_get_iter_at_offset (buffer2, &iter, 1);
+  g_assert (gtk_text_iter_get_pixbuf (&iter) != NULL);
+  g_assert (gtk_text_iter_has_tag (&iter, tag));
+  gtk_text_buffer_get_iter_at_offset (buffer2, &iter, 0);
+  g_assert (!gtk_text_iter_has_tag (&iter, tag));
+  gtk_text_buffer_get_iter_at_offset (buffer2, &iter, 2);
+  g_assert (!gtk_text_iter_has_tag (&iter, tag));
+
+  g_object_unref (input);
+  g_object_unref (output);
+  g_object_unref (buffer2);
+  g_object_unref (buffer);
+}
+
+typedef struct
+{
+  GMainLoop *loop;
+  gboolean success;
+  GError *error;
+} AsyncData;
+
+static void
+serialize_async_cb (GObject      *source,
+                    GAsyncResult *result,
+                    gpointer      user_data)
+{
+  AsyncData *data = user_data;
+
+  data->success = gtk_text_buffer_serialize_to_stream_finish (GTK_TEXT_BUFFER (source),
+                                                              result, &data->error);
+  g_main_loop_quit (data->loop);
+}
+
+static void
+deserialize_async_cb (GObject      *source,
+                      GAsyncResult *result,
+                      gpointer      user_data)
+{
+  AsyncData *data = user_data;
+
+  data->success = gtk_text_buffer_deserialize_from_stream_finish (GTK_TEXT_BUFFER (source),
+                                                                  result, &data->error);
+  g_main_loop_quit (data->loop);
+}
+
+static void
+test_serialize_stream_async (void)
+{
+  GtkTextBuffer *buffer, *buffer2;
+  GtkTextIter start, end, iter;
+  GOutputStream *output;
+  GInputStream *input;
+  GdkAtom format;
+  AsyncData data = { NULL, FALSE, NULL };
+  gchar *text, *text2;
+
+  data.loop = g_main_loop_new (NULL, FALSE);
+
+  buffer = gtk_text_buffer_new (NULL);
+  fill_buffer (buffer);
+
+  /* Long enough to be serialized in several pieces */
+  text = g_strnfill (200000, 'x');
+  gtk_text_buffer_get_end_iter (buffer, &end);
+  gtk_text_buffer_insert_with_tags_by_name (buffer, &end, text, -1,
+                                            "fg_red", NULL);
+  g_free (text);
+
+  format = gtk_text_buffer_register_serialize_tagset (buffer, NULL);
+  gtk_text_buffer_get_bounds (buffer, &start, &end);
+  output = g_memory_output_stream_new (NULL, 0, g_realloc, g_free);
+  gtk_text_buffer_serialize_to_stream_async (buffer, buffer, format,
+                                             &start, &end, output,
+                                             G_PRIORITY_DEFAULT, NULL,
+                                             serialize_async_cb, &data);
+  g_main_loop_run (data.loop);
+  g_assert_no_error (data.error);
+  g_assert (data.success);
+  g_output_stream_close (output, NULL, NULL);
+
+  buffer2 = gtk_text_buffer_new (gtk_text_buffer_get_tag_table (buffer));
+  format = gtk_text_buffer_register_deserialize_tagset (buffer2, NULL);
+  input = g_memory_input_stream_new_from_data (g_memory_output_stream_get_data (G_MEMORY_OUTPUT_STREAM (output)),
+                                               g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (output)),
+                                               NULL);
+  gtk_text_buffer_get_start_iter (buffer2, &iter);
+  data.success = FALSE;
+  gtk_text_buffer_deserialize_from_stream_async (buffer2, buffer2, format,
+                                                 &iter, input,
+                                                 G_PRIORITY_DEFAULT, NULL,
+                                                 deserialize_async_cb, &data);
+  g_main_loop_run (data.loop);
+  g_assert_no_error (data.error);
+  g_assert (data.success);
+
+  gtk_text_buffer_get_bounds (buffer, &start, &end);
+  text = gtk_text_buffer_get_slice (buffer, &start, &end, TRUE);
+  gtk_text_buffer_get_bounds (buffer2, &start, &end);
+  text2 = gtk_text_buffer_get_slice (buffer2, &start, &end, TRUE);
+  g_assert_cmpstr (text, ==, text2);
+  g_free (text);
+  g_free (text2);
+  g_object_unref (input);
+  g_object_unref (output);
+
+  /* Changing the buffer while it is being serialized fails the
+   * operation instead of writing inconsistent data.
+   */
+  output = g_memory_output_stream_new (NULL, 0, g_realloc, g_free);
+  gtk_text_buffer_get_bounds (buffer, &start, &end);
+  format = gtk_text_buffer_register_serialize_tagset (buffer, "modified");
+  gtk_text_buffer_serialize_to_stream_async (buffer, buffer, format,
+                                             &start, &end, output,
+                                             G_PRIORITY_DEFAULT, NULL,
+                                             serialize_async_cb, &data);
+  gtk_text_buffer_get_start_iter (buffer, &iter);
+  gtk_text_buffer_insert (buffer, &iter, "changed", -1);
+
+  data.success = TRUE;
+  g_main_loop_run (data.loop);
+  g_assert (!data.success);
+  g_assert_error (data.error, G_IO_ERROR, G_IO_ERROR_FAILED);
+  g_clear_error (&data.error);
+  g_object_unref (output);
+
+  g_main_loop_unref (data.loop);
+  g_object_unref (buffer2);
+  g_object_unref (buffer);
+}
+
+static void
+count_signal (GtkTextBuffer *buffer,
+              gpointer       data)
+{
+  (*(gint *) data)++;
+}
+
+static void
+count_mark_set (GtkTextBuffer     *buffer,
+                const GtkTextIter *location,
+                GtkTextMark       *mark,
+                gpointer           data)
+{
+  if (mark == gtk_text_buffer_get_insert (buffer))
+    {
+      /* Announced at its final location */
+      g_assert_cmpint (gtk_text_iter_get_offset (location), ==, 3);
+      (*(gint *) data)++;
+    }
+}
+
+static void
+test_freeze_changes (void)
+{
+  GtkTextBuffer *buffer;
+  GtkTextIter iter;
+  gint n_changed = 0;
+  gint n_mark_set = 0;
+  gint i;
+
+  buffer = gtk_text_buffer_new (NULL);
+  g_signal_connect (buffer, "changed", G_CALLBACK (count_signal), &n_changed);
+  g_signal_connect (buffer, "mark-set", G_CALLBACK (count_mark_set), &n_mark_set);
+
+  gtk_text_buffer_freeze_changes (buffer);
+  gtk_text_buffer_freeze_changes (buffer);
+
+  for (i = 0; i < 10; i++)
+    {
+      gtk_text_buffer_get_end_iter (buffer, &iter);
+      gtk_text_buffer_insert (buffer, &iter, "ab\n", -1);
+      gtk_text_buffer_get_iter_at_offset (buffer, &iter, i);
+      gtk_text_buffer_place_cursor (buffer, &iter);
+    }
+  gtk_text_buffer_get_iter_at_offset (buffer, &iter, 3);
+  gtk_text_buffer_place_cursor (buffer, &iter);
+
+  gtk_text_buffer_thaw_changes (buffer);
+  g_assert_cmpint (n_changed, ==, 0);
+  g_assert_cmpint (n_mark_set, ==, 0);
+  g_assert (!gtk_text_buffer_get_modified (buffer));
+
+  gtk_text_buffer_thaw_changes (buffer);
+  g_assert_cmpint (n_changed, ==, 1);
+  g_assert_cmpint (n_mark_set, ==, 1);
+  g_assert (gtk_text_buffer_get_modified (buffer));
+  g_assert_cmpint (gtk_text_buffer_get_char_count (buffer), ==, 30);
+
+  /* Thawed buffers emit right away again */
+  gtk_text_buffer_place_cursor (buffer, &iter);
+  g_assert_cmpint (n_mark_set, ==, 2);
+
+  g_object_unref (buffer);
+}
+
+static void
+test_freeze_location (void)
+{
+  GtkWidget *view;
+  GtkTextBuffer *buffer;
+  GtkTextIter iter;
+  GdkRectangle frozen, thawed, before;
+
+  view = g_object_ref_sink (gtk_text_view_new ());
+  buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (view));
+  gtk_text_buffer_set_text (buffer, "a\nb", -1);
+
+  gtk_text_buffer_get_iter_at_offset (buffer, &iter, 0);
+  gtk_text_view_get_iter_location (GTK_TEXT_VIEW (view), &iter, &before);
+
+  /* Locations asked for during a freeze reflect the edits made so far */
+  gtk_text_buffer_freeze_changes (buffer);
+  gtk_text_buffer_insert (buffer, &iter, "wwwwwwwwww", -1);
+  gtk_text_buffer_get_iter_at_offset (buffer, &iter, 10);
+  gtk_text_view_get_iter_location (GTK_TEXT_VIEW (view), &iter, &frozen);
+  g_assert_cmpint (frozen.x, >, before.x);
+  gtk_text_buffer_thaw_changes (buffer);
+
+  gtk_text_buffer_get_iter_at_offset (buffer, &iter, 10);
+  gtk_text_view_get_iter_location (GTK_TEXT_VIEW (view), &iter, &thawed);
+  g_assert_cmpint (frozen.x, ==, thawed.x);
+  g_assert_cmpint (frozen.y, ==, thawed.y);
+  g_assert_cmpint (frozen.width, ==, thawed.width);
+  g_assert_cmpint (frozen.height, ==, thawed.height);
+
+  g_object_unref (view);
+}
+
+/* Inserting many lines into a buffer whose tree is still a single leaf
+ * builds the whole tree in one go; the tags and marks that were in the
+ * leaf must end up in the right nodes.  With GTK_DEBUG_TEXT, every
+ * change below also runs the btree consistency check.
+ */
+static void
+test_build_from_root_leaf (void)
+{
+  GtkTextBuffer *buffer;
+  GtkTextTag *tag;
+  GtkTextMark *mark;
+  GtkTextIter iter, end;
+  GString *text;
+  gint i;
+
+  buffer = gtk_text_buffer_new (NULL);
+  tag = gtk_text_buffer_create_tag (buffer, "bold",
+                                    "weight", PANGO_WEIGHT_BOLD,
+                                    NULL);
+
+  gtk_text_buffer_set_text (buffer, "first\nsecond\nthird", -1);
+  gtk_text_buffer_get_iter_at_line_offset (buffer, &iter, 1, 1);
+  gtk_text_buffer_get_iter_at_line_offset (buffer, &end, 1, 5);
+  gtk_text_buffer_apply_tag (buffer, tag, &iter, &end);
+  gtk_text_buffer_get_iter_at_line (buffer, &iter, 2);
+  mark = gtk_text_buffer_create_mark (buffer, NULL, &iter, TRUE);
+
+  text = g_string_new (NULL);
+  for (i = 0; i < 500; i++)
+    g_string_append_printf (text, "line %d\n", i);
+
+  gtk_text_buffer_get_iter_at_line_offset (buffer, &iter, 0, 2);
+  gtk_text_buffer_insert (buffer, &iter, text->str, -1);
+  g_string_free (text, TRUE);
+
+  g_assert_cmpint (gtk_text_buffer_get_line_count (buffer), ==, 503);
+
+  gtk_text_buffer_get_start_iter (buffer, &iter);
+  g_assert (gtk_text_iter_forward_to_tag_toggle (&iter, tag));
+  g_assert (gtk_text_iter_begins_tag (&iter, tag));
+  g_assert_cmpint (gtk_text_iter_get_line (&iter), ==, 501);
+  g_assert_cmpint (gtk_text_iter_get_line_offset (&iter), ==, 1);
+  g_assert (gtk_text_iter_forward_to_tag_toggle (&iter, tag));
+  g_assert (gtk_text_iter_ends_tag (&iter, tag));
+  g_assert_cmpint (gtk_text_iter_get_line_offset (&iter), ==, 5);
+  g_assert (!gtk_text_iter_forward_to_tag_toggle (&iter, tag));
+
+  gtk_text_buffer_get_iter_at_mark (buffer, &iter, mark);
+  g_assert_cmpint (gtk_text_iter_get_line (&iter), ==, 502);
+  g_assert_cmpint (gtk_text_iter_get_line_offset (&iter), ==, 0);
+
+  /* the new tree has to support further changes, too */
+  gtk_text_buffer_get_iter_at_line (buffer, &iter, 100);
+  gtk_text_buffer_get_iter_at_line (buffer, &end, 400);
+  gtk_text_buffer_apply_tag (buffer, tag, &iter, &end);
+  gtk_text_buffer_delete (buffer, &iter, &end);
+  g_assert_cmpint (gtk_text_buffer_get_line_count (buffer), ==, 203);
+
+  run_tests (buffer);
+
+  g_object_unref (buffer);
+}
+
 extern void pixbuf_init (void);
 
 int
@@ -1340,6 +1924,14 @@ main (int argc, char** argv)
   g_test_add_func ("/TextBuffer/Get and Set", test_get_set);
   g_test_add_func ("/TextBuffer/Fill and Empty", test_fill_empty);
   g_test_add_func ("/TextBuffer/Tag", test_tag);
+  g_test_add_func ("/TextBuffer/Search", test_search);
+  g_test_add_func ("/TextBuffer/Long line", test_long_line);
+  g_test_add_func ("/TextBuffer/Build from root leaf", test_build_from_root_leaf);
+  g_test_add_func ("/TextBuffer/Serialize to stream", test_serialize_stream);
+  g_test_add_func ("/TextBuffer/Serialize tagged pixbuf to stream", test_serialize_stream_tagged_pixbuf);
+  g_test_add_func ("/TextBuffer/Serialize to stream async", test_serialize_stream_async);
+  g_test_add_func ("/TextBuffer/Freeze changes", test_freeze_changes);
+  g_test_add_func ("/TextBuffer/Freeze location", test_freeze_location);
   
   return g_test_run();
 }
@@ -0,0 +1,426 @@
+/* GTK - The GIMP Toolkit
+ * textlayout.c: Tests for GtkTextLayout
+ * Copyright (C) 1995-1997 Peter Mattis, Spencer Kimball and Josh MacDonald
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#define GTK_TEXT_USE_INTERNAL_UNSUPPORTED_API
+#include <gtk/gtk.h>
+#include <gtk/gtktextlayout.h>
+#include <string.h>
+
+#define N_LINES 200
+
+static GtkTextBuffer *
+text_buffer_new (void)
+{
+  GtkTextBuffer *buffer;
+  GtkTextIter iter;
+  gint i;
+
+  buffer = gtk_text_buffer_new (NULL);
+  gtk_text_buffer_get_end_iter (buffer, &iter);
+
+  for (i = 0; i < N_LINES; i++)
+    {
+      gchar *text = g_strdup_printf ("line %d\n", i);
+
+      gtk_text_buffer_insert (buffer, &iter, text, -1);
+      g_free (text);
+    }
+
+  return buffer;
+}
+
+static GtkTextLayout *
+text_layout_new (GtkTextBuffer *buffer,
+                 GtkWrapMode    wrap_mode)
+{
+  GtkTextLayout *layout;
+  GtkTextAttributes *values;
+  PangoContext *context;
+
+  layout = gtk_text_layout_new ();
+  gtk_text_layout_set_buffer (layout, buffer);
+
+  context = gdk_pango_context_get ();
+  gtk_text_layout_set_contexts (layout, context, context);
+  g_object_unref (context);
+
+  values = gtk_text_attributes_new ();
+  values->font = pango_font_description_from_string ("Sans 10");
+  values->wrap_mode = wrap_mode;
+  gtk_text_layout_set_default_style (layout, values);
+  gtk_text_attributes_unref (values);
+
+  gtk_text_layout_set_screen_width (layout, 400);
+
+  return layout;
+}
+
+static void
+text_layout_free (GtkTextLayout *layout)
+{
+  gtk_text_layout_set_buffer (layout, NULL);
+  g_object_unref (layout);
+}
+
+/* Returns the lines of the validated @layout, in buffer order */
+static GPtrArray *
+text_layout_get_all_lines (GtkTextLayout *layout)
+{
+  GPtrArray *lines;
+  GSList *list, *l;
+  gint height;
+
+  gtk_text_layout_get_size (layout, NULL, &height);
+  list = gtk_text_layout_get_lines (layout, 0, height, NULL);
+
+  lines = g_ptr_array_new ();
+  for (l = list; l; l = l->next)
+    g_ptr_array_add (lines, l->data);
+  g_slist_free (list);
+
+  return lines;
+}
+
+/* Fetches the size-only display of @line, and returns whether it was
+ * served from the line display cache.
+ */
+static gboolean
+line_display_was_cached (GtkTextLayout *layout,
+                         GtkTextLine   *line)
+{
+  GtkTextLineDisplay *display;
+  guint hits_before, hits;
+
+  gtk_text_layout_get_line_display_stats (layout, NULL, &hits_before, NULL);
+  display = gtk_text_layout_get_line_display (layout, line, TRUE);
+  gtk_text_layout_free_line_display (layout, display);
+  gtk_text_layout_get_line_display_stats (layout, NULL, &hits, NULL);
+
+  return hits > hits_before;
+}
+
+static void
+apply_tag_to_lines (GtkTextBuffer *buffer,
+                    GtkTextTag    *tag,
+                    gint           first,
+                    gint           last)
+{
+  GtkTextIter start, end;
+
+  gtk_text_buffer_get_iter_at_line (buffer, &start, first);
+  gtk_text_buffer_get_iter_at_line (buffer, &end, last);
+  gtk_text_iter_forward_to_line_end (&end);
+  gtk_text_buffer_apply_tag (buffer, tag, &start, &end);
+}
+
+static void
+test_line_display_cache (void)
+{
+  GtkTextBuffer *buffer;
+  GtkTextLayout *layout;
+  GtkTextTag *tag;
+  GtkTextIter iter;
+  GPtrArray *lines;
+  guint n_cached;
+  gint i;
+
+  buffer = text_buffer_new ();
+  layout = text_layout_new (buffer, GTK_WRAP_NONE);
+  gtk_text_layout_validate (layout, G_MAXINT);
+
+  lines = text_layout_get_all_lines (layout);
+  g_assert_cmpint (lines->len, ==, N_LINES + 1);
+
+  /* Validation went through all lines, only the most recent ones stay. */
+  gtk_text_layout_get_line_display_stats (layout, &n_cached, NULL, NULL);
+  g_assert_cmpint (n_cached, >, 0);
+  g_assert_cmpint (n_cached, <, N_LINES);
+
+  g_assert (line_display_was_cached (layout, lines->pdata[N_LINES]));
+  g_assert (line_display_was_cached (layout, lines->pdata[N_LINES - n_cached + 1]));
+  g_assert (!line_display_was_cached (layout, lines->pdata[0]));
+
+  /* Fetching line 0 evicted the least recently used display. */
+  g_assert (!line_display_was_cached (layout, lines->pdata[N_LINES - n_cached + 2]));
+
+  /* Redisplaying a range only drops the displays of its lines. */
+  for (i = 140; i <= 160; i++)
+    line_display_was_cached (layout, lines->pdata[i]);
+
+  tag = gtk_text_buffer_create_tag (buffer, NULL, "foreground", "red", NULL);
+  apply_tag_to_lines (buffer, tag, 145, 155);
+
+  g_assert (line_display_was_cached (layout, lines->pdata[144]));
+  g_assert (line_display_was_cached (layout, lines->pdata[156]));
+  for (i = 145; i <= 155; i++)
+    g_assert (!line_display_was_cached (layout, lines->pdata[i]));
+
+  /* The same for ranges with more lines than there are displays. */
+  apply_tag_to_lines (buffer, tag, 1, 180);
+
+  g_assert (line_display_was_cached (layout, lines->pdata[0]));
+  g_assert (!line_display_was_cached (layout, lines->pdata[150]));
+  g_assert (!line_display_was_cached (layout, lines->pdata[180]));
+
+  /* Editing a line only drops its own display. */
+  line_display_was_cached (layout, lines->pdata[190]);
+  line_display_was_cached (layout, lines->pdata[191]);
+  gtk_text_buffer_get_iter_at_line (buffer, &iter, 190);
+  gtk_text_buffer_insert (buffer, &iter, "edited ", -1);
+  g_assert (line_display_was_cached (layout, lines->pdata[191]));
+  g_assert (!line_display_was_cached (layout, lines->pdata[190]));
+
+  g_ptr_array_free (lines, TRUE);
+  text_layout_free (layout);
+  g_object_unref (buffer);
+}
+
+static GArray *
+text_layout_get_line_heights (GtkTextLayout *layout)
+{
+  GArray *heights;
+  GtkTextIter iter;
+
+  heights = g_array_new (FALSE, FALSE, sizeof (gint));
+
+  gtk_text_buffer_get_start_iter (gtk_text_layout_get_buffer (layout), &iter);
+  do
+    {
+      gint y, height;
+
+      gtk_text_layout_get_line_yrange (layout, &iter, &y, &height);
+      g_array_append_val (heights, height);
+    }
+  while (gtk_text_iter_forward_line (&iter));
+
+  return heights;
+}
+
+static void
+check_same_sizes (GtkTextLayout *expected,
+                  GtkTextLayout *layout)
+{
+  GArray *expected_heights, *heights;
+  gint expected_width, expected_height;
+  gint width, height;
+  guint i;
+
+  gtk_text_layout_get_size (expected, &expected_width, &expected_height);
+  gtk_text_layout_get_size (layout, &width, &height);
+  g_assert_cmpint (width, ==, expected_width);
+  g_assert_cmpint (height, ==, expected_height);
+
+  expected_heights = text_layout_get_line_heights (expected);
+  heights = text_layout_get_line_heights (layout);
+
+  g_assert_cmpint (heights->len, ==, expected_heights->len);
+  for (i = 0; i < heights->len; i++)
+    g_assert_cmpint (g_array_index (heights, gint, i), ==,
+                     g_array_index (expected_heights, gint, i));
+
+  g_array_free (expected_heights, TRUE);
+  g_array_free (heights, TRUE);
+}
+
+static void
+test_shaping_threads (void)
+{
+  GtkTextBuffer *buffer;
+  GtkTextLayout *threaded, *layout;
+  GtkTextTag *tag;
+  GtkTextIter iter, end;
+  GString *text;
+  gint i;
+
+  /* Plain, empty, wrapped and tagged lines */
+  buffer = gtk_text_buffer_new (NULL);
+  tag = gtk_text_buffer_create_tag (buffer, NULL,
+                                    "scale", PANGO_SCALE_X_LARGE,
+                                    NULL);
+
+  text = g_string_new (NULL);
+  for (i = 0; i < 1000; i++)
+    {
+      g_string_truncate (text, 0);
+
+      if (i % 5 == 0)
+        {
+          gint j;
+
+          for (j = 0; j < 20 + i % 40; j++)
+            g_string_append (text, "word ");
+        }
+      else if (i % 7 != 0)
+        g_string_append_printf (text, "line %d", i);
+      g_string_append_c (text, '\n');
+
+      gtk_text_buffer_get_end_iter (buffer, &iter);
+      if (i % 10 == 3)
+        gtk_text_buffer_insert_with_tags (buffer, &iter, text->str, -1, tag, NULL);
+      else
+        gtk_text_buffer_insert (buffer, &iter, text->str, -1);
+    }
+
+  threaded = text_layout_new (buffer, GTK_WRAP_WORD);
+  gtk_text_layout_set_shaping_threads (threaded, 4);
+
+  /* Change lines the workers were given */
+  gtk_text_layout_validate (threaded, 200);
+
+  g_string_truncate (text, 0);
+  for (i = 0; i < 60; i++)
+    g_string_append (text, "inserted ");
+  gtk_text_buffer_get_iter_at_line (buffer, &iter, 300);
+  gtk_text_buffer_insert (buffer, &iter, text->str, -1);
+
+  gtk_text_buffer_get_iter_at_line (buffer, &iter, 400);
+  gtk_text_buffer_get_iter_at_line (buffer, &end, 410);
+  gtk_text_buffer_delete (buffer, &iter, &end);
+
+  apply_tag_to_lines (buffer, tag, 500, 500);
+
+  while (!gtk_text_layout_is_valid (threaded))
+    gtk_text_layout_validate (threaded, 1000);
+
+  /* The lines measured by the workers have the synchronous sizes */
+  layout = text_layout_new (buffer, GTK_WRAP_WORD);
+  gtk_text_layout_validate (layout, G_MAXINT);
+
+  check_same_sizes (layout, threaded);
+
+  g_string_free (text, TRUE);
+  text_layout_free (layout);
+  text_layout_free (threaded);
+  g_object_unref (buffer);
+}
+
+/* Checks that the attributes of @type in the display of @line cover
+ * the bytes from @start to @end, or that there are none if @start is -1.
+ */
+static void
+check_attr_range (GtkTextLayout *layout,
+                  GtkTextLine   *line,
+                  PangoAttrType  type,
+                  gint           start,
+                  gint           end)
+{
+  GtkTextLineDisplay *display;
+  PangoAttrIterator *iter;
+  gint found_start = G_MAXINT;
+  gint found_end = -1;
+
+  display = gtk_text_layout_get_line_display (layout, line, TRUE);
+
+  iter = pango_attr_list_get_iterator (pango_layout_get_attributes (display->layout));
+  do
+    {
+      PangoAttribute *attr = pango_attr_iterator_get (iter, type);
+
+      if (attr)
+        {
+          found_start = MIN (found_start, (gint) attr->start_index);
+          found_end = MAX (found_end, (gint) attr->end_index);
+        }
+    }
+  while (pango_attr_iterator_next (iter));
+  pango_attr_iterator_destroy (iter);
+
+  gtk_text_layout_free_line_display (layout, display);
+
+  if (start < 0)
+    g_assert_cmpint (found_end, ==, -1);
+  else
+    {
+      g_assert_cmpint (found_start, ==, start);
+      g_assert_cmpint (found_end, ==, end);
+    }
+}
+
+static void
+test_tag_runs (void)
+{
+  GtkTextBuffer *buffer;
+  GtkTextLayout *layout;
+  GtkTextTag *tag;
+  GtkTextMark *mark;
+  GtkTextIter start, end;
+  GPtrArray *lines;
+  gint i;
+
+  buffer = text_buffer_new ();
+  tag = gtk_text_buffer_create_tag (buffer, NULL, "strikethrough", TRUE, NULL);
+
+  layout = text_layout_new (buffer, GTK_WRAP_NONE);
+  gtk_text_layout_validate (layout, G_MAXINT);
+  lines = text_layout_get_all_lines (layout);
+
+  check_attr_range (layout, lines->pdata[15], PANGO_ATTR_STRIKETHROUGH, -1, -1);
+
+  /* Lines in the range of a tag see it, even without toggles of
+   * their own, and without being relaid out.
+   */
+  apply_tag_to_lines (buffer, tag, 10, 20);
+  check_attr_range (layout, lines->pdata[9], PANGO_ATTR_STRIKETHROUGH, -1, -1);
+  check_attr_range (layout, lines->pdata[15], PANGO_ATTR_STRIKETHROUGH,
+                    0, strlen ("line 15\n"));
+  check_attr_range (layout, lines->pdata[21], PANGO_ATTR_STRIKETHROUGH, -1, -1);
+
+  gtk_text_buffer_get_bounds (buffer, &start, &end);
+  gtk_text_buffer_remove_tag (buffer, tag, &start, &end);
+  check_attr_range (layout, lines->pdata[15], PANGO_ATTR_STRIKETHROUGH, -1, -1);
+
+  /* "line 30": toggles around "ne 3" */
+  gtk_text_buffer_get_iter_at_line_index (buffer, &start, 30, 2);
+  gtk_text_buffer_get_iter_at_line_index (buffer, &end, 30, 6);
+  gtk_text_buffer_apply_tag (buffer, tag, &start, &end);
+  check_attr_range (layout, lines->pdata[30], PANGO_ATTR_STRIKETHROUGH, 2, 6);
+
+  /* Marks split the segments of the line without invalidating it */
+  gtk_text_buffer_get_iter_at_line_index (buffer, &start, 30, 1);
+  mark = gtk_text_buffer_create_mark (buffer, NULL, &start, FALSE);
+  gtk_text_buffer_get_iter_at_line_index (buffer, &start, 30, 4);
+  gtk_text_buffer_move_mark (buffer, mark, &start);
+
+  /* Push the display of the line out of the cache */
+  for (i = 50; i < N_LINES; i++)
+    check_attr_range (layout, lines->pdata[i], PANGO_ATTR_STRIKETHROUGH, -1, -1);
+
+  check_attr_range (layout, lines->pdata[30], PANGO_ATTR_STRIKETHROUGH, 2, 6);
+
+  g_ptr_array_free (lines, TRUE);
+  text_layout_free (layout);
+  g_object_unref (buffer);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  if (!g_thread_supported ())
+    g_thread_init (NULL);
+
+  gtk_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/TextLayout/line-display-cache", test_line_display_cache);
+  g_test_add_func ("/TextLayout/shaping-threads", test_shaping_threads);
+  g_test_add_func ("/TextLayout/tag-runs", test_tag_runs);
+
+  return g_test_run ();
+}
@@ -0,0 +1,160 @@
+/* GTK - The GIMP Toolkit
+ * textview.c: Tests for GtkTextView
+ * Copyright (C) 1995-1997 Peter Mattis, Spencer Kimball and Josh MacDonald
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <gtk/gtk.h>
+
+#define N_LINES 1000
+
+static void
+flush_events (void)
+{
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+}
+
+static GtkWidget *
+add_child_at_line (GtkTextView *view,
+                   gint         line)
+{
+  GtkTextBuffer *buffer;
+  GtkTextChildAnchor *anchor;
+  GtkTextIter iter;
+  GtkWidget *child;
+
+  buffer = gtk_text_view_get_buffer (view);
+  gtk_text_buffer_get_iter_at_line (buffer, &iter, line);
+  anchor = gtk_text_buffer_create_child_anchor (buffer, &iter);
+
+  child = gtk_button_new_with_label ("Child");
+  gtk_text_view_add_child_at_anchor (view, child, anchor);
+  gtk_widget_show (child);
+
+  return child;
+}
+
+static void
+scroll_to_line (GtkTextView *view,
+                gint         line)
+{
+  GtkTextIter iter;
+
+  gtk_text_buffer_get_iter_at_line (gtk_text_view_get_buffer (view),
+                                    &iter, line);
+  gtk_text_view_scroll_to_iter (view, &iter, 0.0, TRUE, 0.0, 0.5);
+  flush_events ();
+}
+
+static void
+check_child_hidden (GtkWidget *child)
+{
+  g_assert (!gtk_widget_get_child_visible (child));
+  g_assert (!gtk_widget_get_mapped (child));
+  g_assert (!gtk_widget_get_realized (child));
+}
+
+static void
+check_child_shown (GtkTextView *view,
+                   GtkWidget   *child)
+{
+  GdkRectangle visible_rect;
+  GtkAllocation allocation;
+
+  g_assert (gtk_widget_get_child_visible (child));
+  g_assert (gtk_widget_get_mapped (child));
+
+  /* The allocation must be the current one, not the one the child
+   * had, or didn't get, while it was hidden.
+   */
+  gtk_text_view_get_visible_rect (view, &visible_rect);
+  gtk_widget_get_allocation (child, &allocation);
+  g_assert_cmpint (allocation.y, >=, 0);
+  g_assert_cmpint (allocation.y + allocation.height, <=, visible_rect.height);
+}
+
+static void
+test_child_visibility (void)
+{
+  GtkWidget *window;
+  GtkWidget *scrolled_window;
+  GtkWidget *view;
+  GtkTextBuffer *buffer;
+  GtkTextIter iter;
+  GtkWidget *top, *middle, *bottom;
+  gint i;
+
+  buffer = gtk_text_buffer_new (NULL);
+  gtk_text_buffer_get_start_iter (buffer, &iter);
+  for (i = 0; i < N_LINES; i++)
+    gtk_text_buffer_insert (buffer, &iter, "line\n", -1);
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  gtk_window_set_default_size (GTK_WINDOW (window), 200, 200);
+  scrolled_window = gtk_scrolled_window_new (NULL, NULL);
+  gtk_container_add (GTK_CONTAINER (window), scrolled_window);
+  view = gtk_text_view_new_with_buffer (buffer);
+  gtk_container_add (GTK_CONTAINER (scrolled_window), view);
+
+  top = add_child_at_line (GTK_TEXT_VIEW (view), 0);
+  middle = add_child_at_line (GTK_TEXT_VIEW (view), N_LINES / 2);
+  bottom = add_child_at_line (GTK_TEXT_VIEW (view), N_LINES - 1);
+
+  gtk_widget_show_all (window);
+  flush_events ();
+
+  /* Only the child near the visible area is realized. */
+  check_child_shown (GTK_TEXT_VIEW (view), top);
+  check_child_hidden (middle);
+  check_child_hidden (bottom);
+
+  /* Scrolling brings the hidden child back, in the right place. */
+  scroll_to_line (GTK_TEXT_VIEW (view), N_LINES / 2);
+  check_child_hidden (top);
+  check_child_shown (GTK_TEXT_VIEW (view), middle);
+  check_child_hidden (bottom);
+
+  /* The focus child stays around when scrolled away... */
+  gtk_widget_grab_focus (middle);
+  scroll_to_line (GTK_TEXT_VIEW (view), N_LINES - 1);
+  check_child_hidden (top);
+  g_assert (gtk_widget_get_child_visible (middle));
+  g_assert (gtk_widget_get_realized (middle));
+  check_child_shown (GTK_TEXT_VIEW (view), bottom);
+
+  /* ...and is hidden once it loses the focus. */
+  gtk_widget_grab_focus (view);
+  scroll_to_line (GTK_TEXT_VIEW (view), 0);
+  check_child_shown (GTK_TEXT_VIEW (view), top);
+  check_child_hidden (middle);
+  check_child_hidden (bottom);
+
+  gtk_widget_destroy (window);
+  g_object_unref (buffer);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  gtk_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/TextView/child-visibility", test_child_visibility);
+
+  return g_test_run ();
+}
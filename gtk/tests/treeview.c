@@ -18,6 +18,7 @@
  */
 
 #include <gtk/gtk.h>
+#include <gdk/gdkkeysyms.h>
 
 static void
 test_bug_546005 (void)
@@ -150,6 +151,607 @@ test_select_collapsed_row (void)
   gtk_tree_path_free (path);
 }
 
+static void
+check_range (GList       *list,
+             const gchar *start,
+             const gchar *end)
+{
+  gchar *str;
+
+  g_assert (list != NULL && list->next != NULL);
+
+  str = gtk_tree_path_to_string (list->data);
+  g_assert_cmpstr (str, ==, start);
+  g_free (str);
+
+  str = gtk_tree_path_to_string (list->next->data);
+  g_assert_cmpstr (str, ==, end);
+  g_free (str);
+}
+
+static void
+free_paths (GList *list)
+{
+  g_list_foreach (list, (GFunc) gtk_tree_path_free, NULL);
+  g_list_free (list);
+}
+
+static void
+test_selected_ranges (void)
+{
+  GtkTreeIter iter, parent;
+  GtkTreePath *path;
+  GtkTreeStore *tree_store;
+  GtkTreeSelection *selection;
+  GtkWidget *view;
+  GList *list;
+  gint i;
+
+  tree_store = gtk_tree_store_new (1, G_TYPE_STRING);
+  view = gtk_tree_view_new_with_model (GTK_TREE_MODEL (tree_store));
+  g_object_ref_sink (view);
+
+  /* 0, 0:0, 0:1, 1, 2, 3 */
+  gtk_tree_store_insert_with_values (tree_store, &parent, NULL, 0,
+                                     0, "Parent",
+                                     -1);
+  for (i = 0; i < 2; i++)
+    gtk_tree_store_insert_with_values (tree_store, &iter, &parent, i,
+                                       0, "Child",
+                                       -1);
+  for (i = 1; i < 4; i++)
+    gtk_tree_store_insert_with_values (tree_store, &iter, NULL, i,
+                                       0, "Row",
+                                       -1);
+
+  gtk_tree_view_expand_all (GTK_TREE_VIEW (view));
+
+  selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (view));
+  gtk_tree_selection_set_mode (selection, GTK_SELECTION_MULTIPLE);
+
+  g_assert (gtk_tree_selection_get_selected_ranges (selection, NULL) == NULL);
+
+  /* A range spanning a parent and its first child, and a single row. */
+  path = gtk_tree_path_new_from_string ("0");
+  gtk_tree_selection_select_path (selection, path);
+  gtk_tree_path_free (path);
+  path = gtk_tree_path_new_from_string ("0:0");
+  gtk_tree_selection_select_path (selection, path);
+  gtk_tree_path_free (path);
+  path = gtk_tree_path_new_from_string ("2");
+  gtk_tree_selection_select_path (selection, path);
+  gtk_tree_path_free (path);
+
+  g_assert_cmpint (gtk_tree_selection_count_selected_rows (selection), ==, 3);
+
+  list = gtk_tree_selection_get_selected_ranges (selection, NULL);
+  g_assert_cmpint (g_list_length (list), ==, 4);
+  check_range (list, "0", "0:0");
+  check_range (list->next->next, "2", "2");
+  free_paths (list);
+
+  gtk_tree_selection_select_all (selection);
+  g_assert_cmpint (gtk_tree_selection_count_selected_rows (selection), ==, 6);
+
+  list = gtk_tree_selection_get_selected_ranges (selection, NULL);
+  g_assert_cmpint (g_list_length (list), ==, 2);
+  check_range (list, "0", "3");
+  free_paths (list);
+
+  /* Collapsing drops the selected children from the count. */
+  path = gtk_tree_path_new_from_string ("0");
+  gtk_tree_view_collapse_row (GTK_TREE_VIEW (view), path);
+  gtk_tree_path_free (path);
+
+  g_assert_cmpint (gtk_tree_selection_count_selected_rows (selection), ==, 4);
+
+  list = gtk_tree_selection_get_selected_rows (selection, NULL);
+  g_assert_cmpint (g_list_length (list), ==, 4);
+  check_range (list, "0", "1");
+  check_range (list->next->next, "2", "3");
+  free_paths (list);
+
+  list = gtk_tree_selection_get_selected_ranges (selection, NULL);
+  g_assert_cmpint (g_list_length (list), ==, 2);
+  check_range (list, "0", "3");
+  free_paths (list);
+
+  gtk_tree_selection_unselect_all (selection);
+  g_assert_cmpint (gtk_tree_selection_count_selected_rows (selection), ==, 0);
+  g_assert (gtk_tree_selection_get_selected_ranges (selection, NULL) == NULL);
+
+  gtk_widget_destroy (view);
+  g_object_unref (view);
+  g_object_unref (tree_store);
+}
+
+static gchar *
+search_cursor_for (GtkTreeView *view,
+                   GtkWidget   *entry,
+                   const gchar *text)
+{
+  GtkTreePath *path;
+  gchar *str;
+
+  gtk_entry_set_text (GTK_ENTRY (entry), text);
+  gtk_tree_view_get_cursor (view, &path, NULL);
+  if (!path)
+    return NULL;
+
+  str = gtk_tree_path_to_string (path);
+  gtk_tree_path_free (path);
+
+  return str;
+}
+
+static void
+test_search_index (void)
+{
+  const gchar *words[] = { "delta", "Alpha", "bravo", "alpine", "Charlie", "BRAVE" };
+  GtkListStore *list_store;
+  GtkWidget *view;
+  GtkWidget *entry;
+  GtkTreeIter iter;
+  gchar *str;
+  gint i;
+
+  list_store = gtk_list_store_new (1, G_TYPE_STRING);
+  for (i = 0; i < G_N_ELEMENTS (words); i++)
+    gtk_list_store_insert_with_values (list_store, &iter, i,
+                                       0, words[i],
+                                       -1);
+
+  view = gtk_tree_view_new_with_model (GTK_TREE_MODEL (list_store));
+  gtk_tree_view_set_search_column (GTK_TREE_VIEW (view), 0);
+  gtk_tree_view_set_enable_search_index (GTK_TREE_VIEW (view), TRUE);
+  g_assert (gtk_tree_view_get_enable_search_index (GTK_TREE_VIEW (view)));
+
+  entry = gtk_entry_new ();
+  g_object_ref_sink (entry);
+  gtk_tree_view_set_search_entry (GTK_TREE_VIEW (view), GTK_ENTRY (entry));
+
+  /* The first match in display order, case insensitive. */
+  str = search_cursor_for (GTK_TREE_VIEW (view), entry, "al");
+  g_assert_cmpstr (str, ==, "1");
+  g_free (str);
+
+  str = search_cursor_for (GTK_TREE_VIEW (view), entry, "bra");
+  g_assert_cmpstr (str, ==, "2");
+  g_free (str);
+
+  /* The index follows changes to the model. */
+  gtk_list_store_insert_with_values (list_store, &iter, 0,
+                                     0, "brand",
+                                     -1);
+  str = search_cursor_for (GTK_TREE_VIEW (view), entry, "bran");
+  g_assert_cmpstr (str, ==, "0");
+  g_free (str);
+
+  gtk_list_store_set (list_store, &iter, 0, "echo", -1);
+  str = search_cursor_for (GTK_TREE_VIEW (view), entry, "brav");
+  g_assert_cmpstr (str, ==, "3");
+  g_free (str);
+
+  g_object_unref (entry);
+  gtk_widget_destroy (view);
+  g_object_unref (list_store);
+}
+
+static gchar *
+search_cursor_move (GtkTreeView *view,
+                    GtkWidget   *entry,
+                    guint        keyval)
+{
+  GdkEventKey event = { 0, };
+  GtkTreePath *path;
+  gboolean handled;
+  gchar *str;
+
+  event.type = GDK_KEY_PRESS;
+  event.keyval = keyval;
+  g_signal_emit_by_name (entry, "key-press-event", &event, &handled);
+
+  gtk_tree_view_get_cursor (view, &path, NULL);
+  str = gtk_tree_path_to_string (path);
+  gtk_tree_path_free (path);
+
+  return str;
+}
+
+static void
+test_search_index_shared_prefix (void)
+{
+  GtkListStore *list_store;
+  GtkWidget *view;
+  GtkWidget *entry;
+  GtkTreeIter iter;
+  gchar *str;
+  gint i;
+
+  /* Every other row matches "item", with keys sorting in the reverse
+   * of display order.
+   */
+  list_store = gtk_list_store_new (1, G_TYPE_STRING);
+  for (i = 0; i < 2000; i++)
+    {
+      gchar *word;
+
+      if (i % 2 == 0)
+        word = g_strdup_printf ("item %04d", 1999 - i);
+      else
+        word = g_strdup ("other");
+
+      gtk_list_store_insert_with_values (list_store, &iter, i,
+                                         0, word,
+                                         -1);
+      g_free (word);
+    }
+
+  view = gtk_tree_view_new_with_model (GTK_TREE_MODEL (list_store));
+  g_object_ref_sink (view);
+  gtk_tree_view_set_search_column (GTK_TREE_VIEW (view), 0);
+  gtk_tree_view_set_enable_search_index (GTK_TREE_VIEW (view), TRUE);
+
+  entry = gtk_entry_new ();
+  g_object_ref_sink (entry);
+  gtk_tree_view_set_search_entry (GTK_TREE_VIEW (view), GTK_ENTRY (entry));
+
+  str = search_cursor_for (GTK_TREE_VIEW (view), entry, "item");
+  g_assert_cmpstr (str, ==, "0");
+  g_free (str);
+
+  /* The next and previous matches go in display order too. */
+  str = search_cursor_move (GTK_TREE_VIEW (view), entry, GDK_Down);
+  g_assert_cmpstr (str, ==, "2");
+  g_free (str);
+
+  str = search_cursor_move (GTK_TREE_VIEW (view), entry, GDK_Down);
+  g_assert_cmpstr (str, ==, "4");
+  g_free (str);
+
+  str = search_cursor_move (GTK_TREE_VIEW (view), entry, GDK_Up);
+  g_assert_cmpstr (str, ==, "2");
+  g_free (str);
+
+  str = search_cursor_for (GTK_TREE_VIEW (view), entry, "item 0");
+  g_assert_cmpstr (str, ==, "1000");
+  g_free (str);
+
+  str = search_cursor_move (GTK_TREE_VIEW (view), entry, GDK_Down);
+  g_assert_cmpstr (str, ==, "1002");
+  g_free (str);
+
+  /* A changed row moves within the run of its prefix. */
+  gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (list_store), &iter, NULL, 1001);
+  gtk_list_store_set (list_store, &iter, 0, "item 5000", -1);
+
+  str = search_cursor_for (GTK_TREE_VIEW (view), entry, "item");
+  g_assert_cmpstr (str, ==, "0");
+  g_free (str);
+
+  str = search_cursor_for (GTK_TREE_VIEW (view), entry, "item 5");
+  g_assert_cmpstr (str, ==, "1001");
+  g_free (str);
+
+  g_object_unref (entry);
+  gtk_widget_destroy (view);
+  g_object_unref (view);
+  g_object_unref (list_store);
+}
+
+static void
+test_search_index_edits (void)
+{
+  GtkTreeStore *tree_store;
+  GtkWidget *view;
+  GtkWidget *entry;
+  GtkTreeIter iter, parent;
+  GtkTreePath *path;
+  gchar *str;
+  gint i;
+
+  tree_store = gtk_tree_store_new (1, G_TYPE_STRING);
+  for (i = 0; i < 100; i++)
+    {
+      gchar *word = g_strdup_printf ("row %02d", i);
+
+      gtk_tree_store_insert_with_values (tree_store, &iter, NULL, i,
+                                         0, word,
+                                         -1);
+      g_free (word);
+    }
+
+  gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (tree_store), &parent, NULL, 50);
+  gtk_tree_store_insert_with_values (tree_store, &iter, &parent, 0,
+                                     0, "child",
+                                     -1);
+
+  view = gtk_tree_view_new_with_model (GTK_TREE_MODEL (tree_store));
+  gtk_tree_view_set_search_column (GTK_TREE_VIEW (view), 0);
+  gtk_tree_view_set_enable_search_index (GTK_TREE_VIEW (view), TRUE);
+
+  entry = gtk_entry_new ();
+  g_object_ref_sink (entry);
+  gtk_tree_view_set_search_entry (GTK_TREE_VIEW (view), GTK_ENTRY (entry));
+
+  str = search_cursor_for (GTK_TREE_VIEW (view), entry, "row 7");
+  g_assert_cmpstr (str, ==, "70");
+  g_free (str);
+
+  /* Changed rows are updated in place. */
+  gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (tree_store), &iter, NULL, 90);
+  gtk_tree_store_set (tree_store, &iter, 0, "row 7x", -1);
+  gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (tree_store), &iter, NULL, 70);
+  gtk_tree_store_set (tree_store, &iter, 0, "other", -1);
+
+  str = search_cursor_for (GTK_TREE_VIEW (view), entry, "row 7");
+  g_assert_cmpstr (str, ==, "71");
+  g_free (str);
+
+  str = search_cursor_for (GTK_TREE_VIEW (view), entry, "row 7x");
+  g_assert_cmpstr (str, ==, "90");
+  g_free (str);
+
+  /* Searches right after structural changes see them as well. */
+  gtk_tree_store_remove (tree_store, &iter);
+  str = search_cursor_for (GTK_TREE_VIEW (view), entry, "row 7");
+  g_assert_cmpstr (str, ==, "70");
+  g_free (str);
+
+  gtk_tree_store_insert_with_values (tree_store, &iter, NULL, 0,
+                                     0, "row 77",
+                                     -1);
+  str = search_cursor_for (GTK_TREE_VIEW (view), entry, "row 7");
+  g_assert_cmpstr (str, ==, "0");
+  g_free (str);
+
+  str = search_cursor_for (GTK_TREE_VIEW (view), entry, "child");
+  g_assert_cmpstr (str, ==, "0");
+  g_free (str);
+
+  path = gtk_tree_path_new_from_indices (51, -1);
+  gtk_tree_view_expand_row (GTK_TREE_VIEW (view), path, FALSE);
+  gtk_tree_path_free (path);
+
+  str = search_cursor_for (GTK_TREE_VIEW (view), entry, "child");
+  g_assert_cmpstr (str, ==, "51:0");
+  g_free (str);
+
+  g_object_unref (entry);
+  gtk_widget_destroy (view);
+  g_object_unref (tree_store);
+}
+
+typedef struct
+{
+  gint heights[4];
+  gint asked[4];
+  gint cell_data;
+} FixedHeightData;
+
+static gint
+fixed_height_for_depth (GtkTreeView *tree_view,
+                        gint         depth,
+                        gpointer     data)
+{
+  FixedHeightData *fixed = data;
+
+  fixed->asked[depth]++;
+
+  return fixed->heights[depth];
+}
+
+static void
+count_cell_data (GtkTreeViewColumn *column,
+                 GtkCellRenderer   *cell,
+                 GtkTreeModel      *model,
+                 GtkTreeIter       *iter,
+                 gpointer           data)
+{
+  FixedHeightData *fixed = data;
+  gchar *text;
+
+  fixed->cell_data++;
+
+  gtk_tree_model_get (model, iter, 0, &text, -1);
+  g_object_set (cell, "text", text, NULL);
+  g_free (text);
+}
+
+static GtkWidget *
+fixed_height_window_new (GtkTreeModel    *model,
+                         FixedHeightData *fixed,
+                         GtkWidget      **view)
+{
+  GtkTreeViewColumn *column;
+  GtkCellRenderer *cell;
+  GtkWidget *window;
+
+  *view = gtk_tree_view_new_with_model (model);
+
+  column = gtk_tree_view_column_new ();
+  gtk_tree_view_column_set_sizing (column, GTK_TREE_VIEW_COLUMN_FIXED);
+  gtk_tree_view_column_set_fixed_width (column, 100);
+  cell = gtk_cell_renderer_text_new ();
+  gtk_tree_view_column_pack_start (column, cell, TRUE);
+  gtk_tree_view_column_set_cell_data_func (column, cell,
+                                           count_cell_data, fixed, NULL);
+  gtk_tree_view_append_column (GTK_TREE_VIEW (*view), column);
+
+  gtk_tree_view_set_fixed_height_func (GTK_TREE_VIEW (*view),
+                                       fixed_height_for_depth, fixed, NULL);
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  gtk_window_set_default_size (GTK_WINDOW (window), 200, 400);
+  gtk_container_add (GTK_CONTAINER (window), *view);
+
+  return window;
+}
+
+static void
+flush_events (void)
+{
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+}
+
+static GdkRectangle
+row_area (GtkWidget   *view,
+          const gchar *path_string)
+{
+  GtkTreePath *path;
+  GdkRectangle rect;
+
+  path = gtk_tree_path_new_from_string (path_string);
+  gtk_tree_view_get_background_area (GTK_TREE_VIEW (view), path, NULL, &rect);
+  gtk_tree_path_free (path);
+
+  return rect;
+}
+
+static void
+check_row_area (GtkWidget   *view,
+                const gchar *path_string,
+                gint         y,
+                gint         height)
+{
+  GdkRectangle rect;
+
+  rect = row_area (view, path_string);
+  g_assert_cmpint (rect.y, ==, y);
+  g_assert_cmpint (rect.height, ==, height);
+}
+
+static void
+check_path_at_y (GtkWidget   *view,
+                 gint         y,
+                 const gchar *path_string)
+{
+  GtkTreePath *path;
+  gchar *str;
+
+  g_assert (gtk_tree_view_get_path_at_pos (GTK_TREE_VIEW (view), 10, y,
+                                           &path, NULL, NULL, NULL));
+  str = gtk_tree_path_to_string (path);
+  g_assert_cmpstr (str, ==, path_string);
+  g_free (str);
+  gtk_tree_path_free (path);
+}
+
+static void
+test_fixed_height_func (void)
+{
+  FixedHeightData fixed = { { 0, 20, 40, -1 }, { 0, }, 0 };
+  GtkTreeIter iter, parent, child;
+  GtkTreeStore *tree_store;
+  GtkWidget *window;
+  GtkWidget *view;
+  gint m;
+
+  /* 0, 0:0, 0:0:0, 0:0:1, 0:1, 1 */
+  tree_store = gtk_tree_store_new (1, G_TYPE_STRING);
+  gtk_tree_store_insert_with_values (tree_store, &parent, NULL, 0,
+                                     0, "Parent",
+                                     -1);
+  gtk_tree_store_insert_with_values (tree_store, &child, &parent, 0,
+                                     0, "Child",
+                                     -1);
+  gtk_tree_store_insert_with_values (tree_store, &iter, &child, 0,
+                                     0, "Grandchild",
+                                     -1);
+  gtk_tree_store_insert_with_values (tree_store, &iter, &child, 1,
+                                     0, "Grandchild",
+                                     -1);
+  gtk_tree_store_insert_with_values (tree_store, &child, &parent, 1,
+                                     0, "Child",
+                                     -1);
+  gtk_tree_store_insert_with_values (tree_store, &iter, NULL, 1,
+                                     0, "Row",
+                                     -1);
+
+  window = fixed_height_window_new (GTK_TREE_MODEL (tree_store), &fixed, &view);
+  gtk_tree_view_set_fixed_height_mode (GTK_TREE_VIEW (view), TRUE);
+  gtk_widget_show_all (window);
+  flush_events ();
+
+  gtk_tree_view_expand_all (GTK_TREE_VIEW (view));
+  flush_events ();
+
+  /* The third level asks to be measured, once. */
+  m = row_area (view, "0:0:0").height;
+  g_assert_cmpint (m, >, 0);
+  g_assert_cmpint (fixed.asked[2], ==, 1);
+  g_assert_cmpint (fixed.asked[3], ==, 1);
+
+  check_row_area (view, "0", 0, 20);
+  check_row_area (view, "0:0", 20, 40);
+  check_row_area (view, "0:0:0", 60, m);
+  check_row_area (view, "0:0:1", 60 + m, m);
+  check_row_area (view, "0:1", 60 + 2 * m, 40);
+  check_row_area (view, "1", 100 + 2 * m, 20);
+
+  check_path_at_y (view, 10, "0");
+  check_path_at_y (view, 59, "0:0");
+  check_path_at_y (view, 60 + m, "0:0:1");
+  check_path_at_y (view, 60 + 2 * m + 39, "0:1");
+  check_path_at_y (view, 100 + 2 * m, "1");
+
+  gtk_widget_destroy (window);
+  g_object_unref (tree_store);
+}
+
+static void
+test_fixed_height_func_deferred (void)
+{
+  FixedHeightData fixed = { { 0, 20, -1, -1 }, { 0, }, 0 };
+  GtkTreeIter iter, parent;
+  GtkTreeStore *tree_store;
+  GtkWidget *window;
+  GtkWidget *view;
+  gint cell_data;
+  gint height;
+
+  tree_store = gtk_tree_store_new (1, G_TYPE_STRING);
+  gtk_tree_store_insert_with_values (tree_store, &parent, NULL, 0,
+                                     0, "Parent",
+                                     -1);
+  gtk_tree_store_insert_with_values (tree_store, &iter, &parent, 0,
+                                     0, "Child",
+                                     -1);
+
+  window = fixed_height_window_new (GTK_TREE_MODEL (tree_store), &fixed, &view);
+  gtk_widget_show_all (window);
+  gtk_tree_view_expand_all (GTK_TREE_VIEW (view));
+  flush_events ();
+
+  height = row_area (view, "0:0").height;
+  g_assert_cmpint (height, >, 0);
+
+  /* Rows validated before fixed height mode was turned on keep their
+   * heights, so the height of the second level is not known yet when a
+   * row is inserted there.
+   */
+  gtk_tree_view_set_fixed_height_mode (GTK_TREE_VIEW (view), TRUE);
+  flush_events ();
+  g_assert_cmpint (fixed.asked[2], ==, 0);
+
+  /* The row is not measured from within the row-inserted handler... */
+  cell_data = fixed.cell_data;
+  gtk_tree_store_insert_with_values (tree_store, &iter, &parent, 1,
+                                     0, "Child",
+                                     -1);
+  g_assert_cmpint (fixed.asked[2], ==, 1);
+  g_assert_cmpint (fixed.cell_data, ==, cell_data);
+
+  /* ...but by the validation handler. */
+  flush_events ();
+  g_assert_cmpint (fixed.cell_data, >, cell_data);
+  check_row_area (view, "0:1", row_area (view, "0:0").y + height, height);
+
+  gtk_widget_destroy (window);
+  g_object_unref (tree_store);
+}
+
 int
 main (int    argc,
       char **argv)
@@ -160,6 +762,16 @@ main (int    argc,
   g_test_add_func ("/TreeView/cursor/bug-539377", test_bug_539377);
   g_test_add_func ("/TreeView/cursor/select-collapsed_row",
                    test_select_collapsed_row);
+  g_test_add_func ("/TreeView/selection/selected-ranges",
+                   test_selected_ranges);
+  g_test_add_func ("/TreeView/search/index", test_search_index);
+  g_test_add_func ("/TreeView/search/index-edits", test_search_index_edits);
+  g_test_add_func ("/TreeView/search/index-shared-prefix",
+                   test_search_index_shared_prefix);
+  g_test_add_func ("/TreeView/sizing/fixed-height-func",
+                   test_fixed_height_func);
+  g_test_add_func ("/TreeView/sizing/fixed-height-func-deferred",
+                   test_fixed_height_func_deferred);
 
   return g_test_run ();
 }
@@ -48,8 +48,16 @@ static gboolean ignore_theme_index = FALSE;
 static gboolean quiet = FALSE;
 static gboolean index_only = FALSE;
 static gboolean validate = FALSE;
+static gboolean prescale = FALSE;
+static gchar *prescale_sizes = NULL;
 static gchar *var_name = "-";
 
+/* The pixel sizes of the builtin GtkIconSizes */
+#define DEFAULT_PRESCALE_SIZES "16,18,20,24,32,48"
+
+static gint *sizes = NULL;
+static gint n_sizes = 0;
+
 /* Quite ugly - if we just add the c file to the
  * list of sources in Makefile.am, libtool complains.
  */
@@ -66,6 +74,13 @@ static gchar *var_name = "-";
 #define MINOR_VERSION 0
 #define HASH_OFFSET 12
 
+/* Caches with pre-scaled images have a third field in ImageData,
+ * and are marked with a minor version of 1. Other caches are
+ * written exactly as before.
+ */
+#define SCALED_MINOR_VERSION 1
+#define IMAGE_DATA_HEADER_SIZE (prescale ? 12 : 8)
+
 #define ALIGN_VALUE(this, boundary) \
   (( ((unsigned long)(this)) + (((unsigned long)(boundary)) -1)) & (~(((unsigned long)(boundary))-1)))
 
@@ -171,6 +186,32 @@ typedef struct
   guint size;
 } ImageData;
 
+typedef struct
+{
+  gint size;
+  GdkPixbuf *pixbuf;
+  GdkPixdata pixdata;
+} ScaledImage;
+
+typedef enum
+{
+  DIR_FIXED,
+  DIR_SCALABLE,
+  DIR_THRESHOLD
+} DirType;
+
+typedef struct
+{
+  DirType type;
+  gint size;
+  gint min_size;
+  gint max_size;
+  gint threshold;
+} DirInfo;
+
+/* Subdirectory name => DirInfo, from index.theme */
+static GHashTable *dir_info_hash = NULL;
+
 typedef struct 
 {
   int has_embedded_rect;
@@ -199,6 +240,9 @@ typedef struct
 
   IconData *icon_data;
   guint icon_data_size;
+
+  GList *scaled;
+  guint scaled_data_size;
 } Image;
 
 
@@ -576,6 +620,203 @@ maybe_cache_icon_data (Image       *image,
     }
 }
 
+static void
+load_dir_info (const gchar *path)
+{
+  GKeyFile *key_file;
+  gchar *index_path;
+  gchar **dirs;
+  GError *error = NULL;
+  gint i;
+
+  dir_info_hash = g_hash_table_new_full (g_str_hash, g_str_equal,
+					 g_free, g_free);
+
+  index_path = g_build_filename (path, "index.theme", NULL);
+  key_file = g_key_file_new ();
+
+  if (!g_key_file_load_from_file (key_file, index_path, 0, NULL))
+    goto out;
+
+  dirs = g_key_file_get_string_list (key_file, "Icon Theme", "Directories",
+				     NULL, NULL);
+  for (i = 0; dirs && dirs[i]; i++)
+    {
+      DirInfo *info;
+      gchar *type;
+
+      info = g_new0 (DirInfo, 1);
+
+      /* Use the same defaults as GtkIconTheme */
+      info->size = g_key_file_get_integer (key_file, dirs[i], "Size", &error);
+      if (error)
+	{
+	  g_clear_error (&error);
+	  g_free (info);
+	  continue;
+	}
+
+      info->type = DIR_THRESHOLD;
+      type = g_key_file_get_string (key_file, dirs[i], "Type", NULL);
+      if (type)
+	{
+	  if (strcmp (type, "Fixed") == 0)
+	    info->type = DIR_FIXED;
+	  else if (strcmp (type, "Scalable") == 0)
+	    info->type = DIR_SCALABLE;
+	  g_free (type);
+	}
+
+      info->max_size = g_key_file_get_integer (key_file, dirs[i], "MaxSize", &error);
+      if (error)
+	{
+	  g_clear_error (&error);
+	  info->max_size = info->size;
+	}
+
+      info->min_size = g_key_file_get_integer (key_file, dirs[i], "MinSize", &error);
+      if (error)
+	{
+	  g_clear_error (&error);
+	  info->min_size = info->size;
+	}
+
+      info->threshold = g_key_file_get_integer (key_file, dirs[i], "Threshold", &error);
+      if (error)
+	{
+	  g_clear_error (&error);
+	  info->threshold = 2;
+	}
+
+      g_hash_table_insert (dir_info_hash, g_strdup (dirs[i]), info);
+    }
+  g_strfreev (dirs);
+
+ out:
+  g_key_file_free (key_file);
+  g_free (index_path);
+}
+
+/* Whether GtkIconTheme would render the image at @size itself when
+ * it finds it in a directory described by @info: SVGs are always
+ * rendered at the requested size, other images are only scaled in
+ * scalable directories.
+ */
+static gboolean
+dir_renders_size (DirInfo  *info,
+		  gint      size,
+		  gboolean  is_svg)
+{
+  switch (info->type)
+    {
+    case DIR_FIXED:
+      return is_svg && size == info->size;
+    case DIR_SCALABLE:
+      return size >= info->min_size && size <= info->max_size &&
+	     (is_svg || size != info->size);
+    case DIR_THRESHOLD:
+      return is_svg &&
+	     size >= info->size - info->threshold &&
+	     size <= info->size + info->threshold;
+    }
+
+  return FALSE;
+}
+
+static void
+maybe_cache_scaled_data (Image       *image,
+			 const gchar *dir_path,
+			 const gchar *subdir,
+			 const gchar *basename)
+{
+  DirInfo *info;
+  const gchar *suffix;
+  gchar *name, *path;
+  GdkPixbuf *source = NULL;
+  gboolean is_svg;
+  gint i;
+
+  if (!prescale || index_only || subdir == NULL)
+    return;
+
+  info = g_hash_table_lookup (dir_info_hash, subdir);
+  if (!info)
+    return;
+
+  /* Pick the file GtkIconTheme would load. Without a PNG it prefers
+   * the SVG only if SVG is allowed, so skip that ambiguous case.
+   */
+  if (image->flags & HAS_SUFFIX_PNG)
+    suffix = ".png";
+  else if ((image->flags & HAS_SUFFIX_SVG) && (image->flags & HAS_SUFFIX_XPM))
+    return;
+  else if (image->flags & HAS_SUFFIX_SVG)
+    suffix = ".svg";
+  else if (image->flags & HAS_SUFFIX_XPM)
+    suffix = ".xpm";
+  else
+    return;
+
+  is_svg = strcmp (suffix, ".svg") == 0;
+
+  name = g_strconcat (basename, suffix, NULL);
+  path = g_build_filename (dir_path, name, NULL);
+
+  for (i = 0; i < n_sizes; i++)
+    {
+      ScaledImage *scaled;
+      GdkPixbuf *pixbuf;
+
+      if (!dir_renders_size (info, sizes[i], is_svg))
+	continue;
+
+      /* Render exactly the way icon_info_ensure_scale_and_pixbuf() does */
+      if (is_svg)
+	pixbuf = gdk_pixbuf_new_from_file_at_scale (path, sizes[i], sizes[i],
+						    TRUE, NULL);
+      else
+	{
+	  gdouble scale = (gdouble) sizes[i] / info->size;
+
+	  if (!source)
+	    source = gdk_pixbuf_new_from_file (path, NULL);
+	  if (!source)
+	    break;
+
+	  pixbuf = gdk_pixbuf_scale_simple (source,
+					    0.5 + gdk_pixbuf_get_width (source) * scale,
+					    0.5 + gdk_pixbuf_get_height (source) * scale,
+					    GDK_INTERP_BILINEAR);
+	}
+
+      if (!pixbuf)
+	continue;
+
+      scaled = g_new0 (ScaledImage, 1);
+      scaled->size = sizes[i];
+      scaled->pixbuf = pixbuf;
+      gdk_pixdata_from_pixbuf (&scaled->pixdata, pixbuf, FALSE);
+
+      image->scaled = g_list_append (image->scaled, scaled);
+    }
+
+  if (source)
+    g_object_unref (source);
+
+  g_free (name);
+  g_free (path);
+}
+
+static void
+cache_scaled_data_foreach (gpointer key,
+			   gpointer value,
+			   gpointer user_data)
+{
+  const gchar **paths = user_data;
+
+  maybe_cache_scaled_data (value, paths[0], paths[1], key);
+}
+
 static GList *
 scan_directory (const gchar *base_path, 
 		const gchar *subdir, 
@@ -681,6 +922,15 @@ scan_directory (const gchar *base_path,
 
   g_dir_close (dir);
 
+  if (prescale && subdir)
+    {
+      const gchar *paths[2];
+
+      paths[0] = dir_path;
+      paths[1] = subdir;
+      g_hash_table_foreach (dir_hash, cache_scaled_data_foreach, paths);
+    }
+
   /* Move dir into the big file hash */
   g_hash_table_foreach_remove (dir_hash, foreach_remove_func, files);
   
@@ -939,11 +1189,62 @@ write_icon_data (FILE *cache, IconData *icon_data, int offset)
   return TRUE;
 }
 
+static gboolean
+write_scaled_data (FILE *cache, Image *image, int offset)
+{
+  GList *l;
+  guint8 *s;
+  guint len;
+  int data_offset;
+  int i;
+
+  if (!write_card32 (cache, g_list_length (image->scaled)))
+    return FALSE;
+
+  data_offset = offset + 4 + 8 * g_list_length (image->scaled);
+  for (l = image->scaled; l; l = l->next)
+    {
+      ScaledImage *scaled = l->data;
+
+      if (!write_card32 (cache, scaled->size) ||
+	  !write_card32 (cache, data_offset))
+	return FALSE;
+
+      data_offset += 8 + scaled->pixdata.length;
+    }
+
+  for (l = image->scaled; l; l = l->next)
+    {
+      ScaledImage *scaled = l->data;
+
+      /* Type 0 is GdkPixdata */
+      if (!write_card32 (cache, 0))
+	return FALSE;
+
+      s = gdk_pixdata_serialize (&scaled->pixdata, &len);
+
+      if (!write_card32 (cache, len))
+	{
+	  g_free (s);
+	  return FALSE;
+	}
+
+      i = fwrite (s, len, 1, cache);
+
+      g_free (s);
+
+      if (i != 1)
+	return FALSE;
+    }
+
+  return TRUE;
+}
+
 static gboolean
 write_header (FILE *cache, guint32 dir_list_offset)
 {
   return (write_card16 (cache, MAJOR_VERSION) &&
-	  write_card16 (cache, MINOR_VERSION) &&
+	  write_card16 (cache, prescale ? SCALED_MINOR_VERSION : MINOR_VERSION) &&
 	  write_card32 (cache, HASH_OFFSET) &&
 	  write_card32 (cache, dir_list_offset));
 }
@@ -1035,6 +1336,28 @@ get_image_pixel_data_size (Image *image)
   return image->pixel_data_size;
 }
 
+static gint
+get_image_scaled_data_size (Image *image)
+{
+  GList *l;
+
+  if (image->scaled_data_size == 0 && image->scaled)
+    {
+      image->scaled_data_size = 4;
+
+      for (l = image->scaled; l; l = l->next)
+	{
+	  ScaledImage *scaled = l->data;
+
+	  image->scaled_data_size += 8 + 8 + scaled->pixdata.length;
+	}
+    }
+
+  g_assert (image->scaled_data_size % 4 == 0);
+
+  return image->scaled_data_size;
+}
+
 static gint
 get_image_data_size (Image *image)
 {
@@ -1044,6 +1367,7 @@ get_image_data_size (Image *image)
 
   len += get_image_pixel_data_size (image);
   len += get_image_meta_data_size (image);
+  len += get_image_scaled_data_size (image);
 
   /* Even if len is zero, we need to reserve space to
    * write the ImageData, unless this is an .svg without 
@@ -1051,7 +1375,7 @@ get_image_data_size (Image *image)
    * are NULL.
    */
   if (len > 0 || image->image_data || image->icon_data)
-    len += 8;
+    len += IMAGE_DATA_HEADER_SIZE;
 
   return len;
 }
@@ -1188,6 +1512,8 @@ write_bucket (FILE *cache, HashNode *node, int *offset)
 	  Image *image = list->data;
 	  int pixel_data_size = get_image_pixel_data_size (image);
 	  int meta_data_size = get_image_meta_data_size (image);
+	  int scaled_data_size = get_image_scaled_data_size (image);
+	  int scaled_data_offset;
 
 	  if (get_image_data_size (image) == 0)
 	    continue;
@@ -1195,7 +1521,7 @@ write_bucket (FILE *cache, HashNode *node, int *offset)
 	  /* Pixel data */
 	  if (pixel_data_size > 0) 
 	    {
-	      image->image_data->offset = image_data_offset + 8;
+	      image->image_data->offset = image_data_offset + IMAGE_DATA_HEADER_SIZE;
 	      if (!write_card32 (cache, image->image_data->offset))
 		return FALSE;
 	    }
@@ -1207,7 +1533,7 @@ write_bucket (FILE *cache, HashNode *node, int *offset)
 
 	  if (meta_data_size > 0)
 	    {
-	      image->icon_data->offset = image_data_offset + pixel_data_size + 8;
+	      image->icon_data->offset = image_data_offset + pixel_data_size + IMAGE_DATA_HEADER_SIZE;
 	      if (!write_card32 (cache, image->icon_data->offset))
 		return FALSE;
 	    }
@@ -1217,6 +1543,14 @@ write_bucket (FILE *cache, HashNode *node, int *offset)
 		return FALSE;
 	    }
 
+	  /* Scaled data */
+	  scaled_data_offset = image_data_offset + IMAGE_DATA_HEADER_SIZE + pixel_data_size + meta_data_size;
+	  if (prescale)
+	    {
+	      if (!write_card32 (cache, scaled_data_size > 0 ? scaled_data_offset : 0))
+		return FALSE;
+	    }
+
 	  if (pixel_data_size > 0)
 	    {
 	      if (!write_image_data (cache, image->image_data, image->image_data->offset))
@@ -1229,7 +1563,13 @@ write_bucket (FILE *cache, HashNode *node, int *offset)
                 return FALSE;
             }
 
-	  image_data_offset += pixel_data_size + meta_data_size + 8;
+	  if (scaled_data_size > 0)
+	    {
+	      if (!write_scaled_data (cache, image, scaled_data_offset))
+		return FALSE;
+	    }
+
+	  image_data_offset += pixel_data_size + meta_data_size + scaled_data_size + IMAGE_DATA_HEADER_SIZE;
 	}
       
       *offset = next_offset;
@@ -1476,6 +1816,9 @@ opentmp:
   image_data_hash = g_hash_table_new (g_str_hash, g_str_equal);
   icon_data_hash = g_hash_table_new (g_str_hash, g_str_equal);
   string_pool = g_hash_table_new (g_str_hash, g_str_equal);
+
+  if (prescale)
+    load_dir_info (path);
  
   directories = scan_directory (path, NULL, files, NULL, 0);
 
@@ -1614,6 +1957,8 @@ static GOptionEntry args[] = {
   { "source", 'c', 0, G_OPTION_ARG_STRING, &var_name, N_("Output a C header file"), "NAME" },
   { "quiet", 'q', 0, G_OPTION_ARG_NONE, &quiet, N_("Turn off verbose output"), NULL },
   { "validate", 'v', 0, G_OPTION_ARG_NONE, &validate, N_("Validate existing icon cache"), NULL },
+  { "prescale", 'p', 0, G_OPTION_ARG_NONE, &prescale, N_("Include icons rendered at common sizes in the cache"), NULL },
+  { "sizes", 's', 0, G_OPTION_ARG_STRING, &prescale_sizes, N_("Comma-separated pixel sizes for --prescale"), "SIZES" },
   { NULL }
 };
 
@@ -1713,6 +2058,23 @@ main (int argc, char **argv)
   if (!force_update && is_cache_up_to_date (path))
     return 0;
 
+  if (prescale)
+    {
+      gchar **strv;
+      gint i;
+
+      strv = g_strsplit (prescale_sizes ? prescale_sizes : DEFAULT_PRESCALE_SIZES, ",", -1);
+      sizes = g_new (gint, g_strv_length (strv));
+      for (i = 0; strv[i]; i++)
+	{
+	  gint size = atoi (strv[i]);
+
+	  if (size > 0)
+	    sizes[n_sizes++] = size;
+	}
+      g_strfreev (strv);
+    }
+
   g_type_init ();
   build_cache (path);
 
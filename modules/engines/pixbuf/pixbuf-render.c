@@ -345,102 +345,79 @@ replicate_cols (GdkPixbuf    *src,
   return result;
 }
 
-/* Scale the rectangle (src_x, src_y, src_width, src_height)
- * onto the rectangle (dest_x, dest_y, dest_width, dest_height)
- * of the destination, clip by clip_rect and render
+/* Scale the rectangle (src_x, src_y, src_width, src_height) onto
+ * the rectangle (dest_x, dest_y, dest_width, dest_height), and
+ * return the part of the result that falls within rect. The part
+ * starts at (*x_offset, *y_offset) in the returned pixbuf.
  */
-static void
-pixbuf_render (GdkPixbuf    *src,
-	       guint         hints,
-	       GdkWindow    *window,
-	       GdkBitmap    *mask,
-	       GdkRectangle *clip_rect,
-	       gint          src_x,
-	       gint          src_y,
-	       gint          src_width,
-	       gint          src_height,
-	       gint          dest_x,
-	       gint          dest_y,
-	       gint          dest_width,
-	       gint          dest_height)
+static GdkPixbuf *
+pixbuf_scale_component (GdkPixbuf    *src,
+			guint         hints,
+			gint          src_x,
+			gint          src_y,
+			gint          src_width,
+			gint          src_height,
+			gint          dest_x,
+			gint          dest_y,
+			gint          dest_width,
+			gint          dest_height,
+			GdkRectangle *rect,
+			gint         *x_offset,
+			gint         *y_offset)
 {
   GdkPixbuf *tmp_pixbuf = NULL;
-  GdkRectangle rect;
-  int x_offset, y_offset;
   gboolean has_alpha = gdk_pixbuf_get_has_alpha (src);
   gint src_rowstride = gdk_pixbuf_get_rowstride (src);
   gint src_n_channels = gdk_pixbuf_get_n_channels (src);
 
-  if (dest_width <= 0 || dest_height <= 0)
-    return;
-
-  rect.x = dest_x;
-  rect.y = dest_y;
-  rect.width = dest_width;
-  rect.height = dest_height;
-
-  if (hints & THEME_MISSING)
-    return;
-
-  /* FIXME: Because we use the mask to shape windows, we don't use
-   * clip_rect to clip what we draw to the mask, only to clip
-   * what we actually draw. But this leads to the horrible ineffiency
-   * of scale the whole image to get a little bit of it.
-   */
-  if (!mask && clip_rect)
-    {
-      if (!gdk_rectangle_intersect (clip_rect, &rect, &rect))
-	return;
-    }
-
   if (dest_width == src_width && dest_height == src_height)
     {
       tmp_pixbuf = g_object_ref (src);
 
-      x_offset = src_x + rect.x - dest_x;
-      y_offset = src_y + rect.y - dest_y;
+      *x_offset = src_x + rect->x - dest_x;
+      *y_offset = src_y + rect->y - dest_y;
     }
   else if (src_width == 0 && src_height == 0)
     {
       tmp_pixbuf = bilinear_gradient (src, src_x, src_y, dest_width, dest_height);      
       
-      x_offset = rect.x - dest_x;
-      y_offset = rect.y - dest_y;
+      *x_offset = rect->x - dest_x;
+      *y_offset = rect->y - dest_y;
     }
   else if (src_width == 0 && dest_height == src_height)
     {
       tmp_pixbuf = horizontal_gradient (src, src_x, src_y, dest_width, dest_height);      
       
-      x_offset = rect.x - dest_x;
-      y_offset = rect.y - dest_y;
+      *x_offset = rect->x - dest_x;
+      *y_offset = rect->y - dest_y;
     }
   else if (src_height == 0 && dest_width == src_width)
     {
       tmp_pixbuf = vertical_gradient (src, src_x, src_y, dest_width, dest_height);
       
-      x_offset = rect.x - dest_x;
-      y_offset = rect.y - dest_y;
+      *x_offset = rect->x - dest_x;
+      *y_offset = rect->y - dest_y;
     }
   else if ((hints & THEME_CONSTANT_COLS) && (hints & THEME_CONSTANT_ROWS))
     {
       tmp_pixbuf = replicate_single (src, src_x, src_y, dest_width, dest_height);
 
-      x_offset = rect.x - dest_x;
-      y_offset = rect.y - dest_y;
+      *x_offset = rect->x - dest_x;
+      *y_offset = rect->y - dest_y;
     }
   else if (dest_width == src_width && (hints & THEME_CONSTANT_COLS))
     {
       tmp_pixbuf = replicate_rows (src, src_x, src_y, dest_width, dest_height);
 
-      x_offset = rect.x - dest_x;
-      y_offset = rect.y - dest_y;
+      *x_offset = rect->x - dest_x;
+      *y_offset = rect->y - dest_y;
     }
   else if (dest_height == src_height && (hints & THEME_CONSTANT_ROWS))
     {
       tmp_pixbuf = replicate_cols (src, src_x, src_y, dest_width, dest_height);
 
-      x_offset = rect.x - dest_x;
-      y_offset = rect.y - dest_y;
+      *x_offset = rect->x - dest_x;
+      *y_offset = rect->y - dest_y;
     }
   else if (src_width > 0 && src_height > 0)
     {
@@ -461,20 +438,73 @@ pixbuf_render (GdkPixbuf    *src,
 						  
       tmp_pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB,
 				   has_alpha, 8,
-				   rect.width, rect.height);
+				   rect->width, rect->height);
 
       gdk_pixbuf_scale (partial_src, tmp_pixbuf,
-			0, 0, rect.width, rect.height,
-			dest_x - rect.x, dest_y - rect.y, 
+			0, 0, rect->width, rect->height,
+			dest_x - rect->x, dest_y - rect->y, 
 			x_scale, y_scale,
 			GDK_INTERP_BILINEAR);
 
       g_object_unref (partial_src);
 
-      x_offset = 0;
-      y_offset = 0;
+      *x_offset = 0;
+      *y_offset = 0;
+    }
+
+  return tmp_pixbuf;
+}
+
+/* Scale the rectangle (src_x, src_y, src_width, src_height)
+ * onto the rectangle (dest_x, dest_y, dest_width, dest_height)
+ * of the destination, clip by clip_rect and render
+ */
+static void
+pixbuf_render (GdkPixbuf    *src,
+	       guint         hints,
+	       GdkWindow    *window,
+	       GdkBitmap    *mask,
+	       GdkRectangle *clip_rect,
+	       gint          src_x,
+	       gint          src_y,
+	       gint          src_width,
+	       gint          src_height,
+	       gint          dest_x,
+	       gint          dest_y,
+	       gint          dest_width,
+	       gint          dest_height)
+{
+  GdkPixbuf *tmp_pixbuf;
+  GdkRectangle rect;
+  int x_offset, y_offset;
+
+  if (dest_width <= 0 || dest_height <= 0)
+    return;
+
+  rect.x = dest_x;
+  rect.y = dest_y;
+  rect.width = dest_width;
+  rect.height = dest_height;
+
+  if (hints & THEME_MISSING)
+    return;
+
+  /* FIXME: Because we use the mask to shape windows, we don't use
+   * clip_rect to clip what we draw to the mask, only to clip
+   * what we actually draw. But this leads to the horrible ineffiency
+   * of scale the whole image to get a little bit of it.
+   */
+  if (!mask && clip_rect)
+    {
+      if (!gdk_rectangle_intersect (clip_rect, &rect, &rect))
+	return;
     }
 
+  tmp_pixbuf = pixbuf_scale_component (src, hints,
+				       src_x, src_y, src_width, src_height,
+				       dest_x, dest_y, dest_width, dest_height,
+				       &rect, &x_offset, &y_offset);
+
   if (tmp_pixbuf)
     {
       if (mask)
@@ -496,6 +526,222 @@ pixbuf_render (GdkPixbuf    *src,
     }
 }
 
+/* Like pixbuf_render(), but into (dest_x, dest_y) of the pixbuf dest */
+static void
+pixbuf_render_to_pixbuf (GdkPixbuf *src,
+			 guint      hints,
+			 GdkPixbuf *dest,
+			 gint       src_x,
+			 gint       src_y,
+			 gint       src_width,
+			 gint       src_height,
+			 gint       dest_x,
+			 gint       dest_y,
+			 gint       dest_width,
+			 gint       dest_height)
+{
+  GdkPixbuf *tmp_pixbuf;
+  GdkRectangle rect;
+  int x_offset, y_offset;
+
+  if (dest_width <= 0 || dest_height <= 0 || (hints & THEME_MISSING))
+    return;
+
+  rect.x = dest_x;
+  rect.y = dest_y;
+  rect.width = dest_width;
+  rect.height = dest_height;
+
+  tmp_pixbuf = pixbuf_scale_component (src, hints,
+				       src_x, src_y, src_width, src_height,
+				       dest_x, dest_y, dest_width, dest_height,
+				       &rect, &x_offset, &y_offset);
+
+  if (tmp_pixbuf)
+    {
+      gdk_pixbuf_copy_area (tmp_pixbuf,
+			    x_offset, y_offset,
+			    rect.width, rect.height,
+			    dest, rect.x, rect.y);
+      g_object_unref (tmp_pixbuf);
+    }
+}
+
+/* Stretched images are drawn over and over at the same few sizes
+ * (all the buttons in a dialog, scrollbar troughs...), so the
+ * results are kept in a small LRU cache instead of being scaled
+ * again on every expose.
+ */
+#define RENDER_CACHE_MAX_BYTES   (4 * 1024 * 1024)
+#define RENDER_CACHE_MAX_ENTRY   (RENDER_CACHE_MAX_BYTES / 8)
+
+/* With GTK_DEBUG=misc, the cache statistics are printed every
+ * RENDER_CACHE_STATS_INTERVAL lookups and whenever a theme image
+ * drops its renders.
+ */
+#define RENDER_CACHE_STATS_INTERVAL 1000
+
+typedef struct
+{
+  ThemePixbuf *theme_pb;
+  guint        component_mask;
+  gint         width;
+  gint         height;
+
+  GdkPixbuf   *pixbuf;
+  gsize        size;
+} RenderCacheEntry;
+
+static GHashTable *render_cache = NULL;	/* RenderCacheEntry => GList link */
+static GQueue      render_cache_lru = G_QUEUE_INIT;
+static gsize       render_cache_size = 0;
+static guint       render_cache_hits = 0;
+static guint       render_cache_misses = 0;
+static guint       render_cache_evictions = 0;
+
+#ifdef G_ENABLE_DEBUG
+static void
+render_cache_print_stats (void)
+{
+  g_print ("pixbuf engine render cache: %u hits, %u misses, %u evictions, %u pixbufs, %" G_GSIZE_FORMAT " bytes\n",
+	   render_cache_hits, render_cache_misses, render_cache_evictions,
+	   render_cache_lru.length, render_cache_size);
+}
+#endif
+
+static guint
+render_cache_entry_hash (gconstpointer v)
+{
+  const RenderCacheEntry *entry = v;
+
+  return GPOINTER_TO_UINT (entry->theme_pb) ^
+         (entry->component_mask << 22) ^
+         (entry->width << 11) ^ entry->height;
+}
+
+static gboolean
+render_cache_entry_equal (gconstpointer a,
+			  gconstpointer b)
+{
+  const RenderCacheEntry *entry_a = a;
+  const RenderCacheEntry *entry_b = b;
+
+  return entry_a->theme_pb == entry_b->theme_pb &&
+         entry_a->component_mask == entry_b->component_mask &&
+         entry_a->width == entry_b->width &&
+         entry_a->height == entry_b->height;
+}
+
+static void
+render_cache_remove (GList *link)
+{
+  RenderCacheEntry *entry = link->data;
+
+  g_hash_table_remove (render_cache, entry);
+  g_queue_delete_link (&render_cache_lru, link);
+
+  render_cache_size -= entry->size;
+  g_object_unref (entry->pixbuf);
+  g_slice_free (RenderCacheEntry, entry);
+}
+
+static void
+render_cache_flush (ThemePixbuf *theme_pb)
+{
+  GList *link, *next;
+  gboolean removed = FALSE;
+
+  if (!render_cache)
+    return;
+
+  for (link = render_cache_lru.head; link; link = next)
+    {
+      RenderCacheEntry *entry = link->data;
+
+      next = link->next;
+
+      if (entry->theme_pb == theme_pb)
+	{
+	  render_cache_remove (link);
+	  removed = TRUE;
+	}
+    }
+
+  if (removed)
+    GTK_NOTE (MISC, render_cache_print_stats ());
+}
+
+static GdkPixbuf *
+render_cache_lookup (ThemePixbuf *theme_pb,
+		     guint        component_mask,
+		     gint         width,
+		     gint         height)
+{
+  RenderCacheEntry lookup;
+  GList *link;
+
+  if (!render_cache)
+    return NULL;
+
+  lookup.theme_pb = theme_pb;
+  lookup.component_mask = component_mask;
+  lookup.width = width;
+  lookup.height = height;
+
+  link = g_hash_table_lookup (render_cache, &lookup);
+
+  if (link)
+    render_cache_hits++;
+  else
+    render_cache_misses++;
+
+  GTK_NOTE (MISC,
+	    if ((render_cache_hits + render_cache_misses) % RENDER_CACHE_STATS_INTERVAL == 0)
+	      render_cache_print_stats ());
+
+  if (!link)
+    return NULL;
+
+  /* Move to the front */
+  g_queue_unlink (&render_cache_lru, link);
+  g_queue_push_head_link (&render_cache_lru, link);
+
+  return ((RenderCacheEntry *) link->data)->pixbuf;
+}
+
+static void
+render_cache_insert (ThemePixbuf *theme_pb,
+		     guint        component_mask,
+		     gint         width,
+		     gint         height,
+		     GdkPixbuf   *pixbuf)
+{
+  RenderCacheEntry *entry;
+
+  if (!render_cache)
+    render_cache = g_hash_table_new (render_cache_entry_hash,
+				     render_cache_entry_equal);
+
+  entry = g_slice_new (RenderCacheEntry);
+  entry->theme_pb = theme_pb;
+  entry->component_mask = component_mask;
+  entry->width = width;
+  entry->height = height;
+  entry->pixbuf = g_object_ref (pixbuf);
+  entry->size = gdk_pixbuf_get_rowstride (pixbuf) * height;
+
+  render_cache_size += entry->size;
+
+  while (render_cache_size > RENDER_CACHE_MAX_BYTES)
+    {
+      render_cache_remove (render_cache_lru.tail);
+      render_cache_evictions++;
+    }
+
+  g_queue_push_head (&render_cache_lru, entry);
+  g_hash_table_insert (render_cache, entry, render_cache_lru.head);
+}
+
 ThemePixbuf *
 theme_pixbuf_new (void)
 {
@@ -523,6 +769,8 @@ void
 theme_pixbuf_set_filename (ThemePixbuf *theme_pb,
 			   const char  *filename)
 {
+  render_cache_flush (theme_pb);
+
   if (theme_pb->pixbuf)
     {
       g_cache_remove (pixbuf_cache, theme_pb->pixbuf);
@@ -685,6 +933,8 @@ theme_pixbuf_set_border (ThemePixbuf *theme_pb,
   theme_pb->border_top = top;
   theme_pb->border_bottom = bottom;
 
+  render_cache_flush (theme_pb);
+
   if (theme_pb->pixbuf)
     theme_pixbuf_compute_hints (theme_pb);
 }
@@ -695,6 +945,8 @@ theme_pixbuf_set_stretch (ThemePixbuf *theme_pb,
 {
   theme_pb->stretch = stretch;
 
+  render_cache_flush (theme_pb);
+
   if (theme_pb->pixbuf)
     theme_pixbuf_compute_hints (theme_pb);
 }
@@ -793,7 +1045,82 @@ theme_pixbuf_render (ThemePixbuf  *theme_pb,
 	  dest_y[1] = dest_y[2] = (dest_y[1] + dest_y[2]) / 2;
 	}
 
+      /* Shaped rendering needs every component drawn into the mask,
+       * so only the unshaped case goes through the cache.
+       */
+      if (!mask && width > 0 && height > 0 &&
+	  width <= RENDER_CACHE_MAX_ENTRY / 4 / height)
+	{
+	  GdkPixbuf *rendered;
+	  GdkRectangle rect;
+
+	  rendered = render_cache_lookup (theme_pb, component_mask, width, height);
+
+	  if (!rendered)
+	    {
+	      gboolean has_alpha;
+	      gint i, j;
+
+	      has_alpha = gdk_pixbuf_get_has_alpha (pixbuf) ||
+		          component_mask != COMPONENT_ALL - 1;
+	      for (i = 0; i < 3; i++)
+		for (j = 0; j < 3; j++)
+		  if (theme_pb->hints[i][j] & THEME_MISSING)
+		    has_alpha = TRUE;
+
+	      rendered = gdk_pixbuf_new (GDK_COLORSPACE_RGB, has_alpha, 8,
+					 width, height);
+	      if (has_alpha)
+		gdk_pixbuf_fill (rendered, 0);
+
+#define RENDER_COMPONENT_TO_PIXBUF(X1,X2,Y1,Y2)					   \
+              pixbuf_render_to_pixbuf (pixbuf, theme_pb->hints[Y1][X1], rendered, \
+	 	                       src_x[X1], src_y[Y1],			   \
+		                       src_x[X2] - src_x[X1], src_y[Y2] - src_y[Y1], \
+		                       dest_x[X1] - x, dest_y[Y1] - y,		   \
+		                       dest_x[X2] - dest_x[X1], dest_y[Y2] - dest_y[Y1]);
+
+	      if (component_mask & COMPONENT_NORTH_WEST)
+		RENDER_COMPONENT_TO_PIXBUF (0, 1, 0, 1);
+	      if (component_mask & COMPONENT_NORTH)
+		RENDER_COMPONENT_TO_PIXBUF (1, 2, 0, 1);
+	      if (component_mask & COMPONENT_NORTH_EAST)
+		RENDER_COMPONENT_TO_PIXBUF (2, 3, 0, 1);
+	      if (component_mask & COMPONENT_WEST)
+		RENDER_COMPONENT_TO_PIXBUF (0, 1, 1, 2);
+	      if (component_mask & COMPONENT_CENTER)
+		RENDER_COMPONENT_TO_PIXBUF (1, 2, 1, 2);
+	      if (component_mask & COMPONENT_EAST)
+		RENDER_COMPONENT_TO_PIXBUF (2, 3, 1, 2);
+	      if (component_mask & COMPONENT_SOUTH_WEST)
+		RENDER_COMPONENT_TO_PIXBUF (0, 1, 2, 3);
+	      if (component_mask & COMPONENT_SOUTH)
+		RENDER_COMPONENT_TO_PIXBUF (1, 2, 2, 3);
+	      if (component_mask & COMPONENT_SOUTH_EAST)
+		RENDER_COMPONENT_TO_PIXBUF (2, 3, 2, 3);
+
+#undef RENDER_COMPONENT_TO_PIXBUF
+
+	      render_cache_insert (theme_pb, component_mask, width, height, rendered);
+	      g_object_unref (rendered);
+	    }
 
+	  rect.x = x;
+	  rect.y = y;
+	  rect.width = width;
+	  rect.height = height;
+
+	  if (clip_rect && !gdk_rectangle_intersect (clip_rect, &rect, &rect))
+	    return;
+
+	  gdk_draw_pixbuf (window, NULL, rendered,
+			   rect.x - x, rect.y - y,
+			   rect.x, rect.y,
+			   rect.width, rect.height,
+			   GDK_RGB_DITHER_NORMAL,
+			   0, 0);
+	  return;
+	}
 
 #define RENDER_COMPONENT(X1,X2,Y1,Y2)					         \
         pixbuf_render (pixbuf, theme_pb->hints[Y1][X1], window, mask, clip_rect, \
@@ -4,6 +4,10 @@
 #include "marshalers.h"
 #include "typebuiltins.h"
 
+#ifdef GDK_WINDOWING_X11
+#include <gdk/gdkx.h>
+#endif
+
 typedef enum {
   STATE_NOT_CREATED,
   STATE_INSTRUMENTED_NOT_MAPPED,
@@ -20,6 +24,9 @@ struct _GtkWidgetProfilerPrivate {
 
   GTimer *timer;
 
+  gulong start_request;
+  guint n_requests;
+
   gulong toplevel_expose_event_id;
   gulong toplevel_property_notify_event_id;
 
@@ -146,6 +153,34 @@ gtk_widget_profiler_set_num_iterations (GtkWidgetProfiler *profiler,
   priv->n_iterations = n_iterations;
 }
 
+/* Sequence number of the next X request, used to count the requests
+ * sent while painting.
+ */
+static gulong
+get_next_request (GtkWidgetProfiler *profiler)
+{
+#ifdef GDK_WINDOWING_X11
+  GtkWidgetProfilerPrivate *priv;
+
+  priv = profiler->priv;
+
+  return XNextRequest (GDK_DISPLAY_XDISPLAY (gtk_widget_get_display (priv->toplevel)));
+#else
+  return 0;
+#endif
+}
+
+static void
+start_expose_timing (GtkWidgetProfiler *profiler)
+{
+  GtkWidgetProfilerPrivate *priv;
+
+  priv = profiler->priv;
+
+  priv->start_request = get_next_request (profiler);
+  g_timer_reset (priv->timer);
+}
+
 static void
 report (GtkWidgetProfiler      *profiler,
 	GtkWidgetProfilerReport report,
@@ -190,6 +225,12 @@ toplevel_property_notify_event_cb (GtkWidget *widget, GdkEventProperty *event, g
   /* Finish timing map/expose */
 
   elapsed = g_timer_elapsed (priv->timer, NULL);
+
+#ifdef GDK_WINDOWING_X11
+  /* Don't count the property change that ended the expose */
+  priv->n_requests = get_next_request (profiler) - priv->start_request - 1;
+#endif
+
   report (profiler, GTK_WIDGET_PROFILER_REPORT_EXPOSE, elapsed);
 
   gtk_main_quit (); /* This will get us back to the end of profile_map_expose() */
@@ -309,7 +350,7 @@ profile_map_expose (GtkWidgetProfiler *profiler)
 
   /* Time expose; this gets recorded in toplevel_property_notify_event_cb() */
 
-  g_timer_reset (priv->timer);
+  start_expose_timing (profiler);
   gtk_main ();
 }
 
@@ -418,10 +459,21 @@ profile_expose (GtkWidgetProfiler *profiler)
 
   /* Time expose; this gets recorded in toplevel_property_notify_event_cb() */
 
-  g_timer_reset (priv->timer);
+  start_expose_timing (profiler);
   gtk_main ();
 }
 
+/* Returns the number of X requests sent during the last expose that
+ * was reported, or 0 if the windowing system can't tell.
+ */
+guint
+gtk_widget_profiler_get_n_requests (GtkWidgetProfiler *profiler)
+{
+  g_return_val_if_fail (GTK_IS_WIDGET_PROFILER (profiler), 0);
+
+  return profiler->priv->n_requests;
+}
+
 void
 gtk_widget_profiler_profile_boot (GtkWidgetProfiler *profiler)
 {
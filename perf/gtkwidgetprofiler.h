@@ -54,6 +54,8 @@ void gtk_widget_profiler_profile_boot (GtkWidgetProfiler *profiler);
 
 void gtk_widget_profiler_profile_expose (GtkWidgetProfiler *profiler);
 
+guint gtk_widget_profiler_get_n_requests (GtkWidgetProfiler *profiler);
+
 
 G_END_DECLS
 
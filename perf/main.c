@@ -38,7 +38,11 @@ report_cb (GtkWidgetProfiler *profiler, GtkWidgetProfilerReport report, GtkWidge
     type = NULL;
   }
 
-  fprintf (stdout, "%s: %g sec\n", type, elapsed);
+  if (report == GTK_WIDGET_PROFILER_REPORT_EXPOSE)
+    fprintf (stdout, "%s: %g sec, %u requests\n", type, elapsed,
+             gtk_widget_profiler_get_n_requests (profiler));
+  else
+    fprintf (stdout, "%s: %g sec\n", type, elapsed);
 
   if (report == GTK_WIDGET_PROFILER_REPORT_DESTROY)
     fputs ("\n", stdout);
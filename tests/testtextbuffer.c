@@ -0,0 +1,330 @@
+/* GTK - The GIMP Toolkit
+ * Copyright (C) 1995-1997 Peter Mattis, Spencer Kimball and Josh MacDonald
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Performance tests for GtkTextBuffer */
+
+#include "config.h"
+
+#include <string.h>
+#include <stdlib.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <gtk/gtk.h>
+
+static gint repeats = 1;
+static gint min_size = 10;
+static gint max_size = 500;
+static gchar *filename = NULL;
+static gint replace_size = 2048;
+
+static GOptionEntry entries[] = {
+  { "repeats", 'r', 0, G_OPTION_ARG_INT, &repeats, "Average over N repetitions", "N" },
+  { "min-size", 0, 0, G_OPTION_ARG_INT, &min_size, "Smallest generated text, in megabytes", "MB" },
+  { "max-size", 'm', 0, G_OPTION_ARG_INT, &max_size, "Largest generated text, in megabytes", "MB" },
+  { "file", 'f', 0, G_OPTION_ARG_FILENAME, &filename, "Load FILE instead of generated text", "FILE" },
+  { "replace-size", 0, 0, G_OPTION_ARG_INT, &replace_size, "Text for the replace-all test, in kilobytes", "KB" },
+  { NULL }
+};
+
+/* Resident set size in kilobytes, or 0 if unknown */
+static glong
+get_rss (void)
+{
+  gchar *contents;
+  glong pages = 0;
+
+  if (g_file_get_contents ("/proc/self/statm", &contents, NULL, NULL))
+    {
+      gchar **fields = g_strsplit (contents, " ", -1);
+
+      if (fields[0] && fields[1])
+        pages = atol (fields[1]);
+
+      g_strfreev (fields);
+      g_free (contents);
+    }
+
+  return pages * (getpagesize () / 1024);
+}
+
+/* Something that looks like a log file */
+static gchar *
+make_text (gsize size)
+{
+  GString *text;
+  guint i = 0;
+
+  text = g_string_sized_new (size + 256);
+
+  while (text->len < size)
+    {
+      g_string_append_printf (text,
+                              "%08u message %u: the quick brown fox jumps over the lazy dog%s\n",
+                              i, i % 97, (i % 7) ? "" : " (and then some more text to make lines differ in length)");
+      i++;
+    }
+
+  return g_string_free (text, FALSE);
+}
+
+typedef void (LoadFunc) (GtkTextBuffer *buffer,
+                         const gchar   *text,
+                         gsize          len);
+
+/* The single pass load */
+static void
+load_set_text (GtkTextBuffer *buffer,
+               const gchar   *text,
+               gsize          len)
+{
+  gtk_text_buffer_set_text (buffer, text, len);
+}
+
+/* Appending in blocks goes through the incremental insertion path */
+static void
+load_append_blocks (GtkTextBuffer *buffer,
+                    const gchar   *text,
+                    gsize          len)
+{
+  GtkTextIter end;
+  gsize pos = 0;
+
+  gtk_text_buffer_set_text (buffer, "", 0);
+
+  while (pos < len)
+    {
+      gsize block = MIN (len - pos, 64 * 1024);
+
+      /* don't split a character */
+      if (pos + block < len)
+        block = g_utf8_find_prev_char (text + pos, text + pos + block + 1) - (text + pos);
+
+      gtk_text_buffer_get_end_iter (buffer, &end);
+      gtk_text_buffer_insert (buffer, &end, text + pos, block);
+      pos += block;
+    }
+}
+
+static void
+test_load (const gchar *title,
+           const gchar *text,
+           gsize        len,
+           LoadFunc    *load)
+{
+  GtkTextBuffer *buffer;
+  GTimer *timer;
+  gdouble elapsed = 0.0;
+  glong rss_before, rss_after = 0;
+  gint d;
+
+  timer = g_timer_new ();
+
+  for (d = 0; d < repeats; d++)
+    {
+      buffer = gtk_text_buffer_new (NULL);
+      rss_before = get_rss ();
+
+      g_timer_reset (timer);
+      g_timer_start (timer);
+      (*load) (buffer, text, len);
+      g_timer_stop (timer);
+
+      elapsed += g_timer_elapsed (timer, NULL);
+      rss_after = get_rss () - rss_before;
+
+      g_object_unref (buffer);
+    }
+
+  elapsed = elapsed * 1000 / repeats;
+
+  g_print ("%-16s \t%6" G_GSIZE_FORMAT "MB \t%10.1f \t%8ldk\n",
+           title, len / (1024 * 1024), elapsed, rss_after);
+
+  g_timer_destroy (timer);
+}
+
+static void
+test_text (const gchar *text,
+           gsize        len)
+{
+  test_load ("set_text", text, len, load_set_text);
+  test_load ("append blocks", text, len, load_append_blocks);
+}
+
+static void
+flush_events (void)
+{
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+}
+
+static void
+count_changed (GtkTextBuffer *buffer,
+               gpointer       data)
+{
+  (*(gint *) data)++;
+}
+
+static gint
+replace_all (GtkTextBuffer *buffer,
+             const gchar   *search,
+             const gchar   *replacement)
+{
+  GtkTextIter iter, match_start, match_end;
+  gint count = 0;
+
+  gtk_text_buffer_get_start_iter (buffer, &iter);
+
+  while (gtk_text_iter_forward_search (&iter, search, 0,
+                                       &match_start, &match_end, NULL))
+    {
+      gtk_text_buffer_delete (buffer, &match_start, &match_end);
+      gtk_text_buffer_insert (buffer, &match_start, replacement, -1);
+      iter = match_start;
+      count++;
+    }
+
+  return count;
+}
+
+/* Replace-all in a displayed buffer: the edit itself, and the
+ * relayout that follows once the main loop runs again.
+ */
+static void
+test_replace (const gchar *title,
+              const gchar *text,
+              gsize        len,
+              gboolean     freeze)
+{
+  GtkWidget *window, *sw, *view;
+  GtkTextBuffer *buffer;
+  GTimer *timer;
+  gdouble edit_time, total_time;
+  gint n_changed = 0;
+  gint count;
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  gtk_window_set_default_size (GTK_WINDOW (window), 600, 400);
+  sw = gtk_scrolled_window_new (NULL, NULL);
+  gtk_container_add (GTK_CONTAINER (window), sw);
+  view = gtk_text_view_new ();
+  gtk_container_add (GTK_CONTAINER (sw), view);
+
+  buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (view));
+  gtk_text_buffer_set_text (buffer, text, len);
+
+  gtk_widget_show_all (window);
+  flush_events ();
+
+  g_signal_connect (buffer, "changed", G_CALLBACK (count_changed), &n_changed);
+
+  timer = g_timer_new ();
+
+  gtk_text_buffer_begin_user_action (buffer);
+  if (freeze)
+    gtk_text_buffer_freeze_changes (buffer);
+
+  count = replace_all (buffer, "fox", "cat");
+
+  if (freeze)
+    gtk_text_buffer_thaw_changes (buffer);
+  gtk_text_buffer_end_user_action (buffer);
+
+  edit_time = g_timer_elapsed (timer, NULL);
+
+  flush_events ();
+
+  total_time = g_timer_elapsed (timer, NULL);
+
+  g_print ("%-16s 	%6" G_GSIZE_FORMAT "k 	%8d 	%10.1f 	%10.1f 	%8d\n",
+           title, len / 1024, count,
+           edit_time * 1000, total_time * 1000, n_changed);
+
+  g_timer_destroy (timer);
+  gtk_widget_destroy (window);
+}
+
+int
+main (int argc, char *argv[])
+{
+  static const gint sizes[] = { 10, 50, 100, 250, 500 };
+  gint i;
+
+  gtk_init_with_args (&argc, &argv, NULL, entries, NULL, NULL);
+
+  g_print ("buffer load (average over %d runs, time in milliseconds)\n"
+           "method           \tsize     \ttime       \tRSS growth\n", repeats);
+
+  if (filename)
+    {
+      GMappedFile *file;
+      GError *error = NULL;
+
+      file = g_mapped_file_new (filename, FALSE, &error);
+      if (file == NULL)
+        {
+          g_printerr ("%s\n", error->message);
+          g_error_free (error);
+          return 1;
+        }
+
+      if (!g_utf8_validate (g_mapped_file_get_contents (file),
+                            g_mapped_file_get_length (file), NULL))
+        {
+          g_printerr ("%s is not valid UTF-8\n", filename);
+          return 1;
+        }
+
+      test_text (g_mapped_file_get_contents (file),
+                 g_mapped_file_get_length (file));
+
+      g_mapped_file_unref (file);
+
+      return 0;
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (sizes); i++)
+    {
+      gchar *text;
+
+      if (sizes[i] < min_size || sizes[i] > max_size)
+        continue;
+
+      text = make_text ((gsize) sizes[i] * 1024 * 1024);
+      test_text (text, strlen (text));
+      g_free (text);
+    }
+
+  if (replace_size > 0)
+    {
+      gchar *text;
+
+      g_print ("\nreplace all (time in milliseconds)\n"
+               "method           \tsize     \tmatches  \tedit       \ttotal      \tchanged\n");
+
+      text = make_text ((gsize) replace_size * 1024);
+      test_replace ("per edit", text, strlen (text), FALSE);
+      test_replace ("frozen", text, strlen (text), TRUE);
+      g_free (text);
+    }
+
+  return 0;
+}
@@ -251,6 +251,88 @@ test_run (gchar        *title,
     }  
 }
 
+static void
+count_reordered (GtkTreeModel *model,
+		 GtkTreePath  *path,
+		 GtkTreeIter  *iter,
+		 gint         *new_order,
+		 gint         *count)
+{
+  (*count)++;
+}
+
+/* Simulates a live-updating sorted table: after filling a list store
+ * behind a sort model, a quarter of the rows get a new sort key per
+ * main loop iteration.
+ */
+static void
+test_sort_update_run (gchar    *title,
+		      gboolean  deferred)
+{
+  gint i, k, d, items;
+  GTimer *timer;
+  gdouble elapsed;
+  gint reordered;
+
+  g_print ("%s (average over %d runs, time in milliseconds)\n"
+	   "items \ttime      \ttime/item \treorders\n", title, repeats);
+
+  timer = g_timer_new ();
+
+  for (k = 0; k < max_size; k++)
+    {
+      GtkListStore *store;
+      GtkTreeModel *sort;
+
+      items = 1 << k;
+      elapsed = 0.0;
+      reordered = 0;
+
+      store = gtk_list_store_new (2, G_TYPE_INT, G_TYPE_STRING);
+      for (i = 0; i < items; i++)
+	list_store_append (GTK_TREE_MODEL (store), items, i);
+
+      sort = gtk_tree_model_sort_new_with_model (GTK_TREE_MODEL (store));
+      gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (sort), 0,
+					    GTK_SORT_ASCENDING);
+      gtk_tree_model_sort_set_deferred_resort (GTK_TREE_MODEL_SORT (sort),
+					       deferred);
+      g_signal_connect (sort, "rows-reordered",
+			G_CALLBACK (count_reordered), &reordered);
+
+      /* build the root level */
+      gtk_tree_model_iter_n_children (sort, NULL);
+
+      for (d = 0; d < repeats; d++)
+	{
+	  g_timer_reset (timer);
+	  g_timer_start (timer);
+	  for (i = 0; i < MAX (items / 4, 1); i++)
+	    {
+	      GtkTreeIter iter;
+
+	      gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (store), &iter, NULL,
+					     g_random_int_range (0, items));
+	      gtk_list_store_set (store, &iter,
+				  0, g_random_int_range (0, items), -1);
+	    }
+	  if (deferred)
+	    gtk_tree_model_sort_flush_resort (GTK_TREE_MODEL_SORT (sort));
+	  g_timer_stop (timer);
+	  elapsed += g_timer_elapsed (timer, NULL);
+	}
+
+      g_object_unref (sort);
+      g_object_unref (store);
+
+      elapsed = elapsed * 1000 / repeats;
+      g_print ("%d \t%f \t%f  \t%d\n",
+	       items, elapsed, elapsed/items, reordered / repeats);
+    }
+
+  g_timer_destroy (timer);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -326,5 +408,11 @@ main (int argc, char *argv[])
 	    (ClearFunc*)gtk_tree_store_clear, 
 	    (InsertFunc*)tree_store_insert_deep);
 
+  g_object_unref (model);
+
+  test_sort_update_run ("sort model update", FALSE);
+
+  test_sort_update_run ("sort model update (deferred resort)", TRUE);
+
   return 0;
 }